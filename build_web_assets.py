@@ -0,0 +1,61 @@
+# build_web_assets.py
+# This script is executed by PlatformIO before every target, including
+# buildfs/uploadfs. It gzips the web UI sources in web/ into data/www/ so the
+# LittleFS image carries them precompressed; the firmware serves them as is
+# with Content-Encoding: gzip (see include/web_assets.h). An uncompressed copy
+# goes next to each .gz for clients that don't accept gzip. The /static/ links
+# of the page shells get the version of the asset (?v=), the same hash the
+# firmware takes of the .gz for its ETag.
+
+import gzip
+import hashlib
+import re
+from pathlib import Path
+
+# --- Configuration ---
+SOURCE_DIR = Path("web")
+OUTPUT_DIR = Path("data/www")
+EXTENSIONS = {".html", ".css", ".js", ".svg"}
+STATIC_LINK = re.compile(r"/static/([\w.-]+)")
+
+def write_if_changed(target, data):
+    if not target.is_file() or target.read_bytes() != data:
+        target.write_bytes(data)
+
+# --- Main Logic ---
+try:
+    OUTPUT_DIR.mkdir(parents=True, exist_ok=True)
+    sources = sorted(p for p in SOURCE_DIR.iterdir() if p.suffix in EXTENSIONS)
+    # The shells last, they link the versions of the others
+    sources.sort(key=lambda p: p.suffix == ".html")
+    versions = {}
+    expected = set()
+    raw_total = 0
+    gz_total = 0
+    for source in sources:
+        data = source.read_bytes()
+        if source.suffix == ".html":
+            def versioned(match):
+                version = versions.get(match.group(1))
+                return match.group(0) + "?v=" + version if version else match.group(0)
+            data = STATIC_LINK.sub(versioned, data.decode("utf-8")).encode("utf-8")
+        # mtime=0 keeps the output, and so the ETag the firmware derives from
+        # it, the same for the same source
+        packed = gzip.compress(data, compresslevel=9, mtime=0)
+        versions[source.name] = hashlib.sha256(packed).hexdigest()[:16]
+        raw_total += len(data)
+        gz_total += len(packed)
+        write_if_changed(OUTPUT_DIR / (source.name + ".gz"), packed)
+        write_if_changed(OUTPUT_DIR / source.name, data)
+        expected.update({source.name + ".gz", source.name})
+        print(f"  - {source.name}: {len(data)} -> {len(packed)} bytes, version {versions[source.name]}")
+
+    # Assets whose source was removed
+    for stale in OUTPUT_DIR.iterdir():
+        if stale.is_file() and stale.name not in expected:
+            stale.unlink()
+
+    print(f"Compressed {len(sources)} web assets into {OUTPUT_DIR}: {raw_total} -> {gz_total} bytes")
+
+except Exception as e:
+    print(f"Error compressing web assets: {e}")
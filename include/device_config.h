@@ -0,0 +1,107 @@
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+// --- Device Config ---
+// The settings of the "beecounter" NVS namespace, read from flash once at
+// boot and kept in RAM. Readers copy a snapshot under a spinlock, writers
+// collect their changes in a Batch whose commit() writes the changed keys to
+// NVS in one session (write-through), bumps the version and then tells the
+// listeners which keys changed. The NVS keys and value types are the ones the
+// firmware always used, so stored settings carry over.
+#define DEVICE_CONFIG_NAMESPACE     "beecounter"
+#define DEVICE_CONFIG_MAX_LISTENERS 4
+
+enum ConfigKey : uint8_t {
+    CONFIG_DEVICE_NAME,
+    CONFIG_SSID,
+    CONFIG_PASSWORD,
+    CONFIG_ADMIN_PASS,      // SHA-256 hex of the admin password
+    CONFIG_DEFAULT_PASS,    // admin/admin is still accepted
+    CONFIG_TIMEZONE,
+    CONFIG_EI_API_KEY,
+    CONFIG_CAM_RESOLUTION,
+    CONFIG_CAM_QUALITY,
+    CONFIG_LOGIN_FAILS,     // failed logins at the last global lockout, see login_guard.h
+    CONFIG_LAST_FAIL_TIME,
+    CONFIG_HISTORY_SNAPSHOT,    // hourly telemetry history file, see telemetry_history.h
+    CONFIG_KEY_COUNT
+};
+
+#define CONFIG_BIT(key) (1UL << (key))
+
+struct DeviceSettings {
+    uint32_t version;       // bumped by every commit that changed something
+    char deviceName[33];
+    char ssid[33];
+    char password[65];
+    char adminPass[65];
+    bool isDefaultPass;
+    char timezone[48];
+    char eiApiKey[128];
+    char camResolution[8];
+    int32_t camQuality;
+    int32_t loginFails;
+    uint32_t lastFailTime;
+    bool historySnapshot;
+};
+
+// Called by the committing task after the new values are visible
+typedef std::function<void(uint32_t changedKeys)> ConfigListener;
+
+class DeviceConfig {
+public:
+    class Batch {
+    public:
+        // false if the key has another type or the text does not fit, the
+        // batch then commits nothing
+        bool setString(ConfigKey key, const char* value);
+        bool setBool(ConfigKey key, bool value);
+        bool setInt(ConfigKey key, int32_t value);
+        bool setULong(ConfigKey key, uint32_t value);
+
+        // Writes the keys whose value changed, false if a set failed
+        bool commit();
+
+    private:
+        friend class DeviceConfig;
+        explicit Batch(DeviceConfig& owner);
+
+        DeviceConfig& config;
+        DeviceSettings values;
+        uint32_t dirty;
+        bool invalid;
+    };
+
+    DeviceConfig();
+
+    // Loads every key, writes the defaults of missing ones
+    void begin();
+
+    DeviceSettings get() const;
+    uint32_t version() const;
+    Batch edit() { return Batch(*this); }
+
+    // Clears the namespace and goes back to the defaults
+    void reset();
+
+    bool onChange(uint32_t keys, ConfigListener listener);
+
+private:
+    void apply(const DeviceSettings& values, uint32_t changed);
+    void notify(uint32_t changed);
+
+    DeviceSettings current;
+    struct {
+        uint32_t keys;
+        ConfigListener listener;
+    } listeners[DEVICE_CONFIG_MAX_LISTENERS];
+    size_t listenerCount;
+};
+
+extern DeviceConfig deviceConfig;
+
+#endif // DEVICE_CONFIG_H
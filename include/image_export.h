@@ -0,0 +1,44 @@
+#ifndef IMAGE_EXPORT_H
+#define IMAGE_EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ESPAsyncWebServer.h>
+#include "image_index.h"
+
+// --- Image Export ---
+// GET /api/images/export sends the selected images as one uncompressed tar,
+// labelled images in a directory named after their label. The archive length
+// is known up front from the image index, so it goes out with a
+// Content-Length and the response filler produces it piece by piece as the
+// socket takes it: a 512 byte header per image, the file read in place, the
+// padding and the end of archive blocks. RAM use is the same for one image or
+// thousands. A single Range on the archive resumes an interrupted download;
+// the ETag covers the selection, so an If-Range from before an image was
+// added or deleted gets the whole archive again. Without If-Range (curl -C -)
+// the offsets still hold: a deleted image keeps its place in the archive as
+// a pax extended header of the same length holding only a comment, which tar
+// skips, or as zeros when no image follows, which read as the end of the
+// archive. New images go after the last one. Only the compaction of the
+// image index at boot moves them, a resume across a reboot needs If-Range.
+#define TAR_BLOCK_SIZE  512
+#define TAR_TYPE_FILE   '0'
+#define TAR_TYPE_PAX    'x'     // pax extended header of the next entry
+
+struct ImageExportFilter {
+    uint32_t fromTime;      // capture time, unix seconds, inclusive
+    uint32_t toTime;
+    char label[IMAGE_LABEL_LEN];    // empty for every label
+};
+
+// Fills a ustar header block, false if the name doesn't fit
+bool tarHeader(uint8_t* block, const char* name, uint32_t size, uint32_t mtime, char type = TAR_TYPE_FILE);
+
+// Offset of the entry after one of size bytes
+inline size_t tarEntrySize(uint32_t size) {
+    return TAR_BLOCK_SIZE + ((size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE) * TAR_BLOCK_SIZE;
+}
+
+void sendImageExport(AsyncWebServerRequest* request, const ImageExportFilter& filter);
+
+#endif // IMAGE_EXPORT_H
@@ -0,0 +1,79 @@
+#ifndef IMAGE_INDEX_H
+#define IMAGE_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ESPAsyncWebServer.h>
+#include <FS.h>
+
+// --- Image Index ---
+// Metadata of every stored sample in one file of fixed size records, so
+// listing the images doesn't open each of them. Captures append a record and
+// deletes mark theirs deleted in place, so a record keeps its position until
+// the index is compacted at boot. A position is therefore a stable cursor for
+// paging through the list while images are added and deleted. Without a
+// valid index file it is rebuilt from IMAGE_DIR once at boot.
+#define IMAGE_DIR                 "/images"
+#define IMAGE_INDEX_PATH          "/images.idx"
+#define IMAGE_INDEX_MAGIC         0x58444942  // "BIDX"
+#define IMAGE_INDEX_VERSION       1
+#define IMAGE_NAME_LEN            32
+#define IMAGE_LABEL_LEN           24
+#define IMAGE_RECORD_DELETED      0x01
+#define IMAGE_LIST_DEFAULT_LIMIT  50
+#define IMAGE_LIST_MAX_LIMIT      200
+
+struct ImageRecord {
+    char name[IMAGE_NAME_LEN];      // file name in IMAGE_DIR
+    char label[IMAGE_LABEL_LEN];    // empty if the capture had none
+    uint32_t size;
+    uint32_t timestamp;             // unix time of the capture
+    uint16_t width;
+    uint16_t height;
+    uint32_t flags;
+};
+
+class ImageIndex {
+public:
+    ImageIndex();
+
+    // Opens the index, or rebuilds it from IMAGE_DIR. Needs a mounted LittleFS.
+    void begin();
+
+    // Records an image written to IMAGE_DIR. The label is cut to the
+    // characters a JSON string and a file name can take without escaping.
+    bool add(const char* name, uint32_t size, uint32_t timestamp, const char* label, uint16_t width, uint16_t height);
+
+    // Marks the record of an image deleted, false if there is none
+    bool remove(const char* name);
+
+    // Position of the record of an image, -1 if there is none
+    int32_t find(const char* name, ImageRecord* out = nullptr);
+
+    // Up to maxCount records that aren't deleted (or all of them), from
+    // position pos on. next is the position after the last record looked at.
+    size_t read(uint32_t pos, ImageRecord* out, size_t maxCount, uint32_t* next, bool withDeleted = false);
+
+    size_t count() const { return liveCount; }
+    uint32_t positions() const { return recordCount; }
+
+private:
+    int32_t findLocked(const char* name, ImageRecord* out);
+    bool rebuild();
+    bool compact();
+
+    uint32_t recordCount;
+    size_t liveCount;
+};
+
+// Width and height from the SOF marker in the first 16 KB of a JPEG, read
+// from the start of the file
+bool readJpegSize(File& file, uint16_t* width, uint16_t* height);
+
+// GET /api/images?cursor=&limit=, the page is serialized record by record
+// into the chunked response
+void sendImageList(AsyncWebServerRequest* request, uint32_t cursor, size_t limit);
+
+extern ImageIndex imageIndex;
+
+#endif // IMAGE_INDEX_H
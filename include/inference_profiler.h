@@ -0,0 +1,65 @@
+#ifndef INFERENCE_PROFILER_H
+#define INFERENCE_PROFILER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Inference Profiler ---
+// Keeps the per operator timings of the last few inferences. The Edge Impulse
+// SDK reports them through the ei_tflite_profiler_* hooks (implemented in
+// inference_profiler.cpp) when the firmware is built with
+// -DEI_CLASSIFIER_TFLITE_OP_PROFILER=1. Without that flag the hooks are never
+// called and inference runs without a profiler.
+#define INFERENCE_PROFILER_HISTORY  8
+#define INFERENCE_PROFILER_MAX_OPS  64
+
+struct InferenceProfileOp {
+    const char* name;   // static string owned by the TFLite op registration
+    uint32_t us;
+};
+
+struct InferenceProfile {
+    uint32_t sequence;
+    uint32_t timestamp;     // millis() when the inference finished
+    uint32_t invokeUs;
+    uint32_t arenaUsed;
+    uint32_t arenaSize;
+    uint16_t opCount;
+    uint16_t opsDropped;    // operators past INFERENCE_PROFILER_MAX_OPS
+    InferenceProfileOp ops[INFERENCE_PROFILER_MAX_OPS];
+};
+
+// Written from the inference task, read from the web server, so every access
+// goes through a short critical section.
+class InferenceProfiler {
+public:
+    InferenceProfiler();
+
+    void setEnabled(bool enable);
+    bool isEnabled() const { return enabled; }
+    void clear();
+
+    void recordOp(const char* name, uint32_t us);
+    void recordInvoke(uint32_t invokeUs, size_t arenaUsed, size_t arenaSize);
+
+    // Number of inferences recorded since boot (or clear()), compare it to
+    // notice a new one
+    uint32_t sequence() const { return seq; }
+    size_t count() const;
+    uint32_t arenaHighWater() const { return highWater; }
+
+    // Copy a recorded inference, age 0 is the most recent one
+    bool get(size_t age, InferenceProfile& out) const;
+
+private:
+    volatile bool enabled;
+    uint32_t seq;
+    uint32_t highWater;
+    size_t head;
+    InferenceProfile pending;
+    InferenceProfile history[INFERENCE_PROFILER_HISTORY];
+};
+
+extern InferenceProfiler inferenceProfiler;
+
+#endif // INFERENCE_PROFILER_H
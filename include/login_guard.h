@@ -0,0 +1,79 @@
+#ifndef LOGIN_GUARD_H
+#define LOGIN_GUARD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+// --- Login Guard ---
+// Failed logins per client IP in a small RAM table. After
+// LOGIN_GUARD_FREE_FAILS failures a client has to wait before its next
+// attempt, LOGIN_GUARD_BASE_LOCK_MS doubling with every further failure up to
+// LOGIN_GUARD_MAX_LOCK_MS. Failures from all clients also add up, at
+// LOGIN_GUARD_GLOBAL_FAILS every client is locked out for
+// LOGIN_GUARD_MAX_LOCK_MS, which bounds attackers that change their address.
+// The table lives in RAM, the listener only hears about the global lockout
+// starting and ending and the successful login that clears it, so a reboot
+// doesn't end a lockout, one that ended isn't restored by the next boot, and
+// guesses don't cost NVS writes on the request path.
+#define LOGIN_GUARD_CLIENTS         8
+#define LOGIN_GUARD_FREE_FAILS      3
+#define LOGIN_GUARD_BASE_LOCK_MS    2000UL
+#define LOGIN_GUARD_MAX_LOCK_MS     (5UL * 60 * 1000)
+#define LOGIN_GUARD_FORGET_MS       (15UL * 60 * 1000)  // unlocked clients idle this long are dropped
+#define LOGIN_GUARD_GLOBAL_FAILS    50
+
+struct LoginGuardStats {
+    uint32_t failures;          // since the last successful login, all clients
+    uint32_t lockouts;          // per client and global
+    uint32_t rejected;          // attempts refused while locked out
+    uint32_t persisted;         // listener calls
+    uint32_t clients;
+};
+
+// Called with the failure count to store, 0 after a successful login or once
+// the global lockout is over
+typedef std::function<void(uint32_t failures)> LockoutListener;
+
+class LoginGuard {
+public:
+    LoginGuard();
+
+    // The count stored by the last lockout before the reboot. A count at the
+    // global limit keeps everyone locked out for LOGIN_GUARD_MAX_LOCK_MS.
+    void begin(uint32_t storedFailures, uint32_t nowMs);
+    void onLockout(LockoutListener listener);
+
+    // Milliseconds until the client may try again, 0 if it may now
+    uint32_t retryAfter(uint32_t ip, uint32_t nowMs);
+
+    void recordFailure(uint32_t ip, uint32_t nowMs);
+    void recordSuccess(uint32_t ip);
+
+    LoginGuardStats stats() const;
+
+private:
+    struct Client {
+        uint32_t ip;
+        uint32_t fails;
+        uint32_t lastFailMs;
+        uint32_t lockMs;        // from lastFailMs, 0 if not locked out
+        bool used;
+    };
+
+    Client* find(uint32_t ip);
+    Client* claim(uint32_t ip, uint32_t nowMs);
+    bool forget(uint32_t nowMs);
+    void notify(uint32_t failures);
+
+    Client clients[LOGIN_GUARD_CLIENTS];
+    bool globalLocked;
+    uint32_t globalLockStartMs;
+    uint32_t storedFailures;
+    LoginGuardStats st;
+    LockoutListener listener;
+};
+
+extern LoginGuard loginGuard;
+
+#endif // LOGIN_GUARD_H
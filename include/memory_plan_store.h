@@ -0,0 +1,77 @@
+#ifndef MEMORY_PLAN_STORE_H
+#define MEMORY_PLAN_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Memory Plan Store ---
+// The Edge Impulse SDK records where every tensor of the model goes in the
+// arena the first time it runs the greedy memory planner (see
+// tflite_memory_plan.h) and replays that plan afterwards. This keeps the
+// plans across reboots through the ei_tflite_memory_plan_* hooks
+// (implemented in memory_plan_store.cpp), so even the first inference after a
+// boot skips the planner. There is a slot per model for the last
+// MEMORY_PLAN_SLOTS models, so impulses that take turns each keep theirs, and
+// a plan is only written when its model has none stored or it changed.
+#define MEMORY_PLAN_PATH          "/memory_plan"
+// The largest plan the SDK records: a 16 byte header and 16 bytes for each
+// of EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MAX_BUFFERS (256) buffers
+#define MEMORY_PLAN_MAX_SIZE      (16 + 256 * 16)
+#define MEMORY_PLAN_SLOTS         4
+// Where earlier firmware kept the plans, erased at boot
+#define MEMORY_PLAN_NVS_NAMESPACE "memplan"
+
+struct MemoryPlanStats {
+    uint32_t modelHash;     // model of the plan last loaded or stored, 0 if none
+    uint32_t planSize;
+    uint32_t plans;         // plans stored
+    uint32_t writes;        // plans written since boot
+    uint32_t hits;          // AllocateTensors() calls that reused the plan
+    uint32_t misses;        // AllocateTensors() calls that ran the planner
+    uint32_t plannedUs;     // last AllocateTensors() with the planner
+    uint32_t cachedUs;      // last AllocateTensors() with the stored plan
+};
+
+// A plan is a file per slot, on the ESP32 in LittleFS: the 24 KB NVS
+// partition holds the settings and can't take 4 plans of up to 4 KB.
+// Only called from the inference task, the stats are plain 32 bit values so
+// the web server can read them without a lock.
+class MemoryPlanStore {
+public:
+    MemoryPlanStore();
+
+    // File to keep the plans in, a slot number is appended. Needs LittleFS
+    // mounted on the ESP32.
+    void begin(const char* path = nullptr);
+
+    size_t load(uint32_t modelHash, void* buf, size_t bufSize);
+    void store(uint32_t modelHash, const void* plan, size_t planSize);
+    void recordAllocate(bool cached, uint32_t allocateUs);
+    void clear();
+
+    MemoryPlanStats stats() const { return st; }
+
+private:
+    struct Slot {
+        uint32_t modelHash; // 0 if free
+        uint32_t planSize;
+        uint32_t lastUsed;
+    };
+
+    int find(uint32_t modelHash) const;
+    // The model's slot, else a free one, else the least recently used
+    int pick(uint32_t modelHash) const;
+    void use(int slot);
+    size_t readSlot(int slot, void* buf, size_t bufSize);
+    bool writeSlot(int slot, uint32_t modelHash, const void* plan, size_t planSize);
+    void countPlans();
+
+    Slot slots[MEMORY_PLAN_SLOTS];
+    uint32_t useCounter;
+    MemoryPlanStats st;
+    char path[256];
+};
+
+extern MemoryPlanStore memoryPlanStore;
+
+#endif // MEMORY_PLAN_STORE_H
@@ -0,0 +1,124 @@
+#ifndef MODEL_LOADER_H
+#define MODEL_LOADER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Model Image Layout ---
+// A 64 byte header followed by the TFLite flatbuffer. The header is written
+// last, so an interrupted upload leaves no valid model behind.
+#define MODEL_IMAGE_MAGIC       0x444D4945 // "EIMD"
+#define MODEL_IMAGE_VERSION     1
+#define MODEL_IMAGE_HEADER_SIZE 64
+
+// Matches the "model" entry in partitions_8mb.csv
+#define MODEL_PARTITION_LABEL   "model"
+#define MODEL_PARTITION_SUBTYPE 0x40
+
+// Largest model accepted by the posix backend
+#define MODEL_POSIX_MAX_SIZE    (16 * 1024 * 1024)
+
+// How long beginWrite() waits for running inferences to let go of the model
+#define MODEL_READER_WAIT_MS    5000
+
+struct ModelImageHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t modelSize;
+    uint32_t arenaSize;   // 0 = use the arena size the model was compiled with
+    uint32_t crc32;       // zlib CRC-32 of the flatbuffer
+    char name[44];
+};
+
+static_assert(sizeof(ModelImageHeader) == MODEL_IMAGE_HEADER_SIZE, "model image header must stay 64 bytes");
+
+// Maps a TFLite model straight from flash so the weights are read through the
+// cache instead of being copied to RAM. On the ESP32 the model lives in the
+// "model" partition (esp_partition_mmap), elsewhere in a file (mmap), which
+// lets the loader run on a Linux host.
+//
+// The Edge Impulse SDK gets the model through acquire() / release() (the
+// ei_tflite_model_* hooks in model_loader.cpp), so every inference builds its
+// interpreter from the mapped model. A writer first takes the claim, which
+// makes acquire() hand out nothing (the SDK falls back to the compiled model)
+// until the write ends; beginWrite() then waits for the inferences still
+// holding the model, because on the ESP32 the flash under the mapping is
+// about to be erased. begin(), reload() and unload() are for setup and must
+// not run while a model is acquired.
+class ModelLoader {
+public:
+    ModelLoader();
+    ~ModelLoader();
+
+    // Find the partition (path is ignored) or remember the file path, then map
+    // the model if there is a valid one. Returns true if a model is loaded.
+    bool begin(const char* path = nullptr);
+    bool reload();
+    void unload();
+
+    // Take the writer, false if another upload holds it. From any task. The
+    // claimer ends every claim with endWrite() or abortWrite(), also after a
+    // failed beginWrite() or write().
+    bool claimWrite();
+
+    // Stream a new flatbuffer in, then commit it with endWrite()
+    bool beginWrite();
+    bool write(const uint8_t* data, size_t len);
+    bool endWrite(const char* name, uint32_t arenaSize);
+    void abortWrite();
+
+    bool isLoaded() const { return modelData != nullptr; }
+    bool isWriting() const { return claimed; }
+    const uint8_t* data() const { return modelData; }
+    size_t size() const { return modelData ? header.modelSize : 0; }
+    uint32_t arenaSize() const { return modelData ? header.arenaSize : 0; }
+    uint32_t crc() const { return modelData ? header.crc32 : 0; }
+    const char* name() const { return modelData ? header.name : ""; }
+    size_t capacity() const;
+    size_t bytesWritten() const { return writeSize; }
+    // Bumped every time a model is mapped, compare it to notice a new model
+    uint32_t generation() const { return gen; }
+    const char* lastError() const { return error; }
+
+    // The mapped model for one inference, nullptr if there is none or a write
+    // is claimed. The model stays mapped until the matching release().
+    const uint8_t* acquire();
+    void release();
+
+private:
+    bool map();
+    bool fail(const char* message);
+    bool waitForReaders();
+    void discardWrite();
+    void endClaim();
+
+    ModelImageHeader header;
+    const uint8_t* modelData;
+    uint32_t gen;
+    char error[64];
+
+    bool claimed;
+    bool writing;
+    size_t writeSize;
+    uint32_t writeCrc;
+    uint32_t readers;
+
+#if defined(ESP_PLATFORM)
+    const void* partition;
+    uint32_t mapHandle;
+    size_t erasedSize;
+#else
+    char path[256];
+    const void* mapAddr;
+    size_t mapSize;
+    int writeFd;
+#endif
+};
+
+extern ModelLoader modelLoader;
+
+// zlib compatible CRC-32, pass 0 to start and the previous result to continue
+uint32_t modelCrc32(uint32_t crc, const uint8_t* data, size_t len);
+
+#endif // MODEL_LOADER_H
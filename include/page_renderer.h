@@ -0,0 +1,94 @@
+#ifndef PAGE_RENDERER_H
+#define PAGE_RENDERER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+// --- Page Renderer ---
+// Renders an HTML page piece by piece straight into the buffer of a chunked
+// response, so the page never exists as a whole in RAM. A page is a template
+// kept in flash (a const char array) with {{name}} placeholders. A
+// placeholder is replaced by a short text copied into the renderer, by
+// another template rendered with the same values, or by a reader that streams
+// e.g. a file. Texts and streamed values are HTML escaped unless set with
+// setRaw(). All state lives in the fixed size object, rendering allocates
+// nothing; unknown placeholders render as nothing.
+#define PAGE_RENDERER_MAX_VALUES  16
+#define PAGE_RENDERER_VALUE_SPACE 768   // copied texts of one page
+#define PAGE_RENDERER_MAX_DEPTH   4     // templates inside templates
+#define PAGE_RENDERER_READ_CHUNK  128   // staging buffer of a reader value
+
+// Fills buf with up to len bytes of the value, 0 once it is complete
+typedef std::function<size_t(char* buf, size_t len)> PageReader;
+
+// Names must outlive the renderer, they are not copied (use literals)
+class PageRenderer {
+public:
+    explicit PageRenderer(const char* tpl);
+
+    bool set(const char* name, const char* text);
+    bool setRaw(const char* name, const char* html);
+    bool setTemplate(const char* name, const char* tpl);
+    bool setReader(const char* name, PageReader reader);
+
+    // Next piece of the page, 0 once it is complete
+    size_t read(uint8_t* buf, size_t maxLen);
+
+    bool done() const;
+    // A value did not fit in the value table or PAGE_RENDERER_VALUE_SPACE
+    bool overflowed() const { return overflow; }
+    size_t rendered() const { return total; }
+
+private:
+    enum ValueKind : uint8_t { VALUE_TEXT, VALUE_RAW, VALUE_TEMPLATE, VALUE_READER };
+    struct Value {
+        const char* name;
+        size_t nameLen;
+        ValueKind kind;
+        const char* data;
+        size_t len;
+        PageReader reader;
+    };
+    struct Frame {
+        const char* tpl;
+        size_t pos;
+    };
+
+    Value* addValue(const char* name, ValueKind kind);
+    bool copyValue(const char* name, const char* text, ValueKind kind);
+    const Value* find(const char* name, size_t nameLen) const;
+    size_t escape(uint8_t* buf, size_t space, const char* src, size_t len, size_t& pos);
+
+    Value values[PAGE_RENDERER_MAX_VALUES];
+    size_t valueCount;
+    char space[PAGE_RENDERER_VALUE_SPACE];
+    size_t spaceUsed;
+    bool overflow;
+
+    Frame stack[PAGE_RENDERER_MAX_DEPTH];
+    size_t depth;
+
+    // Value being written out
+    const Value* current;
+    size_t currentPos;
+    char chunk[PAGE_RENDERER_READ_CHUNK];
+    size_t chunkLen;
+
+    // Escaped character that did not fit in the last buffer
+    char pending[8];
+    uint8_t pendingLen;
+    uint8_t pendingPos;
+
+    size_t total;
+};
+
+#if defined(ESP_PLATFORM)
+class AsyncWebServerRequest;
+
+// Sends the page as a chunked text/html response and takes ownership of it.
+// A page that overflowed the renderer is answered with 500 instead.
+void sendPage(AsyncWebServerRequest* request, PageRenderer* page, int code = 200);
+#endif
+
+#endif // PAGE_RENDERER_H
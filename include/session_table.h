@@ -0,0 +1,76 @@
+#ifndef SESSION_TABLE_H
+#define SESSION_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Session Table ---
+// Logged in browsers and scripts, each with its own 128 bit token from the
+// hardware RNG in the BEE_SESSION cookie. A session ends after
+// SESSION_IDLE_TIMEOUT_MS without a request, SESSION_MAX_AGE_MS after the
+// login, on logout, when the table is full and a new login evicts the
+// least recently used one, or for all of them when the password changes or
+// the device is reset. Tokens are compared in constant time against every
+// slot, so neither the comparison nor the slot it matched can be timed.
+#define SESSION_COOKIE_NAME     "BEE_SESSION"
+#define SESSION_TABLE_SIZE      8
+#define SESSION_TOKEN_BYTES     16
+#define SESSION_TOKEN_HEX_LEN   (SESSION_TOKEN_BYTES * 2)
+#define SESSION_IDLE_TIMEOUT_MS (30UL * 60 * 1000)
+#define SESSION_MAX_AGE_MS      (12UL * 60 * 60 * 1000)
+
+struct SessionStats {
+    uint32_t active;
+    uint32_t created;
+    uint32_t evicted;       // dropped for a newer login while still valid
+    uint32_t expired;
+    uint32_t rejected;      // cookies that matched no session
+};
+
+class SessionTable {
+public:
+    SessionTable();
+
+    // Starts a session and writes its token as SESSION_TOKEN_HEX_LEN hex
+    // digits plus a terminating NUL
+    void create(char* tokenHex);
+
+    // Looks up the session cookie of a Cookie header and refreshes its idle timer
+    bool validate(const char* cookieHeader);
+
+    // Ends the session of a Cookie header, if any
+    void remove(const char* cookieHeader);
+    // Ends every session
+    void clear();
+
+    SessionStats stats() const;
+
+private:
+    struct Session {
+        uint8_t token[SESSION_TOKEN_BYTES];
+        uint32_t createdMs;
+        uint32_t lastUsedMs;
+        uint32_t lastUse;       // useClock at the last request, orders the LRU
+        bool active;
+    };
+
+    int find(const uint8_t* token);
+    void expire(uint32_t now);
+
+    Session sessions[SESSION_TABLE_SIZE];
+    uint32_t useClock;
+    SessionStats st;
+};
+
+// The token of SESSION_COOKIE_NAME in a Cookie header, false if there is none
+// or it is not SESSION_TOKEN_HEX_LEN hex digits
+bool sessionCookieToken(const char* cookieHeader, uint8_t* token);
+
+extern SessionTable sessionTable;
+
+#if !defined(ESP_PLATFORM)
+// The clock of host builds, tests replace it to step through the timeouts
+extern uint32_t (*sessionHostMillis)();
+#endif
+
+#endif // SESSION_TABLE_H
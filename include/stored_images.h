@@ -0,0 +1,50 @@
+#ifndef STORED_IMAGES_H
+#define STORED_IMAGES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ESPAsyncWebServer.h>
+
+// --- Stored Images ---
+// The samples in IMAGE_DIR never change once written and their names carry
+// the capture time, so they are sent with a long lived immutable
+// Cache-Control, an ETag and Last-Modified made from the name and size, and
+// conditional requests are answered with an empty 304. A single byte range
+// gets a 206 streamed from the file. Thumbnails are decoded from the JPEG at
+// 1/2, 1/4 or 1/8 scale, re-encoded and kept in IMAGE_THUMB_DIR. A task
+// makes them in the background, queued when an image is captured or its
+// thumbnail is asked for first. Until it exists the whole image is sent
+// uncached, the web server never waits for a decode.
+#define IMAGE_THUMB_DIR         "/thumbs"
+#define IMAGE_THUMB_MIN_WIDTH   160     // the largest scale that keeps at least this
+#define IMAGE_THUMB_QUALITY     60
+#define IMAGE_THUMB_QUEUE       16      // names waiting, a full queue drops new ones
+#define IMAGE_THUMB_CORE        0       // the decode stays off the core of loop() (1)
+#define IMAGE_THUMB_PRIORITY    1       // below the web server
+#define IMAGE_CACHE_CONTROL     "private, max-age=31536000, immutable"
+
+enum ByteRangeResult {
+    BYTE_RANGE_NONE,            // no usable Range header, send the whole file
+    BYTE_RANGE_OK,
+    BYTE_RANGE_UNSATISFIABLE    // 416
+};
+
+// Parses a single range "bytes=first-last", "bytes=first-" or "bytes=-suffix"
+// against a file of size bytes. Several ranges are answered with the whole file.
+ByteRangeResult parseByteRange(const char* header, size_t size, size_t* first, size_t* last);
+
+// False for names that aren't a plain file name in IMAGE_DIR
+bool isImageName(const char* name);
+
+void sendStoredImage(AsyncWebServerRequest* request, const char* name);
+void sendThumbnail(AsyncWebServerRequest* request, const char* name);
+
+// Starts the thumbnail task, false if it couldn't be created
+bool beginThumbnails();
+// Queues a thumbnail of a stored image, never blocks
+void queueThumbnail(const char* name);
+
+// The image, its index record and its thumbnail. False if there is no such image.
+bool removeStoredImage(const char* name);
+
+#endif // STORED_IMAGES_H
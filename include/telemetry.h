@@ -0,0 +1,107 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#include <ESPAsyncWebServer.h>
+#endif
+
+// --- Telemetry ---
+// Performance samples for the Observability page over a WebSocket in binary
+// frames. A sample is taken every TELEMETRY_SAMPLE_MS while at least one
+// client is connected, and the samples collected since the last frame go out
+// together every refresh interval. A frame is
+//
+//   u8 TELEMETRY_FRAME_VERSION, u8 sample count,
+//   per sample TELEMETRY_FIELD_COUNT zigzag varints, in TelemetryField order
+//
+// where each value is the difference to the same field of the previous sample
+// in the frame (the first sample to zero), so every frame decodes on its own
+// and slowly changing fields take a byte. Without clients nothing is sampled,
+// encoded or sent.
+#define TELEMETRY_WS_URI          "/ws/telemetry"
+#define TELEMETRY_SAMPLE_MS       1000
+#define TELEMETRY_MAX_BATCH       16
+#define TELEMETRY_FRAME_VERSION   1
+
+enum TelemetryField {
+    TELEMETRY_MILLIS,
+    TELEMETRY_CPU0,             // 0.1 %
+    TELEMETRY_CPU1,
+    TELEMETRY_HEAP_FREE,        // bytes
+    TELEMETRY_HEAP_TOTAL,
+    TELEMETRY_FLASH_USED,
+    TELEMETRY_FLASH_TOTAL,
+    TELEMETRY_RSSI,             // dBm
+    TELEMETRY_TEMP,             // 0.1 °C
+    TELEMETRY_FIELD_COUNT
+};
+
+// A varint takes at most 5 bytes
+#define TELEMETRY_MAX_FRAME (2 + TELEMETRY_MAX_BATCH * TELEMETRY_FIELD_COUNT * 5)
+
+struct TelemetrySample {
+    int32_t values[TELEMETRY_FIELD_COUNT];
+};
+
+// Writes value as the zigzag varint of its change from previous, at most 5
+// bytes. Unsigned math, so the millis() wrap is just another change.
+size_t telemetryPutDelta(uint8_t* out, int32_t value, int32_t previous);
+
+class TelemetryEncoder {
+public:
+    TelemetryEncoder();
+
+    // False when the batch is full
+    bool add(const TelemetrySample& sample);
+    size_t count() const { return sampleCount; }
+
+    // Writes the batch as one frame of at most TELEMETRY_MAX_FRAME bytes and
+    // starts the next batch
+    size_t finish(uint8_t* out);
+
+private:
+    TelemetrySample samples[TELEMETRY_MAX_BATCH];
+    size_t sampleCount;
+};
+
+#if defined(ESP_PLATFORM)
+struct TelemetryStats {
+    uint32_t clients;
+    uint32_t samples;
+    uint32_t frames;
+    uint32_t dropped;           // frames a client skipped because it was still busy
+    uint32_t bytes;             // WebSocket payload, per client
+    uint32_t encodeUs;          // sampling and encoding
+};
+
+typedef void (*TelemetrySampler)(TelemetrySample& sample);
+
+class TelemetrySocket {
+public:
+    TelemetrySocket();
+
+    // Clients the filter rejects get a 404 instead of the upgrade
+    void begin(AsyncWebServer& server, ArRequestFilterFunction filter, TelemetrySampler sampler);
+
+    // From loop(): samples when due and sends a frame every flushMs
+    void update(uint32_t nowMs, uint32_t flushMs);
+
+    TelemetryStats stats() const;
+
+private:
+    AsyncWebSocket ws;
+    TelemetrySampler sampler;
+    TelemetryEncoder encoder;
+    TelemetryStats st;
+    uint32_t lastSampleMs;
+    uint32_t lastFlushMs;
+    bool flushSoon;             // a new client gets its first frame right away
+};
+
+extern TelemetrySocket telemetrySocket;
+#endif
+
+#endif // TELEMETRY_H
@@ -0,0 +1,147 @@
+#ifndef TELEMETRY_HISTORY_H
+#define TELEMETRY_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#include <ESPAsyncWebServer.h>
+#endif
+
+// --- Telemetry History ---
+// What the device did over the last days, kept in RAM for the Observability
+// charts. loop() adds a sample every second to the seconds ring, and the same
+// sample is folded into a running minute record that goes into the minutes
+// ring every 60 samples, which is folded into the hour record the same way.
+// Every add is a constant amount of work. A minute or hour record has the
+// mean of CPU, RSSI, temperature and frame rate over its interval, the lowest
+// free heap and PSRAM (the low-water mark) and the total of bees, and the
+// time of its first sample.
+//
+// GET /api/telemetry/history sends every tier in one binary response:
+//
+//   u8 TELEMETRY_HISTORY_VERSION, u8 tier count, u8 field count, u32 device time,
+//   per tier u16 seconds per record, u16 record count, then the records oldest
+//   first, each field a zigzag varint of the change from the previous record
+//   of the tier (the first from zero)
+//
+// with the integers little endian. With the snapshot setting on, the same
+// stream is written to TELEMETRY_HISTORY_PATH every hour and read back at
+// boot, so the history survives a reboot.
+#define TELEMETRY_HISTORY_VERSION     1
+#define TELEMETRY_HISTORY_PATH        "/telemetry.hist"
+#define TELEMETRY_HISTORY_SAMPLE_MS   1000
+#define TELEMETRY_HISTORY_TIERS       3
+#define TELEMETRY_HISTORY_SECONDS     300     // 5 minutes of 1 s records
+#define TELEMETRY_HISTORY_MINUTES     1440    // a day of 1 min records
+#define TELEMETRY_HISTORY_HOURS       168     // a week of 1 h records
+#define TELEMETRY_HISTORY_FOLD        60      // records of a tier per record of the next
+
+enum HistoryField {
+    HISTORY_TIME,               // unix seconds
+    HISTORY_CPU0,               // 0.1 %
+    HISTORY_CPU1,
+    HISTORY_HEAP_FREE,          // bytes
+    HISTORY_PSRAM_FREE,
+    HISTORY_RSSI,               // dBm
+    HISTORY_TEMP,               // 0.1 °C
+    HISTORY_FPS,                // camera frames per second, 0.1 fps
+    HISTORY_BEES_IN,
+    HISTORY_BEES_OUT,
+    HISTORY_FIELD_COUNT
+};
+
+struct HistoryRecord {
+    int32_t values[HISTORY_FIELD_COUNT];
+};
+
+class TelemetryHistory {
+public:
+    TelemetryHistory();
+
+    // Allocates the rings, in PSRAM when there is some. Without them add()
+    // does nothing.
+    bool begin();
+
+    // One sample a second from loop(), true when it completed an hour record
+    bool add(const HistoryRecord& sample);
+
+    // From the camera and counting code, any task. Picked up by the sampler.
+    void countFrame();
+    void countBees(uint32_t in, uint32_t out);
+    // Frames and bees since the last call
+    void takeCounts(uint32_t* frames, uint32_t* beesIn, uint32_t* beesOut);
+
+    uint16_t tierSeconds(int tier) const { return tiers[tier].seconds; }
+    // Numbers of the oldest record of a tier and the one after the newest,
+    // records are numbered from the first ever pushed
+    void window(int tier, uint32_t* first, uint32_t* end) const;
+    // A record by its number. One that was overwritten in the meantime gives
+    // the oldest record still there.
+    bool get(int tier, uint32_t number, HistoryRecord& out) const;
+
+    // Puts the records of a history stream back, before the first add().
+    // False if the stream isn't one.
+    bool restore(const uint8_t* data, size_t len);
+
+    size_t memoryBytes() const;
+
+private:
+    struct Tier {
+        HistoryRecord* records;
+        uint16_t capacity;
+        uint16_t seconds;
+        uint32_t total;
+    };
+
+    // The record of the next tier being built from this one's
+    struct Fold {
+        int64_t sums[HISTORY_FIELD_COUNT];
+        HistoryRecord record;
+        uint16_t count;
+    };
+
+    void push(int tier, const HistoryRecord& record);
+    bool fold(int tier, const HistoryRecord& record);
+
+    Tier tiers[TELEMETRY_HISTORY_TIERS];
+    Fold folds[TELEMETRY_HISTORY_TIERS - 1];
+    uint32_t frames;
+    uint32_t beesIn;
+    uint32_t beesOut;
+};
+
+// The history stream of every tier, produced piece by piece. A tier's record
+// count is taken when the stream gets to it.
+class TelemetryHistoryStream {
+public:
+    TelemetryHistoryStream(const TelemetryHistory& history, uint32_t now);
+
+    // Up to maxLen bytes of the stream, 0 at the end
+    size_t read(uint8_t* buffer, size_t maxLen);
+
+private:
+    void fill();
+
+    const TelemetryHistory& history;
+    uint32_t now;
+    int tier;                   // -1 before the header
+    uint32_t next;              // number of the next record of the tier
+    uint32_t end;
+    int32_t previous[HISTORY_FIELD_COUNT];
+    uint8_t pending[HISTORY_FIELD_COUNT * 5 + 8];
+    size_t pendingLen;
+    size_t pendingPos;
+};
+
+extern TelemetryHistory telemetryHistory;
+
+#if defined(ESP_PLATFORM)
+void sendTelemetryHistory(AsyncWebServerRequest* request);
+
+// The hourly snapshot, written to a temporary file and renamed into place
+bool saveTelemetryHistory();
+bool loadTelemetryHistory();
+#endif
+
+#endif // TELEMETRY_HISTORY_H
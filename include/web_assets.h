@@ -0,0 +1,64 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ESPAsyncWebServer.h>
+
+// --- Web Assets ---
+// The page shells, CSS and JS of the web UI live in web/ and are gzipped into
+// data/www/ by build_web_assets.py, so they are part of the LittleFS image.
+// They are sent as stored with Content-Encoding: gzip, streamed from flash
+// instead of being assembled in a String on every request. A client that
+// doesn't accept gzip gets the uncompressed copy next to the .gz. Each asset
+// gets a strong ETag, the SHA-256 of its .gz taken once at boot, and a
+// request whose If-None-Match matches is answered with an empty 304. The
+// shells link the CSS and JS with the same hash as ?v=, so those URLs change
+// with their content and can be cached for good.
+#define WEB_ASSETS_DIR        "/www"
+#define WEB_ASSETS_MAX        16
+#define WEB_ASSETS_NAME_LEN   32
+#define WEB_ASSETS_STATIC_URI "/static/"
+
+// The shells are behind the login and checked against the ETag on every use,
+// so a new LittleFS image shows up right away. A CSS or JS URL whose ?v= is
+// the current version never changes, without it (or with an old one) it's
+// checked like a shell.
+#define WEB_ASSETS_PAGE_CACHE      "private, no-cache"
+#define WEB_ASSETS_STATIC_CACHE    "public, no-cache"
+#define WEB_ASSETS_VERSIONED_CACHE "public, max-age=31536000, immutable"
+
+struct WebAsset {
+    char name[WEB_ASSETS_NAME_LEN];  // "app.css", the file is WEB_ASSETS_DIR/app.css.gz
+    char version[17];                // 16 hex digits of the SHA-256
+    char etag[19];                   // the version, quoted
+    uint32_t size;                   // gzipped
+    bool identity;                   // WEB_ASSETS_DIR/app.css is there too
+};
+
+class WebAssets {
+public:
+    WebAssets();
+
+    // Indexes WEB_ASSETS_DIR, needs a mounted LittleFS. Returns the asset count.
+    size_t begin();
+
+    // GET WEB_ASSETS_STATIC_URI<name> for every asset that is not a page shell
+    void registerStatic(AsyncWebServer& server);
+
+    // Sends the asset or a 304, false if there is no such asset
+    bool send(AsyncWebServerRequest* request, const char* name, const char* cacheControl);
+
+    const WebAsset* find(const char* name) const;
+    // Hash of the asset for its ?v=, "" if there is no such asset
+    const char* version(const char* name) const;
+    size_t count() const { return assetCount; }
+
+private:
+    WebAsset assets[WEB_ASSETS_MAX];
+    size_t assetCount;
+};
+
+extern WebAssets webAssets;
+
+#endif // WEB_ASSETS_H
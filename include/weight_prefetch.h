@@ -0,0 +1,71 @@
+#ifndef WEIGHT_PREFETCH_H
+#define WEIGHT_PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Weight Prefetch ---
+// With -DEI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH=1 the Edge Impulse SDK copies
+// the filter of the next convolution into a small internal RAM staging area
+// while the current layer runs (see tflite_weight_prefetch.h). The copy goes
+// through the ei_tflite_weight_prefetch_* hooks, implemented in
+// weight_prefetch.cpp by a task pinned to WEIGHT_PREFETCH_COPY_CORE, which
+// overlaps only if the inference runs on the other core. The firmware
+// doesn't run inference itself yet, the task idles until it does. The
+// staging area can't be filled by DMA: the GDMA can't read the flash mapped
+// model. The per layer stall of the last inference is kept for /api/profiler.
+#define WEIGHT_PREFETCH_MAX_LAYERS  64
+#define WEIGHT_PREFETCH_COPY_CORE   0   // off the core of loop() (1)
+#define WEIGHT_PREFETCH_PRIORITY    5
+
+struct WeightPrefetchLayer {
+    const char* op;     // static string owned by the TFLite op registration
+    uint32_t bytes;     // staged filter bytes, 0 if the layer read the model
+    uint32_t stallUs;   // waited for the copy before the layer ran
+    uint32_t opUs;
+};
+
+struct WeightPrefetchReport {
+    uint32_t sequence;
+    uint32_t invokeUs;
+    uint32_t stallUs;
+    uint32_t copiedBytes;
+    uint16_t prefetchedLayers;
+    uint16_t layerCount;
+    WeightPrefetchLayer layers[WEIGHT_PREFETCH_MAX_LAYERS];
+};
+
+// copy() and wait() are called from the inference task only, a copy is
+// always waited for before the next one starts.
+class WeightPrefetch {
+public:
+    WeightPrefetch();
+
+    // Start the copy task, without it every copy runs synchronously
+    bool begin();
+
+    void setEnabled(bool enable) { enabled = enable; }
+    bool isEnabled() const { return enabled; }
+
+    void copy(void* dst, const void* src, size_t size);
+    void wait();
+
+    void recordLayer(const char* op, uint32_t bytes, uint32_t stallUs, uint32_t opUs);
+    void recordInvoke(uint32_t invokeUs, uint32_t stallUs, uint32_t copiedBytes, uint32_t prefetchedLayers);
+
+    // Inferences recorded since boot, 0 if the SDK never prefetched
+    uint32_t sequence() const { return seq; }
+    // Copy the report of the last inference
+    bool last(WeightPrefetchReport& out) const;
+
+private:
+    volatile bool enabled;
+    bool pending;
+    uint32_t seq;
+    WeightPrefetchReport current;
+    WeightPrefetchReport report;
+};
+
+extern WeightPrefetch weightPrefetch;
+
+#endif // WEIGHT_PREFETCH_H
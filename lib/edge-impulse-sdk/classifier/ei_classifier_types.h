@@ -217,6 +217,12 @@ typedef struct {
      * `EI_CLASSIFIER_HAS_ANOMALY == 1`.
      */
     int64_t anomaly_us;
+
+    /**
+     * Amount of time (in microseconds) it took to run the post-processing blocks
+     * (e.g. object tracking and counting)
+     */
+    int64_t postprocessing_us;
 } ei_impulse_result_timing_t;
 
 /**
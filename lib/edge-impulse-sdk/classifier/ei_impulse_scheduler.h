@@ -0,0 +1,390 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EI_CLASSIFIER_IMPULSE_SCHEDULER_H_
+#define _EI_CLASSIFIER_IMPULSE_SCHEDULER_H_
+
+/**
+ * Time-multiplexes several impulses over one tensor arena, e.g. the FOMO
+ * counter on every frame and a classifier (varroa, pollen) on crops of the
+ * tracked bees when the frame budget allows.
+ *
+ * Every inference sets its interpreter up and releases it again, so impulses
+ * that take turns never need their arenas at the same time. begin() measures
+ * the arena every TFLite graph of the added impulses really uses (what the
+ * memory planner packs, not the size the model was exported with) and
+ * allocates one arena for the largest; the interpreters are set up in it
+ * (ei_tflite_set_shared_arena()) instead of allocating their own.
+ *
+ * Per frame:
+ *   scheduler.begin_frame(frame_budget_us);
+ *   scheduler.run(counter, &signal, &result);
+ *   for each tracked bee:
+ *       scheduler.queue(varroa, &crop_signal[i], &crop_result[i]);
+ *   scheduler.run_queued();
+ *   // scheduler.job_status(i) is EI_IMPULSE_CANCELED for skipped crops
+ *
+ * run() always runs. Queued inferences run batched per impulse, highest
+ * priority (lowest number) first, so one impulse's interpreter is set up back
+ * to back for its crops and the memory plan cache only changes models once
+ * per batch. A queued inference is only started when the mean latency of its
+ * impulse still fits in what is left of the frame budget.
+ *
+ * The crop signals and results must stay valid until run_queued() returns.
+ */
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1) && !defined(EI_CLASSIFIER_ALLOCATION_STATIC)
+#define EI_IMPULSE_SCHEDULER_SHARED_ARENA           1
+#else
+#define EI_IMPULSE_SCHEDULER_SHARED_ARENA           0
+#endif
+
+#ifndef EI_CLASSIFIER_SCHEDULER_MAX_IMPULSES
+#define EI_CLASSIFIER_SCHEDULER_MAX_IMPULSES        4
+#endif
+
+// Inferences that can be queued per frame
+#ifndef EI_CLASSIFIER_SCHEDULER_MAX_JOBS
+#define EI_CLASSIFIER_SCHEDULER_MAX_JOBS            16
+#endif
+
+// Priority of impulses run() on every frame; queued ones use 1 and up
+#define EI_IMPULSE_SCHEDULER_PRIORITY_EVERY_FRAME   0
+
+typedef struct {
+    uint32_t runs;
+    uint32_t skipped;           // queued inferences that didn't fit the frame budget
+    uint32_t deadline_misses;   // inferences that took longer than the impulse deadline
+    uint32_t batches;           // frames with at least one queued inference of this impulse
+    uint32_t failed;
+    uint32_t last_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} ei_impulse_scheduler_stats_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t overruns;          // frames that took longer than their budget
+    uint32_t last_us;
+    uint32_t max_us;
+} ei_impulse_scheduler_frame_stats_t;
+
+class EiImpulseScheduler {
+public:
+    EiImpulseScheduler()
+        : impulses_count(0), jobs_count(0), frame_budget_us(0), frame_start_us(0),
+          arena(nullptr), arena_bytes(0) {
+        memset(&frame_stats, 0, sizeof(frame_stats));
+    }
+
+    ~EiImpulseScheduler() {
+        end();
+    }
+
+    /**
+     * Add an impulse, before begin()
+     *
+     * @param      handle       Initialized with run_classifier_init()
+     * @param      priority     EI_IMPULSE_SCHEDULER_PRIORITY_EVERY_FRAME or,
+     *                          for queued inferences, 1 (first) and up
+     * @param      deadline_us  Latency a single inference should stay under,
+     *                          0 for none
+     *
+     * @return     Id of the impulse for run() / queue(), -1 if full
+     */
+    int add(ei_impulse_handle_t *handle, uint8_t priority, uint32_t deadline_us = 0) {
+        if (impulses_count >= EI_CLASSIFIER_SCHEDULER_MAX_IMPULSES || arena != nullptr) {
+            return -1;
+        }
+        impulse_entry_t *entry = &entries[impulses_count];
+        entry->handle = handle;
+        entry->priority = priority;
+        entry->deadline_us = deadline_us;
+        memset(&entry->stats, 0, sizeof(entry->stats));
+        return impulses_count++;
+    }
+
+    /**
+     * Size and allocate the shared arena. Impulses still run without it
+     * (each with its own arena) if it can't be set up.
+     */
+    EI_IMPULSE_ERROR begin() {
+#if EI_IMPULSE_SCHEDULER_SHARED_ARENA == 1
+        if (arena != nullptr) {
+            return EI_IMPULSE_OK;
+        }
+
+        bool split = ei_tflite_get_arena_policy() == EI_TFLITE_ARENA_POLICY_SPLIT;
+        size_t size = 0;
+        for (size_t ix = 0; ix < impulses_count; ix++) {
+            const ei_impulse_t *impulse = entries[ix].handle->impulse;
+            for (size_t block_ix = 0; block_ix < impulse->learning_blocks_size; block_ix++) {
+                const ei_learning_block_t *block = &impulse->learning_blocks[block_ix];
+                if (block->infer_fn != &run_nn_inference) {
+                    continue;
+                }
+                ei_learning_block_config_tflite_graph_t *block_config = (ei_learning_block_config_tflite_graph_t*)block->config;
+                const ei_tflite_arena_measurement_t *measured = ei_tflite_measure_arena(
+                    (ei_config_tflite_graph_t*)block_config->graph_config);
+                if (measured == nullptr) {
+                    EI_LOGW("Failed to measure the TFLite arena of impulse %u\n", (unsigned)ix);
+                    continue;
+                }
+                // with the split policy the persistent part stays per model
+                size_t needed = measured->non_persistent + tflite::MicroArenaBufferAlignment();
+                if (!split) {
+                    needed += measured->persistent;
+                }
+                size = std::max(size, needed);
+            }
+        }
+        if (size == 0) {
+            return EI_IMPULSE_OK;
+        }
+
+        ei_tflite_arena_policy_t policy = ei_tflite_get_arena_policy();
+        arena_region = policy == EI_TFLITE_ARENA_POLICY_EXTERNAL ? EI_TFLITE_ARENA_REGION_EXTERNAL :
+            policy == EI_TFLITE_ARENA_POLICY_DEFAULT ? EI_TFLITE_ARENA_REGION_DEFAULT : EI_TFLITE_ARENA_REGION_INTERNAL;
+        arena = (uint8_t*)ei_tflite_arena_calloc(size, &arena_region);
+        if (arena == nullptr) {
+            ei_printf("Failed to allocate shared TFLite arena (%zu bytes)\n", size);
+            return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+        }
+        arena_bytes = size;
+        ei_tflite_set_shared_arena(arena, arena_bytes, arena_region);
+        EI_LOGD("Shared TFLite arena: %u bytes for %u impulses\n", (unsigned)arena_bytes, (unsigned)impulses_count);
+#endif
+        return EI_IMPULSE_OK;
+    }
+
+    /**
+     * Release the shared arena, impulses allocate their own again
+     */
+    void end() {
+#if EI_IMPULSE_SCHEDULER_SHARED_ARENA == 1
+        if (arena != nullptr) {
+            ei_tflite_set_shared_arena(nullptr, 0, EI_TFLITE_ARENA_REGION_DEFAULT);
+            ei_tflite_arena_free(arena, arena_region);
+        }
+#endif
+        arena = nullptr;
+        arena_bytes = 0;
+    }
+
+    /**
+     * Start a frame, drops whatever is still queued
+     *
+     * @param      budget_us  Time for run() and run_queued() together, 0 runs
+     *                        every queued inference
+     */
+    void begin_frame(uint32_t budget_us) {
+        jobs_count = 0;
+        frame_budget_us = budget_us;
+        frame_start_us = ei_read_timer_us();
+    }
+
+    /**
+     * Run an impulse now, whatever is left of the budget
+     */
+    EI_IMPULSE_ERROR run(int impulse, signal_t *signal, ei_impulse_result_t *result, bool debug = false) {
+        if (impulse < 0 || (size_t)impulse >= impulses_count) {
+            return EI_IMPULSE_INFERENCE_ERROR;
+        }
+        return run_impulse(&entries[impulse], signal, result, debug);
+    }
+
+    /**
+     * Queue an inference for run_queued()
+     *
+     * @return     Job index for job_status(), -1 if the queue is full
+     */
+    int queue(int impulse, signal_t *signal, ei_impulse_result_t *result) {
+        if (impulse < 0 || (size_t)impulse >= impulses_count || jobs_count >= EI_CLASSIFIER_SCHEDULER_MAX_JOBS) {
+            return -1;
+        }
+        job_t *job = &jobs[jobs_count];
+        job->impulse = (uint8_t)impulse;
+        job->signal = signal;
+        job->result = result;
+        job->status = EI_IMPULSE_CANCELED;
+        return jobs_count++;
+    }
+
+    /**
+     * Run the queued inferences that fit in the frame budget and end the frame
+     *
+     * @return     EI_IMPULSE_OK, or the first error an inference returned
+     */
+    EI_IMPULSE_ERROR run_queued(bool debug = false) {
+        EI_IMPULSE_ERROR res = EI_IMPULSE_OK;
+
+        // batches in priority order, then in the order the impulses were added
+        bool done[EI_CLASSIFIER_SCHEDULER_MAX_IMPULSES] = { false };
+        for (size_t batch = 0; batch < impulses_count; batch++) {
+            size_t next = impulses_count;
+            for (size_t ix = 0; ix < impulses_count; ix++) {
+                if (!done[ix] && (next == impulses_count || entries[ix].priority < entries[next].priority)) {
+                    next = ix;
+                }
+            }
+            done[next] = true;
+
+            impulse_entry_t *entry = &entries[next];
+            bool batched = false;
+            for (size_t job_ix = 0; job_ix < jobs_count; job_ix++) {
+                job_t *job = &jobs[job_ix];
+                if (job->impulse != next) {
+                    continue;
+                }
+                if (!fits_budget(entry)) {
+                    entry->stats.skipped++;
+                    continue;
+                }
+                job->status = run_impulse(entry, job->signal, job->result, debug);
+                if (job->status != EI_IMPULSE_OK && res == EI_IMPULSE_OK) {
+                    res = job->status;
+                }
+                batched = true;
+            }
+            if (batched) {
+                entry->stats.batches++;
+            }
+        }
+
+        uint32_t frame_us = (uint32_t)(ei_read_timer_us() - frame_start_us);
+        frame_stats.frames++;
+        frame_stats.last_us = frame_us;
+        frame_stats.max_us = std::max(frame_stats.max_us, frame_us);
+        if (frame_budget_us > 0 && frame_us > frame_budget_us) {
+            frame_stats.overruns++;
+        }
+        return res;
+    }
+
+    /**
+     * Outcome of a queued inference: EI_IMPULSE_CANCELED if it was skipped
+     */
+    EI_IMPULSE_ERROR job_status(int job) const {
+        if (job < 0 || (size_t)job >= jobs_count) {
+            return EI_IMPULSE_CANCELED;
+        }
+        return jobs[job].status;
+    }
+
+    const ei_impulse_scheduler_stats_t* get_stats(int impulse) const {
+        if (impulse < 0 || (size_t)impulse >= impulses_count) {
+            return nullptr;
+        }
+        return &entries[impulse].stats;
+    }
+
+    const ei_impulse_scheduler_frame_stats_t* get_frame_stats() const {
+        return &frame_stats;
+    }
+
+    void clear_stats() {
+        for (size_t ix = 0; ix < impulses_count; ix++) {
+            memset(&entries[ix].stats, 0, sizeof(entries[ix].stats));
+        }
+        memset(&frame_stats, 0, sizeof(frame_stats));
+    }
+
+    size_t impulses() const { return impulses_count; }
+    size_t arena_size() const { return arena_bytes; }
+
+private:
+    typedef struct {
+        ei_impulse_handle_t *handle;
+        uint8_t priority;
+        uint32_t deadline_us;
+        ei_impulse_scheduler_stats_t stats;
+    } impulse_entry_t;
+
+    typedef struct {
+        uint8_t impulse;
+        signal_t *signal;
+        ei_impulse_result_t *result;
+        EI_IMPULSE_ERROR status;
+    } job_t;
+
+    bool fits_budget(const impulse_entry_t *entry) const {
+        if (frame_budget_us == 0) {
+            return true;
+        }
+        uint64_t elapsed_us = ei_read_timer_us() - frame_start_us;
+        uint64_t expected_us = entry->stats.runs > 0 ? entry->stats.total_us / entry->stats.runs : 0;
+        return elapsed_us + expected_us <= frame_budget_us;
+    }
+
+    EI_IMPULSE_ERROR run_impulse(impulse_entry_t *entry, signal_t *signal, ei_impulse_result_t *result, bool debug) {
+        uint64_t start_us = ei_read_timer_us();
+        EI_IMPULSE_ERROR res = run_classifier(entry->handle, signal, result, debug);
+        uint32_t us = (uint32_t)(ei_read_timer_us() - start_us);
+
+        ei_impulse_scheduler_stats_t *stats = &entry->stats;
+        if (res != EI_IMPULSE_OK) {
+            stats->failed++;
+            return res;
+        }
+        if (stats->runs == 0 || us < stats->min_us) {
+            stats->min_us = us;
+        }
+        stats->max_us = std::max(stats->max_us, us);
+        stats->last_us = us;
+        stats->total_us += us;
+        stats->runs++;
+        if (entry->deadline_us > 0 && us > entry->deadline_us) {
+            stats->deadline_misses++;
+        }
+        return res;
+    }
+
+    impulse_entry_t entries[EI_CLASSIFIER_SCHEDULER_MAX_IMPULSES];
+    size_t impulses_count;
+    job_t jobs[EI_CLASSIFIER_SCHEDULER_MAX_JOBS];
+    size_t jobs_count;
+    uint32_t frame_budget_us;
+    uint64_t frame_start_us;
+    ei_impulse_scheduler_frame_stats_t frame_stats;
+    uint8_t *arena;
+    size_t arena_bytes;
+#if EI_IMPULSE_SCHEDULER_SHARED_ARENA == 1
+    ei_tflite_arena_region_t arena_region;
+#endif
+};
+
+#endif // _EI_CLASSIFIER_IMPULSE_SCHEDULER_H_
@@ -40,15 +40,15 @@
 #include "edge-impulse-sdk/classifier/ei_classifier_types.h"
 #include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 
-#if (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV5) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV5_V5_DRPAI) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOX) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_TAO_RETINANET) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_TAO_SSD) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_TAO_YOLOV3) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_TAO_YOLOV4) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV2) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLO_PRO) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV11) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV11_ABS)
-
 // The code below comes from tensorflow/lite/kernels/internal/reference/non_max_suppression.h
 // Copyright 2019 The TensorFlow Authors.  All rights reserved.
 // Licensed under the Apache License, Version 2.0
 #include <algorithm>
 #include <cmath>
 #include <deque>
+#include <functional>
 #include <queue>
+#include <vector>
 
 // A pair of diagonal corners of the box.
 struct BoxCornerEncoding {
@@ -214,6 +214,210 @@ static inline void NonMaxSuppression(const float* boxes, const int num_boxes,
   }
 }
 
+#ifndef EI_CLASSIFIER_NMS_GRID
+#define EI_CLASSIFIER_NMS_GRID 1
+#endif
+
+// Below this many boxes the pairwise loop is faster than building the grid
+#ifndef EI_CLASSIFIER_NMS_GRID_MIN_BOXES
+#define EI_CLASSIFIER_NMS_GRID_MIN_BOXES 64
+#endif
+
+// NonMaxSuppression() with the previously selected boxes bucketed into a
+// uniform grid, so a candidate is only compared against the selected boxes
+// that share a grid cell with it instead of all of them.
+//
+// Boxes that share no cell don't intersect, their IoU is 0. That never
+// suppresses (iou_threshold > 0) and leaves a soft NMS score unchanged
+// (exp(0) == 1), so visiting only the neighbours, still from the most recently
+// selected one backwards, gives exactly the same selections and scores as
+// NonMaxSuppression(). With iou_threshold <= 0 (disjoint boxes suppress each
+// other) or non-finite coordinates it falls back to NonMaxSuppression().
+//
+// The cell size is the average size of the candidates, so in a crowded frame a
+// candidate has a handful of neighbours and NMS is close to O(n log n) instead
+// of O(n^2).
+static inline void NonMaxSuppressionGrid(const float* boxes, const int num_boxes,
+                              const float* scores, const int max_output_size,
+                              const float iou_threshold,
+                              const float score_threshold,
+                              const float soft_nms_sigma, int* selected_indices,
+                              float* selected_scores,
+                              int* num_selected_indices) {
+  struct Candidate {
+    int index;
+    float score;
+    int suppress_begin_index;
+  };
+  struct CellRange {
+    int col_min;
+    int col_max;
+    int row_min;
+    int row_max;
+  };
+  // Grid cells hold a list of selections, most recent first
+  struct GridEntry {
+    int selected;
+    int next;
+  };
+
+  // Extent and average size of the candidates above the score threshold
+  const BoxCornerEncoding* corners = reinterpret_cast<const BoxCornerEncoding*>(boxes);
+  float x_lo = INFINITY, y_lo = INFINITY, x_hi = -INFINITY, y_hi = -INFINITY;
+  double size_sum = 0;
+  int candidate_count = 0;
+  bool pairwise = !(iou_threshold > 0.0f);
+  for (int i = 0; i < num_boxes && !pairwise; ++i) {
+    if (!(scores[i] > score_threshold)) continue;
+    const BoxCornerEncoding& box = corners[i];
+    if (!std::isfinite(box.x1) || !std::isfinite(box.y1) ||
+        !std::isfinite(box.x2) || !std::isfinite(box.y2)) {
+      pairwise = true;
+      break;
+    }
+    const float box_x_min = std::min<float>(box.x1, box.x2);
+    const float box_x_max = std::max<float>(box.x1, box.x2);
+    const float box_y_min = std::min<float>(box.y1, box.y2);
+    const float box_y_max = std::max<float>(box.y1, box.y2);
+    x_lo = std::min(x_lo, box_x_min);
+    x_hi = std::max(x_hi, box_x_max);
+    y_lo = std::min(y_lo, box_y_min);
+    y_hi = std::max(y_hi, box_y_max);
+    size_sum += std::max(box_x_max - box_x_min, box_y_max - box_y_min);
+    candidate_count++;
+  }
+  if (pairwise || !std::isfinite(x_hi - x_lo) || !std::isfinite(y_hi - y_lo)) {
+    NonMaxSuppression(boxes, num_boxes, scores, max_output_size, iou_threshold,
+                      score_threshold, soft_nms_sigma, selected_indices,
+                      selected_scores, num_selected_indices);
+    return;
+  }
+
+  *num_selected_indices = 0;
+  const int num_outputs = std::min(candidate_count, max_output_size);
+  if (num_outputs <= 0) return;
+
+  // At most ~2 cells per candidate, larger cells if the boxes are spread out
+  float cell = static_cast<float>(size_sum / candidate_count);
+  if (!(cell > 0.0f)) cell = 1.0f;
+  const double max_cells = 2.0 * candidate_count + 1;
+  int cols, rows;
+  for (;;) {
+    const double c = std::floor((x_hi - x_lo) / cell) + 1;
+    const double r = std::floor((y_hi - y_lo) / cell) + 1;
+    if (c * r <= max_cells) {
+      cols = static_cast<int>(c);
+      rows = static_cast<int>(r);
+      break;
+    }
+    cell *= 2.0f;
+  }
+  // Rounding in (x - lo) / cell is monotonic, so a point inside two boxes maps
+  // to a cell inside both of their ranges
+  auto cell_range = [&](int index) {
+    const BoxCornerEncoding& box = corners[index];
+    CellRange range;
+    range.col_min = std::min(cols - 1, static_cast<int>((std::min<float>(box.x1, box.x2) - x_lo) / cell));
+    range.col_max = std::min(cols - 1, static_cast<int>((std::max<float>(box.x1, box.x2) - x_lo) / cell));
+    range.row_min = std::min(rows - 1, static_cast<int>((std::min<float>(box.y1, box.y2) - y_lo) / cell));
+    range.row_max = std::min(rows - 1, static_cast<int>((std::max<float>(box.y1, box.y2) - y_lo) / cell));
+    return range;
+  };
+
+  std::vector<int> cell_head(static_cast<size_t>(cols) * rows, -1);
+  std::vector<GridEntry> entries;
+  entries.reserve(num_outputs * 2);
+  std::vector<int> seen(num_outputs, -1);
+  std::vector<int> neighbours;
+
+  // Same queue, filled in the same order as NonMaxSuppression(), so ties pop
+  // in the same order too
+  auto cmp = [](const Candidate bs_i, const Candidate bs_j) {
+    return bs_i.score < bs_j.score;
+  };
+  std::priority_queue<Candidate, std::deque<Candidate>, decltype(cmp)>
+      candidate_priority_queue(cmp);
+  for (int i = 0; i < num_boxes; ++i) {
+    if (scores[i] > score_threshold) {
+      candidate_priority_queue.emplace(Candidate({i, scores[i], 0}));
+    }
+  }
+
+  float scale = 0;
+  if (soft_nms_sigma > 0.0) {
+    scale = -0.5 / soft_nms_sigma;
+  }
+  int query = 0;
+  while (*num_selected_indices < num_outputs &&
+         !candidate_priority_queue.empty()) {
+    Candidate next_candidate = candidate_priority_queue.top();
+    const float original_score = next_candidate.score;
+    candidate_priority_queue.pop();
+
+    // Selections since suppress_begin_index that share a cell, newest first
+    const CellRange range = cell_range(next_candidate.index);
+    neighbours.clear();
+    query++;
+    for (int row = range.row_min; row <= range.row_max; ++row) {
+      for (int col = range.col_min; col <= range.col_max; ++col) {
+        for (int e = cell_head[row * cols + col];
+             e >= 0 && entries[e].selected >= next_candidate.suppress_begin_index;
+             e = entries[e].next) {
+          if (seen[entries[e].selected] != query) {
+            seen[entries[e].selected] = query;
+            neighbours.push_back(entries[e].selected);
+          }
+        }
+      }
+    }
+    std::sort(neighbours.begin(), neighbours.end(), std::greater<int>());
+
+    // Same as the NonMaxSuppression() loop, see the comments there
+    bool should_hard_suppress = false;
+    for (const int j : neighbours) {
+      const float iou = ComputeIntersectionOverUnion(
+          boxes, next_candidate.index, selected_indices[j]);
+
+      if (iou >= iou_threshold) {
+        should_hard_suppress = true;
+        break;
+      }
+
+      if (soft_nms_sigma > 0.0) {
+        next_candidate.score =
+            next_candidate.score * std::exp(scale * iou * iou);
+      }
+
+      if (next_candidate.score <= score_threshold) break;
+    }
+    next_candidate.suppress_begin_index = *num_selected_indices;
+
+    if (!should_hard_suppress) {
+      if (next_candidate.score == original_score) {
+        const int selected = *num_selected_indices;
+        selected_indices[selected] = next_candidate.index;
+        if (selected_scores) {
+          selected_scores[selected] = next_candidate.score;
+        }
+        ++*num_selected_indices;
+
+        for (int row = range.row_min; row <= range.row_max; ++row) {
+          for (int col = range.col_min; col <= range.col_max; ++col) {
+            GridEntry entry = { selected, cell_head[row * cols + col] };
+            cell_head[row * cols + col] = static_cast<int>(entries.size());
+            entries.push_back(entry);
+          }
+        }
+      }
+      if ((soft_nms_sigma > 0.0) && (next_candidate.score > score_threshold)) {
+        candidate_priority_queue.push(next_candidate);
+      }
+    }
+  }
+}
+
+#if (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV5) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV5_V5_DRPAI) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOX) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_TAO_RETINANET) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_TAO_SSD) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_TAO_YOLOV3) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_TAO_YOLOV4) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV2) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLO_PRO) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV11) || (EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER == EI_CLASSIFIER_LAST_LAYER_YOLOV11_ABS)
+
 /**
  * Run non-max suppression over the results array (for bounding boxes)
  */
@@ -250,7 +454,12 @@ EI_IMPULSE_ERROR ei_run_nms(
 
     int num_selected_indices;
 
-    NonMaxSuppression(
+#if EI_CLASSIFIER_NMS_GRID == 1
+    auto nms = bb_count >= (size_t)EI_CLASSIFIER_NMS_GRID_MIN_BOXES ? &NonMaxSuppressionGrid : &NonMaxSuppression;
+#else
+    auto nms = &NonMaxSuppression;
+#endif
+    nms(
         (const float*)boxes, // boxes
         bb_count, // num_boxes
         (const float*)scores, // scores
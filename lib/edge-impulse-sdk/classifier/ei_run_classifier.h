@@ -1071,6 +1071,47 @@ __attribute__((unused)) EI_IMPULSE_ERROR run_classifier(
     return process_impulse(impulse, signal, result, debug);
 }
 
+#if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+/**
+ * @brief Advance object tracking by a frame without running the impulse.
+ *
+ * For frames the model is skipped on (see `EiFrameSkipScheduler`): every open trace is moved
+ * to its Kalman filter prediction, and the post-processing blocks after object tracking (e.g.
+ * object counting) run on the predicted traces. The result has no bounding boxes.
+ *
+ * **Blocking**: yes
+ *
+ * @param[in] impulse Pointer to an `ei_impulse_handle_t` struct, initialized with
+ *  `run_classifier_init()`.
+ * @param[out] result  Pointer to an ei_impulse_result_t struct that receives the predicted traces.
+ *
+ * @return Error code as defined by `EI_IMPULSE_ERROR` enum. Will be `EI_IMPULSE_OK` if the
+ *  traces were advanced.
+ */
+__attribute__((unused)) EI_IMPULSE_ERROR run_classifier_predicted(
+    ei_impulse_handle_t *impulse,
+    ei_impulse_result_t *result)
+{
+    memset(result, 0, sizeof(ei_impulse_result_t));
+    return run_postprocessing_predicted(impulse, result);
+}
+
+/**
+ * @brief Advance object tracking by a frame without running the impulse.
+ *
+ * Overloaded function [run_classifier_predicted()](#run_classifier_predicted-1) that defaults to
+ * the single impulse.
+ *
+ * @param[out] result  Pointer to an ei_impulse_result_t struct that receives the predicted traces.
+ *
+ * @return Error code as defined by `EI_IMPULSE_ERROR` enum.
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_predicted(ei_impulse_result_t *result)
+{
+    return run_classifier_predicted(&ei_default_impulse, result);
+}
+#endif // EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+
 /** @} */ // end of ei_functions Doxygen group
 
 /* Deprecated functions ------------------------------------------------------- */
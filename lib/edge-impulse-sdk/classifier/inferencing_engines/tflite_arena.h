@@ -0,0 +1,463 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_ARENA_H_
+#define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_ARENA_H_
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+
+/**
+ * Tensor arena placement for the TFLite Micro interpreter.
+ *
+ * TFLM splits the arena in a persistent part (tensor structs, op data,
+ * variable tensors, lives as long as the interpreter) and a non-persistent
+ * part (activations and scratch buffers, packed by the greedy planner from
+ * their first/last use). The split policy puts the non-persistent part - the
+ * memory every kernel reads and writes - in internal RAM and the persistent
+ * part in PSRAM. The size of both parts is measured once per model with a
+ * single arena, so the split allocations are exact.
+ */
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_interpreter.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/memory_helpers.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_arena_constants.h"
+#include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
+
+#if EI_PORTING_ESPRESSIF == 1
+#include "esp_heap_caps.h"
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
+#define EI_TFLITE_ARENA_HEAP_CAPS   1
+#endif
+#endif
+
+#ifndef EI_TFLITE_ARENA_HEAP_CAPS
+#define EI_TFLITE_ARENA_HEAP_CAPS   0
+#endif
+
+typedef enum {
+    EI_TFLITE_ARENA_POLICY_DEFAULT  = 0, // one arena from ei_calloc, wherever the heap puts it
+    EI_TFLITE_ARENA_POLICY_INTERNAL = 1, // one arena in internal RAM
+    EI_TFLITE_ARENA_POLICY_EXTERNAL = 2, // one arena in PSRAM
+    EI_TFLITE_ARENA_POLICY_SPLIT    = 3, // activations / scratch internal, persistent data in PSRAM
+    EI_TFLITE_ARENA_POLICY_COUNT
+} ei_tflite_arena_policy_t;
+
+typedef enum {
+    EI_TFLITE_ARENA_REGION_DEFAULT  = 0,
+    EI_TFLITE_ARENA_REGION_INTERNAL = 1,
+    EI_TFLITE_ARENA_REGION_EXTERNAL = 2,
+    EI_TFLITE_ARENA_REGION_MODEL    = 3  // constant tensor, read straight from the model
+} ei_tflite_arena_region_t;
+
+// Compile time default, can be changed at runtime with ei_tflite_set_arena_policy()
+#ifndef EI_CLASSIFIER_TFLITE_ARENA_POLICY
+#define EI_CLASSIFIER_TFLITE_ARENA_POLICY           EI_TFLITE_ARENA_POLICY_DEFAULT
+#endif
+
+// Extra bytes added to the measured persistent size; the split allocator
+// keeps two allocator objects in there instead of one
+#ifndef EI_CLASSIFIER_TFLITE_ARENA_SPLIT_SLACK
+#define EI_CLASSIFIER_TFLITE_ARENA_SPLIT_SLACK      256
+#endif
+
+// Models whose arena usage is kept, more than one when impulses take turns
+// (EiImpulseScheduler)
+#ifndef EI_CLASSIFIER_TFLITE_ARENA_MEASURED_MODELS
+#define EI_CLASSIFIER_TFLITE_ARENA_MEASURED_MODELS  4
+#endif
+
+// Number of tensors described by the placement report, 0 only keeps the totals
+#ifndef EI_CLASSIFIER_TFLITE_ARENA_REPORT_MAX_TENSORS
+#define EI_CLASSIFIER_TFLITE_ARENA_REPORT_MAX_TENSORS 0
+#endif
+
+typedef struct {
+    uint16_t index;
+    uint8_t region;         // ei_tflite_arena_region_t
+    uint8_t persistent;     // 1 if allocated from the persistent part of the arena
+    uint32_t offset;        // offset in its arena part (0 for model tensors)
+    uint32_t bytes;
+    int16_t first_op;       // first operator using the tensor, -1 if none
+    int16_t last_op;        // last operator using the tensor, -1 if none
+} ei_tflite_tensor_placement_t;
+
+typedef struct {
+    const uint8_t *model;
+    uint8_t policy;                     // policy the layout below was built with
+    uint8_t persistent_region;
+    uint8_t non_persistent_region;
+    size_t persistent_bytes;            // allocated size of both parts, persistent_bytes
+    size_t non_persistent_bytes;        // is 0 when they share one arena
+    size_t persistent_used;             // measured usage
+    size_t non_persistent_used;
+    size_t tensors_count;               // tensors in the model
+    size_t tensors_reported;            // entries filled in tensors[]
+#if EI_CLASSIFIER_TFLITE_ARENA_REPORT_MAX_TENSORS > 0
+    ei_tflite_tensor_placement_t tensors[EI_CLASSIFIER_TFLITE_ARENA_REPORT_MAX_TENSORS];
+#endif
+} ei_tflite_arena_report_t;
+
+typedef struct {
+    uint32_t invokes;
+    uint32_t last_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} ei_tflite_arena_timing_t;
+
+typedef struct {
+    const uint8_t *model;
+    size_t persistent;
+    size_t non_persistent;
+    bool split_failed;      // didn't fit the split arena, uses a single one
+} ei_tflite_arena_measurement_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    uint8_t region;         // ei_tflite_arena_region_t
+    uint32_t uses;          // interpreters set up in it
+    uint32_t misses;        // interpreters that needed more and allocated their own
+} ei_tflite_shared_arena_t;
+
+typedef struct {
+    uint8_t active_policy;  // policy of the interpreter that's currently set up
+    uint8_t measured_next;  // entry replaced by the next measurement
+    ei_tflite_arena_measurement_t measured[EI_CLASSIFIER_TFLITE_ARENA_MEASURED_MODELS];
+    ei_tflite_shared_arena_t shared;
+    ei_tflite_arena_report_t report;
+    ei_tflite_arena_timing_t timing[EI_TFLITE_ARENA_POLICY_COUNT];
+} ei_tflite_arena_state_t;
+
+static ei_tflite_arena_state_t ei_tflite_arena_state;
+static uint8_t ei_tflite_arena_policy = EI_CLASSIFIER_TFLITE_ARENA_POLICY;
+
+/**
+ * Select the arena policy, used from the next inference on
+ */
+__attribute__((unused)) static void ei_tflite_set_arena_policy(ei_tflite_arena_policy_t policy) {
+    if (policy >= EI_TFLITE_ARENA_POLICY_COUNT) {
+        policy = EI_TFLITE_ARENA_POLICY_DEFAULT;
+    }
+    ei_tflite_arena_policy = policy;
+}
+
+__attribute__((unused)) static ei_tflite_arena_policy_t ei_tflite_get_arena_policy() {
+    return (ei_tflite_arena_policy_t)ei_tflite_arena_policy;
+}
+
+/**
+ * Where the last interpreter placed its arena and (optionally) every tensor
+ */
+__attribute__((unused)) static const ei_tflite_arena_report_t* ei_tflite_get_arena_report() {
+    return &ei_tflite_arena_state.report;
+}
+
+/**
+ * Forget the measured layout, e.g. after a new model was loaded at the same
+ * address as the previous one
+ */
+__attribute__((unused)) static void ei_tflite_arena_invalidate() {
+    memset(ei_tflite_arena_state.measured, 0, sizeof(ei_tflite_arena_state.measured));
+    ei_tflite_arena_state.report.model = nullptr;
+}
+
+/**
+ * Measured persistent / non-persistent usage of a model, nullptr if it wasn't
+ * measured (yet)
+ */
+__attribute__((unused)) static const ei_tflite_arena_measurement_t* ei_tflite_arena_find_measurement(const uint8_t *model) {
+    for (size_t ix = 0; ix < EI_CLASSIFIER_TFLITE_ARENA_MEASURED_MODELS; ix++) {
+        if (model != nullptr && ei_tflite_arena_state.measured[ix].model == model) {
+            return &ei_tflite_arena_state.measured[ix];
+        }
+    }
+    return nullptr;
+}
+
+__attribute__((unused)) static void ei_tflite_arena_store_measurement(const uint8_t *model, size_t persistent, size_t non_persistent) {
+    ei_tflite_arena_measurement_t *entry = (ei_tflite_arena_measurement_t*)ei_tflite_arena_find_measurement(model);
+    if (entry == nullptr) {
+        entry = &ei_tflite_arena_state.measured[ei_tflite_arena_state.measured_next];
+        ei_tflite_arena_state.measured_next = (ei_tflite_arena_state.measured_next + 1) % EI_CLASSIFIER_TFLITE_ARENA_MEASURED_MODELS;
+    }
+    entry->model = model;
+    entry->persistent = persistent;
+    entry->non_persistent = non_persistent;
+    entry->split_failed = false;
+}
+
+/**
+ * The model couldn't be allocated in the arena parts sized from its
+ * measurement, the split policy sets it up in a single arena instead
+ */
+__attribute__((unused)) static void ei_tflite_arena_mark_split_failed(const uint8_t *model) {
+    ei_tflite_arena_measurement_t *entry = (ei_tflite_arena_measurement_t*)ei_tflite_arena_find_measurement(model);
+    if (entry != nullptr) {
+        entry->split_failed = true;
+    }
+}
+
+/**
+ * Set up every interpreter in one caller owned arena instead of allocating
+ * one per inference, so impulses that take turns share it. An interpreter
+ * that needs more than fits allocates its own arena as usual. Pass nullptr to
+ * stop using it. Ignored with EI_CLASSIFIER_ALLOCATION_STATIC, where every
+ * model already shares the static arena.
+ *
+ * @param      arena   16 byte aligned buffer, e.g. from ei_tflite_arena_calloc()
+ * @param      size    Size in bytes
+ * @param      region  Region the buffer is in
+ */
+__attribute__((unused)) static void ei_tflite_set_shared_arena(uint8_t *arena, size_t size, ei_tflite_arena_region_t region) {
+    ei_tflite_shared_arena_t *shared = &ei_tflite_arena_state.shared;
+    shared->data = arena;
+    shared->size = arena != nullptr ? size : 0;
+    shared->region = region;
+    shared->uses = 0;
+    shared->misses = 0;
+}
+
+__attribute__((unused)) static const ei_tflite_shared_arena_t* ei_tflite_get_shared_arena() {
+    return &ei_tflite_arena_state.shared;
+}
+
+/**
+ * The shared arena, if there is one and needed bytes fit in it
+ *
+ * @param      needed  Bytes the interpreter needs
+ * @param      size    Updated with the size of the shared arena
+ * @param      region  Updated with its region
+ */
+__attribute__((unused)) static uint8_t* ei_tflite_arena_take_shared(size_t needed, size_t *size, ei_tflite_arena_region_t *region) {
+    ei_tflite_shared_arena_t *shared = &ei_tflite_arena_state.shared;
+    if (shared->data == nullptr) {
+        return nullptr;
+    }
+    if (needed > shared->size) {
+        EI_LOGD("Shared arena (%u bytes) too small, %u bytes needed\n", (unsigned)shared->size, (unsigned)needed);
+        shared->misses++;
+        return nullptr;
+    }
+    shared->uses++;
+    *size = shared->size;
+    *region = (ei_tflite_arena_region_t)shared->region;
+    return shared->data;
+}
+
+/**
+ * Invoke() timing, collected per policy so they can be compared on the device
+ */
+__attribute__((unused)) static const ei_tflite_arena_timing_t* ei_tflite_get_arena_timing(ei_tflite_arena_policy_t policy) {
+    if (policy >= EI_TFLITE_ARENA_POLICY_COUNT) {
+        return nullptr;
+    }
+    return &ei_tflite_arena_state.timing[policy];
+}
+
+__attribute__((unused)) static void ei_tflite_reset_arena_timing() {
+    memset(ei_tflite_arena_state.timing, 0, sizeof(ei_tflite_arena_state.timing));
+}
+
+__attribute__((unused)) static void ei_tflite_arena_record_invoke(uint64_t invoke_us) {
+    ei_tflite_arena_timing_t *timing = &ei_tflite_arena_state.timing[ei_tflite_arena_state.active_policy];
+    uint32_t us = (uint32_t)invoke_us;
+
+    if (timing->invokes == 0 || us < timing->min_us) {
+        timing->min_us = us;
+    }
+    if (us > timing->max_us) {
+        timing->max_us = us;
+    }
+    timing->last_us = us;
+    timing->total_us += invoke_us;
+    timing->invokes++;
+}
+
+/**
+ * Allocate a zeroed, 16 byte aligned arena part in the requested region.
+ * Falls back to the other region, then to ei_aligned_calloc, if it doesn't fit.
+ *
+ * @param      size    Size in bytes
+ * @param      region  Requested region, updated with the region it landed in
+ *
+ * @return     The buffer, release it with ei_tflite_arena_free() and the same region
+ */
+__attribute__((unused)) static void* ei_tflite_arena_calloc(size_t size, ei_tflite_arena_region_t *region) {
+#if EI_TFLITE_ARENA_HEAP_CAPS == 1
+    if (*region == EI_TFLITE_ARENA_REGION_INTERNAL || *region == EI_TFLITE_ARENA_REGION_EXTERNAL) {
+        const uint32_t internal_caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        const uint32_t external_caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+        bool internal = *region == EI_TFLITE_ARENA_REGION_INTERNAL;
+
+        void *ptr = heap_caps_aligned_calloc(16, 1, size, internal ? internal_caps : external_caps);
+        if (ptr == nullptr) {
+            EI_LOGD("Arena part (%u bytes) doesn't fit in %s RAM\n",
+                (unsigned)size, internal ? "internal" : "external");
+            internal = !internal;
+            ptr = heap_caps_aligned_calloc(16, 1, size, internal ? internal_caps : external_caps);
+        }
+        if (ptr != nullptr) {
+            *region = internal ? EI_TFLITE_ARENA_REGION_INTERNAL : EI_TFLITE_ARENA_REGION_EXTERNAL;
+            return ptr;
+        }
+    }
+#endif
+    *region = EI_TFLITE_ARENA_REGION_DEFAULT;
+    return ei_aligned_calloc(16, size);
+}
+
+__attribute__((unused)) static void ei_tflite_arena_free(void *ptr, ei_tflite_arena_region_t region) {
+    if (ptr == nullptr) {
+        return;
+    }
+#if EI_TFLITE_ARENA_HEAP_CAPS == 1
+    if (region != EI_TFLITE_ARENA_REGION_DEFAULT) {
+        heap_caps_free(ptr);
+        return;
+    }
+#else
+    (void)region;
+#endif
+    ei_aligned_free(ptr);
+}
+
+/**
+ * Record where the interpreter placed its arena parts and tensors. Only
+ * rebuilt when the model or the policy changes, offsets within the parts stay
+ * the same between runs even though the buffers themselves are reallocated.
+ *
+ * @param      persistent  Persistent part, nullptr if the interpreter uses a
+ *                         single arena (passed as non_persistent)
+ */
+__attribute__((unused)) static void ei_tflite_arena_update_report(
+    const uint8_t *model_data,
+    const tflite::Model *model,
+    tflite::MicroInterpreter *interpreter,
+    const uint8_t *persistent, size_t persistent_bytes, ei_tflite_arena_region_t persistent_region,
+    const uint8_t *non_persistent, size_t non_persistent_bytes, ei_tflite_arena_region_t non_persistent_region) {
+
+    ei_tflite_arena_report_t *report = &ei_tflite_arena_state.report;
+    if (report->model == model_data && report->policy == ei_tflite_arena_state.active_policy) {
+        return;
+    }
+
+    report->model = model_data;
+    report->policy = ei_tflite_arena_state.active_policy;
+    report->persistent_region = persistent_region;
+    report->non_persistent_region = non_persistent_region;
+    report->persistent_bytes = persistent_bytes;
+    report->non_persistent_bytes = non_persistent_bytes;
+    report->persistent_used = interpreter->arena_persistent_used_bytes();
+    report->non_persistent_used = interpreter->arena_non_persistent_used_bytes();
+    report->tensors_count = interpreter->tensors_size();
+    report->tensors_reported = 0;
+
+#if EI_CLASSIFIER_TFLITE_ARENA_REPORT_MAX_TENSORS > 0
+    // single arena: planned tensors at the head, persistent data at the tail
+    size_t head_bytes = non_persistent_bytes;
+    if (persistent == nullptr) {
+        persistent = non_persistent;
+        persistent_bytes = non_persistent_bytes;
+        persistent_region = non_persistent_region;
+        head_bytes = report->non_persistent_used;
+    }
+
+    size_t count = report->tensors_count;
+    if (count > EI_CLASSIFIER_TFLITE_ARENA_REPORT_MAX_TENSORS) {
+        count = EI_CLASSIFIER_TFLITE_ARENA_REPORT_MAX_TENSORS;
+    }
+
+    for (size_t ix = 0; ix < count; ix++) {
+        ei_tflite_tensor_placement_t *t = &report->tensors[ix];
+        const TfLiteEvalTensor *eval = interpreter->eval_tensor(ix);
+        const uint8_t *data = (const uint8_t*)eval->data.data;
+        size_t bytes = 0;
+        tflite::TfLiteEvalTensorByteLength(eval, &bytes);
+
+        t->index = ix;
+        t->bytes = bytes;
+        t->first_op = -1;
+        t->last_op = -1;
+        t->persistent = 0;
+        t->offset = 0;
+
+        if (data >= non_persistent && data < non_persistent + head_bytes) {
+            t->region = non_persistent_region;
+            t->offset = data - non_persistent;
+        }
+        else if (data >= persistent && data < persistent + persistent_bytes) {
+            t->region = persistent_region;
+            t->persistent = 1;
+            t->offset = data - persistent;
+        }
+        else {
+            t->region = EI_TFLITE_ARENA_REGION_MODEL;
+        }
+    }
+
+    // lifetimes the same way the planner derives them: operators run in order
+    const auto *operators = model->subgraphs()->Get(0)->operators();
+    for (size_t op_ix = 0; op_ix < operators->size(); op_ix++) {
+        const auto *op = operators->Get(op_ix);
+        const flatbuffers::Vector<int32_t> *lists[2] = { op->inputs(), op->outputs() };
+        for (size_t l = 0; l < 2; l++) {
+            if (lists[l] == nullptr) {
+                continue;
+            }
+            for (size_t i = 0; i < lists[l]->size(); i++) {
+                int32_t tensor_ix = lists[l]->Get(i);
+                if (tensor_ix < 0 || (size_t)tensor_ix >= count) {
+                    continue;
+                }
+                ei_tflite_tensor_placement_t *t = &report->tensors[tensor_ix];
+                if (t->first_op < 0) {
+                    t->first_op = op_ix;
+                }
+                t->last_op = op_ix;
+            }
+        }
+    }
+
+    report->tensors_reported = count;
+#else
+    (void)model;
+    (void)persistent;
+    (void)non_persistent;
+#endif
+}
+
+#endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+#endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_ARENA_H_
@@ -0,0 +1,472 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_MEMORY_PLAN_H_
+#define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_MEMORY_PLAN_H_
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+
+/**
+ * Memory plan cache for the TFLite Micro interpreter.
+ *
+ * The interpreter is set up again for every inference, and each time
+ * AllocateTensors() runs the GreedyMemoryPlanner over every activation and
+ * scratch buffer. The greedy plan only depends on the size and lifetime of
+ * those buffers, so it's recorded once per model and replayed afterwards.
+ * Every buffer is still checked against the recorded one; on any difference
+ * the greedy planner runs as usual and the plan is recorded again.
+ *
+ * Plans of the last EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MODELS models are kept
+ * in RAM, so impulses that take turns (EiImpulseScheduler) each keep theirs.
+ * Override the weak load / store hooks below to keep them in flash as well,
+ * which also skips the planning at boot.
+ */
+
+#ifndef EI_CLASSIFIER_TFLITE_MEMORY_PLAN_CACHE
+#define EI_CLASSIFIER_TFLITE_MEMORY_PLAN_CACHE      1
+#endif
+
+#if EI_CLASSIFIER_TFLITE_MEMORY_PLAN_CACHE == 1
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/memory_planner/greedy_memory_planner.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+
+// Most buffers a plan is recorded for (tensors plus scratch buffers), larger
+// models always run the greedy planner
+#ifndef EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MAX_BUFFERS
+#define EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MAX_BUFFERS 256
+#endif
+
+// Models a plan is kept in RAM for, the oldest is replaced by the next one
+#ifndef EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MODELS
+#define EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MODELS 4
+#endif
+
+#define EI_TFLITE_MEMORY_PLAN_MAGIC                 0x4E4C5045 // "EPLN"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t model_hash;
+    int32_t buffer_count;
+    int32_t max_memory_size;
+} ei_tflite_memory_plan_header_t;
+
+typedef struct {
+    int32_t size;
+    int32_t first_time_used;
+    int32_t last_time_used;
+    int32_t offset;
+} ei_tflite_memory_plan_entry_t;
+
+typedef struct {
+    uint32_t model_hash;
+    uint32_t buffer_count;
+    bool cached;                    // the last AllocateTensors() reused the plan
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t planned_allocate_us;   // last AllocateTensors() that ran the greedy planner
+    uint32_t cached_allocate_us;    // last AllocateTensors() with the recorded plan
+} ei_tflite_memory_plan_report_t;
+
+/**
+ * Read a stored plan
+ *
+ * @param[in]  model_hash  Hash of the model the plan is for
+ * @param      buf         Destination, nullptr to only ask for the size
+ * @param[in]  buf_size    Size of buf
+ *
+ * @return     Size of the stored plan, 0 if there is none for this model
+ */
+__attribute__((weak)) size_t ei_tflite_memory_plan_load(uint32_t model_hash, void *buf, size_t buf_size) {
+    (void)model_hash;
+    (void)buf;
+    (void)buf_size;
+    return 0;
+}
+
+/**
+ * Store a newly recorded plan, replacing the previous one of the same model.
+ * Only called when the model has no plan in RAM and none could be loaded,
+ * or the one it had no longer matched.
+ */
+__attribute__((weak)) void ei_tflite_memory_plan_store(uint32_t model_hash, const void *plan, size_t plan_size) {
+    (void)model_hash;
+    (void)plan;
+    (void)plan_size;
+}
+
+/**
+ * Called after every AllocateTensors()
+ *
+ * @param[in]  cached       true if the recorded plan was used
+ * @param[in]  allocate_us  Time spent in AllocateTensors()
+ */
+__attribute__((weak)) void ei_tflite_memory_plan_allocated(bool cached, uint32_t allocate_us) {
+    (void)cached;
+    (void)allocate_us;
+}
+
+static inline ei_tflite_memory_plan_entry_t* ei_tflite_memory_plan_entries(ei_tflite_memory_plan_header_t *plan) {
+    return (ei_tflite_memory_plan_entry_t*)(plan + 1);
+}
+
+static inline size_t ei_tflite_memory_plan_size(int32_t buffer_count) {
+    return sizeof(ei_tflite_memory_plan_header_t) + buffer_count * sizeof(ei_tflite_memory_plan_entry_t);
+}
+
+/**
+ * Replays a recorded plan while every buffer matches it, otherwise hands out
+ * the offsets of the greedy planner. The greedy planner gets every buffer
+ * either way (that part is cheap), it only calculates offsets when asked.
+ */
+class EiCachedMemoryPlanner : public tflite::MicroMemoryPlanner {
+public:
+    /**
+     * @param      plan              Plan to replay, nullptr if none
+     * @param      capture           Where to record the greedy plan, nullptr to not record
+     * @param[in]  capture_capacity  Buffers that fit in capture
+     */
+    void Prepare(ei_tflite_memory_plan_header_t *plan, ei_tflite_memory_plan_header_t *capture, int capture_capacity) {
+        plan_ = plan;
+        capture_ = capture;
+        capture_capacity_ = capture_capacity;
+    }
+
+    bool UsedPlan() const {
+        return matches_ && buffer_count_ == plan_->buffer_count;
+    }
+
+    bool Captured() const {
+        return capture_ok_ && capture_->max_memory_size > 0;
+    }
+
+    TfLiteStatus Init(unsigned char *scratch_buffer, int scratch_buffer_size) override {
+        buffer_count_ = 0;
+        matches_ = plan_ != nullptr;
+        capture_ok_ = capture_ != nullptr;
+        if (capture_ok_) {
+            capture_->buffer_count = 0;
+            capture_->max_memory_size = 0;
+        }
+        return greedy_.Init(scratch_buffer, scratch_buffer_size);
+    }
+
+    TfLiteStatus AddBuffer(int size, int first_time_used, int last_time_used) override {
+        Record(size, first_time_used, last_time_used);
+        return greedy_.AddBuffer(size, first_time_used, last_time_used);
+    }
+
+    TfLiteStatus AddBuffer(int size, int first_time_used, int last_time_used, int offline_offset) override {
+        Record(size, first_time_used, last_time_used);
+        return greedy_.AddBuffer(size, first_time_used, last_time_used, offline_offset);
+    }
+
+    size_t GetMaximumMemorySize() override {
+        if (UsedPlan()) {
+            return plan_->max_memory_size;
+        }
+        size_t size = greedy_.GetMaximumMemorySize();
+        if (capture_ok_) {
+            capture_->max_memory_size = (int32_t)size;
+        }
+        return size;
+    }
+
+    int GetBufferCount() override {
+        return buffer_count_;
+    }
+
+    TfLiteStatus GetOffsetForBuffer(int buffer_index, int *offset) override {
+        if (UsedPlan()) {
+            if (buffer_index < 0 || buffer_index >= buffer_count_) {
+                return kTfLiteError;
+            }
+            *offset = ei_tflite_memory_plan_entries(plan_)[buffer_index].offset;
+            return kTfLiteOk;
+        }
+        TfLiteStatus status = greedy_.GetOffsetForBuffer(buffer_index, offset);
+        if (status == kTfLiteOk && capture_ok_ && buffer_index < buffer_count_) {
+            ei_tflite_memory_plan_entries(capture_)[buffer_index].offset = *offset;
+        }
+        return status;
+    }
+
+    void PrintMemoryPlan() override {
+        greedy_.PrintMemoryPlan();
+    }
+
+private:
+    void Record(int size, int first_time_used, int last_time_used) {
+        int index = buffer_count_++;
+
+        if (matches_) {
+            const ei_tflite_memory_plan_entry_t *entry = ei_tflite_memory_plan_entries(plan_) + index;
+            matches_ = index < plan_->buffer_count &&
+                entry->size == size &&
+                entry->first_time_used == first_time_used &&
+                entry->last_time_used == last_time_used;
+        }
+        if (capture_ok_) {
+            if (index >= capture_capacity_) {
+                capture_ok_ = false;
+                return;
+            }
+            ei_tflite_memory_plan_entry_t *entry = ei_tflite_memory_plan_entries(capture_) + index;
+            entry->size = size;
+            entry->first_time_used = first_time_used;
+            entry->last_time_used = last_time_used;
+            entry->offset = -1;
+            capture_->buffer_count = buffer_count_;
+        }
+    }
+
+    tflite::GreedyMemoryPlanner greedy_;
+    ei_tflite_memory_plan_header_t *plan_ = nullptr;
+    ei_tflite_memory_plan_header_t *capture_ = nullptr;
+    int capture_capacity_ = 0;
+    int buffer_count_ = 0;
+    bool matches_ = false;
+    bool capture_ok_ = false;
+};
+
+typedef struct {
+    ei_tflite_memory_plan_header_t *plans[EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MODELS];
+    uint8_t plans_next;                         // entry replaced by the next plan
+    ei_tflite_memory_plan_header_t *plan;       // plan of the current setup, nullptr if none
+    ei_tflite_memory_plan_header_t *capture;    // plan being recorded by the current setup
+    ei_tflite_memory_plan_report_t report;
+} ei_tflite_memory_plan_state_t;
+
+static ei_tflite_memory_plan_state_t ei_tflite_memory_plan_state;
+
+static inline uint32_t ei_tflite_memory_plan_fnv(uint32_t hash, int32_t value) {
+    for (int i = 0; i < 4; i++) {
+        hash ^= (uint8_t)(value >> (i * 8));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline uint32_t ei_tflite_memory_plan_fnv(uint32_t hash, const flatbuffers::Vector<int32_t> *values) {
+    if (values == nullptr) {
+        return ei_tflite_memory_plan_fnv(hash, -1);
+    }
+    hash = ei_tflite_memory_plan_fnv(hash, (int32_t)values->size());
+    for (size_t ix = 0; ix < values->size(); ix++) {
+        hash = ei_tflite_memory_plan_fnv(hash, values->Get(ix));
+    }
+    return hash;
+}
+
+/**
+ * Hash of the parts of the model the memory plan follows from: the graph and
+ * the type and shape of every tensor. Weights don't change the plan, so they
+ * are left out, which keeps this cheap enough to run on every setup (and
+ * notices a different model loaded at the same address).
+ */
+__attribute__((unused)) static uint32_t ei_tflite_memory_plan_hash(const tflite::Model *model) {
+    uint32_t hash = 2166136261u;
+    const auto *subgraphs = model->subgraphs();
+    if (subgraphs == nullptr) {
+        return hash;
+    }
+    for (size_t sx = 0; sx < subgraphs->size(); sx++) {
+        const tflite::SubGraph *subgraph = subgraphs->Get(sx);
+        hash = ei_tflite_memory_plan_fnv(hash, subgraph->inputs());
+        hash = ei_tflite_memory_plan_fnv(hash, subgraph->outputs());
+        if (subgraph->tensors() != nullptr) {
+            for (size_t tx = 0; tx < subgraph->tensors()->size(); tx++) {
+                const tflite::Tensor *tensor = subgraph->tensors()->Get(tx);
+                hash = ei_tflite_memory_plan_fnv(hash, (int32_t)tensor->type());
+                hash = ei_tflite_memory_plan_fnv(hash, (int32_t)tensor->is_variable());
+                hash = ei_tflite_memory_plan_fnv(hash, tensor->shape());
+            }
+        }
+        if (subgraph->operators() != nullptr) {
+            for (size_t ox = 0; ox < subgraph->operators()->size(); ox++) {
+                const tflite::Operator *op = subgraph->operators()->Get(ox);
+                hash = ei_tflite_memory_plan_fnv(hash, (int32_t)op->opcode_index());
+                hash = ei_tflite_memory_plan_fnv(hash, op->inputs());
+                hash = ei_tflite_memory_plan_fnv(hash, op->outputs());
+            }
+        }
+    }
+    return hash;
+}
+
+__attribute__((unused)) static const ei_tflite_memory_plan_report_t* ei_tflite_get_memory_plan_report() {
+    return &ei_tflite_memory_plan_state.report;
+}
+
+/**
+ * Drop every recorded plan, the next setup of each model runs the greedy
+ * planner (or loads its plan from the store)
+ */
+__attribute__((unused)) static void ei_tflite_memory_plan_invalidate() {
+    ei_tflite_memory_plan_state_t *state = &ei_tflite_memory_plan_state;
+    for (size_t ix = 0; ix < EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MODELS; ix++) {
+        ei_free(state->plans[ix]);
+        state->plans[ix] = nullptr;
+    }
+    state->plan = nullptr;
+}
+
+__attribute__((unused)) static int ei_tflite_memory_plan_find(uint32_t hash) {
+    for (size_t ix = 0; ix < EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MODELS; ix++) {
+        if (ei_tflite_memory_plan_state.plans[ix] != nullptr && ei_tflite_memory_plan_state.plans[ix]->model_hash == hash) {
+            return (int)ix;
+        }
+    }
+    return -1;
+}
+
+// Takes plan, replacing the model's previous plan or else the oldest one
+__attribute__((unused)) static void ei_tflite_memory_plan_keep(ei_tflite_memory_plan_header_t *plan) {
+    ei_tflite_memory_plan_state_t *state = &ei_tflite_memory_plan_state;
+    int ix = ei_tflite_memory_plan_find(plan->model_hash);
+    if (ix < 0) {
+        ix = state->plans_next;
+        state->plans_next = (state->plans_next + 1) % EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MODELS;
+    }
+    ei_free(state->plans[ix]);
+    state->plans[ix] = plan;
+}
+
+__attribute__((unused)) static void ei_tflite_memory_plan_drop(uint32_t hash) {
+    ei_tflite_memory_plan_state_t *state = &ei_tflite_memory_plan_state;
+    int ix = ei_tflite_memory_plan_find(hash);
+    if (ix >= 0) {
+        ei_free(state->plans[ix]);
+        state->plans[ix] = nullptr;
+    }
+}
+
+/**
+ * Pick the plan for this model (from RAM, or from the store after a boot or
+ * when it was replaced) and return the planner to build the allocator with.
+ * Pair with ei_tflite_memory_plan_end().
+ */
+__attribute__((unused)) static EiCachedMemoryPlanner* ei_tflite_memory_plan_begin(const tflite::Model *model) {
+    static EiCachedMemoryPlanner planner;
+    ei_tflite_memory_plan_state_t *state = &ei_tflite_memory_plan_state;
+    uint32_t hash = ei_tflite_memory_plan_hash(model);
+
+    int ix = ei_tflite_memory_plan_find(hash);
+    state->plan = ix >= 0 ? state->plans[ix] : nullptr;
+    if (state->plan == nullptr) {
+        size_t size = ei_tflite_memory_plan_load(hash, nullptr, 0);
+        if (size >= sizeof(ei_tflite_memory_plan_header_t)) {
+            ei_tflite_memory_plan_header_t *plan = (ei_tflite_memory_plan_header_t*)ei_malloc(size);
+            if (plan != nullptr && (
+                    ei_tflite_memory_plan_load(hash, plan, size) != size ||
+                    plan->magic != EI_TFLITE_MEMORY_PLAN_MAGIC ||
+                    plan->model_hash != hash ||
+                    plan->buffer_count < 0 ||
+                    ei_tflite_memory_plan_size(plan->buffer_count) != size)) {
+                EI_LOGW("Stored TFLite memory plan is invalid, replanning\n");
+                ei_free(plan);
+                plan = nullptr;
+            }
+            if (plan != nullptr) {
+                ei_tflite_memory_plan_keep(plan);
+                state->plan = plan;
+            }
+        }
+    }
+
+    if (state->plan == nullptr) {
+        state->capture = (ei_tflite_memory_plan_header_t*)ei_malloc(
+            ei_tflite_memory_plan_size(EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MAX_BUFFERS));
+    }
+    state->report.model_hash = hash;
+    planner.Prepare(state->plan, state->capture, EI_CLASSIFIER_TFLITE_MEMORY_PLAN_MAX_BUFFERS);
+    return &planner;
+}
+
+/**
+ * Keep the plan the greedy planner just made, and update the report
+ *
+ * @param[in]  allocated    true if AllocateTensors() succeeded
+ * @param[in]  allocate_us  Time spent in AllocateTensors()
+ */
+__attribute__((unused)) static void ei_tflite_memory_plan_end(EiCachedMemoryPlanner *planner, bool allocated, uint64_t allocate_us) {
+    ei_tflite_memory_plan_state_t *state = &ei_tflite_memory_plan_state;
+    ei_tflite_memory_plan_report_t *report = &state->report;
+    bool cached = state->plan != nullptr && planner->UsedPlan();
+
+    report->cached = cached;
+    if (cached) {
+        report->hits++;
+        report->cached_allocate_us = (uint32_t)allocate_us;
+    }
+    else {
+        report->misses++;
+        report->planned_allocate_us = (uint32_t)allocate_us;
+        // the recorded plan no longer matches the model
+        ei_tflite_memory_plan_drop(report->model_hash);
+        state->plan = nullptr;
+    }
+
+    if (!allocated) {
+        ei_tflite_memory_plan_drop(report->model_hash);
+        state->plan = nullptr;
+    }
+    else if (state->capture != nullptr && planner->Captured()) {
+        size_t size = ei_tflite_memory_plan_size(state->capture->buffer_count);
+        ei_tflite_memory_plan_header_t *plan = (ei_tflite_memory_plan_header_t*)ei_malloc(size);
+        if (plan != nullptr) {
+            memcpy(plan, state->capture, size);
+            plan->magic = EI_TFLITE_MEMORY_PLAN_MAGIC;
+            plan->model_hash = report->model_hash;
+            ei_tflite_memory_plan_keep(plan);
+            state->plan = plan;
+            ei_tflite_memory_plan_store(report->model_hash, plan, size);
+            EI_LOGD("TFLite memory plan recorded (%d buffers)\n", (int)plan->buffer_count);
+        }
+    }
+    ei_free(state->capture);
+    state->capture = nullptr;
+
+    report->buffer_count = state->plan != nullptr ? (uint32_t)state->plan->buffer_count : 0;
+    state->plan = nullptr;
+    planner->Prepare(nullptr, nullptr, 0);
+
+    ei_tflite_memory_plan_allocated(cached, (uint32_t)allocate_us);
+}
+
+#endif // EI_CLASSIFIER_TFLITE_MEMORY_PLAN_CACHE == 1
+
+#endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+#endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_MEMORY_PLAN_H_
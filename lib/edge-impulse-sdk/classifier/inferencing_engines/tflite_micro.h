@@ -39,6 +39,7 @@
 
 #include "model-parameters/model_metadata.h"
 
+#include <algorithm>
 #include <cmath>
 #include "edge-impulse-sdk/tensorflow/lite/micro/all_ops_resolver.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_interpreter.h"
@@ -47,6 +48,11 @@
 #include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
 #include "edge-impulse-sdk/classifier/inferencing_engines/tflite_helper.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_arena.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_profiler.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_memory_plan.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_weight_prefetch.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_model_source.h"
 
 #if defined(EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER) && EI_CLASSIFIER_HAS_TFLITE_OPS_RESOLVER == 1
 #include "tflite-model/tflite-resolver.h"
@@ -88,6 +94,138 @@
 #define DEFINE_SECTION(x) __attribute__((section(x)))
 #endif
 
+#if EI_CLASSIFIER_TFLITE_OP_PROFILER == 1 && !defined(EI_CLASSIFIER_ENABLE_PROFILER)
+static void inference_tflite_profiler_invoke_end(tflite::MicroInterpreter *interpreter, uint64_t invoke_us) {
+    const ei_tflite_arena_report_t *report = ei_tflite_get_arena_report();
+    ei_tflite_profiler_invoke_end(
+        (uint32_t)invoke_us,
+        interpreter->arena_used_bytes(),
+        report->persistent_bytes + report->non_persistent_bytes);
+}
+#endif
+
+/**
+ * The op resolver every interpreter is built with, static to match the life
+ * of the interpreters
+ */
+static const tflite::MicroOpResolver& inference_tflite_resolver() {
+#ifdef EI_TFLITE_RESOLVER
+    EI_TFLITE_RESOLVER
+#else
+    static tflite::AllOpsResolver resolver;
+#endif
+    return resolver;
+}
+
+/**
+ * Put the runtime model in config if there is one (see tflite_model_source.h).
+ * Each new generation is verified once, and the arena measurements are
+ * dropped because the new model may be mapped at the address of the old one.
+ *
+ * @return  true if config holds an acquired model, hand it back with
+ *          ei_tflite_model_release()
+ */
+static bool inference_tflite_acquire_model(ei_config_tflite_graph_t *config) {
+    static bool checked = false;
+    static bool checked_ok = false;
+    static uint32_t checked_generation = 0;
+
+    const unsigned char *model = config->model;
+    size_t model_size = config->model_size;
+    size_t arena_size = config->arena_size;
+    uint32_t generation = 0;
+    if (!ei_tflite_model_acquire(&model, &model_size, &arena_size, &generation)) {
+        return false;
+    }
+
+    if (!checked || generation != checked_generation) {
+        flatbuffers::Verifier verifier(model, model_size);
+        checked_ok = tflite::VerifyModelBuffer(verifier) &&
+            tflite::GetModel(model)->version() == TFLITE_SCHEMA_VERSION;
+        checked = true;
+        checked_generation = generation;
+        ei_tflite_arena_invalidate();
+        if (!checked_ok) {
+            ei_printf("Runtime model failed verification, using the compiled model\n");
+        }
+    }
+    if (!checked_ok) {
+        ei_tflite_model_release();
+        return false;
+    }
+
+    config->model = model;
+    config->model_size = model_size;
+    config->arena_size = arena_size;
+    return true;
+}
+
+#ifndef EI_CLASSIFIER_ALLOCATION_STATIC
+/**
+ * Measure the persistent and non-persistent arena usage of a model by
+ * allocating its tensors once in a single arena. The split policy sizes its
+ * two arena parts from this, a shared arena is checked against it.
+ *
+ * @return  true if the model could be allocated
+ */
+static bool inference_tflite_measure_arena(
+    const tflite::Model *model,
+    const tflite::MicroOpResolver &resolver,
+    ei_config_tflite_graph_t *graph_config) {
+
+    uint8_t *arena = (uint8_t*)ei_aligned_calloc(16, graph_config->arena_size);
+    if (arena == NULL) {
+        return false;
+    }
+
+    tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
+        model, resolver, arena, graph_config->arena_size, nullptr, nullptr);
+
+    bool ok = interpreter->AllocateTensors(true) == kTfLiteOk;
+    if (ok) {
+        // the memory planner and the allocation info are temporary buffers
+        // at the head while planning, make sure they still fit
+        size_t persistent = interpreter->arena_persistent_used_bytes();
+        size_t non_persistent = std::max(interpreter->arena_non_persistent_used_bytes(),
+            interpreter->arena_planning_used_bytes());
+
+        ei_tflite_arena_store_measurement(graph_config->model, persistent, non_persistent);
+
+        EI_LOGD("TFLite arena: %u bytes persistent, %u bytes non-persistent\n",
+            (unsigned)persistent, (unsigned)non_persistent);
+    }
+
+    delete interpreter;
+    ei_aligned_free(arena);
+
+    return ok;
+}
+
+/**
+ * Arena usage of a model, measured on the first call
+ *
+ * @return  The measurement, nullptr if the model can't be allocated
+ */
+__attribute__((unused)) static const ei_tflite_arena_measurement_t* ei_tflite_measure_arena(ei_config_tflite_graph_t *graph_config) {
+    ei_config_tflite_graph_t runtime_config = *graph_config;
+    bool model_acquired = inference_tflite_acquire_model(&runtime_config);
+
+    const ei_tflite_arena_measurement_t *measured = ei_tflite_arena_find_measurement(runtime_config.model);
+    if (measured == nullptr) {
+        const tflite::Model *model = tflite::GetModel(runtime_config.model);
+        if (model->version() == TFLITE_SCHEMA_VERSION &&
+                inference_tflite_measure_arena(model, inference_tflite_resolver(), &runtime_config)) {
+            measured = ei_tflite_arena_find_measurement(runtime_config.model);
+        }
+    }
+
+    if (model_acquired) {
+        ei_tflite_model_release();
+    }
+    return measured;
+}
+#endif // EI_CLASSIFIER_ALLOCATION_STATIC
+
 /**
  * Setup the TFLite runtime
  *
@@ -112,19 +250,11 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
 
     ei_config_tflite_graph_t *graph_config = (ei_config_tflite_graph_t*)block_config->graph_config;
 
-#ifdef EI_CLASSIFIER_ALLOCATION_STATIC
-    // Assign a no-op lambda to the "free" function in case of static arena
-    static uint8_t tensor_arena[EI_CLASSIFIER_TFLITE_LARGEST_ARENA_SIZE] ALIGN(16) DEFINE_SECTION(STRINGIZE_VALUE_OF(EI_TENSOR_ARENA_LOCATION));
-    p_tensor_arena = ei_unique_ptr_t(tensor_arena, [](void*){});
-#else
-    // Create an area of memory to use for input, output, and intermediate arrays.
-    uint8_t *tensor_arena = (uint8_t*)ei_aligned_calloc(16, graph_config->arena_size);
-    if (tensor_arena == NULL) {
-        ei_printf("Failed to allocate TFLite arena (%zu bytes)\n", graph_config->arena_size);
-        return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
-    }
-    p_tensor_arena = ei_unique_ptr_t(tensor_arena, ei_aligned_free);
-#endif
+    // A model loaded at runtime takes the place of the compiled one until the
+    // arena is freed after the inference
+    ei_config_tflite_graph_t runtime_config = *graph_config;
+    bool model_acquired = inference_tflite_acquire_model(&runtime_config);
+    graph_config = &runtime_config;
 
     static bool tflite_first_run = true;
     static uint8_t *model_arr = NULL;
@@ -150,15 +280,108 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
                 "Model provided is schema version %d not equal "
                 "to supported version %d.",
                 model->version(), TFLITE_SCHEMA_VERSION);
+            if (model_acquired) {
+                ei_tflite_model_release();
+            }
             return EI_IMPULSE_TFLITE_ERROR;
         }
         tflite_first_run = false;
     }
 
-#ifdef EI_TFLITE_RESOLVER
-    EI_TFLITE_RESOLVER
+    const tflite::MicroOpResolver &resolver = inference_tflite_resolver();
+
+    // With the split policy tensor_arena only holds the activations and
+    // scratch buffers, the persistent data goes in persistent_arena
+    uint8_t *persistent_arena = nullptr;
+    size_t persistent_arena_size = 0;
+    ei_tflite_arena_region_t persistent_region = EI_TFLITE_ARENA_REGION_DEFAULT;
+    ei_tflite_arena_region_t arena_region = EI_TFLITE_ARENA_REGION_DEFAULT;
+    size_t tensor_arena_size = graph_config->arena_size;
+
+#ifdef EI_CLASSIFIER_ALLOCATION_STATIC
+    // Assign a no-op lambda to the "free" function in case of static arena
+    static uint8_t tensor_arena[EI_CLASSIFIER_TFLITE_LARGEST_ARENA_SIZE] ALIGN(16) DEFINE_SECTION(STRINGIZE_VALUE_OF(EI_TENSOR_ARENA_LOCATION));
+    tensor_arena_size = std::min(tensor_arena_size, (size_t)EI_CLASSIFIER_TFLITE_LARGEST_ARENA_SIZE);
+    p_tensor_arena = ei_unique_ptr_t(tensor_arena, [model_acquired](void*){
+        if (model_acquired) {
+            ei_tflite_model_release();
+        }
+    });
+    ei_tflite_arena_state.active_policy = EI_TFLITE_ARENA_POLICY_DEFAULT;
 #else
-    static tflite::AllOpsResolver resolver; // needs static to match the life of the interpreter
+    ei_tflite_arena_policy_t policy = ei_tflite_get_arena_policy();
+    const ei_tflite_arena_measurement_t *measured = ei_tflite_arena_find_measurement(graph_config->model);
+    if (policy == EI_TFLITE_ARENA_POLICY_SPLIT && measured == nullptr) {
+        if (inference_tflite_measure_arena(model, resolver, graph_config)) {
+            measured = ei_tflite_arena_find_measurement(graph_config->model);
+        }
+        else {
+            EI_LOGW("Failed to measure the TFLite arena, using a single arena\n");
+            policy = EI_TFLITE_ARENA_POLICY_DEFAULT;
+        }
+    }
+    if (policy == EI_TFLITE_ARENA_POLICY_SPLIT && measured != nullptr && measured->split_failed) {
+        policy = EI_TFLITE_ARENA_POLICY_DEFAULT;
+    }
+    ei_tflite_arena_state.active_policy = policy;
+
+    switch (policy) {
+        case EI_TFLITE_ARENA_POLICY_INTERNAL:
+            arena_region = EI_TFLITE_ARENA_REGION_INTERNAL;
+            break;
+        case EI_TFLITE_ARENA_POLICY_EXTERNAL:
+            arena_region = EI_TFLITE_ARENA_REGION_EXTERNAL;
+            break;
+        case EI_TFLITE_ARENA_POLICY_SPLIT: {
+            arena_region = EI_TFLITE_ARENA_REGION_INTERNAL;
+            persistent_region = EI_TFLITE_ARENA_REGION_EXTERNAL;
+            tensor_arena_size = measured->non_persistent + tflite::MicroArenaBufferAlignment();
+            persistent_arena_size = measured->persistent + EI_CLASSIFIER_TFLITE_ARENA_SPLIT_SLACK;
+
+            persistent_arena = (uint8_t*)ei_tflite_arena_calloc(persistent_arena_size, &persistent_region);
+            if (persistent_arena == NULL) {
+                ei_printf("Failed to allocate TFLite persistent arena (%zu bytes)\n", persistent_arena_size);
+                if (model_acquired) {
+                    ei_tflite_model_release();
+                }
+                return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    // A shared arena only has to fit what the model measured at, not the
+    // arena size it was exported with
+    size_t shared_needed = tensor_arena_size;
+    if (persistent_arena == nullptr && measured != nullptr) {
+        shared_needed = measured->persistent + measured->non_persistent + tflite::MicroArenaBufferAlignment();
+    }
+    uint8_t *tensor_arena = ei_tflite_arena_take_shared(shared_needed, &tensor_arena_size, &arena_region);
+    bool shared_arena = tensor_arena != nullptr;
+
+    // Create an area of memory to use for input, output, and intermediate arrays.
+    if (!shared_arena) {
+        tensor_arena = (uint8_t*)ei_tflite_arena_calloc(tensor_arena_size, &arena_region);
+    }
+    if (tensor_arena == NULL) {
+        ei_tflite_arena_free(persistent_arena, persistent_region);
+        ei_printf("Failed to allocate TFLite arena (%zu bytes)\n", tensor_arena_size);
+        if (model_acquired) {
+            ei_tflite_model_release();
+        }
+        return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+    }
+    p_tensor_arena = ei_unique_ptr_t(tensor_arena, [shared_arena, arena_region, persistent_arena, persistent_region, model_acquired](void *ptr) {
+        if (!shared_arena) {
+            ei_tflite_arena_free(ptr, arena_region);
+        }
+        ei_tflite_arena_free(persistent_arena, persistent_region);
+        if (model_acquired) {
+            ei_tflite_model_release();
+        }
+    });
 #endif
 
     // Build an interpreter to run the model with.
@@ -166,26 +389,89 @@ static EI_IMPULSE_ERROR inference_tflite_setup(
 #ifdef EI_CLASSIFIER_ENABLE_PROFILER
     tflite::MicroProfiler *profiler = new tflite::MicroProfiler;
 
-    tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
-        model, resolver, tensor_arena, graph_config->arena_size, nullptr, profiler);
+    *micro_profiler = (void*)profiler;
+#elif EI_CLASSIFIER_TFLITE_OP_PROFILER == 1
+    static EiOpProfiler op_profiler;
+    tflite::MicroProfilerInterface *profiler = ei_tflite_profiler_enabled() ? &op_profiler : nullptr;
 
     *micro_profiler = (void*)profiler;
 #else
-    tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
-        model, resolver, tensor_arena, graph_config->arena_size, nullptr, nullptr);
+    tflite::MicroProfilerInterface *profiler = nullptr;
 
     micro_profiler = nullptr;
 #endif
 
+    tflite::MicroAllocator *allocator;
+#if EI_CLASSIFIER_TFLITE_MEMORY_PLAN_CACHE == 1
+    // Replays the memory plan of the previous setup instead of running the
+    // greedy planner again
+    EiCachedMemoryPlanner *memory_planner = ei_tflite_memory_plan_begin(model);
+    if (persistent_arena != nullptr) {
+        allocator = tflite::MicroAllocator::Create(
+            persistent_arena, persistent_arena_size, tensor_arena, tensor_arena_size, memory_planner);
+    }
+    else {
+        allocator = tflite::MicroAllocator::Create(tensor_arena, tensor_arena_size, memory_planner);
+    }
+#else
+    if (persistent_arena != nullptr) {
+        allocator = tflite::MicroAllocator::Create(
+            persistent_arena, persistent_arena_size, tensor_arena, tensor_arena_size);
+    }
+    else {
+        allocator = tflite::MicroAllocator::Create(tensor_arena, tensor_arena_size);
+    }
+#endif
+
+    tflite::MicroInterpreter *interpreter = new tflite::MicroInterpreter(
+        model, resolver, allocator, nullptr, profiler);
+
     *micro_interpreter = interpreter;
 
+#if EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1
+    // Stages the filters through internal RAM, the first copy starts as soon
+    // as the tensors are allocated
+    interpreter->SetWeightPrefetcher(ei_tflite_weight_prefetch_begin());
+#endif
+
     // Allocate memory from the tensor_arena for the model's tensors.
+    uint64_t allocate_start_us = ei_read_timer_us();
     TfLiteStatus allocate_status = interpreter->AllocateTensors(true);
+#if EI_CLASSIFIER_TFLITE_MEMORY_PLAN_CACHE == 1
+    ei_tflite_memory_plan_end(memory_planner, allocate_status == kTfLiteOk, ei_read_timer_us() - allocate_start_us);
+#else
+    (void)allocate_start_us;
+#endif
+#ifndef EI_CLASSIFIER_ALLOCATION_STATIC
+    if (allocate_status != kTfLiteOk && ei_tflite_arena_state.active_policy == EI_TFLITE_ARENA_POLICY_SPLIT) {
+        // The model needs more than it measured at in one of the two parts,
+        // it's set up in a single arena from now on
+        EI_LOGW("Split TFLite arena too small, using a single arena\n");
+        ei_tflite_arena_mark_split_failed(graph_config->model);
+        delete interpreter;
+#ifdef EI_CLASSIFIER_ENABLE_PROFILER
+        delete profiler;
+#endif
+        *micro_interpreter = nullptr;
+        p_tensor_arena.reset();
+        uint64_t start_us = *ctx_start_us;
+        EI_IMPULSE_ERROR res = inference_tflite_setup(block_config, ctx_start_us, input, outputs,
+            micro_interpreter, p_tensor_arena, micro_profiler);
+        *ctx_start_us = start_us;
+        return res;
+    }
+#endif
     if (allocate_status != kTfLiteOk) {
+        ei_tflite_arena_invalidate();
         ei_printf("AllocateTensors() failed");
         return EI_IMPULSE_TFLITE_ERROR;
     }
 
+    ei_tflite_arena_update_report(
+        graph_config->model, model, interpreter,
+        persistent_arena, persistent_arena_size, persistent_region,
+        tensor_arena, tensor_arena_size, arena_region);
+
     // Obtain pointers to the model's input and output tensors.
     *input = interpreter->input(0);
     for (uint8_t i = 0; i < block_config->output_tensors_size; i++) {
@@ -218,7 +504,11 @@ static EI_IMPULSE_ERROR inference_tflite_run(
     void* micro_profiler) {
 
     // Run inference, and report any error
+    uint64_t invoke_start_us = ei_read_timer_us();
     TfLiteStatus invoke_status = interpreter->Invoke();
+#if EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1
+    ei_tflite_weight_prefetch_end(ei_read_timer_us() - invoke_start_us);
+#endif
     if (invoke_status != kTfLiteOk) {
         delete interpreter;
         ei_printf("Invoke failed (%d)\n", invoke_status);
@@ -226,6 +516,12 @@ static EI_IMPULSE_ERROR inference_tflite_run(
     }
 
     uint64_t ctx_end_us = ei_read_timer_us();
+    ei_tflite_arena_record_invoke(ctx_end_us - invoke_start_us);
+#if EI_CLASSIFIER_TFLITE_OP_PROFILER == 1 && !defined(EI_CLASSIFIER_ENABLE_PROFILER)
+    if (micro_profiler != nullptr) {
+        inference_tflite_profiler_invoke_end(interpreter, ctx_end_us - invoke_start_us);
+    }
+#endif
 
     result->timing.classification_us = ctx_end_us - ctx_start_us;
     result->timing.classification = (int)(result->timing.classification_us / 1000);
@@ -297,11 +593,22 @@ EI_IMPULSE_ERROR run_nn_inference_from_dsp(
     }
 
     // Run inference, and report any error
+    uint64_t invoke_start_us = ei_read_timer_us();
     TfLiteStatus invoke_status = interpreter->Invoke();
+#if EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1
+    ei_tflite_weight_prefetch_end(ei_read_timer_us() - invoke_start_us);
+#endif
     if (invoke_status != kTfLiteOk) {
         ei_printf("Invoke failed (%d)\n", invoke_status);
         return EI_IMPULSE_TFLITE_ERROR;
     }
+    uint64_t invoke_us = ei_read_timer_us() - invoke_start_us;
+    ei_tflite_arena_record_invoke(invoke_us);
+#if EI_CLASSIFIER_TFLITE_OP_PROFILER == 1 && !defined(EI_CLASSIFIER_ENABLE_PROFILER)
+    if (profiler != nullptr) {
+        inference_tflite_profiler_invoke_end(interpreter, invoke_us);
+    }
+#endif
 
     auto output_res = fill_output_matrix_from_tensor(&outputs[0], output_matrix);
     if (output_res != EI_IMPULSE_OK) {
@@ -0,0 +1,84 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_MODEL_SOURCE_H_
+#define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_MODEL_SOURCE_H_
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+
+/**
+ * Model the TFLite Micro interpreter is built from.
+ *
+ * By default that's the flatbuffer compiled into the library. Override the
+ * weak hooks below to run a model that's loaded at runtime instead, e.g. one
+ * mapped from a flash partition. The interpreter is set up for every
+ * inference, so the next inference after a new model is handed out runs it.
+ * A model with a new generation is checked with the flatbuffers verifier
+ * before it's used; one that fails falls back to the compiled model.
+ *
+ * The op resolver is generated for the compiled model, so a runtime model
+ * has to use the same operators, inputs and outputs (a retrained version of
+ * the same impulse).
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Called at the start of every interpreter setup
+ *
+ * @param      model       Flatbuffer to use, set to the compiled one
+ * @param      model_size  Its size in bytes
+ * @param      arena_size  Arena size to use, set to the compiled one
+ * @param      generation  Changes whenever a different model is handed out
+ *
+ * @return     true if the model was replaced; it must stay valid until the
+ *             matching ei_tflite_model_release()
+ */
+__attribute__((weak)) bool ei_tflite_model_acquire(const unsigned char **model, size_t *model_size, size_t *arena_size, uint32_t *generation) {
+    (void)model;
+    (void)model_size;
+    (void)arena_size;
+    (void)generation;
+    return false;
+}
+
+/**
+ * Called once the interpreter of an acquired model is gone
+ */
+__attribute__((weak)) void ei_tflite_model_release(void) {
+}
+
+#endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+#endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_MODEL_SOURCE_H_
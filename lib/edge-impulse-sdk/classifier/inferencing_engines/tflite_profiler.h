@@ -0,0 +1,125 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_PROFILER_H_
+#define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_PROFILER_H_
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+
+/**
+ * Per operator profiling for the TFLite Micro interpreter.
+ *
+ * Unlike EI_CLASSIFIER_ENABLE_PROFILER, which prints a CSV after every
+ * inference, this hands each operator's time to the application, which decides
+ * what to keep. Override the weak hooks below to receive the timings. With
+ * EI_CLASSIFIER_TFLITE_OP_PROFILER set to 0 (the default) none of this is
+ * compiled in and the interpreter runs without a profiler.
+ *
+ * Set the macro for the whole build, not just for this header: micro_graph.cc
+ * only emits the per operator events when it's defined.
+ */
+
+#ifndef EI_CLASSIFIER_TFLITE_OP_PROFILER
+#define EI_CLASSIFIER_TFLITE_OP_PROFILER            0
+#endif
+
+#if EI_CLASSIFIER_TFLITE_OP_PROFILER == 1
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_profiler_interface.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+
+// Nested events (e.g. IF / WHILE running a subgraph) deeper than this are not timed
+#ifndef EI_CLASSIFIER_TFLITE_OP_PROFILER_DEPTH
+#define EI_CLASSIFIER_TFLITE_OP_PROFILER_DEPTH      4
+#endif
+
+/**
+ * Checked before every inference, return false to run without the profiler
+ */
+__attribute__((weak)) bool ei_tflite_profiler_enabled(void) {
+    return true;
+}
+
+/**
+ * Called after every operator, in execution order
+ *
+ * @param      op    Operator name, a static string
+ * @param[in]  us    Time spent in the operator
+ */
+__attribute__((weak)) void ei_tflite_profiler_op(const char *op, uint32_t us) {
+    (void)op;
+    (void)us;
+}
+
+/**
+ * Called after every profiled Invoke()
+ *
+ * @param[in]  invoke_us   Time spent in Invoke()
+ * @param[in]  arena_used  Arena bytes used by the interpreter (persistent and planned)
+ * @param[in]  arena_size  Arena bytes allocated
+ */
+__attribute__((weak)) void ei_tflite_profiler_invoke_end(uint32_t invoke_us, size_t arena_used, size_t arena_size) {
+    (void)invoke_us;
+    (void)arena_used;
+    (void)arena_size;
+}
+
+class EiOpProfiler : public tflite::MicroProfilerInterface {
+public:
+    uint32_t BeginEvent(const char *tag) override {
+        if (depth < EI_CLASSIFIER_TFLITE_OP_PROFILER_DEPTH) {
+            tags[depth] = tag;
+            start_us[depth] = (uint32_t)ei_read_timer_us();
+        }
+        return depth++;
+    }
+
+    void EndEvent(uint32_t event_handle) override {
+        uint32_t end_us = (uint32_t)ei_read_timer_us();
+        depth = event_handle;
+        if (event_handle < EI_CLASSIFIER_TFLITE_OP_PROFILER_DEPTH) {
+            ei_tflite_profiler_op(tags[event_handle], end_us - start_us[event_handle]);
+        }
+    }
+
+private:
+    uint32_t depth = 0;
+    const char *tags[EI_CLASSIFIER_TFLITE_OP_PROFILER_DEPTH];
+    uint32_t start_us[EI_CLASSIFIER_TFLITE_OP_PROFILER_DEPTH];
+};
+
+#endif // EI_CLASSIFIER_TFLITE_OP_PROFILER == 1
+
+#endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+#endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_PROFILER_H_
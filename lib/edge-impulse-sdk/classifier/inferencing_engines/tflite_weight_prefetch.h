@@ -0,0 +1,345 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_WEIGHT_PREFETCH_H_
+#define _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_WEIGHT_PREFETCH_H_
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+
+/**
+ * Layer by layer weight prefetch for the TFLite Micro interpreter.
+ *
+ * When the model is mapped from flash (or sits in PSRAM) every convolution
+ * streams its filter through the cache. With EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH
+ * set to 1 the filter of the next convolution / fully connected layer is
+ * copied into a small internal RAM staging area while the current layer runs
+ * (see tflite::MicroWeightPrefetcher), so the kernels read their weights from
+ * internal RAM.
+ *
+ * The copy itself goes through the weak ei_tflite_weight_prefetch_copy() and
+ * ei_tflite_weight_prefetch_wait() hooks. The defaults copy synchronously,
+ * which is correct but gains nothing; the application overrides them to copy
+ * on the other core or with a DMA engine. Set the macro for the whole build:
+ * micro_graph.cc only calls the prefetcher when it's defined.
+ */
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_weight_prefetch.h"
+#include "edge-impulse-sdk/classifier/inferencing_engines/tflite_arena.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+
+#if EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1
+
+#if EI_PORTING_ESPRESSIF == 1
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "esp_memory_utils.h"
+#else
+#include "soc/soc_memory_layout.h"
+#endif
+#endif
+
+// Size of the staging area, split in two slots. Filters larger than a slot are
+// read in place.
+#ifndef EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_STAGING
+#define EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_STAGING    (32 * 1024)
+#endif
+
+// Operators of the first subgraph that can be prefetched and reported
+#ifndef EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_MAX_LAYERS
+#define EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_MAX_LAYERS 64
+#endif
+
+typedef struct {
+    const char *op;         // operator name, a static string
+    uint32_t bytes;         // filter bytes staged for this layer, 0 if it read the model
+    uint32_t stall_us;      // time spent waiting for the copy before the layer ran
+    uint32_t op_us;         // time spent in the layer itself
+} ei_tflite_prefetch_layer_t;
+
+typedef struct {
+    uint32_t staging_size;  // 0 if the staging area couldn't be allocated
+    uint32_t slot_size;
+    uint32_t layers;        // entries in layer[]
+    uint32_t prefetched;    // layers that ran on a staged filter
+    uint32_t copied_bytes;
+    uint32_t stall_us;      // sum of the layer stalls
+    uint32_t invoke_us;
+    ei_tflite_prefetch_layer_t layer[EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_MAX_LAYERS];
+} ei_tflite_prefetch_report_t;
+
+typedef struct {
+    uint32_t serial_copy_us;    // copying every staged filter right before its layer
+    uint32_t stall_us;          // left over with the double buffered schedule
+} ei_tflite_prefetch_simulation_t;
+
+/**
+ * Checked before every inference, return false to read the weights in place
+ */
+__attribute__((weak)) bool ei_tflite_weight_prefetch_enabled(void) {
+    return true;
+}
+
+/**
+ * Start copying a filter into the staging area. Only one copy is in flight at
+ * a time, ei_tflite_weight_prefetch_wait() is always called before the next.
+ */
+__attribute__((weak)) void ei_tflite_weight_prefetch_copy(void *dst, const void *src, size_t size) {
+    memcpy(dst, src, size);
+}
+
+/**
+ * Block until the copy started last has finished
+ */
+__attribute__((weak)) void ei_tflite_weight_prefetch_wait(void) {
+}
+
+/**
+ * Called after every Invoke() that ran with the prefetcher, once per operator
+ * of the first subgraph in order
+ */
+__attribute__((weak)) void ei_tflite_weight_prefetch_op(const char *op, uint32_t bytes, uint32_t stall_us, uint32_t op_us) {
+    (void)op;
+    (void)bytes;
+    (void)stall_us;
+    (void)op_us;
+}
+
+/**
+ * Called after the operators, with the totals of the invoke
+ */
+__attribute__((weak)) void ei_tflite_weight_prefetch_invoke_end(uint32_t invoke_us, uint32_t stall_us, uint32_t copied_bytes, uint32_t prefetched_layers) {
+    (void)invoke_us;
+    (void)stall_us;
+    (void)copied_bytes;
+    (void)prefetched_layers;
+}
+
+class EiWeightPrefetcher : public tflite::MicroWeightPrefetcher {
+public:
+    EiWeightPrefetcher(uint8_t *staging, size_t staging_size, ei_tflite_prefetch_report_t *report)
+        : tflite::MicroWeightPrefetcher(staging, staging_size, filters, EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_MAX_LAYERS),
+          report(report) {
+    }
+
+protected:
+    bool ShouldPrefetch(const void *data, size_t bytes) override {
+        (void)bytes;
+#if EI_PORTING_ESPRESSIF == 1
+        // already in internal RAM, e.g. a model compiled into the firmware's DRAM
+        return !esp_ptr_internal(data);
+#else
+        (void)data;
+        return true;
+#endif
+    }
+
+    void StartCopy(void *dst, const void *src, size_t bytes) override {
+        ei_tflite_weight_prefetch_copy(dst, src, bytes);
+    }
+
+    void WaitCopy() override {
+        ei_tflite_weight_prefetch_wait();
+    }
+
+    uint32_t NowUs() override {
+        return (uint32_t)ei_read_timer_us();
+    }
+
+    void RecordOp(int node_idx, const TfLiteRegistration *registration,
+                  size_t prefetched_bytes, uint32_t stall_us, uint32_t op_us) override {
+        if ((uint32_t)node_idx >= EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_MAX_LAYERS) {
+            return;
+        }
+        ei_tflite_prefetch_layer_t *layer = &report->layer[node_idx];
+        layer->op = registration->builtin_code == tflite::BuiltinOperator_CUSTOM ?
+            registration->custom_name :
+            tflite::EnumNameBuiltinOperator((tflite::BuiltinOperator)registration->builtin_code);
+        layer->bytes = (uint32_t)prefetched_bytes;
+        layer->stall_us = stall_us;
+        layer->op_us = op_us;
+        if ((uint32_t)node_idx >= report->layers) {
+            report->layers = node_idx + 1;
+        }
+        if (prefetched_bytes > 0) {
+            report->prefetched++;
+            report->copied_bytes += prefetched_bytes;
+        }
+        report->stall_us += stall_us;
+    }
+
+private:
+    int16_t filters[EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_MAX_LAYERS];
+    ei_tflite_prefetch_report_t *report;
+};
+
+static struct {
+    uint8_t *staging;
+    ei_tflite_arena_region_t region;
+    bool failed;                        // don't retry a failed staging allocation every inference
+    EiWeightPrefetcher *prefetcher;     // set between begin() and end()
+    ei_tflite_prefetch_report_t report;
+} ei_tflite_weight_prefetch_state;
+
+__attribute__((unused)) static const ei_tflite_prefetch_report_t* ei_tflite_get_weight_prefetch_report() {
+    return &ei_tflite_weight_prefetch_state.report;
+}
+
+/**
+ * Get the prefetcher for the next interpreter, pass it to
+ * MicroInterpreter::SetWeightPrefetcher() before AllocateTensors()
+ *
+ * @return     The prefetcher, nullptr when disabled or without a staging area
+ */
+__attribute__((unused)) static tflite::MicroWeightPrefetcher* ei_tflite_weight_prefetch_begin() {
+    auto *state = &ei_tflite_weight_prefetch_state;
+    state->prefetcher = nullptr;
+    if (!ei_tflite_weight_prefetch_enabled() || state->failed) {
+        return nullptr;
+    }
+
+    // allocated once and kept, it's small and always wanted in internal RAM
+    if (state->staging == nullptr) {
+        state->region = EI_TFLITE_ARENA_REGION_INTERNAL;
+        state->staging = (uint8_t*)ei_tflite_arena_calloc(EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_STAGING, &state->region);
+#if EI_TFLITE_ARENA_HEAP_CAPS == 1
+        // staging in PSRAM would be slower than reading the weights in place
+        if (state->staging != nullptr && state->region != EI_TFLITE_ARENA_REGION_INTERNAL) {
+            ei_tflite_arena_free(state->staging, state->region);
+            state->staging = nullptr;
+        }
+#endif
+        if (state->staging == nullptr) {
+            EI_LOGW("No internal RAM for the weight prefetch staging area (%u bytes)\n",
+                (unsigned)EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_STAGING);
+            state->failed = true;
+            return nullptr;
+        }
+    }
+
+    static EiWeightPrefetcher prefetcher(state->staging, EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_STAGING, &state->report);
+    memset(&state->report, 0, sizeof(state->report));
+    state->report.staging_size = EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_STAGING;
+    state->report.slot_size = (uint32_t)prefetcher.slot_size();
+    state->prefetcher = &prefetcher;
+    return &prefetcher;
+}
+
+/**
+ * Call after Invoke(), whether it succeeded or not
+ */
+__attribute__((unused)) static void ei_tflite_weight_prefetch_end(uint64_t invoke_us) {
+    auto *state = &ei_tflite_weight_prefetch_state;
+    if (state->prefetcher == nullptr) {
+        return;
+    }
+    state->prefetcher->Finish();
+    state->prefetcher = nullptr;
+    ei_tflite_prefetch_report_t *report = &state->report;
+    report->invoke_us = (uint32_t)invoke_us;
+    for (uint32_t ix = 0; ix < report->layers; ix++) {
+        const ei_tflite_prefetch_layer_t *layer = &report->layer[ix];
+        ei_tflite_weight_prefetch_op(layer->op, layer->bytes, layer->stall_us, layer->op_us);
+    }
+    ei_tflite_weight_prefetch_invoke_end(report->invoke_us, report->stall_us, report->copied_bytes, report->prefetched);
+}
+
+/**
+ * Replay a recorded schedule with a different copy speed, e.g. to predict the
+ * stalls on a device from a run on a host. Layers take the op_us recorded in
+ * the report, each staged filter takes bytes / bytes_per_us to copy, and the
+ * first copy starts with the invoke.
+ *
+ * @param      report        Recorded schedule
+ * @param[in]  bytes_per_us  Copy speed (flash or PSRAM read bandwidth)
+ * @param      stall_us      Optional, receives the stall of every layer (report->layers entries)
+ *
+ * @return     Serial copy time and the stall left with double buffering
+ */
+__attribute__((unused)) static ei_tflite_prefetch_simulation_t ei_tflite_weight_prefetch_simulate(
+    const ei_tflite_prefetch_report_t *report,
+    float bytes_per_us,
+    uint32_t *stall_us) {
+
+    ei_tflite_prefetch_simulation_t sim = { 0, 0 };
+    if (bytes_per_us <= 0.0f) {
+        return sim;
+    }
+
+    auto copy_us = [bytes_per_us](uint32_t bytes) {
+        return (uint64_t)(bytes / bytes_per_us + 0.5f);
+    };
+    auto next_staged = [report](uint32_t start) {
+        uint32_t ix = start;
+        while (ix < report->layers && report->layer[ix].bytes == 0) {
+            ix++;
+        }
+        return ix;
+    };
+
+    uint64_t now = 0;
+    uint64_t serial = 0;
+    uint64_t total_stall = 0;
+    uint32_t pending = next_staged(0);
+    uint64_t copy_done = pending < report->layers ? copy_us(report->layer[pending].bytes) : 0;
+
+    for (uint32_t ix = 0; ix < report->layers; ix++) {
+        const ei_tflite_prefetch_layer_t *layer = &report->layer[ix];
+        uint64_t stall = 0;
+        if (layer->bytes > 0) {
+            serial += copy_us(layer->bytes);
+            if (copy_done > now) {
+                stall = copy_done - now;
+                now = copy_done;
+            }
+            pending = next_staged(ix + 1);
+            if (pending < report->layers) {
+                copy_done = now + copy_us(report->layer[pending].bytes);
+            }
+        }
+        if (stall_us != nullptr) {
+            stall_us[ix] = (uint32_t)stall;
+        }
+        total_stall += stall;
+        now += layer->op_us;
+    }
+
+    sim.serial_copy_us = (uint32_t)serial;
+    sim.stall_us = (uint32_t)total_stall;
+    return sim;
+}
+
+#endif // EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1
+
+#endif // (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+#endif // _EI_CLASSIFIER_INFERENCING_ENGINE_TFLITE_WEIGHT_PREFETCH_H_
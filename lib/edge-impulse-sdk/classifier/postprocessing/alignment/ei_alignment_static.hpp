@@ -0,0 +1,255 @@
+#pragma once
+
+/*
+ * Fixed-capacity variant of JonkerVolgenantAlignment.
+ *
+ * The shortest augmenting path solver below is the same algorithm as
+ * rectangular_lsap.hpp (Crouse, IEEE TAES 52(4), 2016), but every buffer is a
+ * member array sized by the template arguments, so align() never allocates.
+ * Matches are produced in ascending trace index order, which is the order
+ * solve() + argsort_iter() produce for both the wide and the tall case.
+ */
+
+#include <stdint.h>
+#include <cmath>
+#include "ei_alignment.hpp"
+
+typedef struct {
+    uint16_t trace_idx;
+    uint16_t detection_idx;
+    float score;
+} ei_alignment_match_t;
+
+template <size_t MaxTraces, size_t MaxDetections>
+class StaticJonkerVolgenantAlignment {
+public:
+    static constexpr size_t max_dim = MaxTraces > MaxDetections ? MaxTraces : MaxDetections;
+    static constexpr size_t max_matches = MaxTraces < MaxDetections ? MaxTraces : MaxDetections;
+
+    StaticJonkerVolgenantAlignment(float threshold, bool use_iou = true) : threshold(threshold), use_iou(use_iou) {
+    }
+
+    /**
+     * Align traces with detections.
+     * @param traces Trace bounding boxes (at most MaxTraces)
+     * @param traces_count Number of traces
+     * @param detections Detection bounding boxes (at most MaxDetections)
+     * @param detections_count Number of detections
+     * @param matches Output, must hold at least max_matches entries
+     * @return Number of matches written
+     */
+    size_t align(const ei_impulse_result_bounding_box_t *traces, size_t traces_count,
+                 const ei_impulse_result_bounding_box_t *detections, size_t detections_count,
+                 ei_alignment_match_t *matches) {
+
+        if (traces_count == 0 || detections_count == 0) {
+            return 0;
+        }
+        if (traces_count > MaxTraces) {
+            traces_count = MaxTraces;
+        }
+        if (detections_count > MaxDetections) {
+            detections_count = MaxDetections;
+        }
+
+        // the solver wants rows <= cols, so a tall matrix is built transposed
+        // straight away instead of being copied later
+        transposed = detections_count < traces_count;
+        nr = transposed ? detections_count : traces_count;
+        nc = transposed ? traces_count : detections_count;
+
+        for (size_t trace_idx = 0; trace_idx < traces_count; ++trace_idx) {
+            for (size_t detection_idx = 0; detection_idx < detections_count; ++detection_idx) {
+                float cost = 0.0;
+                if (use_iou) {
+                    float iou = intersection_over_union(traces[trace_idx], detections[detection_idx]);
+                    cost = 1 - iou;
+                } else {
+                    cost = centroid_euclidean_distance(traces[trace_idx], detections[detection_idx]);
+                }
+                cost_at(trace_idx, detection_idx) = cost;
+            }
+        }
+
+        if (solve() != 0) {
+            return 0;
+        }
+
+        // rows are traces (wide case) or detections (tall case); either way
+        // emit the assignment ordered by trace index
+        int32_t detection_for_trace[MaxTraces];
+        for (size_t i = 0; i < traces_count; i++) {
+            detection_for_trace[i] = -1;
+        }
+        for (size_t row = 0; row < nr; row++) {
+            if (transposed) {
+                detection_for_trace[col4row[row]] = row;
+            }
+            else {
+                detection_for_trace[row] = col4row[row];
+            }
+        }
+
+        size_t matches_count = 0;
+        for (size_t trace_idx = 0; trace_idx < traces_count; trace_idx++) {
+            if (detection_for_trace[trace_idx] < 0) {
+                continue;
+            }
+            size_t detection_idx = detection_for_trace[trace_idx];
+
+            if (use_iou) {
+                float iou = 1 - cost_at(trace_idx, detection_idx);
+                if (iou > threshold) {
+                    matches[matches_count++] = { (uint16_t)trace_idx, (uint16_t)detection_idx, iou };
+                }
+            } else {
+                float cost = cost_at(trace_idx, detection_idx);
+                if (cost < threshold) {
+                    matches[matches_count++] = { (uint16_t)trace_idx, (uint16_t)detection_idx, cost };
+                }
+            }
+        }
+
+        return matches_count;
+    }
+
+    float threshold;
+    bool use_iou;
+
+private:
+    double &cost_at(size_t trace_idx, size_t detection_idx) {
+        return transposed ? cost[detection_idx * nc + trace_idx] : cost[trace_idx * nc + detection_idx];
+    }
+
+    intptr_t augmenting_path(intptr_t i, double *p_minVal) {
+        double minVal = 0;
+
+        intptr_t num_remaining = nc;
+        for (intptr_t it = 0; it < (intptr_t)nc; it++) {
+            // reverse order, see rectangular_lsap.hpp
+            remaining[it] = nc - it - 1;
+        }
+
+        for (size_t it = 0; it < nr; it++) {
+            SR[it] = false;
+        }
+        for (size_t it = 0; it < nc; it++) {
+            SC[it] = false;
+            shortestPathCosts[it] = INFINITY;
+        }
+
+        intptr_t sink = -1;
+        while (sink == -1) {
+
+            intptr_t index = -1;
+            double lowest = INFINITY;
+            SR[i] = true;
+
+            for (intptr_t it = 0; it < num_remaining; it++) {
+                intptr_t j = remaining[it];
+
+                double r = minVal + cost[i * nc + j] - u[i] - v[j];
+                if (r < shortestPathCosts[j]) {
+                    path[j] = i;
+                    shortestPathCosts[j] = r;
+                }
+
+                if (shortestPathCosts[j] < lowest ||
+                    (shortestPathCosts[j] == lowest && row4col[j] == -1)) {
+                    lowest = shortestPathCosts[j];
+                    index = it;
+                }
+            }
+
+            minVal = lowest;
+            if (minVal == INFINITY) { // infeasible cost matrix
+                return -1;
+            }
+
+            intptr_t j = remaining[index];
+            if (row4col[j] == -1) {
+                sink = j;
+            } else {
+                i = row4col[j];
+            }
+
+            SC[j] = true;
+            remaining[index] = remaining[--num_remaining];
+        }
+
+        *p_minVal = minVal;
+        return sink;
+    }
+
+    int solve() {
+        // test for NaN and -inf entries
+        for (size_t i = 0; i < nr * nc; i++) {
+            if (cost[i] != cost[i] || cost[i] == -INFINITY) {
+                return RECTANGULAR_LSAP_INVALID;
+            }
+        }
+
+        for (size_t i = 0; i < nr; i++) {
+            u[i] = 0;
+            col4row[i] = -1;
+        }
+        for (size_t j = 0; j < nc; j++) {
+            v[j] = 0;
+            path[j] = -1;
+            row4col[j] = -1;
+        }
+
+        for (intptr_t curRow = 0; curRow < (intptr_t)nr; curRow++) {
+
+            double minVal;
+            intptr_t sink = augmenting_path(curRow, &minVal);
+            if (sink < 0) {
+                return RECTANGULAR_LSAP_INFEASIBLE;
+            }
+
+            // update dual variables
+            u[curRow] += minVal;
+            for (intptr_t i = 0; i < (intptr_t)nr; i++) {
+                if (SR[i] && i != curRow) {
+                    u[i] += minVal - shortestPathCosts[col4row[i]];
+                }
+            }
+
+            for (intptr_t j = 0; j < (intptr_t)nc; j++) {
+                if (SC[j]) {
+                    v[j] -= minVal - shortestPathCosts[j];
+                }
+            }
+
+            // augment previous solution
+            intptr_t j = sink;
+            while (1) {
+                intptr_t i = path[j];
+                row4col[j] = i;
+                intptr_t tmp = col4row[i];
+                col4row[i] = j;
+                j = tmp;
+                if (i == curRow) {
+                    break;
+                }
+            }
+        }
+
+        return 0;
+    }
+
+    bool transposed;
+    size_t nr;
+    size_t nc;
+
+    double cost[MaxTraces * MaxDetections];
+    double u[max_dim];
+    double v[max_dim];
+    double shortestPathCosts[max_dim];
+    intptr_t path[max_dim];
+    intptr_t col4row[max_dim];
+    intptr_t row4col[max_dim];
+    bool SR[max_dim];
+    bool SC[max_dim];
+    intptr_t remaining[max_dim];
+};
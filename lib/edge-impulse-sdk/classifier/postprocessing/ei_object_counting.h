@@ -40,6 +40,8 @@
 #include "edge-impulse-sdk/dsp/returntypes.hpp"
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
 #include "edge-impulse-sdk/porting/ei_logging.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include <string.h>
 
 extern ei_impulse_handle_t & ei_default_impulse;
 
@@ -53,12 +55,16 @@ public:
 
     void update(std::tuple<int, int, int, int> other_segment) {
         for (size_t segment_idx = 0; segment_idx < segments.size(); segment_idx++) {
-            if (_line_intersects(segments[segment_idx], other_segment)) {
+            if (crosses(segment_idx, other_segment)) {
                 counts[segment_idx] += 1;
             }
         }
     }
 
+    bool crosses(size_t segment_idx, std::tuple<int, int, int, int> other_segment) {
+        return _line_intersects(segments[segment_idx], other_segment);
+    }
+
     std::vector<uint32_t> counts;
     std::vector<std::tuple<int, int, int, int>> segments;
 private:
@@ -82,30 +88,852 @@ private:
     }
 };
 
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL
+#define EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL 0
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_MAX_LINES
+#define EI_CLASSIFIER_OBJECT_COUNTING_MAX_LINES 4
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_MAX_ZONES
+#define EI_CLASSIFIER_OBJECT_COUNTING_MAX_ZONES 4
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_MAX_ZONE_VERTICES
+#define EI_CLASSIFIER_OBJECT_COUNTING_MAX_ZONE_VERTICES 8
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_MAX_TRACES
+#define EI_CLASSIFIER_OBJECT_COUNTING_MAX_TRACES 32
+#endif
+
+// centroid grid in pixels, a trace is only tested again once it moves to another cell
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_CELL_SIZE
+#define EI_CLASSIFIER_OBJECT_COUNTING_CELL_SIZE 8
+#endif
+
+// the per-minute rates are summed over 60 s worth of buckets of this length
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKET_MS
+#define EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKET_MS 5000
+#endif
+
+#define EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKETS (60000 / EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKET_MS)
+
+/**
+ * Polygon zone, vertices in input image pixels
+ */
+typedef struct {
+    uint8_t vertices_count;
+    int16_t x[EI_CLASSIFIER_OBJECT_COUNTING_MAX_ZONE_VERTICES];
+    int16_t y[EI_CLASSIFIER_OBJECT_COUNTING_MAX_ZONE_VERTICES];
+} ei_object_counting_zone_t;
+
+/**
+ * Directional counts of one line or zone
+ */
+typedef struct {
+    uint32_t in;
+    uint32_t out;
+    int32_t net;
+    uint32_t in_per_minute;
+    uint32_t out_per_minute;
+} ei_object_counting_flow_t;
+
+/**
+ * Counts traces crossing lines and entering / leaving polygon zones.
+ *
+ * A line A->B is crossed "in" when a centroid moves from the side where
+ * cross(B - A, P - A) > 0 to the side where it is < 0, and "out" the other
+ * way around. A zone counts "in" when a centroid moves from outside the polygon
+ * to inside, and "out" when it moves back out; traces that first show up, or
+ * disappear, inside a zone are not counted.
+ *
+ * Every open trace keeps its cell, last tested centroid and a side / inside bit
+ * per line and zone. Traces are looked up by id in an open addressing table and
+ * are only tested when their centroid changes cell. Nothing is allocated after
+ * construction.
+ *
+ * A trace can be held (see TraceConsensusFilter): its crossings are kept with
+ * the trace and only counted once it is no longer held. If it is closed while
+ * held they are dropped and added to suppressed_crossings.
+ */
+template<size_t MaxLines, size_t MaxZones, size_t MaxTraces>
+class DirectionalCounter {
+public:
+    static constexpr size_t max_flows = MaxLines + MaxZones;
+
+    DirectionalCounter(const std::vector<std::tuple<int, int, int, int>> &segments) {
+        lines_count = 0;
+        zones_count = 0;
+        frame = 0;
+        bucket_idx = 0;
+        bucket_start_ms = 0;
+        set_lines(segments);
+    }
+
+    void set_lines(const std::vector<std::tuple<int, int, int, int>> &segments) {
+        lines_count = segments.size() < MaxLines ? segments.size() : MaxLines;
+        if (segments.size() > MaxLines) {
+            EI_LOGW("DirectionalCounter: only the first %d of %d segments are counted\n", (int)MaxLines, (int)segments.size());
+        }
+        for (size_t i = 0; i < lines_count; i++) {
+            lines[i][0] = std::get<0>(segments[i]);
+            lines[i][1] = std::get<1>(segments[i]);
+            lines[i][2] = std::get<2>(segments[i]);
+            lines[i][3] = std::get<3>(segments[i]);
+        }
+        reset();
+    }
+
+    void get_lines(std::vector<std::tuple<int, int, int, int>> &segments) const {
+        segments.clear();
+        for (size_t i = 0; i < lines_count; i++) {
+            segments.push_back(std::make_tuple(lines[i][0], lines[i][1], lines[i][2], lines[i][3]));
+        }
+    }
+
+    bool set_zones(const ei_object_counting_zone_t *new_zones, size_t count) {
+        if (count > MaxZones) {
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (new_zones[i].vertices_count < 3 ||
+                new_zones[i].vertices_count > EI_CLASSIFIER_OBJECT_COUNTING_MAX_ZONE_VERTICES) {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            zones[i] = new_zones[i];
+        }
+        zones_count = count;
+        reset();
+        return true;
+    }
+
+    /**
+     * Update the counters with the open traces of the current frame
+     * @param now_ms Timestamp of the frame, for the per-minute rates
+     * @param held Optional, per trace: non-zero to hold back its crossings
+     */
+    void update(const ei_object_tracking_trace_t *traces, size_t traces_count, uint64_t now_ms,
+                const uint8_t *held = NULL) {
+        advance_buckets(now_ms);
+        if (++frame == 0) {
+            frame = 1; // 0 marks free slots
+        }
+
+        for (size_t i = 0; i < traces_count; i++) {
+            const ei_object_tracking_trace_t *trace = &traces[i];
+            float px = trace->x + static_cast<float>(trace->width) / 2;
+            float py = trace->y + static_cast<float>(trace->height) / 2;
+            int16_t cell_x = (int16_t)(px / EI_CLASSIFIER_OBJECT_COUNTING_CELL_SIZE);
+            int16_t cell_y = (int16_t)(py / EI_CLASSIFIER_OBJECT_COUNTING_CELL_SIZE);
+
+            trace_state_t *s = find_or_insert(trace->id);
+            if (!s) {
+                EI_LOGD("DirectionalCounter: no room for trace %d\n", (int)trace->id);
+                continue;
+            }
+
+            bool is_new = s->frame == 0;
+            bool hold = held != NULL && held[i] != 0;
+            s->frame = frame;
+
+            if (is_new) {
+                s->has_pending = false;
+                s->cell_x = cell_x;
+                s->cell_y = cell_y;
+                s->px = px;
+                s->py = py;
+                s->line_known = 0;
+                s->line_positive = 0;
+                s->zone_inside = 0;
+                for (size_t k = 0; k < lines_count; k++) {
+                    float side = line_side(k, px, py);
+                    if (side != 0) {
+                        s->line_known |= (1u << k);
+                        if (side > 0) s->line_positive |= (1u << k);
+                    }
+                }
+                for (size_t k = 0; k < zones_count; k++) {
+                    if (zone_contains(k, px, py)) s->zone_inside |= (1u << k);
+                }
+                continue;
+            }
+
+            if (!hold && s->has_pending) {
+                commit_pending(s);
+            }
+
+            if (cell_x == s->cell_x && cell_y == s->cell_y) {
+                continue;
+            }
+
+            for (size_t k = 0; k < lines_count; k++) {
+                float side = line_side(k, px, py);
+                if (side == 0) continue; // on the line, wait until it is clearly on one side
+
+                uint32_t bit = 1u << k;
+                bool positive = side > 0;
+                if ((s->line_known & bit) && ((s->line_positive & bit) != 0) != positive &&
+                    move_crosses_line(k, s->px, s->py, px, py)) {
+                    count_or_hold(s, k, !positive, hold);
+                }
+                s->line_known |= bit;
+                if (positive) s->line_positive |= bit;
+                else s->line_positive &= ~bit;
+            }
+
+            for (size_t k = 0; k < zones_count; k++) {
+                uint32_t bit = 1u << k;
+                bool inside = zone_contains(k, px, py);
+                if (inside != ((s->zone_inside & bit) != 0)) {
+                    count_or_hold(s, MaxLines + k, inside, hold);
+                }
+                if (inside) s->zone_inside |= bit;
+                else s->zone_inside &= ~bit;
+            }
+
+            s->cell_x = cell_x;
+            s->cell_y = cell_y;
+            s->px = px;
+            s->py = py;
+        }
+
+        drop_closed_traces();
+        fill_outputs();
+    }
+
+    size_t flows_count() const {
+        return lines_count + zones_count;
+    }
+
+    // lines first, then zones
+    ei_object_counting_flow_t flows[max_flows];
+    uint32_t counts[max_flows];
+
+    // crossings of traces that were closed while held
+    uint32_t suppressed_crossings;
+
+private:
+    typedef struct {
+        uint32_t id;
+        uint32_t frame; // 0 = free slot
+        int16_t cell_x;
+        int16_t cell_y;
+        float px;
+        float py;
+        uint32_t line_known;
+        uint32_t line_positive;
+        uint32_t zone_inside;
+        bool has_pending;
+        uint8_t pending_in[max_flows];  // crossings while held
+        uint8_t pending_out[max_flows];
+    } trace_state_t;
+
+    static constexpr size_t table_size = MaxTraces * 2;
+
+    static_assert(MaxLines <= 32 && MaxZones <= 32, "line and zone state is kept in 32-bit masks");
+
+    void reset() {
+        memset(table, 0, sizeof(table));
+        live_traces = 0;
+        memset(totals_in, 0, sizeof(totals_in));
+        memset(totals_out, 0, sizeof(totals_out));
+        memset(buckets_in, 0, sizeof(buckets_in));
+        memset(buckets_out, 0, sizeof(buckets_out));
+        suppressed_crossings = 0;
+        fill_outputs();
+    }
+
+    trace_state_t *find_or_insert(uint32_t id) {
+        size_t slot = id % table_size;
+        for (size_t probe = 0; probe < table_size; probe++) {
+            trace_state_t *s = &table[slot];
+            if (s->frame == 0) {
+                if (live_traces == MaxTraces) {
+                    return NULL;
+                }
+                s->id = id;
+                live_traces++;
+                return s;
+            }
+            if (s->id == id) {
+                return s;
+            }
+            slot = (slot + 1) % table_size;
+        }
+        return NULL;
+    }
+
+    // rebuild the table with the traces seen this frame, keeps probe chains short
+    void drop_closed_traces() {
+        memcpy(scratch, table, sizeof(table));
+        memset(table, 0, sizeof(table));
+        live_traces = 0;
+        for (size_t i = 0; i < table_size; i++) {
+            if (scratch[i].frame != frame) {
+                if (scratch[i].frame != 0 && scratch[i].has_pending) {
+                    for (size_t k = 0; k < max_flows; k++) {
+                        suppressed_crossings += scratch[i].pending_in[k] + scratch[i].pending_out[k];
+                    }
+                }
+                continue;
+            }
+            size_t slot = scratch[i].id % table_size;
+            while (table[slot].frame != 0) {
+                slot = (slot + 1) % table_size;
+            }
+            table[slot] = scratch[i];
+            live_traces++;
+        }
+    }
+
+    float line_side(size_t k, float px, float py) const {
+        const int *l = lines[k];
+        return (float)(l[2] - l[0]) * (py - l[1]) - (float)(l[3] - l[1]) * (px - l[0]);
+    }
+
+    // whether A and B lie on different sides of the movement (or on it)
+    bool move_crosses_line(size_t k, float x0, float y0, float x1, float y1) const {
+        const int *l = lines[k];
+        float d1 = (x1 - x0) * (l[1] - y0) - (y1 - y0) * (l[0] - x0);
+        float d2 = (x1 - x0) * (l[3] - y0) - (y1 - y0) * (l[2] - x0);
+        return (d1 <= 0 && d2 >= 0) || (d1 >= 0 && d2 <= 0);
+    }
+
+    // even-odd rule, the edge intersection is compared through the sign of a cross product
+    bool zone_contains(size_t k, float px, float py) const {
+        const ei_object_counting_zone_t *z = &zones[k];
+        bool inside = false;
+        for (size_t i = 0, j = z->vertices_count - 1; i < z->vertices_count; j = i++) {
+            float xi = z->x[i], yi = z->y[i];
+            float xj = z->x[j], yj = z->y[j];
+            if ((yi > py) == (yj > py)) continue;
+            float c = (xj - xi) * (py - yi) - (px - xi) * (yj - yi);
+            if (yj > yi ? c > 0 : c < 0) {
+                inside = !inside;
+            }
+        }
+        return inside;
+    }
+
+    void count(size_t flow_idx, bool in) {
+        if (in) {
+            totals_in[flow_idx]++;
+            buckets_in[bucket_idx][flow_idx]++;
+        }
+        else {
+            totals_out[flow_idx]++;
+            buckets_out[bucket_idx][flow_idx]++;
+        }
+    }
+
+    void count_or_hold(trace_state_t *s, size_t flow_idx, bool in, bool hold) {
+        if (!hold) {
+            count(flow_idx, in);
+            return;
+        }
+        if (!s->has_pending) {
+            memset(s->pending_in, 0, sizeof(s->pending_in));
+            memset(s->pending_out, 0, sizeof(s->pending_out));
+            s->has_pending = true;
+        }
+        uint8_t *pending = in ? &s->pending_in[flow_idx] : &s->pending_out[flow_idx];
+        if (*pending < UINT8_MAX) {
+            (*pending)++;
+        }
+    }
+
+    void commit_pending(trace_state_t *s) {
+        for (size_t k = 0; k < max_flows; k++) {
+            for (uint8_t n = 0; n < s->pending_in[k]; n++) count(k, true);
+            for (uint8_t n = 0; n < s->pending_out[k]; n++) count(k, false);
+        }
+        s->has_pending = false;
+    }
+
+    void advance_buckets(uint64_t now_ms) {
+        if (now_ms < bucket_start_ms || now_ms - bucket_start_ms >= 60000) {
+            // first frame, clock jump, or nothing seen for a minute
+            memset(buckets_in, 0, sizeof(buckets_in));
+            memset(buckets_out, 0, sizeof(buckets_out));
+            bucket_start_ms = now_ms;
+            return;
+        }
+        while (now_ms - bucket_start_ms >= EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKET_MS) {
+            bucket_idx = (bucket_idx + 1) % EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKETS;
+            memset(buckets_in[bucket_idx], 0, sizeof(buckets_in[bucket_idx]));
+            memset(buckets_out[bucket_idx], 0, sizeof(buckets_out[bucket_idx]));
+            bucket_start_ms += EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKET_MS;
+        }
+    }
+
+    void fill_outputs() {
+        for (size_t i = 0; i < flows_count(); i++) {
+            // zones are stored after MaxLines, outputs are packed
+            size_t src = i < lines_count ? i : MaxLines + (i - lines_count);
+            ei_object_counting_flow_t *f = &flows[i];
+            f->in = totals_in[src];
+            f->out = totals_out[src];
+            f->net = (int32_t)(f->in - f->out);
+            f->in_per_minute = 0;
+            f->out_per_minute = 0;
+            for (size_t b = 0; b < EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKETS; b++) {
+                f->in_per_minute += buckets_in[b][src];
+                f->out_per_minute += buckets_out[b][src];
+            }
+            counts[i] = f->in + f->out;
+        }
+    }
+
+    int lines[MaxLines][4];
+    size_t lines_count;
+    ei_object_counting_zone_t zones[MaxZones];
+    size_t zones_count;
+
+    trace_state_t table[table_size];
+    trace_state_t scratch[table_size];
+    size_t live_traces;
+    uint32_t frame;
+
+    uint32_t totals_in[max_flows];
+    uint32_t totals_out[max_flows];
+    uint16_t buckets_in[EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKETS][max_flows];
+    uint16_t buckets_out[EI_CLASSIFIER_OBJECT_COUNTING_RATE_BUCKETS][max_flows];
+    size_t bucket_idx;
+    uint64_t bucket_start_ms;
+};
+
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL == 1
+typedef DirectionalCounter<EI_CLASSIFIER_OBJECT_COUNTING_MAX_LINES,
+                           EI_CLASSIFIER_OBJECT_COUNTING_MAX_ZONES,
+                           EI_CLASSIFIER_OBJECT_COUNTING_MAX_TRACES> ei_object_counter_t;
+#else
+typedef CrossingCounter ei_object_counter_t;
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS
+#define EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS 1
+#endif
+
+#define EI_CONSENSUS_K_OF_N 0
+#define EI_CONSENSUS_EMA    1
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_MODE
+#define EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_MODE EI_CONSENSUS_K_OF_N
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_K
+#define EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_K 3
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_N
+#define EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_N 5
+#endif
+
+// three frames in a row with a detection reach 0.784
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_EMA_ALPHA
+#define EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_EMA_ALPHA 0.4f
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_EMA_THRESHOLD
+#define EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_EMA_THRESHOLD 0.75f
+#endif
+
+/**
+ * When a trace is confirmed for counting
+ */
+typedef struct {
+    uint8_t mode;           // EI_CONSENSUS_K_OF_N or EI_CONSENSUS_EMA
+    uint8_t k;              // k-of-n: frames with a detection among the last n
+    uint8_t n;              // 1..32
+    float ema_alpha;        // EMA: weight of the current frame
+    float ema_threshold;    // EMA: presence score that confirms the trace
+} ei_object_counting_consensus_config_t;
+
+#define EI_OBJECT_COUNTING_CONSENSUS_CONFIG_DEFAULT { EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_MODE, \
+                                                      EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_K, \
+                                                      EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_N, \
+                                                      EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_EMA_ALPHA, \
+                                                      EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS_EMA_THRESHOLD }
+
+typedef struct {
+    uint32_t confirmed_traces;      // traces that reached consensus
+    uint32_t rejected_traces;       // traces closed before they did
+    uint32_t suppressed_crossings;  // crossings of traces while they weren't confirmed, not counted
+} ei_object_counting_consensus_stats_t;
+
+/**
+ * Temporal consensus on detection presence, between the tracker and the
+ * counter. A flickering detection opens short lived traces next to a bee that
+ * can grab its detection for a frame or two and jump across a line. A trace is
+ * held until it had a detection in k of the last n frames (a bit ring per
+ * trace), or its presence EMA reaches a threshold. Confirmation sticks until
+ * the trace is closed, the tracker bridges the gaps of a confirmed trace.
+ *
+ * A trace is present on a frame when the tracker matched a detection to it
+ * (its last_ground_truth_update_t moved). Frames the model didn't run on
+ * (run_classifier_predicted()) don't step the history. Traces are kept in an
+ * open addressing table like DirectionalCounter, so memory is constant.
+ */
+template<size_t MaxTraces>
+class TraceConsensusFilter {
+public:
+    TraceConsensusFilter(const ei_object_counting_consensus_config_t &config) {
+        set_config(config);
+    }
+
+    void set_config(const ei_object_counting_consensus_config_t &new_config) {
+        config = new_config;
+        if (config.n < 1) config.n = 1;
+        if (config.n > 32) config.n = 32;
+        if (config.k < 1) config.k = 1;
+        if (config.k > config.n) config.k = config.n;
+        history_mask = config.n == 32 ? 0xffffffffu : ((1u << config.n) - 1);
+        reset();
+    }
+
+    const ei_object_counting_consensus_config_t &get_config() const {
+        return config;
+    }
+
+    void reset() {
+        memset(table, 0, sizeof(table));
+        live_traces = 0;
+        frame = 0;
+        clear_stats();
+    }
+
+    void clear_stats() {
+        confirmed_traces = 0;
+        rejected_traces = 0;
+    }
+
+    /**
+     * Step the open traces of the current frame
+     * @param observed false on frames the model didn't run on
+     * @param held Receives a flag per trace, non-zero while it isn't confirmed
+     */
+    void update(const ei_object_tracking_trace_t *traces, size_t traces_count, bool observed, uint8_t *held) {
+        if (++frame == 0) {
+            frame = 1; // 0 marks free slots
+        }
+
+        for (size_t i = 0; i < traces_count; i++) {
+            const ei_object_tracking_trace_t *trace = &traces[i];
+            trace_state_t *s = find_or_insert(trace->id);
+            if (!s) {
+                // no room to judge it, counting it beats losing it
+                held[i] = 0;
+                continue;
+            }
+
+            bool is_new = s->frame == 0;
+            s->frame = frame;
+            if (is_new) {
+                s->history = 0;
+                s->score = 0;
+                s->confirmed = false;
+            }
+            if (!s->confirmed && (is_new || observed)) {
+                bool present = is_new || trace->last_ground_truth_update_t != s->last_update_t;
+                if (config.mode == EI_CONSENSUS_EMA) {
+                    s->score = config.ema_alpha * (present ? 1.0f : 0.0f) + (1.0f - config.ema_alpha) * s->score;
+                    s->confirmed = s->score >= config.ema_threshold;
+                }
+                else {
+                    s->history = ((s->history << 1) | (present ? 1u : 0u)) & history_mask;
+                    s->confirmed = popcount(s->history) >= config.k;
+                }
+                if (s->confirmed) {
+                    confirmed_traces++;
+                }
+            }
+            s->last_update_t = trace->last_ground_truth_update_t;
+            held[i] = s->confirmed ? 0 : 1;
+        }
+
+        drop_closed_traces();
+    }
+
+    uint32_t confirmed_traces;
+    uint32_t rejected_traces;
+
+private:
+    typedef struct {
+        uint32_t id;
+        uint32_t frame; // 0 = free slot
+        uint32_t last_update_t;
+        uint32_t history;
+        float score;
+        bool confirmed;
+    } trace_state_t;
+
+    static constexpr size_t table_size = MaxTraces * 2;
+
+    static int popcount(uint32_t v) {
+        int bits = 0;
+        for (; v; v &= v - 1) bits++;
+        return bits;
+    }
+
+    trace_state_t *find_or_insert(uint32_t id) {
+        size_t slot = id % table_size;
+        for (size_t probe = 0; probe < table_size; probe++) {
+            trace_state_t *s = &table[slot];
+            if (s->frame == 0) {
+                if (live_traces == MaxTraces) {
+                    return NULL;
+                }
+                s->id = id;
+                live_traces++;
+                return s;
+            }
+            if (s->id == id) {
+                return s;
+            }
+            slot = (slot + 1) % table_size;
+        }
+        return NULL;
+    }
+
+    // rebuild the table with the traces seen this frame, the others were closed
+    void drop_closed_traces() {
+        memcpy(scratch, table, sizeof(table));
+        memset(table, 0, sizeof(table));
+        live_traces = 0;
+        for (size_t i = 0; i < table_size; i++) {
+            if (scratch[i].frame != frame) {
+                if (scratch[i].frame != 0 && !scratch[i].confirmed) {
+                    rejected_traces++;
+                }
+                continue;
+            }
+            size_t slot = scratch[i].id % table_size;
+            while (table[slot].frame != 0) {
+                slot = (slot + 1) % table_size;
+            }
+            table[slot] = scratch[i];
+            live_traces++;
+        }
+    }
+
+    ei_object_counting_consensus_config_t config;
+    uint32_t history_mask;
+    trace_state_t table[table_size];
+    trace_state_t scratch[table_size];
+    size_t live_traces;
+    uint32_t frame;
+};
+
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL != 1
+/**
+ * The crossings of held traces for CrossingCounter, which keeps no state per
+ * trace. Like DirectionalCounter they are kept with the trace, counted once
+ * it is no longer held and added to suppressed_crossings if it is closed
+ * while held. Only the first MaxSegments segments can be kept, crossings of
+ * the others are counted right away. Traces are kept in an open addressing
+ * table like TraceConsensusFilter.
+ */
+template<size_t MaxTraces, size_t MaxSegments>
+class HeldCrossings {
+public:
+    HeldCrossings() {
+        reset();
+    }
+
+    void reset() {
+        memset(table, 0, sizeof(table));
+        live_traces = 0;
+        frame = 0;
+        suppressed_crossings = 0;
+    }
+
+    /**
+     * Count or keep the last centroid segment of every open trace
+     * @param held Per trace, non-zero while it isn't confirmed
+     */
+    void update(CrossingCounter &counter, const ei_object_tracking_trace_t *traces, size_t traces_count,
+                const uint8_t *held) {
+        if (++frame == 0) {
+            frame = 1; // 0 marks free slots
+        }
+
+        for (size_t i = 0; i < traces_count; i++) {
+            const ei_object_tracking_trace_t *trace = &traces[i];
+            trace_state_t *s = find_or_insert(trace->id);
+            if (!s) {
+                // no room to keep its crossings, counting them beats losing them
+                counter.update(trace->last_centroid_segment);
+                continue;
+            }
+
+            if (s->frame == 0) {
+                s->has_pending = false;
+            }
+            s->frame = frame;
+
+            if (!held[i]) {
+                if (s->has_pending) {
+                    commit_pending(counter, s);
+                }
+                counter.update(trace->last_centroid_segment);
+                continue;
+            }
+
+            for (size_t k = 0; k < counter.segments.size(); k++) {
+                if (!counter.crosses(k, trace->last_centroid_segment)) {
+                    continue;
+                }
+                if (k >= MaxSegments) {
+                    counter.counts[k]++;
+                    continue;
+                }
+                if (!s->has_pending) {
+                    memset(s->pending, 0, sizeof(s->pending));
+                    s->has_pending = true;
+                }
+                if (s->pending[k] < UINT8_MAX) {
+                    s->pending[k]++;
+                }
+            }
+        }
+
+        drop_closed_traces();
+    }
+
+    // crossings of traces that were closed while held
+    uint32_t suppressed_crossings;
+
+private:
+    typedef struct {
+        uint32_t id;
+        uint32_t frame; // 0 = free slot
+        bool has_pending;
+        uint8_t pending[MaxSegments];
+    } trace_state_t;
+
+    static constexpr size_t table_size = MaxTraces * 2;
+
+    trace_state_t *find_or_insert(uint32_t id) {
+        size_t slot = id % table_size;
+        for (size_t probe = 0; probe < table_size; probe++) {
+            trace_state_t *s = &table[slot];
+            if (s->frame == 0) {
+                if (live_traces == MaxTraces) {
+                    return NULL;
+                }
+                s->id = id;
+                live_traces++;
+                return s;
+            }
+            if (s->id == id) {
+                return s;
+            }
+            slot = (slot + 1) % table_size;
+        }
+        return NULL;
+    }
+
+    void commit_pending(CrossingCounter &counter, trace_state_t *s) {
+        for (size_t k = 0; k < MaxSegments && k < counter.counts.size(); k++) {
+            counter.counts[k] += s->pending[k];
+        }
+        s->has_pending = false;
+    }
+
+    // rebuild the table with the traces seen this frame, the others were closed
+    void drop_closed_traces() {
+        memcpy(scratch, table, sizeof(table));
+        memset(table, 0, sizeof(table));
+        live_traces = 0;
+        for (size_t i = 0; i < table_size; i++) {
+            if (scratch[i].frame != frame) {
+                if (scratch[i].frame != 0 && scratch[i].has_pending) {
+                    for (size_t k = 0; k < MaxSegments; k++) {
+                        suppressed_crossings += scratch[i].pending[k];
+                    }
+                }
+                continue;
+            }
+            size_t slot = scratch[i].id % table_size;
+            while (table[slot].frame != 0) {
+                slot = (slot + 1) % table_size;
+            }
+            table[slot] = scratch[i];
+            live_traces++;
+        }
+    }
+
+    trace_state_t table[table_size];
+    trace_state_t scratch[table_size];
+    size_t live_traces;
+    uint32_t frame;
+};
+#endif
+
+/**
+ * State of the counting block
+ */
+typedef struct {
+    ei_object_counter_t *counter;
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+    TraceConsensusFilter<EI_CLASSIFIER_OBJECT_COUNTING_MAX_TRACES> *filter;
+    uint8_t *held;                  // per open trace, from the filter
+    size_t held_size;
+    uint32_t tracker_frame;
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL != 1
+    // CrossingCounter has no per trace state to hold crossings in
+    HeldCrossings<EI_CLASSIFIER_OBJECT_COUNTING_MAX_TRACES, EI_CLASSIFIER_OBJECT_COUNTING_MAX_LINES> *crossings;
+#endif
+#endif
+} ei_object_counting_state_t;
+
 EI_IMPULSE_ERROR init_object_counting(ei_impulse_handle_t *handle, void **state, void *config)
 {
     // const ei_impulse_t *impulse = handle->impulse;
     const ei_object_counting_config_t *object_counting_config = (ei_object_counting_config_t*)config;
 
     // Allocate the object counter
-    CrossingCounter *object_counter = new CrossingCounter(object_counting_config->segments);
+    ei_object_counting_state_t *counting = new ei_object_counting_state_t();
 
-    if (!object_counter) {
+    if (!counting) {
         return EI_IMPULSE_POSTPROCESSING_ERROR;
     }
+    counting->counter = new ei_object_counter_t(object_counting_config->segments);
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+    const ei_object_counting_consensus_config_t consensus = EI_OBJECT_COUNTING_CONSENSUS_CONFIG_DEFAULT;
+    counting->filter = new TraceConsensusFilter<EI_CLASSIFIER_OBJECT_COUNTING_MAX_TRACES>(consensus);
+    counting->held = NULL;
+    counting->held_size = 0;
+    counting->tracker_frame = 0;
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL != 1
+    counting->crossings = new HeldCrossings<EI_CLASSIFIER_OBJECT_COUNTING_MAX_TRACES, EI_CLASSIFIER_OBJECT_COUNTING_MAX_LINES>();
+#endif
+#endif
 
     // Store the object counter in the handle
-    *state = (void *)object_counter;
+    *state = (void *)counting;
 
     return EI_IMPULSE_OK;
 }
 
 EI_IMPULSE_ERROR deinit_object_counting(void *state, void *config)
 {
-    CrossingCounter *object_counter = (CrossingCounter*)state;
+    ei_object_counting_state_t *counting = (ei_object_counting_state_t*)state;
 
-    if (object_counter) {
-        delete object_counter;
+    if (counting) {
+        delete counting->counter;
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+        delete counting->filter;
+        ei_free(counting->held);
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL != 1
+        delete counting->crossings;
+#endif
+#endif
+        delete counting;
     }
 
     return EI_IMPULSE_OK;
@@ -119,17 +947,63 @@ EI_IMPULSE_ERROR process_object_counting(ei_impulse_handle_t *handle,
                                          void *state)
 {
     const ei_impulse_t *impulse = handle->impulse;
-    CrossingCounter *object_counter = (CrossingCounter*)state;
+    ei_object_counting_state_t *counting = (ei_object_counting_state_t*)state;
 
     if (impulse->sensor == EI_CLASSIFIER_SENSOR_CAMERA) {
-        if((void *)object_counter != NULL) {
+        if((void *)counting != NULL) {
+            ei_object_counter_t *object_counter = counting->counter;
+            const uint8_t *held = NULL;
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+            size_t traces_count = result->postprocessed_output.object_tracking_output.open_traces_count;
+            if (traces_count > counting->held_size) {
+                ei_free(counting->held);
+                counting->held = (uint8_t *)ei_malloc(traces_count);
+                counting->held_size = counting->held ? traces_count : 0;
+                if (!counting->held) {
+                    return EI_IMPULSE_OUT_OF_MEMORY;
+                }
+            }
+
+            // the tracker's frame only moves on frames the model ran on
+            bool observed = true;
+#if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+            uint32_t tracker_frame;
+            if (get_object_tracking_frame(handle, &tracker_frame) == EI_IMPULSE_OK) {
+                observed = tracker_frame != counting->tracker_frame;
+                counting->tracker_frame = tracker_frame;
+            }
+#endif
+            counting->filter->update(result->postprocessed_output.object_tracking_output.open_traces,
+                                     traces_count, observed, counting->held);
+            held = counting->held;
+#endif
+
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL == 1
+            object_counter->update(result->postprocessed_output.object_tracking_output.open_traces,
+                                   result->postprocessed_output.object_tracking_output.open_traces_count,
+                                   ei_read_timer_ms(),
+                                   held);
+
+            // in + out per line, then per zone; see get_object_counting_flows() for the split
+            result->postprocessed_output.object_counting_output.counts = object_counter->counts;
+            result->postprocessed_output.object_counting_output.counter_num = object_counter->flows_count();
+#else
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+            counting->crossings->update(*object_counter,
+                                        result->postprocessed_output.object_tracking_output.open_traces,
+                                        result->postprocessed_output.object_tracking_output.open_traces_count,
+                                        held);
+#else
             for (size_t i = 0; i < result->postprocessed_output.object_tracking_output.open_traces_count; i++) {
                 ei_object_tracking_trace_t trace = result->postprocessed_output.object_tracking_output.open_traces[i];
                 object_counter->update(trace.last_centroid_segment);
             }
+            (void)held;
+#endif
 
             result->postprocessed_output.object_counting_output.counts = object_counter->counts.data();
             result->postprocessed_output.object_counting_output.counter_num = object_counter->counts.size();
+#endif
         }
     }
 
@@ -153,9 +1027,20 @@ EI_IMPULSE_ERROR set_post_process_params(ei_impulse_handle_t* handle, ei_object_
     if (block_number == -1) {
         return EI_IMPULSE_POSTPROCESSING_ERROR;
     }
-    CrossingCounter *object_counter = (CrossingCounter*)handle->post_processing_state[block_number];
+    ei_object_counting_state_t *counting = (ei_object_counting_state_t*)handle->post_processing_state[block_number];
 
-    object_counter->segments = params->segments;
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL == 1
+    counting->counter->set_lines(params->segments);
+#else
+    counting->counter->segments = params->segments;
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+    // the kept crossings are by segment index
+    counting->crossings->reset();
+#endif
+#endif
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+    counting->filter->clear_stats();
+#endif
     return EI_IMPULSE_OK;
 }
 
@@ -164,9 +1049,13 @@ EI_IMPULSE_ERROR get_post_process_params(ei_impulse_handle_t* handle, ei_object_
     if (block_number == -1) {
         return EI_IMPULSE_POSTPROCESSING_ERROR;
     }
-    CrossingCounter *object_counter = (CrossingCounter*)handle->post_processing_state[block_number];
+    ei_object_counter_t *object_counter = ((ei_object_counting_state_t*)handle->post_processing_state[block_number])->counter;
 
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL == 1
+    object_counter->get_lines(params->segments);
+#else
     params->segments = object_counter->segments;
+#endif
     return EI_IMPULSE_OK;
 }
 
@@ -189,5 +1078,122 @@ EI_IMPULSE_ERROR get_post_process_params(ei_object_counting_config_t *params) {
     return EI_IMPULSE_OK;
 }
 
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL == 1
+/**
+ * Replace the polygon zones, this resets all counters
+ */
+EI_IMPULSE_ERROR set_object_counting_zones(ei_impulse_handle_t* handle, const ei_object_counting_zone_t *zones, size_t zones_count) {
+    int16_t block_number = get_block_number(handle, (void*)init_object_counting);
+    if (block_number == -1) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    ei_object_counting_state_t *counting = (ei_object_counting_state_t*)handle->post_processing_state[block_number];
+
+    if (!counting->counter->set_zones(zones, zones_count)) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+    counting->filter->clear_stats();
+#endif
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Directional counts of the last processed frame, lines first, then zones
+ */
+EI_IMPULSE_ERROR get_object_counting_flows(ei_impulse_handle_t* handle, const ei_object_counting_flow_t **flows, size_t *flows_count) {
+    int16_t block_number = get_block_number(handle, (void*)init_object_counting);
+    if (block_number == -1) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    ei_object_counter_t *object_counter = ((ei_object_counting_state_t*)handle->post_processing_state[block_number])->counter;
+
+    *flows = object_counter->flows;
+    *flows_count = object_counter->flows_count();
+    return EI_IMPULSE_OK;
+}
+
+// versions that operate on the default impulse
+EI_IMPULSE_ERROR set_object_counting_zones(const ei_object_counting_zone_t *zones, size_t zones_count) {
+    ei_impulse_handle_t* handle = &ei_default_impulse;
+
+    if(handle->post_processing_state == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    return set_object_counting_zones(handle, zones, zones_count);
+}
+
+EI_IMPULSE_ERROR get_object_counting_flows(const ei_object_counting_flow_t **flows, size_t *flows_count) {
+    ei_impulse_handle_t* handle = &ei_default_impulse;
+
+    if(handle->post_processing_state == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    return get_object_counting_flows(handle, flows, flows_count);
+}
+#endif // EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL == 1
+
+#if EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+/**
+ * Change when traces are confirmed for counting. The open traces are
+ * forgotten and have to reach consensus again, the counts are kept.
+ */
+EI_IMPULSE_ERROR set_object_counting_consensus(ei_impulse_handle_t* handle, const ei_object_counting_consensus_config_t *config) {
+    int16_t block_number = get_block_number(handle, (void*)init_object_counting);
+    if (block_number == -1 || handle->post_processing_state == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    ei_object_counting_state_t *counting = (ei_object_counting_state_t*)handle->post_processing_state[block_number];
+
+    counting->filter->set_config(*config);
+    return EI_IMPULSE_OK;
+}
+
+EI_IMPULSE_ERROR get_object_counting_consensus(ei_impulse_handle_t* handle, ei_object_counting_consensus_config_t *config) {
+    int16_t block_number = get_block_number(handle, (void*)init_object_counting);
+    if (block_number == -1 || handle->post_processing_state == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    ei_object_counting_state_t *counting = (ei_object_counting_state_t*)handle->post_processing_state[block_number];
+
+    *config = counting->filter->get_config();
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Traces confirmed and rejected by the consensus filter, and the crossings it
+ * kept from the counter, since the lines or zones were last set
+ */
+EI_IMPULSE_ERROR get_object_counting_consensus_stats(ei_impulse_handle_t* handle, ei_object_counting_consensus_stats_t *stats) {
+    int16_t block_number = get_block_number(handle, (void*)init_object_counting);
+    if (block_number == -1 || handle->post_processing_state == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    ei_object_counting_state_t *counting = (ei_object_counting_state_t*)handle->post_processing_state[block_number];
+
+    stats->confirmed_traces = counting->filter->confirmed_traces;
+    stats->rejected_traces = counting->filter->rejected_traces;
+#if EI_CLASSIFIER_OBJECT_COUNTING_DIRECTIONAL == 1
+    stats->suppressed_crossings = counting->counter->suppressed_crossings;
+#else
+    stats->suppressed_crossings = counting->crossings->suppressed_crossings;
+#endif
+    return EI_IMPULSE_OK;
+}
+
+// versions that operate on the default impulse
+EI_IMPULSE_ERROR set_object_counting_consensus(const ei_object_counting_consensus_config_t *config) {
+    return set_object_counting_consensus(&ei_default_impulse, config);
+}
+
+EI_IMPULSE_ERROR get_object_counting_consensus(ei_object_counting_consensus_config_t *config) {
+    return get_object_counting_consensus(&ei_default_impulse, config);
+}
+
+EI_IMPULSE_ERROR get_object_counting_consensus_stats(ei_object_counting_consensus_stats_t *stats) {
+    return get_object_counting_consensus_stats(&ei_default_impulse, stats);
+}
+#endif // EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1
+
 #endif // EI_CLASSIFIER_OBJECT_COUNTING_ENABLED
 #endif // EI_OBJECT_COUNTING_H
\ No newline at end of file
@@ -48,6 +48,7 @@ extern ei_impulse_handle_t & ei_default_impulse;
 #include <vector>
 #include "tinyEKF/tinyekf.hpp"
 #include "alignment/ei_alignment.hpp"
+#include "alignment/ei_alignment_static.hpp"
 
 float clip(float num, float min_val = -3.4028235e+38, float max_val = 3.4028235e+38) {
     return std::fmax(min_val, std::fmin(num, max_val));
@@ -59,6 +60,18 @@ typedef struct {
     float keep_grace;
 } ei_obj_tracking_params_t;
 
+/**
+ * How far a prediction was off: distance between the predicted and the
+ * observed centroid, relative to the larger side of the observed box
+ */
+__attribute__((unused)) static float ei_object_tracking_prediction_error(const ei_impulse_result_bounding_box_t &predicted,
+                                                                         const ei_impulse_result_bounding_box_t &observed) {
+    float dx = (predicted.x + predicted.width / 2.0f) - (observed.x + observed.width / 2.0f);
+    float dy = (predicted.y + predicted.height / 2.0f) - (observed.y + observed.height / 2.0f);
+    float size = std::fmax(1.0f, static_cast<float>(std::max(observed.width, observed.height)));
+    return std::sqrt(dx * dx + dy * dy) / size;
+}
+
 class ExponentialMovingAverage {
 public:
     ExponentialMovingAverage(int n, float gain = 2) : gain(gain / (n + 1)), ema_value(-255.0) {
@@ -84,7 +97,8 @@ private:
 class Trace {
 public:
     Trace(int id, int t, const ei_impulse_result_bounding_box_t& initial_bbox, uint32_t max_observations = 5)
-        : id(id), last_ground_truth_update_t(t), last_prediction(initial_bbox), max_observations(max_observations) {
+        : id(id), last_ground_truth_update_t(t), last_prediction(initial_bbox), prediction_error(1.0f),
+          max_observations(max_observations) {
         if (max_observations < 2) {
             EI_LOGE("%s", "max_observations needs to be at least 2 for counting");
         }
@@ -145,6 +159,7 @@ public:
         } else {
             EI_LOGD("update (ground truth prediction) %d %d %d %d %f\n", bbox->x, bbox->y, bbox->width, bbox->height, bbox->value);
             last_ground_truth_update_t = t;
+            prediction_error = ei_object_tracking_prediction_error(last_prediction, *bbox);
         }
 
         hx_centroid[0] = centroid_filter->x[0];
@@ -224,6 +239,8 @@ public:
     uint32_t id;
     uint32_t last_ground_truth_update_t;
     ei_impulse_result_bounding_box_t last_prediction;
+    // error of the prediction at the last detection, 1 until the trace has been predicted
+    float prediction_error;
 
 private:
     std::vector<ei_impulse_result_bounding_box_t> observations;
@@ -372,6 +389,56 @@ public:
         }
 
         open_traces = traces_tmp;
+        update_output();
+        t += 1;
+    }
+
+    /**
+     * Advance the open traces by one frame the model didn't run on. Every
+     * trace rolls its filters forward on its own prediction, like a trace
+     * without a match in process_new_detections(). Frames without detections
+     * don't count towards keep_grace, and no trace is opened or closed.
+     */
+    void predict_frame() {
+        for (auto trace : open_traces) {
+            trace->predict();
+            trace->update(t, nullptr);
+        }
+        update_output();
+    }
+
+    size_t open_trace_count() const {
+        return open_traces.size();
+    }
+
+    // frames the model ran on so far, predicted frames don't count
+    uint32_t frame() const {
+        return t;
+    }
+
+    /**
+     * Largest prediction error of the open traces, 0 without open traces
+     */
+    float prediction_uncertainty() const {
+        float uncertainty = 0;
+        for (auto trace : open_traces) {
+            uncertainty = std::fmax(uncertainty, trace->prediction_error);
+        }
+        return uncertainty;
+    }
+
+    void set_threshold(float threshold) {
+        alignment.threshold = threshold;
+    }
+
+    float get_threshold() {
+        return alignment.threshold;
+    }
+
+    uint32_t keep_grace;
+    uint16_t max_observations;
+private:
+    void update_output() {
         object_tracking_output.clear();
 
         for (auto trace : open_traces) {
@@ -387,9 +454,364 @@ public:
 
             object_tracking_output.push_back(trace_result);
         }
+    }
+
+    uint32_t trace_seq_id;
+    uint32_t t;
+    JonkerVolgenantAlignment alignment;
+    std::vector<std::string> seen_labels;
+};
+
+#ifndef EI_CLASSIFIER_OBJECT_TRACKING_STATIC
+#define EI_CLASSIFIER_OBJECT_TRACKING_STATIC 0
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES
+#define EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES 32
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_TRACKING_MAX_DETECTIONS
+#define EI_CLASSIFIER_OBJECT_TRACKING_MAX_DETECTIONS EI_CLASSIFIER_MAX_OBJECT_DETECTION_COUNT
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_TRACKING_MAX_OBSERVATIONS
+#define EI_CLASSIFIER_OBJECT_TRACKING_MAX_OBSERVATIONS 8
+#endif
+
+/**
+ * Trace with inline filter state and a fixed ring of observations.
+ * Same filtering as Trace, but it can live in a preallocated pool.
+ */
+template <size_t MaxObservations>
+class StaticTrace {
+public:
+    StaticTrace() : centroid_filter(zero_xy, 8, 2), width_height_filter(zero_xy, 8, 2),
+                    xyxy_emas{ ExponentialMovingAverage(1), ExponentialMovingAverage(1),
+                               ExponentialMovingAverage(1), ExponentialMovingAverage(1) } {
+    }
+
+    void reset(int id, int t, const ei_impulse_result_bounding_box_t& initial_bbox, uint32_t max_observations = 5) {
+        if (max_observations < 2) {
+            EI_LOGE("%s", "max_observations needs to be at least 2 for counting");
+        }
+        this->id = id;
+        this->last_ground_truth_update_t = t;
+        this->last_prediction = initial_bbox;
+        this->prediction_error = 1.0f;
+        this->max_observations = max_observations > MaxObservations ? MaxObservations : max_observations;
+
+        trace_label = initial_bbox.label;
+        trace_score = initial_bbox.value;
+        observations_head = 0;
+        observations_count = 0;
+        push_observation(initial_bbox);
+
+        float initial_centroid[2] = { initial_bbox.x + static_cast<float>(initial_bbox.width) / 2,
+                                      initial_bbox.y + static_cast<float>(initial_bbox.height) / 2 };
+
+        float initial_width_height[2] = { static_cast<float>(initial_bbox.width),
+                                          static_cast<float>(initial_bbox.height) };
+
+        centroid_filter = TinyEKF(initial_centroid, 8, 2);
+        width_height_filter = TinyEKF(initial_width_height, 8, 2);
+
+        // smoothing follows the requested window even when the ring is shorter
+        for (size_t i = 0; i < 4; i++) {
+            xyxy_emas[i] = ExponentialMovingAverage(max_observations);
+        }
+    }
+
+    ei_impulse_result_bounding_box_t predict() {
+        fx_centroid[0] = centroid_filter.x[0];
+        fx_centroid[1] = centroid_filter.x[1];
+        fx_width_height[0] = width_height_filter.x[0];
+        fx_width_height[1] = width_height_filter.x[1];
+
+        centroid_filter.predict(fx_centroid);
+        width_height_filter.predict(fx_width_height);
+
+        ei_impulse_result_bounding_box_t p_bbox = {"", 0, 0, 0, 0, 0.0};
+        p_bbox.label = trace_label;
+        p_bbox.value = trace_score;
+        p_bbox.x = round(clip((centroid_filter.x[0] - width_height_filter.x[0] / 2), 0));
+        p_bbox.y = round(clip(centroid_filter.x[1] - width_height_filter.x[1] / 2, 0));
+        p_bbox.width = round(clip(width_height_filter.x[0], 0));
+        p_bbox.height = round(clip(width_height_filter.x[1], 0));
+        last_prediction = p_bbox;
+        return last_prediction;
+    }
+
+    void update(int t, const ei_impulse_result_bounding_box_t* bbox) {
+        if (bbox == nullptr) {
+            bbox = &last_prediction;
+        } else {
+            last_ground_truth_update_t = t;
+            prediction_error = ei_object_tracking_prediction_error(last_prediction, *bbox);
+        }
+
+        hx_centroid[0] = centroid_filter.x[0];
+        hx_centroid[1] = centroid_filter.x[1];
+        hx_width_height[0] = width_height_filter.x[0];
+        hx_width_height[1] = width_height_filter.x[1];
+
+        float centroid[2] = { bbox->x + static_cast<float>(bbox->width) / 2,
+                              bbox->y + static_cast<float>(bbox->height) / 2 };
+        centroid_filter.update(centroid , hx_centroid);
+
+        float width_height[2] = { static_cast<float>(bbox->width),
+                                  static_cast<float>(bbox->height) };
+        width_height_filter.update(width_height, hx_width_height);
+
+        trace_score = bbox->value;
+        push_observation(*bbox);
+
+        xyxy_emas[0].update(bbox->x);
+        xyxy_emas[1].update(bbox->y);
+        xyxy_emas[2].update(bbox->width);
+        xyxy_emas[3].update(bbox->height);
+    }
+
+    std::tuple<int, int, int, int> last_centroid_segment() const {
+        if (observations_count < 2) {
+            return {};
+        }
+        const ei_impulse_result_bounding_box_t &obs_t_minus1 = observation(observations_count - 2);
+        const ei_impulse_result_bounding_box_t &obs_t_0 = observation(observations_count - 1);
+
+        return {obs_t_minus1.x + static_cast<float>(obs_t_minus1.width) / 2,
+                obs_t_minus1.y + static_cast<float>(obs_t_minus1.height) / 2,
+                obs_t_0.x + static_cast<float>(obs_t_0.width) / 2,
+                obs_t_0.y + static_cast<float>(obs_t_0.height) / 2};
+    }
+
+    const ei_impulse_result_bounding_box_t* last_observation() const {
+        if (observations_count == 0) {
+            return nullptr;
+        }
+        return &observation(observations_count - 1);
+    }
+
+    ei_impulse_result_bounding_box_t smoothed_last_observation() {
+        ei_impulse_result_bounding_box_t bbox = {"", 0, 0, 0, 0, 0.0};
+        if (observations_count == 0) {
+            return bbox;
+        }
+
+        bbox.x = round(xyxy_emas[0].smoothed_value());
+        bbox.y = round(xyxy_emas[1].smoothed_value());
+        bbox.width = round(xyxy_emas[2].smoothed_value());
+        bbox.height = round(xyxy_emas[3].smoothed_value());
+        bbox.label = trace_label;
+        bbox.value = trace_score;
+        return bbox;
+    }
+
+    uint32_t id;
+    uint32_t last_ground_truth_update_t;
+    ei_impulse_result_bounding_box_t last_prediction;
+    // error of the prediction at the last detection, 1 until the trace has been predicted
+    float prediction_error;
+
+private:
+    // i-th oldest observation still kept
+    const ei_impulse_result_bounding_box_t &observation(uint32_t i) const {
+        return observations[(observations_head + i) % MaxObservations];
+    }
+
+    void push_observation(const ei_impulse_result_bounding_box_t &bbox) {
+        if (observations_count < max_observations) {
+            observations[(observations_head + observations_count) % MaxObservations] = bbox;
+            observations_count++;
+        }
+        else {
+            // drop the oldest, as Trace does with observations.erase(begin())
+            observations[(observations_head + observations_count) % MaxObservations] = bbox;
+            observations_head = (observations_head + 1) % MaxObservations;
+        }
+    }
+
+    static constexpr float zero_xy[2] = { 0, 0 };
+
+    ei_impulse_result_bounding_box_t observations[MaxObservations];
+    uint32_t observations_head;
+    uint32_t observations_count;
+    TinyEKF centroid_filter;
+    TinyEKF width_height_filter;
+    uint32_t max_observations;
+    float fx_centroid[2];
+    float fx_width_height[2];
+    float hx_centroid[2];
+    float hx_width_height[2];
+    const char* trace_label;
+    float trace_score;
+    ExponentialMovingAverage xyxy_emas[4];
+};
+
+template <size_t MaxObservations>
+constexpr float StaticTrace<MaxObservations>::zero_xy[2];
+
+/**
+ * Allocation-free counterpart of Tracker.
+ *
+ * Matching semantics are the same as Tracker (Jonker-Volgenant alignment
+ * against both the last observations and the Kalman predictions, whichever
+ * has the lower total cost wins), but traces live in a fixed pool and all
+ * scratch buffers are members, so process_new_detections() never touches the
+ * heap. Detections beyond MaxDetections and new traces beyond MaxTraces are
+ * dropped with a warning.
+ */
+template <size_t MaxTraces, size_t MaxDetections, size_t MaxObservations = EI_CLASSIFIER_OBJECT_TRACKING_MAX_OBSERVATIONS>
+class StaticTracker {
+public:
+    typedef StaticJonkerVolgenantAlignment<MaxTraces, MaxDetections> alignment_t;
+
+    StaticTracker(uint32_t keep_grace = 5, uint16_t max_observations = 5, float threshold = 0.5, bool use_iou = true)
+            : keep_grace(keep_grace),
+              max_observations(max_observations),
+              alignment(threshold, use_iou) {
+        trace_seq_id = 0;
+        t = 0;
+        open_traces_count = 0;
+        object_tracking_output_count = 0;
+        for (size_t i = 0; i < MaxTraces; i++) {
+            free_slots[i] = MaxTraces - 1 - i;
+        }
+        free_slots_count = MaxTraces;
+    }
+
+    /**
+     * Process new detections.
+     * @param bbs Bounding boxes, not modified (they are copied and sorted internally)
+     * @param bbs_num Number of bounding boxes
+     */
+    void process_new_detections(const ei_impulse_result_bounding_box_t *bbs, size_t bbs_num) {
+        if (bbs_num > MaxDetections) {
+            EI_LOGW("StaticTracker: %u detections, only tracking the first %u\n", (unsigned)bbs_num, (unsigned)MaxDetections);
+            bbs_num = MaxDetections;
+        }
+        memcpy(detections, bbs, bbs_num * sizeof(ei_impulse_result_bounding_box_t));
+        detections_count = bbs_num;
+
+        // same ordering as Tracker, so it doesn't matter in what order we pass in the detections
+        std::sort(detections, detections + detections_count, [](const ei_impulse_result_bounding_box_t& a, const ei_impulse_result_bounding_box_t& b) {
+            if (a.x != b.x) return a.x < b.x;
+            if (a.y != b.y) return a.y < b.y;
+            if (a.width != b.width) return a.width < b.width;
+            if (a.height != b.height) return a.height < b.height;
+            return std::strcmp(a.label, b.label) < 0;
+        });
+
+        // firstly try an alignment with last observations...
+        for (size_t i = 0; i < open_traces_count; i++) {
+            trace_bboxes[i] = *traces[open_traces[i]].last_observation();
+        }
+        size_t last_obs_matches_count = alignment.align(trace_bboxes, open_traces_count,
+                                                        detections, detections_count,
+                                                        last_obs_matches);
+        float last_obs_cost = 0;
+        for (size_t i = 0; i < last_obs_matches_count; i++) {
+            last_obs_cost += last_obs_matches[i].score;
+        }
+
+        // ... then with the kalman filter predictions
+        for (size_t i = 0; i < open_traces_count; i++) {
+            trace_bboxes[i] = traces[open_traces[i]].predict();
+        }
+        size_t predicted_matches_count = alignment.align(trace_bboxes, open_traces_count,
+                                                         detections, detections_count,
+                                                         predicted_matches);
+        float predicted_cost = 0;
+        for (size_t i = 0; i < predicted_matches_count; i++) {
+            predicted_cost += predicted_matches[i].score;
+        }
+        EI_LOGD("last_obs_cost %f predicted_cost %f\n", last_obs_cost, predicted_cost);
+
+        // and use whichever matching set is better
+        const ei_alignment_match_t *matches = predicted_matches;
+        size_t matches_count = predicted_matches_count;
+        if (last_obs_cost < predicted_cost) {
+            matches = last_obs_matches;
+            matches_count = last_obs_matches_count;
+        }
+
+        for (size_t i = 0; i < detections_count; i++) {
+            detection_assigned[i] = false;
+        }
+
+        // update existing traces with any matches
+        for (size_t i = 0; i < matches_count; i++) {
+            traces[open_traces[matches[i].trace_idx]].update(t, &detections[matches[i].detection_idx]);
+            detection_assigned[matches[i].detection_idx] = true;
+        }
+
+        // unassigned detections become new traces
+        for (size_t i = 0; i < detections_count; i++) {
+            if (detection_assigned[i]) {
+                continue;
+            }
+            if (free_slots_count == 0) {
+                EI_LOGW("StaticTracker: out of trace slots (%u), dropping detection\n", (unsigned)MaxTraces);
+                break;
+            }
+            uint16_t slot = free_slots[--free_slots_count];
+            traces[slot].reset(trace_seq_id, t, detections[i], max_observations);
+            open_traces[open_traces_count++] = slot;
+            trace_seq_id += 1;
+        }
+
+        // close stale traces, roll the rest forward, keeping their order
+        size_t still_open = 0;
+        for (size_t i = 0; i < open_traces_count; i++) {
+            uint16_t slot = open_traces[i];
+            trace_t &trace = traces[slot];
+            uint32_t time_since_last_update = t - trace.last_ground_truth_update_t;
+            if (time_since_last_update > keep_grace) {
+                EI_LOGD("closing trace %d\n", trace.id);
+                free_slots[free_slots_count++] = slot;
+            }
+            else {
+                if (trace.last_ground_truth_update_t != t) {
+                    // wasn't match this step, so do rollout of filters
+                    trace.update(t, nullptr);
+                }
+                open_traces[still_open++] = slot;
+            }
+        }
+        open_traces_count = still_open;
+        update_output();
         t += 1;
     }
 
+    /**
+     * Advance the open traces by one frame the model didn't run on, see
+     * Tracker::predict_frame()
+     */
+    void predict_frame() {
+        for (size_t i = 0; i < open_traces_count; i++) {
+            trace_t &trace = traces[open_traces[i]];
+            trace.predict();
+            trace.update(t, nullptr);
+        }
+        update_output();
+    }
+
+    size_t open_trace_count() const {
+        return open_traces_count;
+    }
+
+    // frames the model ran on so far, predicted frames don't count
+    uint32_t frame() const {
+        return t;
+    }
+
+    float prediction_uncertainty() const {
+        float uncertainty = 0;
+        for (size_t i = 0; i < open_traces_count; i++) {
+            uncertainty = std::fmax(uncertainty, traces[open_traces[i]].prediction_error);
+        }
+        return uncertainty;
+    }
+
     void set_threshold(float threshold) {
         alignment.threshold = threshold;
     }
@@ -398,13 +820,151 @@ public:
         return alignment.threshold;
     }
 
+    ei_object_tracking_trace_t object_tracking_output[MaxTraces];
+    size_t object_tracking_output_count;
+
     uint32_t keep_grace;
     uint16_t max_observations;
 private:
+    typedef StaticTrace<MaxObservations> trace_t;
+
+    void update_output() {
+        for (size_t i = 0; i < open_traces_count; i++) {
+            const trace_t &trace = traces[open_traces[i]];
+            ei_object_tracking_trace_t &trace_result = object_tracking_output[i];
+            trace_result = { 0 };
+            trace_result.id = trace.id;
+            trace_result.last_ground_truth_update_t = trace.last_ground_truth_update_t;
+            trace_result.label = trace.last_prediction.label;
+            trace_result.x = trace.last_prediction.x;
+            trace_result.y = trace.last_prediction.y;
+            trace_result.width = trace.last_prediction.width;
+            trace_result.height = trace.last_prediction.height;
+            trace_result.last_centroid_segment = trace.last_centroid_segment();
+        }
+        object_tracking_output_count = open_traces_count;
+    }
+
     uint32_t trace_seq_id;
     uint32_t t;
-    JonkerVolgenantAlignment alignment;
-    std::vector<std::string> seen_labels;
+    alignment_t alignment;
+
+    trace_t traces[MaxTraces];
+    uint16_t open_traces[MaxTraces];
+    size_t open_traces_count;
+    uint16_t free_slots[MaxTraces];
+    size_t free_slots_count;
+
+    ei_impulse_result_bounding_box_t detections[MaxDetections];
+    size_t detections_count;
+    bool detection_assigned[MaxDetections];
+    ei_impulse_result_bounding_box_t trace_bboxes[MaxTraces];
+    ei_alignment_match_t last_obs_matches[alignment_t::max_matches];
+    ei_alignment_match_t predicted_matches[alignment_t::max_matches];
+};
+
+#if EI_CLASSIFIER_OBJECT_TRACKING_STATIC == 1
+typedef StaticTracker<EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES, EI_CLASSIFIER_OBJECT_TRACKING_MAX_DETECTIONS> ei_object_tracker_t;
+#else
+typedef Tracker ei_object_tracker_t;
+#endif
+
+#ifndef EI_CLASSIFIER_OBJECT_TRACKING_SKIP_MAX_INTERVAL
+#define EI_CLASSIFIER_OBJECT_TRACKING_SKIP_MAX_INTERVAL 3
+#endif
+
+/**
+ * Frame skipping: run the model on every n-th frame and advance the traces
+ * by prediction in between (run_classifier_predicted()).
+ */
+typedef struct {
+    uint16_t max_interval;          // frames per inference while every trace is predicted well
+    uint16_t idle_interval;         // frames per inference without open traces
+    uint16_t traces_per_step;       // each this many open traces shortens the interval by a frame, 0 = ignore
+    float max_prediction_error;     // prediction error at (and above) which every frame runs the model
+} ei_frame_skip_config_t;
+
+#define EI_FRAME_SKIP_CONFIG_DEFAULT { EI_CLASSIFIER_OBJECT_TRACKING_SKIP_MAX_INTERVAL, 2, 4, 0.5f }
+
+/**
+ * Picks the frames the model runs on. The interval shrinks linearly with the
+ * largest prediction error of the open traces (a new trace counts as fully
+ * uncertain, so it is always confirmed on the next frame) and with the number
+ * of open traces.
+ *
+ * Per frame:
+ *   if (scheduler.should_run_model()) {
+ *       run_classifier(&signal, &result);
+ *       size_t traces; float uncertainty;
+ *       get_object_tracking_state(&traces, &uncertainty);
+ *       scheduler.update(traces, uncertainty);
+ *   } else {
+ *       run_classifier_predicted(&result);
+ *   }
+ */
+class EiFrameSkipScheduler {
+public:
+    EiFrameSkipScheduler(const ei_frame_skip_config_t &config = EI_FRAME_SKIP_CONFIG_DEFAULT)
+        : config(config), current_interval(1), countdown(0), frames_count(0), inferences_count(0) {
+        if (this->config.max_interval < 1) {
+            this->config.max_interval = 1;
+        }
+    }
+
+    /**
+     * Call once per frame
+     * @return true when the model has to run on this frame
+     */
+    bool should_run_model() {
+        frames_count++;
+        if (countdown > 0) {
+            countdown--;
+            return false;
+        }
+        inferences_count++;
+        countdown = current_interval - 1;
+        return true;
+    }
+
+    /**
+     * Call after every inference with the tracker state
+     */
+    void update(size_t open_traces, float uncertainty) {
+        uint16_t max_interval = config.max_interval;
+        int interval;
+        if (open_traces == 0) {
+            interval = config.idle_interval;
+        }
+        else {
+            float error = config.max_prediction_error > 0 ? uncertainty / config.max_prediction_error : 1.0f;
+            error = std::fmin(1.0f, std::fmax(0.0f, error));
+            interval = 1 + (int)std::lround((max_interval - 1) * (1.0f - error));
+            if (config.traces_per_step > 0) {
+                interval -= (int)(open_traces / config.traces_per_step);
+            }
+        }
+        current_interval = (uint16_t)std::max(1, std::min<int>(interval, max_interval));
+        countdown = current_interval - 1;
+    }
+
+    void reset() {
+        current_interval = 1;
+        countdown = 0;
+        frames_count = 0;
+        inferences_count = 0;
+    }
+
+    uint16_t interval() const { return current_interval; }
+    uint32_t frames() const { return frames_count; }
+    uint32_t inferences() const { return inferences_count; }
+
+    ei_frame_skip_config_t config;
+
+private:
+    uint16_t current_interval;
+    uint16_t countdown;
+    uint32_t frames_count;
+    uint32_t inferences_count;
 };
 
 EI_IMPULSE_ERROR init_object_tracking(ei_impulse_handle_t *handle, void** state, void *config)
@@ -413,7 +973,7 @@ EI_IMPULSE_ERROR init_object_tracking(ei_impulse_handle_t *handle, void** state,
     const ei_object_tracking_config_t *ei_object_tracking_config = (ei_object_tracking_config_t*)config;
 
     // Allocate the object counter
-    Tracker *object_tracker = new Tracker(ei_object_tracking_config->keep_grace,
+    ei_object_tracker_t *object_tracker = new ei_object_tracker_t(ei_object_tracking_config->keep_grace,
                                           ei_object_tracking_config->max_observations,
                                           ei_object_tracking_config->threshold,
                                           ei_object_tracking_config->use_iou);
@@ -429,7 +989,7 @@ EI_IMPULSE_ERROR init_object_tracking(ei_impulse_handle_t *handle, void** state,
 
 EI_IMPULSE_ERROR deinit_object_tracking(void* state, void *config)
 {
-    Tracker *object_tracker = (Tracker *)state;
+    ei_object_tracker_t *object_tracker = (ei_object_tracker_t *)state;
 
     if (object_tracker) {
         delete object_tracker;
@@ -438,6 +998,17 @@ EI_IMPULSE_ERROR deinit_object_tracking(void* state, void *config)
     return EI_IMPULSE_OK;
 }
 
+__attribute__((unused)) static void set_object_tracking_output(ei_object_tracker_t *object_tracker, ei_impulse_result_t *result)
+{
+#if EI_CLASSIFIER_OBJECT_TRACKING_STATIC == 1
+    result->postprocessed_output.object_tracking_output.open_traces = object_tracker->object_tracking_output;
+    result->postprocessed_output.object_tracking_output.open_traces_count = object_tracker->object_tracking_output_count;
+#else
+    result->postprocessed_output.object_tracking_output.open_traces = object_tracker->object_tracking_output.data();
+    result->postprocessed_output.object_tracking_output.open_traces_count = object_tracker->object_tracking_output.size();
+#endif
+}
+
 EI_IMPULSE_ERROR process_object_tracking(ei_impulse_handle_t *handle,
                                          uint32_t block_index,
                                          uint32_t input_block_id,
@@ -445,17 +1016,19 @@ EI_IMPULSE_ERROR process_object_tracking(ei_impulse_handle_t *handle,
                                          void *config_ptr,
                                          void *state)
 {
-    Tracker *object_tracker = (Tracker *)state;
+    ei_object_tracker_t *object_tracker = (ei_object_tracker_t *)state;
 
     if((void *)object_tracker != NULL) {
         ei_impulse_result_bounding_box_t *bbs = result->bounding_boxes;
         uint32_t bbs_num = result->bounding_boxes_count;
+#if EI_CLASSIFIER_OBJECT_TRACKING_STATIC == 1
+        object_tracker->process_new_detections(bbs, bbs_num);
+#else
         std::vector<ei_impulse_result_bounding_box_t> detections(bbs, bbs + bbs_num);
 
         object_tracker->process_new_detections(detections);
-
-        result->postprocessed_output.object_tracking_output.open_traces = object_tracker->object_tracking_output.data();
-        result->postprocessed_output.object_tracking_output.open_traces_count = object_tracker->object_tracking_output.size();
+#endif
+        set_object_tracking_output(object_tracker, result);
     }
     else {
         EI_LOGW("process_object_tracking: object_tracker is NULL, did you forget to call run_classifier_init()?\n");
@@ -464,6 +1037,64 @@ EI_IMPULSE_ERROR process_object_tracking(ei_impulse_handle_t *handle,
     return EI_IMPULSE_OK;
 }
 
+/**
+ * Advance the traces of the object tracking block by prediction, for a frame
+ * the model didn't run on, and put them in the result
+ */
+EI_IMPULSE_ERROR predict_object_tracking(ei_impulse_handle_t *handle, ei_impulse_result_t *result)
+{
+    int16_t block_number = get_block_number(handle, (void*)init_object_tracking);
+    if (block_number == -1 || handle->post_processing_state == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    ei_object_tracker_t *object_tracker = (ei_object_tracker_t*)handle->post_processing_state[block_number];
+    if (object_tracker == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+
+    object_tracker->predict_frame();
+    set_object_tracking_output(object_tracker, result);
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Open traces and their largest prediction error, to feed EiFrameSkipScheduler
+ */
+EI_IMPULSE_ERROR get_object_tracking_state(ei_impulse_handle_t *handle, size_t *open_traces, float *uncertainty)
+{
+    int16_t block_number = get_block_number(handle, (void*)init_object_tracking);
+    if (block_number == -1 || handle->post_processing_state == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    ei_object_tracker_t *object_tracker = (ei_object_tracker_t*)handle->post_processing_state[block_number];
+    if (object_tracker == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+
+    *open_traces = object_tracker->open_trace_count();
+    *uncertainty = object_tracker->prediction_uncertainty();
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Frames the tracker processed model output for, frames advanced by
+ * predict_object_tracking() don't count
+ */
+EI_IMPULSE_ERROR get_object_tracking_frame(ei_impulse_handle_t *handle, uint32_t *frame)
+{
+    int16_t block_number = get_block_number(handle, (void*)init_object_tracking);
+    if (block_number == -1 || handle->post_processing_state == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+    ei_object_tracker_t *object_tracker = (ei_object_tracker_t*)handle->post_processing_state[block_number];
+    if (object_tracker == NULL) {
+        return EI_IMPULSE_POSTPROCESSING_ERROR;
+    }
+
+    *frame = object_tracker->frame();
+    return EI_IMPULSE_OK;
+}
+
 EI_IMPULSE_ERROR display_object_tracking(ei_impulse_result_t *result,
                                          void *config)
 {
@@ -488,7 +1119,7 @@ EI_IMPULSE_ERROR set_post_process_params(ei_impulse_handle_t* handle, ei_object_
     if (block_number == -1) {
         return EI_IMPULSE_POSTPROCESSING_ERROR;
     }
-    Tracker *object_tracker = (Tracker*)handle->post_processing_state[block_number];
+    ei_object_tracker_t *object_tracker = (ei_object_tracker_t*)handle->post_processing_state[block_number];
 
     object_tracker->keep_grace = params->keep_grace;
     object_tracker->max_observations = params->max_observations;
@@ -501,7 +1132,7 @@ EI_IMPULSE_ERROR get_post_process_params(ei_impulse_handle_t* handle, ei_object_
     if (block_number == -1) {
         return EI_IMPULSE_POSTPROCESSING_ERROR;
     }
-    Tracker *object_tracker = (Tracker*)handle->post_processing_state[block_number];
+    ei_object_tracker_t *object_tracker = (ei_object_tracker_t*)handle->post_processing_state[block_number];
 
     params->keep_grace = object_tracker->keep_grace;
     params->max_observations = object_tracker->max_observations;
@@ -528,5 +1159,9 @@ EI_IMPULSE_ERROR get_post_process_params(ei_object_tracking_config_t *params) {
     return EI_IMPULSE_OK;
 }
 
+EI_IMPULSE_ERROR get_object_tracking_state(size_t *open_traces, float *uncertainty) {
+    return get_object_tracking_state(&ei_default_impulse, open_traces, uncertainty);
+}
+
 #endif // EI_CLASSIFIER_OBJECT_TRACKING_ENABLED
 #endif // EI_OBJECT_TRACKING_H
\ No newline at end of file
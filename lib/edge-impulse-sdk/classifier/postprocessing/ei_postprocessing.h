@@ -36,6 +36,7 @@
 #define EI_POSTPROCESSING_H
 
 #include "edge-impulse-sdk/classifier/ei_model_types.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
 
 #if EI_CLASSIFIER_CALIBRATION_ENABLED
 #include "edge-impulse-sdk/classifier/postprocessing/ei_performance_calibration.h"
@@ -105,6 +106,7 @@ extern "C" EI_IMPULSE_ERROR run_postprocessing(ei_impulse_handle_t *handle,
         return EI_IMPULSE_OUT_OF_MEMORY;
     }
     auto impulse = handle->impulse;
+    uint64_t postprocessing_start_us = ei_read_timer_us();
 
     for (size_t ix = 0; ix < impulse->postprocessing_blocks_size; ix++) {
         void* state = NULL;
@@ -131,9 +133,50 @@ extern "C" EI_IMPULSE_ERROR run_postprocessing(ei_impulse_handle_t *handle,
         }
     }
 
+    result->timing.postprocessing_us = ei_read_timer_us() - postprocessing_start_us;
+
     return EI_IMPULSE_OK;
 }
 
+#if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+/**
+ * Post-processing for a frame the model didn't run on: the object tracking
+ * block advances its traces by prediction, and the blocks after it (e.g.
+ * object counting) run on the predicted traces. The blocks before it need
+ * model output and are skipped.
+ */
+extern "C" EI_IMPULSE_ERROR run_postprocessing_predicted(ei_impulse_handle_t *handle,
+                                                         ei_impulse_result_t *result) {
+    if (!handle) {
+        return EI_IMPULSE_OUT_OF_MEMORY;
+    }
+    auto impulse = handle->impulse;
+    uint64_t postprocessing_start_us = ei_read_timer_us();
+
+    EI_IMPULSE_ERROR res = predict_object_tracking(handle, result);
+    if (res != EI_IMPULSE_OK) {
+        return res;
+    }
+
+    int16_t tracking_block = get_block_number(handle, (void*)init_object_tracking);
+    for (size_t ix = tracking_block + 1; ix < impulse->postprocessing_blocks_size; ix++) {
+        res = impulse->postprocessing_blocks[ix].postprocess_fn(handle,
+                                                                ix,
+                                                                impulse->postprocessing_blocks[ix].input_block_id,
+                                                                result,
+                                                                impulse->postprocessing_blocks[ix].config,
+                                                                handle->post_processing_state[ix]);
+        if (res != EI_IMPULSE_OK) {
+            return res;
+        }
+    }
+
+    result->timing.postprocessing_us = ei_read_timer_us() - postprocessing_start_us;
+
+    return EI_IMPULSE_OK;
+}
+#endif
+
 extern "C" EI_IMPULSE_ERROR display_postprocessing(ei_impulse_handle_t *handle,
                                                    ei_impulse_result_t *result) {
     if (!handle) {
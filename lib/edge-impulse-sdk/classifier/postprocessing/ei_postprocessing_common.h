@@ -276,6 +276,255 @@ __attribute__((unused)) static void process_cubes(ei_impulse_result_t *result, s
     result->bounding_boxes_count = added_boxes_count;
 }
 
+#ifdef EI_HAS_FOMO
+
+/**
+ * Allocation-free variant of ei_handle_cube + process_cubes.
+ *
+ * Cubes live in a fixed pool instead of being allocated per activated cell.
+ * Rows are scanned top to bottom and a cube only ever grows when a cell joins
+ * it, so once its bottom edge is more than one row above the current row it
+ * can't match anymore. Only the remaining ("active") cubes are searched, still
+ * in creation order, which gives exactly the same boxes as the cube path.
+ *
+ * Frames with more than EI_CLASSIFIER_FOMO_MAX_CUBES cubes fall back to the
+ * cube path.
+ */
+#ifndef EI_CLASSIFIER_FOMO_STATIC_CUBES
+#define EI_CLASSIFIER_FOMO_STATIC_CUBES 1
+#endif
+
+#ifndef EI_CLASSIFIER_FOMO_MAX_CUBES
+#define EI_CLASSIFIER_FOMO_MAX_CUBES 64
+#endif
+
+/**
+ * Threshold of a quantized FOMO output, in the int8 domain.
+ *
+ * Finds the smallest int8 value v for which the float path's test
+ * !((v - zero_point) * scale < threshold) passes, by evaluating that exact
+ * expression for all 256 values, so comparing the raw output against it gives
+ * the same cells. If the passing values are not one contiguous upper range
+ * (scale <= 0, NaN) every value is let through and the float test decides.
+ * @return int8 threshold, or 128 if no value can pass
+ */
+__attribute__((unused)) static int16_t ei_fomo_i8_threshold(float zero_point, float scale, float threshold) {
+    static bool cached = false;
+    static float cached_zero_point;
+    static float cached_scale;
+    static float cached_threshold;
+    static int16_t cached_q;
+
+    if (cached && zero_point == cached_zero_point && scale == cached_scale && threshold == cached_threshold) {
+        return cached_q;
+    }
+
+    int16_t q = 128;
+    bool contiguous = true;
+    for (int16_t v = -128; v <= 127; v++) {
+        float vf = static_cast<float>(v - zero_point) * scale;
+        bool passes = !(vf < threshold);
+        if (passes && q == 128) {
+            q = v;
+        }
+        else if (!passes && q != 128) {
+            contiguous = false;
+        }
+    }
+
+    cached = true;
+    cached_zero_point = zero_point;
+    cached_scale = scale;
+    cached_threshold = threshold;
+    cached_q = contiguous ? q : -128;
+    return cached_q;
+}
+
+/**
+ * Whether any class output in a row of cells is at or above the int8 threshold.
+ * Single class models (background + class per cell) are checked two cells per
+ * 32-bit word: the class bytes are masked out, biased to unsigned and added to
+ * (256 - threshold) in 16-bit lanes, so a carry into bit 8 marks a hit.
+ */
+__attribute__((unused)) static bool ei_fomo_i8_row_above(const int8_t *row, size_t cells, size_t label_count, int16_t q_threshold) {
+    if (q_threshold > 127) {
+        return false;
+    }
+
+    const size_t stride = label_count + 1;
+    size_t i = 0;
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    if (stride == 2) {
+        const uint32_t add = (uint32_t)(256 - (q_threshold + 128)) * 0x00010001u;
+        for (; i + 2 <= cells; i += 2) {
+            uint32_t w;
+            memcpy(&w, row + (i * stride), sizeof(w));
+            uint32_t lanes = ((w >> 8) & 0x00ff00ffu) ^ 0x00800080u;
+            if ((lanes + add) & 0x01000100u) {
+                return true;
+            }
+        }
+    }
+#endif
+
+    for (; i < cells; i++) {
+        for (size_t ix = 1; ix < stride; ix++) {
+            if (row[(i * stride) + ix] >= q_threshold) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Whether any class output in a row of cells is at or above the threshold,
+ * with the same test as ei_handle_cube. No early exit, so the compare doesn't
+ * branch and an empty row costs no more than the cube path's own test.
+ */
+__attribute__((unused)) static bool ei_fomo_f32_row_above(const float *row, size_t cells, size_t label_count, float threshold) {
+    const size_t stride = label_count + 1;
+    bool above = false;
+    for (size_t i = 0; i < cells; i++) {
+        for (size_t ix = 1; ix < stride; ix++) {
+            if (row[(i * stride) + ix] < threshold) continue;
+            above = true;
+        }
+    }
+    return above;
+}
+
+#if EI_CLASSIFIER_FOMO_STATIC_CUBES == 1
+
+static ei_classifier_cube_t ei_fomo_cubes[EI_CLASSIFIER_FOMO_MAX_CUBES];
+static uint16_t ei_fomo_active_cubes[EI_CLASSIFIER_FOMO_MAX_CUBES];
+static uint16_t ei_fomo_merged_cubes[EI_CLASSIFIER_FOMO_MAX_CUBES];
+static ei_impulse_result_bounding_box_t ei_fomo_results[EI_CLASSIFIER_FOMO_MAX_CUBES];
+
+/**
+ * Cluster the activated cells of a FOMO output and fill the result.
+ * @param cell_value Callable as bool(size_t idx, float *vf), returns whether output idx
+ *                   is at or above the threshold and if so writes its confidence
+ * @param row_has_cells Callable as bool(size_t y), may return false to skip a row
+ *                      without any cell above the threshold
+ * @return false if the frame needs more than EI_CLASSIFIER_FOMO_MAX_CUBES cubes,
+ *         result is not touched in that case
+ */
+template<typename CellValueFn, typename RowFn>
+__attribute__((unused)) static bool ei_fomo_fill_static_cubes(ei_impulse_result_t *result,
+                                                              CellValueFn cell_value,
+                                                              RowFn row_has_cells,
+                                                              size_t out_width,
+                                                              size_t out_height,
+                                                              size_t label_count,
+                                                              const char * const *categories,
+                                                              uint32_t out_width_factor,
+                                                              uint32_t object_detection_count) {
+    if (object_detection_count > EI_CLASSIFIER_FOMO_MAX_CUBES) {
+        return false;
+    }
+
+    size_t cubes_count = 0;
+    size_t active_count = 0;
+
+    // same scan order as process_fomo_f32 / process_fomo_i8
+    for (size_t y = 0; y < out_width; y++) {
+        // nothing joins or starts a cube here; retiring can wait for the next row with cells
+        if (!row_has_cells(y)) continue;
+
+        // retire cubes that no cell on this row (or below) can touch, keep the order
+        size_t kept = 0;
+        for (size_t i = 0; i < active_count; i++) {
+            const ei_classifier_cube_t *c = &ei_fomo_cubes[ei_fomo_active_cubes[i]];
+            if (c->y + c->height >= y) {
+                ei_fomo_active_cubes[kept++] = ei_fomo_active_cubes[i];
+            }
+        }
+        active_count = kept;
+
+        for (size_t x = 0; x < out_height; x++) {
+            size_t loc = ((y * out_height) + x) * (label_count + 1);
+
+            for (size_t ix = 1; ix < label_count + 1; ix++) {
+                float vf;
+                if (!cell_value(loc + ix, &vf)) continue;
+
+                const char *label = categories[ix - 1];
+                bool has_overlapping = false;
+
+                for (size_t i = 0; i < active_count; i++) {
+                    ei_classifier_cube_t *c = &ei_fomo_cubes[ei_fomo_active_cubes[i]];
+                    // not cube for same class? continue
+                    if (c->label != label && strcmp(c->label, label) != 0) continue;
+
+                    if (ei_cube_check_overlap(c, x, y, 1, 1, vf)) {
+                        has_overlapping = true;
+                        break;
+                    }
+                }
+
+                if (has_overlapping) continue;
+
+                if (cubes_count == EI_CLASSIFIER_FOMO_MAX_CUBES) {
+                    return false;
+                }
+                ei_fomo_cubes[cubes_count] = { (uint32_t)x, (uint32_t)y, 1, 1, vf, label };
+                ei_fomo_active_cubes[active_count++] = cubes_count;
+                cubes_count++;
+            }
+        }
+    }
+
+    // second pass, see process_cubes
+    size_t merged_count = 0;
+    uint32_t added_boxes_count = 0;
+
+    for (size_t i = 0; i < cubes_count; i++) {
+        const ei_classifier_cube_t *sc = &ei_fomo_cubes[i];
+        bool has_overlapping = false;
+
+        for (size_t j = 0; j < merged_count; j++) {
+            ei_classifier_cube_t *c = &ei_fomo_cubes[ei_fomo_merged_cubes[j]];
+            // not cube for same class? continue
+            if (c->label != sc->label && strcmp(c->label, sc->label) != 0) continue;
+
+            if (ei_cube_check_overlap(c, sc->x, sc->y, sc->width, sc->height, sc->confidence)) {
+                has_overlapping = true;
+                break;
+            }
+        }
+
+        if (has_overlapping) {
+            continue;
+        }
+
+        ei_fomo_merged_cubes[merged_count++] = i;
+
+        ei_fomo_results[added_boxes_count++] = {
+            .label = sc->label,
+            .x = (uint32_t)(sc->x * out_width_factor),
+            .y = (uint32_t)(sc->y * out_width_factor),
+            .width = (uint32_t)(sc->width * out_width_factor),
+            .height = (uint32_t)(sc->height * out_width_factor),
+            .value = sc->confidence
+        };
+    }
+
+    // if we didn't detect min required objects, fill the rest with fixed value
+    for (size_t ix = added_boxes_count; ix < object_detection_count; ix++) {
+        ei_fomo_results[ix] = { };
+    }
+
+    result->bounding_boxes = ei_fomo_results;
+    result->bounding_boxes_count = added_boxes_count;
+    return true;
+}
+
+#endif // EI_CLASSIFIER_FOMO_STATIC_CUBES == 1
+
+#endif // EI_HAS_FOMO
+
 /**
  * Fill the result structure from an unquantized output tensor
  */
@@ -423,6 +672,23 @@ __attribute__((unused)) static EI_IMPULSE_ERROR process_fomo_f32(ei_impulse_hand
     ei::matrix_t* raw_output_mtx = NULL;
     find_mtx_by_idx(result->_raw_outputs, &raw_output_mtx, input_block_id, impulse->learning_blocks_size);
 
+#if EI_CLASSIFIER_FOMO_STATIC_CUBES == 1
+    const float *buffer = raw_output_mtx->buffer;
+    const float threshold = config->threshold;
+    auto cell_value = [buffer, threshold](size_t idx, float *vf) {
+        *vf = buffer[idx];
+        return !(*vf < threshold);
+    };
+    const size_t row_size = config->out_height * (impulse->label_count + 1);
+    auto row_has_cells = [buffer, config, impulse, threshold, row_size](size_t y) {
+        return ei_fomo_f32_row_above(buffer + (y * row_size), config->out_height, impulse->label_count, threshold);
+    };
+    if (ei_fomo_fill_static_cubes(result, cell_value, row_has_cells, config->out_width, config->out_height, impulse->label_count,
+                                  impulse->categories, out_width_factor, config->object_detection_count)) {
+        return EI_IMPULSE_OK;
+    }
+#endif
+
     for (size_t y = 0; y < config->out_width; y++) {
         for (size_t x = 0; x < config->out_height; x++) {
             size_t loc = ((y * config->out_height) + x) * (impulse->label_count + 1);
@@ -460,12 +726,33 @@ __attribute__((unused)) static EI_IMPULSE_ERROR process_fomo_i8(ei_impulse_handl
     ei::matrix_i8_t* raw_output_mtx = NULL;
     find_mtx_by_idx(result->_raw_outputs, &raw_output_mtx, input_block_id, impulse->learning_blocks_size);
 
+    // compare in the int8 domain, only cells that pass are dequantized
+    const int16_t q_threshold = ei_fomo_i8_threshold(config->zero_point, config->scale, config->threshold);
+
+#if EI_CLASSIFIER_FOMO_STATIC_CUBES == 1
+    const int8_t *buffer = raw_output_mtx->buffer;
+    const size_t row_size = config->out_height * (impulse->label_count + 1);
+    auto cell_value = [buffer, config, q_threshold](size_t idx, float *vf) {
+        if (buffer[idx] < q_threshold) return false;
+        *vf = static_cast<float>(buffer[idx] - config->zero_point) * config->scale;
+        return !(*vf < config->threshold);
+    };
+    auto row_has_cells = [buffer, config, impulse, q_threshold, row_size](size_t y) {
+        return ei_fomo_i8_row_above(buffer + (y * row_size), config->out_height, impulse->label_count, q_threshold);
+    };
+    if (ei_fomo_fill_static_cubes(result, cell_value, row_has_cells, config->out_width, config->out_height, impulse->label_count,
+                                  impulse->categories, out_width_factor, config->object_detection_count)) {
+        return EI_IMPULSE_OK;
+    }
+#endif
+
     for (size_t y = 0; y < config->out_width; y++) {
         for (size_t x = 0; x < config->out_height; x++) {
             size_t loc = ((y * config->out_height) + x) * (impulse->label_count + 1);
 
             for (size_t ix = 1; ix < impulse->label_count + 1; ix++) {
                 int8_t v = raw_output_mtx->buffer[loc+ix];
+                if (v < q_threshold) continue;
                 float vf = static_cast<float>(v - config->zero_point) * config->scale;
 
                 ei_handle_cube(&cubes, x, y, vf, impulse->categories[ix - 1], config->threshold);
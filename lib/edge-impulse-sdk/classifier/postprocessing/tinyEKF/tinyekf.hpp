@@ -13,6 +13,11 @@
 #include <string.h>
 #include <stdio.h>
 
+// State and control storage is held inline so a filter never touches the heap;
+// the tracker only ever uses an 8-element state with 2 observations.
+#define TINYEKF_MAX_N 8
+#define TINYEKF_MAX_M 2
+
 template <typename T>
 void print_arr(T *arr, int m, int n, const char *name = "arr") {
 // verbose debug
@@ -37,12 +42,11 @@ public:
             float observation_noise_scale=0.1)
 {
         // set private variables
-        this->EKF_N = EKF_N;
-        this->EKF_M = EKF_M;
+        this->EKF_N = EKF_N > TINYEKF_MAX_N ? TINYEKF_MAX_N : EKF_N;
+        this->EKF_M = EKF_M > TINYEKF_MAX_M ? TINYEKF_MAX_M : EKF_M;
         this->dt = dt;
 
-        x = new float[this->EKF_N];
-        memset(x, 0, sizeof(float) * this->EKF_N);
+        memset(x, 0, sizeof(x));
         // x is the state
         x[0] = x0[0];
         x[1] = x0[1];
@@ -60,8 +64,7 @@ public:
         //      [0, 0, 0, 1]]
         // )
 
-        F = new float[16];
-        memset(F, 0, sizeof(float) * 16);
+        memset(F, 0, sizeof(F));
         for (int i = 0; i < 4; ++i) {
             for (int j = 0; j < 4; ++j) {
                 F[i * 4 + j] = (i == j) ? 1 : 0;
@@ -73,8 +76,7 @@ public:
         print_arr(F, 4, 4, "init F");
 
         // H is the observation model
-        H = new float[8];
-        memset(H, 0, sizeof(float) * 8);
+        memset(H, 0, sizeof(H));
 
         H[0] = H[5] = 1;
 
@@ -82,8 +84,7 @@ public:
         print_arr(H, 2, 4, "init H");
 
         // Q is the covariance of the process noise
-        Q = new float[16];
-        memset(Q, 0, sizeof(float) * 16);
+        memset(Q, 0, sizeof(Q));
 
         // self.Q = (
         //     np.array(
@@ -111,8 +112,7 @@ public:
         print_arr(Q, 4, 4, "init Q");
 
         // R is the covariance of the observation noise
-        R = new float[4];
-        memset(R, 0, sizeof(float) * 4);
+        memset(R, 0, sizeof(R));
 
         for (int i = 0; i < 2; ++i) {
             for (int j = 0; j < 2; ++j) {
@@ -130,20 +130,20 @@ public:
         //      [0, self.dt]]
         // )
 
-        B = new float[this->EKF_N * this->EKF_N * 2];
-        memset(B, 0, sizeof(float) * this->EKF_N * this->EKF_N * 2);
+        memset(B, 0, sizeof(B));
         B[0] = B[3] = (dt * dt) / 2;
         B[4] = B[7] = dt;
 
         if (u == nullptr) {
-            u = new float[2];
-            u[0] = u[1] = 0.1;
+            this->u[0] = this->u[1] = 0.1;
+        }
+        else {
+            this->u[0] = u[0];
+            this->u[1] = u[1];
         }
-        this->u = u;
 
         // P is the predict / update transition
-        P = new float[16];
-        memset(P, 0, sizeof(float) * 16);
+        memset(P, 0, sizeof(P));
 
         for (int i = 0; i < 4; ++i) {
             for (int j = 0; j < 4; ++j) {
@@ -155,32 +155,22 @@ public:
         print_arr(P, 4, 4, "init P");
     }
 
-    ~TinyEKF() {
-        delete[] x;
-        delete[] P;
-        delete[] Q;
-        delete[] F;
-        delete[] H;
-        delete[] R;
-        delete[] B;
-        delete[] u;
-    }
-
     void predict(const float *fx);
     bool update(const float *z, const float *hx);
-    float *x;
+    float x[TINYEKF_MAX_N];
 private:
     uint32_t EKF_N;
     uint32_t EKF_M;
 
-    float *P;
-    float *Q;
-    float *F;
-    float *H;
-    float *R;
+    float P[16];
+    float Q[16];
+    float F[16];
+    float H[8];
+    float R[4];
 
-    float *B;
-    float *u;
+    // B is a 4x2 control-input model
+    float B[8];
+    float u[TINYEKF_MAX_M];
     float dt;
 
     void update_step3(float *GH);
@@ -364,7 +354,7 @@ private:
     /// @private
     static bool invert(const float * a, float * ainv, uint32_t EKF_M)
     {
-        float tmp[EKF_M];
+        float tmp[TINYEKF_MAX_M];
 
         return _cholsl(a, ainv, tmp, EKF_M) == 0;
     }
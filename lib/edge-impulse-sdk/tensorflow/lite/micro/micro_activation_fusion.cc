@@ -0,0 +1,288 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_activation_fusion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/internal/cppmath.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/flatbuffer_utils.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_log.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_utils.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated_full.h"
+
+namespace tflite {
+
+namespace {
+
+// The convolution already wrote the activation's output
+TfLiteStatus FusedActivationInvoke(TfLiteContext* context, TfLiteNode* node) {
+  (void)context;
+  (void)node;
+  return kTfLiteOk;
+}
+
+const TfLiteRegistration* FusedActivationRegistration() {
+  static TfLiteRegistration registration = {};
+  registration.invoke = FusedActivationInvoke;
+  registration.builtin_code = BuiltinOperator_CUSTOM;
+  registration.custom_name = "FUSED_ACTIVATION";
+  return &registration;
+}
+
+// int8 scale and zero point of a per-tensor quantized tensor
+bool GetInt8Quantization(const Tensor* tensor, float* scale,
+                         int32_t* zero_point) {
+  if (tensor == nullptr || tensor->type() != TensorType_INT8) {
+    return false;
+  }
+  const auto* quantization = tensor->quantization();
+  if (quantization == nullptr || quantization->scale() == nullptr ||
+      quantization->zero_point() == nullptr ||
+      quantization->scale()->size() != 1 ||
+      quantization->zero_point()->size() != 1) {
+    return false;
+  }
+  *scale = quantization->scale()->Get(0);
+  *zero_point = static_cast<int32_t>(quantization->zero_point()->Get(0));
+  return true;
+}
+
+// Same arithmetic as CalculateActivationRangeQuantized() for int8 outputs
+void ConvActivationRange(TfLiteFusedActivation activation, float scale,
+                         int32_t zero_point, int32_t* act_min,
+                         int32_t* act_max) {
+  const int32_t qmin = std::numeric_limits<int8_t>::min();
+  const int32_t qmax = std::numeric_limits<int8_t>::max();
+  auto quantize = [&](float f) {
+    return zero_point + static_cast<int32_t>(TfLiteRound(f / scale));
+  };
+  *act_min = qmin;
+  *act_max = qmax;
+  if (activation == kTfLiteActRelu) {
+    *act_min = std::max(qmin, quantize(0.0f));
+  } else if (activation == kTfLiteActRelu6) {
+    *act_min = std::max(qmin, quantize(0.0f));
+    *act_max = std::min(qmax, quantize(6.0f));
+  } else if (activation == kTfLiteActReluN1To1) {
+    *act_min = std::max(qmin, quantize(-1.0f));
+    *act_max = std::min(qmax, quantize(1.0f));
+  }
+}
+
+// Same arithmetic as the int8 RELU / RELU6 kernels in activations_common.cc
+bool ActivationOpRange(BuiltinOperator op, float scale, int32_t zero_point,
+                       int32_t* act_min, int32_t* act_max) {
+  if (op == BuiltinOperator_RELU) {
+    *act_min = std::max(static_cast<int32_t>(std::numeric_limits<int8_t>::min()),
+                        zero_point + static_cast<int32_t>(roundf(0.0f / scale)));
+    *act_max = std::numeric_limits<int8_t>::max();
+    return true;
+  }
+  if (op == BuiltinOperator_RELU6) {
+    *act_min = zero_point;
+    *act_max = FloatToQuantizedType<int8_t>(6.0f, scale, zero_point);
+    return true;
+  }
+  return false;
+}
+
+TfLiteFusedActivation* ConvActivation(const TfLiteRegistration* registration,
+                                      TfLiteNode* node) {
+  if (node->builtin_data == nullptr) {
+    return nullptr;
+  }
+  if (registration->builtin_code == BuiltinOperator_CONV_2D) {
+    return &static_cast<TfLiteConvParams*>(node->builtin_data)->activation;
+  }
+  if (registration->builtin_code == BuiltinOperator_DEPTHWISE_CONV_2D) {
+    return &static_cast<TfLiteDepthwiseConvParams*>(node->builtin_data)
+                ->activation;
+  }
+  return nullptr;
+}
+
+bool IsSubgraphOutput(const SubGraph* subgraph, int tensor_index) {
+  for (size_t i = 0;
+       subgraph->outputs() != nullptr && i < subgraph->outputs()->size(); i++) {
+    if (subgraph->outputs()->Get(i) == tensor_index) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int CountConsumers(NodeAndRegistration* nodes, uint32_t node_count,
+                   int tensor_index) {
+  int consumers = 0;
+  for (uint32_t i = 0; i < node_count; i++) {
+    const TfLiteIntArray* inputs = nodes[i].node.inputs;
+    for (int n = 0; inputs != nullptr && n < inputs->size; n++) {
+      if (inputs->data[n] == tensor_index) {
+        consumers++;
+      }
+    }
+  }
+  return consumers;
+}
+
+// Index of the node reading tensor_index, -1 if none
+int FindConsumer(NodeAndRegistration* nodes, uint32_t node_count,
+                 uint32_t start, int tensor_index) {
+  for (uint32_t i = start; i < node_count; i++) {
+    const TfLiteIntArray* inputs = nodes[i].node.inputs;
+    for (int n = 0; inputs != nullptr && n < inputs->size; n++) {
+      if (inputs->data[n] == tensor_index) {
+        return static_cast<int>(i);
+      }
+    }
+  }
+  return -1;
+}
+
+TfLiteIntArray* AllocateIntArray(MicroAllocator& allocator, int size) {
+  TfLiteIntArray* array = static_cast<TfLiteIntArray*>(
+      allocator.AllocatePersistentBuffer(TfLiteIntArrayGetSizeInBytes(size)));
+  if (array != nullptr) {
+    array->size = size;
+  }
+  return array;
+}
+
+}  // namespace
+
+TfLiteStatus FuseActivations(const Model* model,
+                             SubgraphAllocations* allocations,
+                             MicroAllocator& allocator, int* fused_count) {
+  static const TfLiteFusedActivation kCandidates[] = {
+      kTfLiteActNone, kTfLiteActRelu, kTfLiteActRelu6, kTfLiteActReluN1To1};
+  *fused_count = 0;
+
+  for (size_t subgraph_idx = 0; subgraph_idx < model->subgraphs()->size();
+       subgraph_idx++) {
+    const SubGraph* subgraph = model->subgraphs()->Get(subgraph_idx);
+    NodeAndRegistration* nodes =
+        allocations[subgraph_idx].node_and_registrations;
+    const uint32_t node_count = NumSubgraphOperators(subgraph);
+
+    for (uint32_t i = 0; i < node_count; i++) {
+      TfLiteNode* conv = &nodes[i].node;
+      TfLiteFusedActivation* conv_activation =
+          ConvActivation(nodes[i].registration, conv);
+      if (conv_activation == nullptr || conv->outputs == nullptr ||
+          conv->outputs->size != 1) {
+        continue;
+      }
+      const int conv_output = conv->outputs->data[0];
+      if (IsSubgraphOutput(subgraph, conv_output) ||
+          CountConsumers(nodes, node_count, conv_output) != 1) {
+        continue;
+      }
+      const int act_idx = FindConsumer(nodes, node_count, i + 1, conv_output);
+      if (act_idx < 0) {
+        continue;
+      }
+      TfLiteNode* act = &nodes[act_idx].node;
+      const BuiltinOperator act_op =
+          static_cast<BuiltinOperator>(nodes[act_idx].registration->builtin_code);
+      if (act->inputs->size != 1 || act->outputs == nullptr ||
+          act->outputs->size != 1) {
+        continue;
+      }
+      const int act_output = act->outputs->data[0];
+
+      // Same quantization on both sides, so the activation is a pure clamp
+      float conv_scale, act_scale;
+      int32_t conv_zero_point, act_zero_point;
+      if (!GetInt8Quantization(subgraph->tensors()->Get(conv_output),
+                               &conv_scale, &conv_zero_point) ||
+          !GetInt8Quantization(subgraph->tensors()->Get(act_output),
+                               &act_scale, &act_zero_point) ||
+          conv_scale != act_scale || conv_zero_point != act_zero_point) {
+        continue;
+      }
+
+      // Both clamps applied in a row, then find the fused activation that
+      // produces exactly that range
+      int32_t conv_min, conv_max, op_min, op_max;
+      ConvActivationRange(*conv_activation, conv_scale, conv_zero_point,
+                          &conv_min, &conv_max);
+      if (!ActivationOpRange(act_op, act_scale, act_zero_point, &op_min,
+                             &op_max)) {
+        continue;
+      }
+      const int32_t want_min = std::max(conv_min, op_min);
+      const int32_t want_max = std::min(conv_max, op_max);
+      bool found = false;
+      TfLiteFusedActivation fused = kTfLiteActNone;
+      for (TfLiteFusedActivation candidate : kCandidates) {
+        int32_t min, max;
+        ConvActivationRange(candidate, conv_scale, conv_zero_point, &min, &max);
+        if (min == want_min && max == want_max) {
+          fused = candidate;
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        continue;
+      }
+
+      // The flatbuffer arrays are read only, so the rewritten ones go into
+      // the persistent arena
+      TfLiteIntArray* outputs = AllocateIntArray(allocator, 1);
+      TfLiteIntArray* empty = AllocateIntArray(allocator, 0);
+      if (outputs == nullptr || empty == nullptr) {
+        MicroPrintf("Failed to allocate fused activation arrays");
+        return kTfLiteError;
+      }
+      outputs->data[0] = act_output;
+      conv->outputs = outputs;
+      *conv_activation = fused;
+
+      nodes[act_idx].registration = FusedActivationRegistration();
+      act->inputs = empty;
+      act->outputs = empty;
+      act->builtin_data = nullptr;
+      (*fused_count)++;
+    }
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace tflite
@@ -0,0 +1,67 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_ACTIVATION_FUSION_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_ACTIVATION_FUSION_H_
+
+#include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_allocator.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
+
+// Fold standalone RELU / RELU6 ops into the convolution that feeds them
+#ifndef EI_CLASSIFIER_TFLITE_FUSE_ACTIVATIONS
+#define EI_CLASSIFIER_TFLITE_FUSE_ACTIVATIONS 1
+#endif
+
+namespace tflite {
+
+// Rewrites the parsed graph so that an int8 CONV_2D or DEPTHWISE_CONV_2D whose
+// output is only read by a RELU or RELU6 writes the activation's output
+// directly, with the clamp applied through the convolution's fused activation
+// (the ESP-NN and reference kernels clamp inside their output loop). The
+// activation node is left in place as a no-op, so node indices and the memory
+// plan lifetimes stay valid. The tensor between the two is no longer produced
+// or read by any node and gets no arena space.
+//
+// Only pairs where both tensors share scale and zero point are folded: the
+// activation is then a pure clamp and the folded graph is bit exact with the
+// original one. Must run after the nodes are parsed and before Init().
+TfLiteStatus FuseActivations(const Model* model,
+                             SubgraphAllocations* allocations,
+                             MicroAllocator& allocator, int* fused_count);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_ACTIVATION_FUSION_H_
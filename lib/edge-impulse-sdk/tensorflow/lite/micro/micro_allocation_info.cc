@@ -258,10 +258,13 @@ TfLiteStatus AllocationInfoBuilder::MarkAllocationLifetimes(
     // Each operator has a new allocation scope.
     allocation_scope_count_++;
     const auto* op = subgraph->operators()->Get(i);
+    // Patched by Edge Impulse: tensors are taken from the parsed node rather
+    // than the flatbuffer, so graph rewrites (FuseActivations) are planned
+    const TfLiteNode& node =
+        allocations[subgraph_idx].node_and_registrations[i].node;
     // Figure out when the first creation and use of each tensor is.
-    for (size_t n = 0; op->outputs() != nullptr && n < op->outputs()->size();
-         ++n) {
-      const int tensor_index = op->outputs()->Get(n);
+    for (int n = 0; node.outputs != nullptr && n < node.outputs->size; ++n) {
+      const int tensor_index = node.outputs->data[n];
       AllocationInfo* current = &subgraph_allocation_info[tensor_index];
       UpdateFirstCreated(current, allocation_scope_count_);
     }
@@ -276,9 +279,8 @@ TfLiteStatus AllocationInfoBuilder::MarkAllocationLifetimes(
                                      scratch_buffer_handles, allocations);
 
     // Figure out when the last use of each tensor is.
-    for (size_t n = 0; op->inputs() != nullptr && n < op->inputs()->size();
-         ++n) {
-      const int tensor_index = op->inputs()->Get(n);
+    for (int n = 0; node.inputs != nullptr && n < node.inputs->size; ++n) {
+      const int tensor_index = node.inputs->data[n];
       // Optional bias tensors can have an index of -1 when they are omitted.
       if (tensor_index >= 0) {
         AllocationInfo* current = &subgraph_allocation_info[tensor_index];
@@ -288,9 +290,8 @@ TfLiteStatus AllocationInfoBuilder::MarkAllocationLifetimes(
         UpdateLastUsed(current, allocation_scope_count_);
       }
     }
-    for (size_t n = 0; op->outputs() != nullptr && n < op->outputs()->size();
-         ++n) {
-      const int tensor_index = op->outputs()->Get(n);
+    for (int n = 0; node.outputs != nullptr && n < node.outputs->size; ++n) {
+      const int tensor_index = node.outputs->data[n];
       AllocationInfo* current = &subgraph_allocation_info[tensor_index];
       UpdateLastUsed(current, allocation_scope_count_);
     }
@@ -330,6 +331,17 @@ TfLiteStatus AllocationInfoBuilder::MarkAllocationLifetimes(
     UpdateFirstCreated(current, allocation_scope_count_);
     UpdateLastUsed(current, allocation_scope_count_);
   }
+
+  // Patched by Edge Impulse: a tensor no node produces or reads any more (the
+  // intermediate of a pair FuseActivations folded) has no lifetime. Planned
+  // as -1..-1 it would overlap every other buffer, so it gets no space.
+  for (size_t i = 0; i < subgraph->tensors()->size(); ++i) {
+    AllocationInfo* current = &subgraph_allocation_info[i];
+    if (current->first_created == kUninitializedLifetime &&
+        current->last_used == kUninitializedLifetime) {
+      current->needs_allocating = false;
+    }
+  }
   return kTfLiteOk;
 }
 
@@ -439,6 +439,33 @@ MicroAllocator* MicroAllocator::Create(uint8_t* persistent_tensor_arena,
   return allocator;
 }
 
+MicroAllocator* MicroAllocator::Create(uint8_t* persistent_tensor_arena,
+                                       size_t persistent_arena_size,
+                                       uint8_t* non_persistent_tensor_arena,
+                                       size_t non_persistent_arena_size,
+                                       MicroMemoryPlanner* memory_planner) {
+  TFLITE_DCHECK(persistent_tensor_arena != nullptr);
+  TFLITE_DCHECK(non_persistent_tensor_arena != nullptr);
+  TFLITE_DCHECK(persistent_tensor_arena != non_persistent_tensor_arena);
+  TFLITE_DCHECK(memory_planner != nullptr);
+
+  IPersistentBufferAllocator* persistent_buffer_allocator =
+      CreatePersistentArenaAllocator(persistent_tensor_arena,
+                                     persistent_arena_size);
+  INonPersistentBufferAllocator* non_persistent_buffer_allocator =
+      CreateNonPersistentArenaAllocator(non_persistent_tensor_arena,
+                                        non_persistent_arena_size,
+                                        persistent_buffer_allocator);
+
+  uint8_t* micro_allocator_buffer =
+      persistent_buffer_allocator->AllocatePersistentBuffer(
+          sizeof(MicroAllocator), alignof(MicroAllocator));
+  MicroAllocator* allocator = new (micro_allocator_buffer)
+      MicroAllocator(persistent_buffer_allocator,
+                     non_persistent_buffer_allocator, memory_planner);
+  return allocator;
+}
+
 SubgraphAllocations* MicroAllocator::StartModelAllocation(const Model* model) {
   TFLITE_DCHECK(model != nullptr);
 
@@ -581,6 +608,14 @@ size_t MicroAllocator::used_bytes() const {
          persistent_buffer_allocator_->GetPersistentUsedBytes();
 }
 
+size_t MicroAllocator::persistent_used_bytes() const {
+  return persistent_buffer_allocator_->GetPersistentUsedBytes();
+}
+
+size_t MicroAllocator::non_persistent_used_bytes() const {
+  return non_persistent_buffer_allocator_->GetNonPersistentUsedBytes();
+}
+
 TfLiteStatus MicroAllocator::AllocateNodeAndRegistrations(
     const Model* model, SubgraphAllocations* subgraph_allocations) {
   TFLITE_DCHECK(subgraph_allocations != nullptr);
@@ -838,6 +873,13 @@ TfLiteStatus MicroAllocator::CommitStaticMemoryPlan(
   int allocation_info_count = builder.AllocationCount();
   AllocationInfo* allocation_info = builder.Finish();
 
+  // The planner takes whatever is left, it only needs per_buffer_size() for
+  // every buffer
+  planning_used_bytes_ =
+      non_persistent_buffer_allocator_->GetNonPersistentUsedBytes() +
+      MicroArenaBufferAlignment() +
+      allocation_info_count * GreedyMemoryPlanner::per_buffer_size();
+
   // Remaining arena size that memory planner can use for calculating offsets.
   size_t remaining_arena_size =
       non_persistent_buffer_allocator_->GetAvailableMemory(
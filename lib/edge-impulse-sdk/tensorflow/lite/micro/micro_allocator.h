@@ -142,6 +142,14 @@ class MicroAllocator {
                                 uint8_t* non_persistent_tensor_arena,
                                 size_t non_persistent_arena_size);
 
+  // Same as above, but with a given MemoryPlanner instead of a
+  // GreedyMemoryPlanner created on the persistent arena.
+  static MicroAllocator* Create(uint8_t* persistent_tensor_arena,
+                                size_t persistent_arena_size,
+                                uint8_t* non_persistent_tensor_arena,
+                                size_t non_persistent_arena_size,
+                                MicroMemoryPlanner* memory_planner);
+
   // Returns the fixed amount of memory overhead of MicroAllocator.
   static size_t GetDefaultTailUsage(bool is_memory_planner_given);
 
@@ -226,6 +234,16 @@ class MicroAllocator {
   // `FinishModelAllocation`. Otherwise, it will return 0.
   size_t used_bytes() const;
 
+  // Split of used_bytes() between the persistent (tail) and non-persistent
+  // (head: planned tensors and scratch buffers) allocations.
+  size_t persistent_used_bytes() const;
+  size_t non_persistent_used_bytes() const;
+
+  // Non-persistent bytes the greedy memory planner needs while it plans: what
+  // is in use at that point plus its per-buffer scratch for every tensor and
+  // scratch buffer. Only available after `FinishModelAllocation`.
+  size_t planning_used_bytes() const { return planning_used_bytes_; }
+
   TfLiteBridgeBuiltinDataAllocator* GetBuiltinDataAllocator();
 
  protected:
@@ -311,6 +329,9 @@ class MicroAllocator {
   // section when a model is allocating.
   size_t scratch_buffer_request_count_ = 0;
 
+  // Non-persistent bytes needed while planning, see planning_used_bytes()
+  size_t planning_used_bytes_ = 0;
+
   // Holds ScratchBufferRequest when a model is allocating
   uint8_t* scratch_buffer_head_ = nullptr;
 
@@ -171,15 +171,25 @@ TfLiteStatus MicroGraph::InvokeSubgraph(int subgraph_idx) {
 
 // This ifdef is needed (even though ScopedMicroProfiler itself is a no-op with
 // -DTF_LITE_STRIP_ERROR_STRINGS) because the function OpNameFromRegistration is
-// only defined for builds with the error strings.
-#if !defined(TF_LITE_STRIP_ERROR_STRINGS)
+// only defined for builds with the error strings. The op profiler keeps it.
+#if !defined(TF_LITE_STRIP_ERROR_STRINGS) || EI_CLASSIFIER_TFLITE_OP_PROFILER == 1
     ScopedMicroProfiler scoped_profiler(
         OpNameFromRegistration(registration),
         reinterpret_cast<MicroProfilerInterface*>(context_->profiler));
 #endif
 
     TFLITE_DCHECK(registration->invoke);
+#if EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1
+    if (weight_prefetcher_ != nullptr) {
+      weight_prefetcher_->BeforeOp(subgraph_idx, i);
+    }
+#endif
     TfLiteStatus invoke_status = registration->invoke(context_, node);
+#if EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1
+    if (weight_prefetcher_ != nullptr) {
+      weight_prefetcher_->AfterOp(subgraph_idx, i);
+    }
+#endif
 
     // All TfLiteTensor structs used in the kernel are allocated from temp
     // memory in the allocator. This creates a chain of allocations in the
@@ -19,6 +19,7 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_allocator.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_resource_variable.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_weight_prefetch.h"
 #include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
 
 namespace tflite {
@@ -93,6 +94,11 @@ class MicroGraph {
   // Get the resource variables for this TFLM graph.
   MicroResourceVariables* GetResourceVariables() { return resource_variables_; }
 
+  // Patched by Edge Impulse, called around every operator when set
+  void SetWeightPrefetcher(MicroWeightPrefetcher* prefetcher) {
+    weight_prefetcher_ = prefetcher;
+  }
+
  private:
   TfLiteContext* context_;
   const Model* model_;
@@ -101,6 +107,7 @@ class MicroGraph {
   int current_subgraph_index_;
   MicroResourceVariables* resource_variables_;
   const flatbuffers::Vector<flatbuffers::Offset<SubGraph>>* subgraphs_;
+  MicroWeightPrefetcher* weight_prefetcher_ = nullptr;
 
   TF_LITE_REMOVE_VIRTUAL_DELETE
 };
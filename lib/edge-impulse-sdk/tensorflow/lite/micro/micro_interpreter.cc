@@ -23,6 +23,7 @@ limitations under the License.
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/flatbuffer_utils.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/memory_helpers.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_activation_fusion.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_allocator.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_log.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/micro_op_resolver.h"
@@ -206,6 +207,14 @@ TfLiteStatus MicroInterpreter::AllocateTensors(bool run_all_prep_ops) {
 
   TF_LITE_ENSURE_STATUS(PrepareNodeAndRegistrationDataFromFlatbuffer());
 
+  // Patched by Edge Impulse, fold activations before the kernels see the nodes
+#if EI_CLASSIFIER_TFLITE_FUSE_ACTIVATIONS == 1
+  int fused_activations = 0;
+  TF_LITE_ENSURE_STATUS(FuseActivations(model_, graph_.GetAllocations(),
+                                        allocator_, &fused_activations));
+  (void)fused_activations;
+#endif
+
   // Only allow AllocatePersistentBuffer in Init stage.
   context_.AllocatePersistentBuffer = MicroContextAllocatePersistentBuffer;
   context_.RequestScratchBufferInArena = nullptr;
@@ -234,6 +243,13 @@ TfLiteStatus MicroInterpreter::AllocateTensors(bool run_all_prep_ops) {
 
   micro_context_.SetScratchBufferHandles(scratch_buffer_handles_);
 
+#if EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1
+  if (weight_prefetcher_ != nullptr) {
+    TF_LITE_ENSURE_STATUS(
+        weight_prefetcher_->Prepare(model_, graph_.GetAllocations()));
+  }
+#endif
+
   // TODO(b/162311891): Drop these allocations when the interpreter supports
   // handling buffers from TfLiteEvalTensor.
   input_tensors_ =
@@ -74,6 +74,14 @@ class MicroInterpreter {
   // TODO(b/149795762): Add this to the TfLiteStatus enum.
   TfLiteStatus Invoke();
 
+  // Patched by Edge Impulse: stage filter tensors through a prefetcher (see
+  // micro_weight_prefetch.h). Set it before AllocateTensors(), it has to
+  // stay valid as long as the interpreter is invoked.
+  void SetWeightPrefetcher(MicroWeightPrefetcher* prefetcher) {
+    weight_prefetcher_ = prefetcher;
+    graph_.SetWeightPrefetcher(prefetcher);
+  }
+
   // This is the recommended API for an application to pass an external payload
   // pointer as an external context to kernels. The life time of the payload
   // pointer should be at least as long as this interpreter. TFLM supports only
@@ -163,6 +171,23 @@ class MicroInterpreter {
   // utilize the space. If it's not the case, the optimial arena size would be
   // arena_used_bytes() + 16.
   size_t arena_used_bytes() const { return allocator_.used_bytes(); }
+  size_t arena_persistent_used_bytes() const {
+    return allocator_.persistent_used_bytes();
+  }
+  size_t arena_non_persistent_used_bytes() const {
+    return allocator_.non_persistent_used_bytes();
+  }
+  size_t arena_planning_used_bytes() const {
+    return allocator_.planning_used_bytes();
+  }
+
+  // Returns the eval tensor backing `tensor_index`. Unlike tensor(), this
+  // doesn't allocate a TfLiteTensor from the persistent arena, so it can be
+  // used to inspect the memory plan. Only valid after `AllocateTensors`.
+  const TfLiteEvalTensor* eval_tensor(size_t tensor_index,
+                                      size_t subgraph_idx = 0) {
+    return &graph_.GetAllocations()[subgraph_idx].tensors[tensor_index];
+  }
 
  protected:
   const MicroAllocator& allocator() const { return allocator_; }
@@ -193,6 +218,7 @@ class MicroInterpreter {
   TfLiteTensor** output_tensors_;
 
   MicroContext micro_context_;
+  MicroWeightPrefetcher* weight_prefetcher_ = nullptr;
 };
 
 }  // namespace tflite
@@ -90,11 +90,12 @@ class MicroProfiler : public MicroProfilerInterface {
   TF_LITE_REMOVE_VIRTUAL_DELETE;
 };
 
-#if defined(TF_LITE_STRIP_ERROR_STRINGS)
+#if defined(TF_LITE_STRIP_ERROR_STRINGS) && !(EI_CLASSIFIER_TFLITE_OP_PROFILER == 1)
 // For release builds, the ScopedMicroProfiler is a noop.
 //
 // This is done because the ScipedProfiler is used as part of the
 // MicroInterpreter and we want to ensure zero overhead for the release builds.
+// Building with EI_CLASSIFIER_TFLITE_OP_PROFILER=1 keeps it.
 class ScopedMicroProfiler {
  public:
   explicit ScopedMicroProfiler(const char* tag,
@@ -133,7 +134,7 @@ class ScopedMicroProfiler {
   uint32_t event_handle_ = 0;
   MicroProfilerInterface* profiler_ = nullptr;
 };
-#endif  // !defined(TF_LITE_STRIP_ERROR_STRINGS)
+#endif  // defined(TF_LITE_STRIP_ERROR_STRINGS) && !(EI_CLASSIFIER_TFLITE_OP_PROFILER == 1)
 
 }  // namespace tflite
 
@@ -0,0 +1,215 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_weight_prefetch.h"
+
+#include "edge-impulse-sdk/tensorflow/lite/micro/flatbuffer_utils.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/memory_helpers.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated_full.h"
+
+namespace tflite {
+
+namespace {
+
+constexpr int kFilterTensor = 1;
+constexpr uintptr_t kSlotAlignment = 16;
+
+bool HasPrefetchableFilter(const TfLiteRegistration* registration) {
+  switch (registration->builtin_code) {
+    case BuiltinOperator_CONV_2D:
+    case BuiltinOperator_DEPTHWISE_CONV_2D:
+    case BuiltinOperator_FULLY_CONNECTED:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+MicroWeightPrefetcher::MicroWeightPrefetcher(uint8_t* staging,
+                                             size_t staging_size,
+                                             int16_t* filters, size_t max_ops)
+    : slot_size_(0),
+      filters_(filters),
+      max_ops_(max_ops),
+      op_count_(0),
+      prefetched_ops_(0),
+      allocations_(nullptr),
+      pending_node_(-1),
+      pending_slot_(0),
+      active_node_(-1),
+      active_data_(nullptr),
+      active_bytes_(0),
+      stall_us_(0),
+      op_start_us_(0) {
+  slots_[0] = slots_[1] = nullptr;
+  if (staging != nullptr) {
+    uint8_t* start = AlignPointerUp(staging, kSlotAlignment);
+    size_t usable = staging_size - (start - staging);
+    slot_size_ = (usable / 2) & ~(kSlotAlignment - 1);
+    slots_[0] = start;
+    slots_[1] = start + slot_size_;
+  }
+}
+
+TfLiteStatus MicroWeightPrefetcher::Prepare(const Model* model,
+                                            SubgraphAllocations* allocations) {
+  // A copy left over from the previous interpreter, whose tensors are gone
+  if (pending_node_ >= 0) {
+    WaitCopy();
+    pending_node_ = -1;
+  }
+  allocations_ = allocations;
+  op_count_ = 0;
+  prefetched_ops_ = 0;
+  active_node_ = -1;
+  if (slot_size_ == 0 || model->subgraphs()->size() == 0) {
+    return kTfLiteOk;
+  }
+
+  const uint32_t operators = NumSubgraphOperators(model, 0);
+  op_count_ = operators < max_ops_ ? operators : max_ops_;
+  for (size_t i = 0; i < op_count_; i++) {
+    filters_[i] = -1;
+    const NodeAndRegistration& nr = allocations[0].node_and_registrations[i];
+    if (!HasPrefetchableFilter(nr.registration) || nr.node.inputs == nullptr ||
+        nr.node.inputs->size <= kFilterTensor) {
+      continue;
+    }
+    const int tensor_idx = nr.node.inputs->data[kFilterTensor];
+    if (tensor_idx < 0 || tensor_idx > INT16_MAX) {
+      continue;
+    }
+    const TfLiteEvalTensor* filter = &allocations[0].tensors[tensor_idx];
+    size_t bytes = 0;
+    if (filter->data.data == nullptr ||
+        TfLiteEvalTensorByteLength(filter, &bytes) != kTfLiteOk ||
+        bytes == 0 || bytes > slot_size_ ||
+        !ShouldPrefetch(filter->data.data, bytes)) {
+      continue;
+    }
+    filters_[i] = static_cast<int16_t>(tensor_idx);
+    prefetched_ops_++;
+  }
+
+  // The first copy overlaps with filling the input tensor
+  const int first = NextPrefetched(0);
+  if (first >= 0) {
+    StartPrefetch(first, 0);
+  }
+  return kTfLiteOk;
+}
+
+int MicroWeightPrefetcher::NextPrefetched(int start) const {
+  for (size_t i = start; i < op_count_; i++) {
+    if (filters_[i] >= 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+void MicroWeightPrefetcher::StartPrefetch(int node_idx, int slot) {
+  const TfLiteEvalTensor* filter = &allocations_[0].tensors[filters_[node_idx]];
+  size_t bytes = 0;
+  TfLiteEvalTensorByteLength(filter, &bytes);
+  StartCopy(slots_[slot], filter->data.data, bytes);
+  pending_node_ = node_idx;
+  pending_slot_ = slot;
+}
+
+void MicroWeightPrefetcher::BeforeOp(int subgraph_idx, int node_idx) {
+  if (subgraph_idx != 0 || static_cast<size_t>(node_idx) >= op_count_) {
+    return;
+  }
+  stall_us_ = 0;
+  active_bytes_ = 0;
+
+  // Invoked again without AllocateTensors(), nothing was copied ahead of the
+  // first layer
+  if (filters_[node_idx] >= 0 && pending_node_ != node_idx) {
+    if (pending_node_ >= 0) {
+      WaitCopy();
+    }
+    StartPrefetch(node_idx, 0);
+  }
+
+  if (pending_node_ == node_idx) {
+    const uint32_t wait_start_us = NowUs();
+    WaitCopy();
+    stall_us_ = NowUs() - wait_start_us;
+    pending_node_ = -1;
+
+    TfLiteEvalTensor* filter = &allocations_[0].tensors[filters_[node_idx]];
+    TfLiteEvalTensorByteLength(filter, &active_bytes_);
+    active_data_ = filter->data.data;
+    filter->data.data = slots_[pending_slot_];
+    active_node_ = node_idx;
+
+    // The other slot was used by the previous layer, which is done with it
+    const int next = NextPrefetched(node_idx + 1);
+    if (next >= 0) {
+      StartPrefetch(next, pending_slot_ ^ 1);
+    }
+  }
+  op_start_us_ = NowUs();
+}
+
+void MicroWeightPrefetcher::AfterOp(int subgraph_idx, int node_idx) {
+  if (subgraph_idx != 0 || static_cast<size_t>(node_idx) >= op_count_) {
+    return;
+  }
+  const uint32_t op_us = NowUs() - op_start_us_;
+  if (active_node_ == node_idx) {
+    allocations_[0].tensors[filters_[node_idx]].data.data = active_data_;
+    active_node_ = -1;
+  }
+  RecordOp(node_idx, allocations_[0].node_and_registrations[node_idx].registration,
+           active_bytes_, stall_us_, op_us);
+}
+
+void MicroWeightPrefetcher::Finish() {
+  if (pending_node_ >= 0) {
+    WaitCopy();
+    pending_node_ = -1;
+  }
+  if (active_node_ >= 0) {
+    allocations_[0].tensors[filters_[active_node_]].data.data = active_data_;
+    active_node_ = -1;
+  }
+}
+
+}  // namespace tflite
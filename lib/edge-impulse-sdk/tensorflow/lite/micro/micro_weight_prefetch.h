@@ -0,0 +1,122 @@
+/* The Clear BSD License
+ *
+ * Copyright (c) 2025 EdgeImpulse Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ *   * Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ *
+ *   * Neither the name of the copyright holder nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ * IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef TENSORFLOW_LITE_MICRO_MICRO_WEIGHT_PREFETCH_H_
+#define TENSORFLOW_LITE_MICRO_MICRO_WEIGHT_PREFETCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "edge-impulse-sdk/tensorflow/lite/c/common.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_allocator.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated.h"
+
+// Copy filter tensors to a staging area before the layer that uses them runs
+#ifndef EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH
+#define EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH 0
+#endif
+
+namespace tflite {
+
+// Double buffers the filter tensors of CONV_2D, DEPTHWISE_CONV_2D and
+// FULLY_CONNECTED layers through a small staging area, for models whose
+// weights are read from flash or PSRAM. The staging area is split in two
+// slots: while a layer runs on the filter in one slot, the filter of the next
+// eligible layer is copied into the other one. Before a layer runs its filter
+// tensor is pointed at its slot, afterwards back at the model.
+//
+// Only the first subgraph is prefetched. Filters larger than a slot, or that
+// ShouldPrefetch() rejects, are read in place as before.
+//
+// Subclasses provide the copy engine (which must run concurrently with the
+// caller to gain anything), the clock and the statistics.
+class MicroWeightPrefetcher {
+ public:
+  // filters holds one entry per operator of the first subgraph, operators
+  // past max_ops are never prefetched
+  MicroWeightPrefetcher(uint8_t* staging, size_t staging_size,
+                        int16_t* filters, size_t max_ops);
+  virtual ~MicroWeightPrefetcher() {}
+
+  // Called by the interpreter once the tensors are allocated. Picks the
+  // filters to prefetch and starts copying the first one.
+  TfLiteStatus Prepare(const Model* model, SubgraphAllocations* allocations);
+
+  // Called by the graph around every operator
+  void BeforeOp(int subgraph_idx, int node_idx);
+  void AfterOp(int subgraph_idx, int node_idx);
+
+  // Wait for a copy still in flight, e.g. after a failed invoke
+  void Finish();
+
+  size_t slot_size() const { return slot_size_; }
+  size_t prefetched_ops() const { return prefetched_ops_; }
+
+ protected:
+  virtual bool ShouldPrefetch(const void* data, size_t bytes) = 0;
+  virtual void StartCopy(void* dst, const void* src, size_t bytes) = 0;
+  virtual void WaitCopy() = 0;
+  virtual uint32_t NowUs() = 0;
+
+  // Called after every operator of the first subgraph. stall_us is the time
+  // spent waiting for its filter, op_us the time the operator itself took.
+  virtual void RecordOp(int node_idx, const TfLiteRegistration* registration,
+                        size_t prefetched_bytes, uint32_t stall_us,
+                        uint32_t op_us) = 0;
+
+ private:
+  int NextPrefetched(int start) const;
+  void StartPrefetch(int node_idx, int slot);
+
+  uint8_t* slots_[2];
+  size_t slot_size_;
+  int16_t* filters_;
+  size_t max_ops_;
+  size_t op_count_;
+  size_t prefetched_ops_;
+  SubgraphAllocations* allocations_;
+
+  int pending_node_;    // operator whose filter is being copied, -1 if none
+  int pending_slot_;
+  int active_node_;     // operator running on a staged filter, -1 if none
+  void* active_data_;   // its filter data in the model
+  size_t active_bytes_;
+  uint32_t stall_us_;
+  uint32_t op_start_us_;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_MICRO_MICRO_WEIGHT_PREFETCH_H_
@@ -0,0 +1,84 @@
+#include "bench_alloc.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include <malloc.h>
+#include <stdlib.h>
+#include <new>
+
+// Counters are plain globals: the benchmark runs the pipeline on one thread.
+static BenchAllocStats stats;
+
+static void* countAlloc(void* ptr) {
+    if (ptr) {
+        size_t size = malloc_usable_size(ptr);
+        stats.allocs++;
+        stats.bytes += size;
+        stats.live += size;
+        if (stats.live > stats.peak) stats.peak = stats.live;
+    }
+    return ptr;
+}
+
+static void countFree(void* ptr) {
+    if (ptr) {
+        stats.frees++;
+        stats.live -= malloc_usable_size(ptr);
+    }
+}
+
+BenchAllocStats benchAllocStats() {
+    return stats;
+}
+
+void benchAllocResetPeak() {
+    stats.peak = stats.live;
+}
+
+// --- Edge Impulse SDK allocators (weak in porting/posix) ---
+void* ei_malloc(size_t size) {
+    return countAlloc(malloc(size));
+}
+
+void* ei_calloc(size_t nitems, size_t size) {
+    return countAlloc(calloc(nitems, size));
+}
+
+void ei_free(void* ptr) {
+    countFree(ptr);
+    free(ptr);
+}
+
+// --- Global operator new/delete (std::vector, unique_ptr<T[]>, ...) ---
+void* operator new(size_t size) {
+    void* ptr = countAlloc(malloc(size ? size : 1));
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return countAlloc(malloc(size ? size : 1));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return countAlloc(malloc(size ? size : 1));
+}
+
+void operator delete(void* ptr) noexcept {
+    countFree(ptr);
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    operator delete(ptr);
+}
@@ -0,0 +1,23 @@
+#ifndef BENCH_ALLOC_H
+#define BENCH_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Allocation Counters ---
+// Every ei_malloc/ei_calloc and every operator new in the process is counted
+// (bench_alloc.cpp replaces the weak posix ei_* allocators and the global
+// operator new/delete). Sizes come from malloc_usable_size(), so the byte
+// counts include allocator rounding, like a heap on the device would.
+struct BenchAllocStats {
+    uint64_t allocs;        // allocations since start
+    uint64_t frees;
+    uint64_t bytes;         // bytes allocated since start
+    size_t live;            // bytes allocated and not yet freed
+    size_t peak;            // highest value of live
+};
+
+BenchAllocStats benchAllocStats();
+void benchAllocResetPeak();
+
+#endif // BENCH_ALLOC_H
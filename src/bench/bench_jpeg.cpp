@@ -0,0 +1,53 @@
+#include "bench_jpeg.h"
+#include <string.h>
+#include "tjpgd.h"
+
+// Same work area size the camera driver gives the decoder
+#define JPEG_WORK_SIZE 3100
+
+struct JpegSource {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+    uint8_t* rgb;
+    UINT width;
+};
+
+static UINT jpegRead(JDEC* decoder, BYTE* buf, UINT len) {
+    JpegSource* src = (JpegSource*)decoder->device;
+    size_t left = src->len - src->pos;
+    if (len > left) len = left;
+    if (buf) memcpy(buf, src->data + src->pos, len);
+    src->pos += len;
+    return len;
+}
+
+static UINT jpegWrite(JDEC* decoder, void* bitmap, JRECT* rect) {
+    JpegSource* src = (JpegSource*)decoder->device;
+    const uint8_t* in = (const uint8_t*)bitmap;
+    size_t rowBytes = (rect->right - rect->left + 1) * 3;
+    for (UINT y = rect->top; y <= rect->bottom; y++) {
+        memcpy(src->rgb + ((size_t)y * src->width + rect->left) * 3, in, rowBytes);
+        in += rowBytes;
+    }
+    return 1;
+}
+
+bool benchDecodeJpeg(const uint8_t* jpg, size_t len, std::vector<uint8_t>& rgb, int& width, int& height) {
+    static uint8_t work[JPEG_WORK_SIZE];
+    JDEC decoder;
+    JpegSource src = { jpg, len, 0, nullptr, 0 };
+
+    if (jd_prepare(&decoder, jpegRead, work, sizeof(work), &src) != JDR_OK) {
+        return false;
+    }
+    src.width = decoder.width;
+    rgb.resize((size_t)decoder.width * decoder.height * 3);
+    src.rgb = rgb.data();
+    if (jd_decomp(&decoder, jpegWrite, 0) != JDR_OK) {
+        return false;
+    }
+    width = decoder.width;
+    height = decoder.height;
+    return true;
+}
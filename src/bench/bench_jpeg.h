@@ -0,0 +1,12 @@
+#ifndef BENCH_JPEG_H
+#define BENCH_JPEG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Decode a baseline JPEG (what the OV3660 produces) into packed RGB888.
+// rgb is grown as needed and reused between frames.
+bool benchDecodeJpeg(const uint8_t* jpg, size_t len, std::vector<uint8_t>& rgb, int& width, int& height);
+
+#endif // BENCH_JPEG_H
@@ -0,0 +1,1524 @@
+// --- Host Inference Benchmark ---
+// Runs a directory of captured camera JPEGs through the same pipeline as the
+// hive: JPEG decode, crop and resize to the impulse input, DSP, classifier
+// and the postprocessing blocks (FOMO object tracking and counting). It uses
+// the posix porting layer and, with EI_CLASSIFIER_TFLITE_ENABLE_ESP_NN, the
+// ESP-NN C kernels, so the same kernel code paths run as on the ESP32-S3
+// minus the assembly.
+//
+// Prints a JSON report with per-stage latency percentiles, allocations per
+// frame and peak heap. With --budget, every number in the budget file is an
+// upper limit for the same entry in the report, and the run exits with 2 if
+// any is exceeded. With --flash-mbs, a firmware built with
+// EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH=1 also replays the layer times of the
+// last frame against that flash bandwidth (MB/s) to predict the prefetch
+// stalls. With --frame-skip, the images are replayed twice more in order,
+// running the model on every frame and then only on the frames
+// EiFrameSkipScheduler picks (tracking predicts the others), to compare
+// counts and CPU time. --tracker runs that many synthetic detection streams
+// through the tracker and the fixed-capacity tracker and fails if their
+// traces ever differ. --fomo times the FOMO cell clustering against the
+// heap cube version it replaced on that many synthetic outputs per bee count,
+// and checks the int8 thresholding against the float test it replaced.
+// --nms-scenes times the pairwise and the grid NMS on
+// that many synthetic crowded frames per box count. With --scheduler, the
+// images are replayed once more through EiImpulseScheduler with that frame
+// budget (ms): the impulse on every frame, and a second handle of it standing
+// in for a crop classifier on a crop around every detection. --model-updates
+// stores the compiled model that many times through the model loader's posix
+// backend, checking that inference runs from the mapped copy and that
+// aborted, broken and corrupted updates fall back. --fusion runs that many
+// random inputs through synthetic conv -> RELU graphs with the activations
+// folded and kept apart, and fails if the outputs aren't bit exact. See
+// DEVELOPMENT.md.
+//
+//   bench [--warmup N] [--passes N] [--budget FILE] [--output FILE] [--flash-mbs N]
+//         [--frame-skip N] [--tracker N] [--fomo N] [--nms-scenes N]
+//         [--scheduler MS] [--model-updates N] [--fusion N] IMAGE_DIR
+
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <dirent.h>
+#include <memory>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <ArduinoJson.h>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "edge-impulse-sdk/classifier/ei_nms.h"
+#include "edge-impulse-sdk/classifier/ei_impulse_scheduler.h"
+#include "edge-impulse-sdk/dsp/image/processing.hpp"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_activation_fusion.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_interpreter.h"
+#include "edge-impulse-sdk/tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "edge-impulse-sdk/tensorflow/lite/schema/schema_generated_full.h"
+#include "bench_alloc.h"
+#include "bench_jpeg.h"
+#include "model_loader.h"
+
+#if EI_CLASSIFIER_SENSOR != EI_CLASSIFIER_SENSOR_CAMERA
+#error "The inference benchmark needs an image (camera) impulse"
+#endif
+
+#define BENCH_EXIT_OK      0
+#define BENCH_EXIT_ERROR   1
+#define BENCH_EXIT_BUDGET  2
+
+enum BenchStage {
+    STAGE_DECODE,
+    STAGE_RESIZE,
+    STAGE_DSP,
+    STAGE_CLASSIFICATION,
+    STAGE_POSTPROCESSING,
+    STAGE_TOTAL,
+    STAGE_COUNT
+};
+
+static const char* stageNames[STAGE_COUNT] = {
+    "decode", "resize", "dsp", "classification", "postprocessing", "total"
+};
+
+struct BenchImage {
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+static uint8_t inputImage[EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * 3];
+
+// Packed RGB888 to the 0xRRGGBB floats the image DSP block expects
+static int getInputData(size_t offset, size_t length, float* out) {
+    const uint8_t* pixel = inputImage + offset * 3;
+    for (size_t i = 0; i < length; i++) {
+        out[i] = (float)((pixel[0] << 16) | (pixel[1] << 8) | pixel[2]);
+        pixel += 3;
+    }
+    return 0;
+}
+
+// --- Input ---
+
+static bool isJpeg(const char* name) {
+    const char* ext = strrchr(name, '.');
+    if (!ext) return false;
+    char lower[8] = { 0 };
+    for (size_t i = 0; i < sizeof(lower) - 1 && ext[i]; i++) {
+        lower[i] = (char)tolower((unsigned char)ext[i]);
+    }
+    return strcmp(lower, ".jpg") == 0 || strcmp(lower, ".jpeg") == 0;
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    out.resize(size > 0 ? (size_t)size : 0);
+    bool ok = size > 0 && fread(out.data(), 1, out.size(), file) == out.size();
+    fclose(file);
+    return ok;
+}
+
+// Everything is read up front so file I/O never shows up in the timings
+static bool loadImages(const char* dir, std::vector<BenchImage>& images) {
+    DIR* d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "ERROR: Can't open image directory %s\n", dir);
+        return false;
+    }
+    std::vector<std::string> names;
+    while (struct dirent* entry = readdir(d)) {
+        if (isJpeg(entry->d_name)) names.push_back(entry->d_name);
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    for (const std::string& name : names) {
+        BenchImage image;
+        image.name = name;
+        if (!readFile(std::string(dir) + "/" + name, image.data)) {
+            fprintf(stderr, "ERROR: Can't read %s\n", name.c_str());
+            return false;
+        }
+        images.push_back(std::move(image));
+    }
+    if (images.empty()) {
+        fprintf(stderr, "ERROR: No .jpg files in %s\n", dir);
+        return false;
+    }
+    return true;
+}
+
+// --- Statistics ---
+
+// Nearest-rank percentile of sorted samples
+static uint64_t percentile(const std::vector<uint64_t>& sorted, int p) {
+    size_t rank = (sorted.size() * p + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void addStageJson(JsonObject obj, std::vector<uint64_t>& samples) {
+    std::sort(samples.begin(), samples.end());
+    uint64_t sum = 0;
+    for (uint64_t us : samples) sum += us;
+    obj["p50_us"] = percentile(samples, 50);
+    obj["p90_us"] = percentile(samples, 90);
+    obj["p95_us"] = percentile(samples, 95);
+    obj["p99_us"] = percentile(samples, 99);
+    obj["mean_us"] = sum / samples.size();
+    obj["max_us"] = samples.back();
+}
+
+static uint64_t elapsedNs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// --- Budget ---
+
+// Every number in the budget is the upper limit for the same path in the report
+static void checkBudget(JsonObjectConst budget, JsonObjectConst report, const std::string& path, JsonArray violations) {
+    for (JsonPairConst entry : budget) {
+        std::string name = path.empty() ? entry.key().c_str() : path + "." + entry.key().c_str();
+        JsonVariantConst actual = report[entry.key()];
+        if (entry.value().is<JsonObjectConst>()) {
+            checkBudget(entry.value().as<JsonObjectConst>(), actual.as<JsonObjectConst>(), name, violations);
+        } else if (entry.value().is<double>()) {
+            if (!actual.is<double>()) {
+                JsonObject violation = violations.add<JsonObject>();
+                violation["metric"] = name;
+                violation["error"] = "not in report";
+            } else if (actual.as<double>() > entry.value().as<double>()) {
+                JsonObject violation = violations.add<JsonObject>();
+                violation["metric"] = name;
+                violation["value"] = actual;
+                violation["limit"] = entry.value();
+            }
+        }
+    }
+}
+
+// --- Frame Skip Replay ---
+
+#if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+struct ReplayResult {
+    uint64_t us;
+    uint32_t frames;
+    uint32_t inferences;
+    std::vector<uint32_t> counts;
+};
+
+// One pass over the images in capture order with fresh tracking state. A
+// skipped frame isn't decoded either, the camera frame would just be dropped.
+static bool replayImages(const std::vector<BenchImage>& images, EiFrameSkipScheduler* scheduler, ReplayResult& out) {
+    run_classifier_deinit();
+    run_classifier_init();
+
+    std::vector<uint8_t> rgb;
+    signal_t signal;
+    signal.total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
+    signal.get_data = &getInputData;
+
+    out = ReplayResult();
+    ei_impulse_result_t result;
+    for (const BenchImage& image : images) {
+        uint64_t startUs = ei_read_timer_us();
+        EI_IMPULSE_ERROR res;
+        if (scheduler == nullptr || scheduler->should_run_model()) {
+            int width, height;
+            if (!benchDecodeJpeg(image.data.data(), image.data.size(), rgb, width, height)) {
+                fprintf(stderr, "ERROR: Can't decode %s (baseline colour JPEG only)\n", image.name.c_str());
+                return false;
+            }
+            ei::image::processing::crop_and_interpolate_rgb888(rgb.data(), width, height, inputImage,
+                                                               EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT);
+            res = run_classifier(&signal, &result, false);
+            if (res == EI_IMPULSE_OK && scheduler != nullptr) {
+                size_t openTraces = 0;
+                float uncertainty = 0;
+                get_object_tracking_state(&openTraces, &uncertainty);
+                scheduler->update(openTraces, uncertainty);
+            }
+            out.inferences++;
+        } else {
+            res = run_classifier_predicted(&result);
+        }
+        out.us += ei_read_timer_us() - startUs;
+        out.frames++;
+        if (res != EI_IMPULSE_OK) {
+            fprintf(stderr, "ERROR: Replay failed (%d) on %s\n", res, image.name.c_str());
+            return false;
+        }
+#if EI_CLASSIFIER_OBJECT_COUNTING_ENABLED == 1
+        const auto& counting = result.postprocessed_output.object_counting_output;
+        out.counts.assign(counting.counts, counting.counts + counting.counter_num);
+#endif
+    }
+    return true;
+}
+
+static bool addFrameSkipJson(JsonObject obj, const std::vector<BenchImage>& images, int maxInterval) {
+    ReplayResult baseline, skipped;
+    ei_frame_skip_config_t config = EI_FRAME_SKIP_CONFIG_DEFAULT;
+    config.max_interval = (uint16_t)maxInterval;
+    EiFrameSkipScheduler scheduler(config);
+    if (!replayImages(images, nullptr, baseline) || !replayImages(images, &scheduler, skipped)) {
+        return false;
+    }
+
+    obj["max_interval"] = maxInterval;
+    obj["frames"] = skipped.frames;
+    obj["inferences"] = skipped.inferences;
+    obj["baseline_us"] = baseline.us;
+    obj["skip_us"] = skipped.us;
+    obj["cpu_saved_pct"] = baseline.us > 0 ? 100.0 * ((double)baseline.us - (double)skipped.us) / baseline.us : 0.0;
+
+    // Counting accuracy against running the model on every frame
+    JsonArray baselineCounts = obj["baseline_counts"].to<JsonArray>();
+    JsonArray skipCounts = obj["skip_counts"].to<JsonArray>();
+    uint64_t total = 0, error = 0;
+    for (size_t i = 0; i < baseline.counts.size(); i++) {
+        uint32_t skipCount = i < skipped.counts.size() ? skipped.counts[i] : 0;
+        baselineCounts.add(baseline.counts[i]);
+        skipCounts.add(skipCount);
+        total += baseline.counts[i];
+        error += baseline.counts[i] > skipCount ? baseline.counts[i] - skipCount : skipCount - baseline.counts[i];
+    }
+    obj["count_error"] = error;
+    obj["count_accuracy"] = total > 0 ? 1.0 - (double)error / total : 1.0;
+    return true;
+}
+#endif
+
+// --- Tracker Equivalence ---
+
+#if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+#define TRACKER_BENCH_FRAMES        200
+#define TRACKER_BENCH_MAX_OBJECTS   12
+#define TRACKER_BENCH_IOU           0.3f
+#define TRACKER_BENCH_DISTANCE      30.0f   // centroid distance threshold, pixels
+
+typedef StaticTracker<EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES, EI_CLASSIFIER_OBJECT_TRACKING_MAX_DETECTIONS> BenchStaticTracker;
+
+struct TrackerBenchObject {
+    float x, y, vx, vy;
+    uint32_t width, height;
+};
+
+static const char* trackerBenchLabels[] = { "bee", "wasp" };
+
+// Bees flying through the frame: some arrive, some leave, every detection is
+// a few pixels off and some frames miss one, in no particular order
+static void makeTrackerFrame(std::mt19937& rng, std::vector<TrackerBenchObject>& objects,
+                             std::vector<ei_impulse_result_bounding_box_t>& detections) {
+    size_t maxObjects = std::min<size_t>(TRACKER_BENCH_MAX_OBJECTS, EI_CLASSIFIER_OBJECT_TRACKING_MAX_DETECTIONS);
+    if (objects.size() < maxObjects && rng() % 4 == 0) {
+        objects.push_back({ (float)(rng() % 300), (float)(rng() % 300), (float)((int)(rng() % 11) - 5),
+                            (float)((int)(rng() % 11) - 5), (uint32_t)(8 + rng() % 24), (uint32_t)(8 + rng() % 24) });
+    }
+    if (!objects.empty() && rng() % 10 == 0) {
+        objects.erase(objects.begin() + rng() % objects.size());
+    }
+    detections.clear();
+    for (TrackerBenchObject& o : objects) {
+        o.x = std::max(0.0f, o.x + o.vx);
+        o.y = std::max(0.0f, o.y + o.vy);
+        if (rng() % 8 == 0) continue;
+        const char* label = trackerBenchLabels[rng() % 2];
+        uint32_t x = (uint32_t)o.x + rng() % 3;
+        uint32_t y = (uint32_t)o.y + rng() % 3;
+        detections.push_back({ label, x, y, o.width, o.height, 0.5f + (rng() % 50) / 100.0f });
+    }
+    std::shuffle(detections.begin(), detections.end(), rng);
+}
+
+static bool sameTraces(const Tracker& tracker, const BenchStaticTracker& staticTracker) {
+    if (tracker.object_tracking_output.size() != staticTracker.object_tracking_output_count) return false;
+    for (size_t i = 0; i < staticTracker.object_tracking_output_count; i++) {
+        const ei_object_tracking_trace_t& a = tracker.object_tracking_output[i];
+        const ei_object_tracking_trace_t& b = staticTracker.object_tracking_output[i];
+        if (a.id != b.id || a.x != b.x || a.y != b.y || a.width != b.width || a.height != b.height ||
+                a.last_ground_truth_update_t != b.last_ground_truth_update_t ||
+                a.last_centroid_segment != b.last_centroid_segment || strcmp(a.label, b.label) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Every stream goes through Tracker and StaticTracker side by side, IoU
+// matching on even streams and centroid distance on odd ones. Fails on the
+// first frame where the open traces differ.
+static bool addTrackerJson(JsonObject obj, int streams) {
+    std::vector<uint64_t> trackerNs, staticNs;
+    trackerNs.reserve((size_t)streams * TRACKER_BENCH_FRAMES);
+    staticNs.reserve((size_t)streams * TRACKER_BENCH_FRAMES);
+    uint64_t trackerAllocs = 0, staticAllocs = 0, detectionCount = 0;
+    std::vector<TrackerBenchObject> objects;
+    std::vector<ei_impulse_result_bounding_box_t> detections;
+    for (int stream = 0; stream < streams; stream++) {
+        std::mt19937 rng(stream);
+        bool useIou = stream % 2 == 0;
+        float threshold = useIou ? TRACKER_BENCH_IOU : TRACKER_BENCH_DISTANCE;
+        Tracker tracker(5, 5, threshold, useIou);
+        std::unique_ptr<BenchStaticTracker> staticTracker(new BenchStaticTracker(5, 5, threshold, useIou));
+        objects.clear();
+        for (int frame = 0; frame < TRACKER_BENCH_FRAMES; frame++) {
+            makeTrackerFrame(rng, objects, detections);
+            detectionCount += detections.size();
+
+            // The vector copy is part of it, process_object_tracking() makes one
+            BenchAllocStats before = benchAllocStats();
+            auto start = std::chrono::steady_clock::now();
+            tracker.process_new_detections(detections);
+            trackerNs.push_back(elapsedNs(start));
+            BenchAllocStats between = benchAllocStats();
+            start = std::chrono::steady_clock::now();
+            staticTracker->process_new_detections(detections.data(), detections.size());
+            staticNs.push_back(elapsedNs(start));
+            BenchAllocStats after = benchAllocStats();
+            trackerAllocs += between.allocs - before.allocs;
+            staticAllocs += after.allocs - between.allocs;
+
+            if (!sameTraces(tracker, *staticTracker)) {
+                fprintf(stderr, "ERROR: StaticTracker differs from Tracker (stream %d, frame %d)\n", stream, frame);
+                return false;
+            }
+        }
+    }
+
+    uint64_t frames = trackerNs.size();
+    obj["streams"] = streams;
+    obj["frames"] = frames;
+    obj["detections_mean"] = (double)detectionCount / frames;
+    obj["max_traces"] = EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES;
+    obj["max_detections"] = EI_CLASSIFIER_OBJECT_TRACKING_MAX_DETECTIONS;
+    obj["static_bytes"] = sizeof(BenchStaticTracker);
+    struct { const char* name; std::vector<uint64_t>& ns; uint64_t allocs; } results[] = {
+        { "tracker", trackerNs, trackerAllocs },
+        { "static", staticNs, staticAllocs },
+    };
+    for (auto& r : results) {
+        std::sort(r.ns.begin(), r.ns.end());
+        JsonObject json = obj[r.name].to<JsonObject>();
+        json["p50_ns"] = percentile(r.ns, 50);
+        json["p99_ns"] = percentile(r.ns, 99);
+        json["max_ns"] = r.ns.back();
+        json["allocs_per_frame"] = (double)r.allocs / frames;
+    }
+    uint64_t staticP50 = obj["static"]["p50_ns"];
+    obj["speedup_p50"] = staticP50 > 0 ? (double)obj["tracker"]["p50_ns"].as<uint64_t>() / staticP50 : 0.0;
+    return true;
+}
+#endif
+
+// --- FOMO Clustering ---
+
+#ifdef EI_HAS_FOMO
+#define FOMO_BENCH_CELL_PIXELS  8       // a FOMO output cell covers 8x8 input pixels
+#define FOMO_BENCH_THRESHOLD    0.5f
+#define FOMO_BENCH_REPEAT       16
+
+static const int fomoBenchBees[] = { 0, 10, 50 };
+
+// A FOMO output with that many bees, each lighting up a few neighbouring
+// cells of one class above the threshold, and some noise below it
+static void makeFomoFrame(std::mt19937& rng, int bees, size_t width, size_t height, size_t labelCount,
+                          std::vector<float>& out) {
+    std::uniform_real_distribution<float> noise(0.0f, FOMO_BENCH_THRESHOLD * 0.8f);
+    std::uniform_real_distribution<float> hit(FOMO_BENCH_THRESHOLD, 1.0f);
+    size_t stride = labelCount + 1;
+    out.assign(width * height * stride, 0.0f);
+    for (size_t i = 0; i < width * height; i++) {
+        out[i * stride + 1 + rng() % labelCount] = noise(rng);
+    }
+    for (int bee = 0; bee < bees; bee++) {
+        size_t x = rng() % width, y = rng() % height, label = 1 + rng() % labelCount;
+        for (size_t dy = 0; dy < 2 && y + dy < height; dy++) {
+            for (size_t dx = 0; dx < 2 && x + dx < width; dx++) {
+                if (rng() % 3 == 0) continue;
+                out[((y + dy) * height + x + dx) * stride + label] = hit(rng);
+            }
+        }
+    }
+}
+
+// The clustering as it was before the fixed cube pool: a heap cube per
+// activated cell, then process_cubes()
+static void fomoReferenceCubes(const float* buffer, const ei_fill_result_fomo_f32_config_t& config,
+                               ei_impulse_result_t* result) {
+    const ei_impulse_t* impulse = ei_default_impulse.impulse;
+    std::vector<ei_classifier_cube_t*> cubes;
+    for (size_t y = 0; y < config.out_width; y++) {
+        for (size_t x = 0; x < config.out_height; x++) {
+            size_t loc = ((y * config.out_height) + x) * (impulse->label_count + 1);
+            for (size_t ix = 1; ix < impulse->label_count + 1; ix++) {
+                ei_handle_cube(&cubes, x, y, buffer[loc + ix], impulse->categories[ix - 1], config.threshold);
+            }
+        }
+    }
+    process_cubes(result, &cubes, impulse->input_width / config.out_width, config.object_detection_count);
+}
+
+static bool sameFomoBoxes(const std::vector<ei_impulse_result_bounding_box_t>& expected, const ei_impulse_result_t& result) {
+    if (result.bounding_boxes_count != expected.size()) return false;
+    for (size_t i = 0; i < expected.size(); i++) {
+        const ei_impulse_result_bounding_box_t& a = expected[i];
+        const ei_impulse_result_bounding_box_t& b = result.bounding_boxes[i];
+        if (strcmp(a.label, b.label) != 0 || a.x != b.x || a.y != b.y || a.width != b.width ||
+                a.height != b.height || a.value != b.value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Nanoseconds per call of fn, averaged over FOMO_BENCH_REPEAT calls
+template <typename Fn>
+static uint64_t timeFomo(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < FOMO_BENCH_REPEAT; i++) {
+        fn();
+    }
+    return (elapsedNs(start) + FOMO_BENCH_REPEAT / 2) / FOMO_BENCH_REPEAT;
+}
+
+// The int8 output as it was read before thresholding in the int8 domain:
+// every cell dequantized and tested as a float, then the heap cubes
+static void fomoReferenceCubesI8(const int8_t* buffer, const ei_fill_result_fomo_i8_config_t& config,
+                                 ei_impulse_result_t* result) {
+    const ei_impulse_t* impulse = ei_default_impulse.impulse;
+    std::vector<ei_classifier_cube_t*> cubes;
+    for (size_t y = 0; y < config.out_width; y++) {
+        for (size_t x = 0; x < config.out_height; x++) {
+            size_t loc = ((y * config.out_height) + x) * (impulse->label_count + 1);
+            for (size_t ix = 1; ix < impulse->label_count + 1; ix++) {
+                float vf = static_cast<float>(buffer[loc + ix] - config.zero_point) * config.scale;
+                ei_handle_cube(&cubes, x, y, vf, impulse->categories[ix - 1], config.threshold);
+            }
+        }
+    }
+    process_cubes(result, &cubes, impulse->input_width / config.out_width, config.object_detection_count);
+}
+
+// A quantized FOMO output: the float frame through the output quantization,
+// or random bytes when the scale isn't a usable one
+static void quantizeFomoFrame(std::mt19937& rng, const std::vector<float>& frame,
+                              const ei_fill_result_fomo_i8_config_t& config, int8_t* out) {
+    for (size_t i = 0; i < frame.size(); i++) {
+        float q = config.scale > 0.0f ? roundf(frame[i] / config.scale) + config.zero_point : (float)(int8_t)rng();
+        out[i] = (int8_t)std::max(-128.0f, std::min(127.0f, q));
+    }
+}
+
+// process_fomo_i8() against the float test on every cell. Half the frames use
+// the usual softmax output quantization, the rest random zero points, scales
+// (zero and negative ones too) and thresholds. Times both on the former.
+static bool addFomoI8Json(JsonObject obj, int frames, const ei_fill_result_fomo_f32_config_t& f32Config) {
+    const ei_impulse_t* impulse = ei_default_impulse.impulse;
+    ei_fill_result_fomo_i8_config_t config = {};
+    config.out_width = f32Config.out_width;
+    config.out_height = f32Config.out_height;
+    config.object_detection_count = f32Config.object_detection_count;
+
+    ei::matrix_i8_t output(1, config.out_width * config.out_height * (impulse->label_count + 1));
+    ei_feature_t feature = {};
+    feature.matrix_i8 = &output;
+    ei_impulse_result_t result = {};
+    result._raw_outputs = &feature;
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> frame;
+    std::vector<ei_impulse_result_bounding_box_t> expected;
+    std::vector<uint64_t> referenceNs, int8Ns;
+    for (int i = 0; i < frames; i++) {
+        bool usual = i % 2 == 0;
+        if (usual) {
+            config.zero_point = -128.0f;
+            config.scale = 1.0f / 256.0f;
+            config.threshold = FOMO_BENCH_THRESHOLD;
+        } else {
+            config.zero_point = (float)(int8_t)rng();
+            int kind = rng() % 8;
+            config.scale = kind == 0 ? 0.0f : (kind == 1 ? -unit(rng) / 64.0f : unit(rng) / 64.0f);
+            config.threshold = unit(rng);
+        }
+        makeFomoFrame(rng, fomoBenchBees[rng() % 3], config.out_width, config.out_height, impulse->label_count, frame);
+        quantizeFomoFrame(rng, frame, config, output.buffer);
+
+        fomoReferenceCubesI8(output.buffer, config, &result);
+        expected.assign(result.bounding_boxes, result.bounding_boxes + result.bounding_boxes_count);
+        process_fomo_i8(&ei_default_impulse, 0, 0, &result, &config, nullptr);
+        if (!sameFomoBoxes(expected, result)) {
+            fprintf(stderr, "ERROR: int8 FOMO thresholding differs from the float test (frame %d, zero point %g, "
+                            "scale %g, threshold %g)\n", i, config.zero_point, config.scale, config.threshold);
+            return false;
+        }
+
+        if (usual) {
+            referenceNs.push_back(timeFomo([&]() { fomoReferenceCubesI8(output.buffer, config, &result); }));
+            int8Ns.push_back(timeFomo([&]() { process_fomo_i8(&ei_default_impulse, 0, 0, &result, &config, nullptr); }));
+        }
+    }
+
+    obj["frames"] = frames;
+    std::sort(referenceNs.begin(), referenceNs.end());
+    std::sort(int8Ns.begin(), int8Ns.end());
+    obj["dequantize_p50_ns"] = percentile(referenceNs, 50);
+    obj["int8_p50_ns"] = percentile(int8Ns, 50);
+    obj["speedup_p50"] = obj["int8_p50_ns"].as<uint64_t>() > 0 ?
+        (double)obj["dequantize_p50_ns"].as<uint64_t>() / obj["int8_p50_ns"].as<uint64_t>() : 0.0;
+    return true;
+}
+
+// process_fomo_f32() against the reference clustering on synthetic outputs
+// of the impulse's grid. Fails if the boxes ever differ.
+static bool addFomoJson(JsonObject obj, int frames) {
+    const ei_impulse_t* impulse = ei_default_impulse.impulse;
+    ei_fill_result_fomo_f32_config_t config = {};
+    config.threshold = FOMO_BENCH_THRESHOLD;
+    config.out_width = impulse->input_width / FOMO_BENCH_CELL_PIXELS;
+    config.out_height = impulse->input_height / FOMO_BENCH_CELL_PIXELS;
+    config.object_detection_count = EI_CLASSIFIER_MAX_OBJECT_DETECTION_COUNT;
+
+    ei::matrix_t output(1, config.out_width * config.out_height * (impulse->label_count + 1));
+    ei_feature_t feature = {};
+    feature.matrix = &output;
+    ei_impulse_result_t result = {};
+    result._raw_outputs = &feature;
+
+    std::mt19937 rng(3);
+    std::vector<float> frame;
+    std::vector<ei_impulse_result_bounding_box_t> expected;
+    obj["grid_width"] = config.out_width;
+    obj["grid_height"] = config.out_height;
+    obj["labels"] = impulse->label_count;
+    obj["frames"] = frames;
+    for (int bees : fomoBenchBees) {
+        std::vector<uint64_t> referenceNs, staticNs;
+        uint64_t referenceAllocs = 0, staticAllocs = 0, boxes = 0;
+        for (int i = 0; i < frames; i++) {
+            makeFomoFrame(rng, bees, config.out_width, config.out_height, impulse->label_count, frame);
+            memcpy(output.buffer, frame.data(), frame.size() * sizeof(float));
+
+            BenchAllocStats before = benchAllocStats();
+            fomoReferenceCubes(output.buffer, config, &result);
+            BenchAllocStats between = benchAllocStats();
+            expected.assign(result.bounding_boxes, result.bounding_boxes + result.bounding_boxes_count);
+            BenchAllocStats beforeStatic = benchAllocStats();
+            process_fomo_f32(&ei_default_impulse, 0, 0, &result, &config, nullptr);
+            BenchAllocStats after = benchAllocStats();
+            referenceAllocs += between.allocs - before.allocs;
+            staticAllocs += after.allocs - beforeStatic.allocs;
+            if (!sameFomoBoxes(expected, result)) {
+                fprintf(stderr, "ERROR: FOMO clustering differs from the reference (%d bees, frame %d)\n", bees, i);
+                return false;
+            }
+            boxes += expected.size();
+
+            referenceNs.push_back(timeFomo([&]() { fomoReferenceCubes(output.buffer, config, &result); }));
+            staticNs.push_back(timeFomo([&]() {
+                process_fomo_f32(&ei_default_impulse, 0, 0, &result, &config, nullptr);
+            }));
+        }
+
+        JsonObject beesJson = obj["bees_" + std::to_string(bees)].to<JsonObject>();
+        beesJson["boxes_mean"] = (double)boxes / frames;
+        struct { const char* name; std::vector<uint64_t>& ns; uint64_t allocs; } results[] = {
+            { "cubes", referenceNs, referenceAllocs },
+            { "static", staticNs, staticAllocs },
+        };
+        for (auto& r : results) {
+            std::sort(r.ns.begin(), r.ns.end());
+            JsonObject json = beesJson[r.name].to<JsonObject>();
+            json["p50_ns"] = percentile(r.ns, 50);
+            json["p99_ns"] = percentile(r.ns, 99);
+            json["allocs_per_frame"] = (double)r.allocs / frames;
+        }
+        uint64_t staticP50 = beesJson["static"]["p50_ns"];
+        beesJson["speedup_p50"] = staticP50 > 0 ? (double)beesJson["cubes"]["p50_ns"].as<uint64_t>() / staticP50 : 0.0;
+    }
+    return addFomoI8Json(obj["int8"].to<JsonObject>(), frames, config);
+}
+#endif
+
+// --- Synthetic NMS Scenes ---
+
+#define NMS_BENCH_IOU_THRESHOLD    0.45f
+#define NMS_BENCH_SCORE_THRESHOLD  0.25f
+#define NMS_BENCH_REPEAT           16
+
+static const int nmsBoxCounts[] = { 32, 64, 128, 256, 512, 1024 };
+
+// A crowded frame as a box detector's last layer sees it: a cluster of
+// overlapping candidates around each object, at the model's input size
+static void makeNmsScene(std::mt19937& rng, int boxCount, std::vector<float>& boxes, std::vector<float>& scores) {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float objectSize = EI_CLASSIFIER_INPUT_WIDTH / 12.0f;
+    boxes.resize(boxCount * 4);
+    scores.resize(boxCount);
+    int i = 0;
+    while (i < boxCount) {
+        float cx = unit(rng) * EI_CLASSIFIER_INPUT_WIDTH;
+        float cy = unit(rng) * EI_CLASSIFIER_INPUT_HEIGHT;
+        float size = objectSize * (0.6f + 0.8f * unit(rng));
+        float confidence = 0.4f + 0.6f * unit(rng);
+        for (int c = 3 + (int)(unit(rng) * 6); c > 0 && i < boxCount; c--, i++) {
+            float x = cx + (unit(rng) - 0.5f) * size * 0.4f;
+            float y = cy + (unit(rng) - 0.5f) * size * 0.4f;
+            float w = size * (0.8f + 0.4f * unit(rng));
+            float h = size * (0.8f + 0.4f * unit(rng));
+            // [y1, x1, y2, x2]
+            boxes[i * 4 + 0] = y - h / 2;
+            boxes[i * 4 + 1] = x - w / 2;
+            boxes[i * 4 + 2] = y + h / 2;
+            boxes[i * 4 + 3] = x + w / 2;
+            scores[i] = confidence * (0.5f + 0.5f * unit(rng));
+        }
+    }
+}
+
+// Microseconds per call, averaged over NMS_BENCH_REPEAT calls so small scenes
+// aren't all rounded to the same microsecond
+template <typename Nms>
+static uint64_t timeNms(Nms nms, const std::vector<float>& boxes, const std::vector<float>& scores,
+                        std::vector<int>& selected, std::vector<float>& selectedScores, int& selectedCount) {
+    uint64_t startUs = ei_read_timer_us();
+    for (int i = 0; i < NMS_BENCH_REPEAT; i++) {
+        nms(boxes.data(), (int)scores.size(), scores.data(), (int)scores.size(), NMS_BENCH_IOU_THRESHOLD,
+            NMS_BENCH_SCORE_THRESHOLD, 0.0f, selected.data(), selectedScores.data(), &selectedCount);
+    }
+    return (ei_read_timer_us() - startUs + NMS_BENCH_REPEAT / 2) / NMS_BENCH_REPEAT;
+}
+
+static bool addNmsJson(JsonObject obj, int scenes) {
+    std::mt19937 rng(1);
+    obj["scenes"] = scenes;
+    obj["iou_threshold"] = NMS_BENCH_IOU_THRESHOLD;
+    obj["grid_min_boxes"] = EI_CLASSIFIER_NMS_GRID_MIN_BOXES;
+    for (int boxCount : nmsBoxCounts) {
+        std::vector<float> boxes, scores;
+        std::vector<int> pairwiseSelected(boxCount), gridSelected(boxCount);
+        std::vector<float> pairwiseScores(boxCount), gridScores(boxCount);
+        std::vector<uint64_t> pairwiseUs, gridUs;
+        uint64_t selectedSum = 0;
+        for (int scene = 0; scene < scenes; scene++) {
+            makeNmsScene(rng, boxCount, boxes, scores);
+            int pairwiseCount = 0, gridCount = 0;
+            pairwiseUs.push_back(timeNms(NonMaxSuppression, boxes, scores, pairwiseSelected, pairwiseScores, pairwiseCount));
+            gridUs.push_back(timeNms(NonMaxSuppressionGrid, boxes, scores, gridSelected, gridScores, gridCount));
+            if (gridCount != pairwiseCount ||
+                !std::equal(gridSelected.begin(), gridSelected.begin() + gridCount, pairwiseSelected.begin()) ||
+                !std::equal(gridScores.begin(), gridScores.begin() + gridCount, pairwiseScores.begin())) {
+                fprintf(stderr, "ERROR: Grid NMS differs from pairwise NMS (%d boxes, scene %d)\n", boxCount, scene);
+                return false;
+            }
+            selectedSum += pairwiseCount;
+        }
+
+        JsonObject sizeJson = obj["boxes_" + std::to_string(boxCount)].to<JsonObject>();
+        sizeJson["selected_mean"] = (double)selectedSum / scenes;
+        addStageJson(sizeJson["pairwise"].to<JsonObject>(), pairwiseUs);
+        addStageJson(sizeJson["grid"].to<JsonObject>(), gridUs);
+        uint64_t gridP50 = sizeJson["grid"]["p50_us"];
+        sizeJson["speedup_p50"] = gridP50 > 0 ? (double)sizeJson["pairwise"]["p50_us"].as<uint64_t>() / gridP50 : 0.0;
+    }
+    return true;
+}
+
+// --- Activation Fusion ---
+#define FUSION_BENCH_ARENA  (32 * 1024)
+
+static const tflite::ActivationFunctionType fusionBenchActivations[] = {
+    tflite::ActivationFunctionType_NONE, tflite::ActivationFunctionType_RELU,
+    tflite::ActivationFunctionType_RELU6, tflite::ActivationFunctionType_RELU_N1_TO_1
+};
+
+struct FusionGraph {
+    std::vector<uint8_t> model;
+    int pairs[3][2];                // convolution's own activation, the tensor between it and its RELU/RELU6
+};
+
+// conv -> RELU -> depthwise conv -> RELU6 -> 1x1 conv -> RELU, int8, with the
+// activation of the first two convolutions given and weights from seed. The
+// tensor between a convolution and its activation has the quantization of
+// the activation's output, so FuseActivations() may fold the pair. With
+// keepIntermediates those tensors are subgraph outputs too, which keeps every
+// pair apart.
+static void makeFusionGraph(uint32_t seed, tflite::ActivationFunctionType convAct,
+                            tflite::ActivationFunctionType dwAct, bool keepIntermediates, FusionGraph& graph) {
+    using namespace tflite;
+    // The SDK's flatbuffers has no default allocator, it never builds on the device
+    flatbuffers::DefaultAllocator allocator;
+    flatbuffers::FlatBufferBuilder b(4096, &allocator);
+    std::vector<flatbuffers::Offset<Buffer>> buffers = { CreateBuffer(b) };
+    std::vector<flatbuffers::Offset<Tensor>> tensors;
+    std::mt19937 rng(seed);
+    auto weights = [&](size_t count, bool bias) {
+        std::vector<uint8_t> data(count * (bias ? 4 : 1));
+        for (size_t i = 0; i < count; i++) {
+            if (bias) {
+                int32_t value = (int32_t)(rng() % 2001) - 1000;
+                memcpy(&data[i * 4], &value, 4);
+            } else {
+                data[i] = (uint8_t)(rng() % 255 + 1);   // -127..127
+            }
+        }
+        buffers.push_back(CreateBuffer(b, b.CreateVector(data)));
+        return (uint32_t)buffers.size() - 1;
+    };
+    auto tensor = [&](std::vector<int32_t> shape, TensorType type, std::vector<float> scale,
+                      int64_t zeroPoint, uint32_t buffer = 0, int quantizedDimension = 0) {
+        std::vector<int64_t> zeroPoints(scale.size(), zeroPoint);
+        auto q = CreateQuantizationParameters(b, 0, 0, b.CreateVector(scale), b.CreateVector(zeroPoints),
+                                              QuantizationDetails_NONE, 0, quantizedDimension);
+        tensors.push_back(CreateTensor(b, b.CreateVector(shape), type, buffer, 0, q));
+        return (int32_t)tensors.size() - 1;
+    };
+
+    int32_t in = tensor({ 1, 12, 12, 3 }, TensorType_INT8, { 0.05f }, -3);
+    int32_t w1 = tensor({ 4, 3, 3, 3 }, TensorType_INT8, { 0.01f, 0.02f, 0.015f, 0.03f }, 0, weights(108, false));
+    int32_t b1 = tensor({ 4 }, TensorType_INT32, { 0.0005f, 0.001f, 0.00075f, 0.0015f }, 0, weights(4, true));
+    int32_t t1 = tensor({ 1, 12, 12, 4 }, TensorType_INT8, { 0.1f }, 5);
+    int32_t a1 = tensor({ 1, 12, 12, 4 }, TensorType_INT8, { 0.1f }, 5);
+    int32_t w2 = tensor({ 1, 3, 3, 4 }, TensorType_INT8, { 0.01f, 0.02f, 0.015f, 0.03f }, 0, weights(36, false), 3);
+    int32_t b2 = tensor({ 4 }, TensorType_INT32, { 0.001f, 0.002f, 0.0015f, 0.003f }, 0, weights(4, true));
+    int32_t t2 = tensor({ 1, 12, 12, 4 }, TensorType_INT8, { 0.02f }, -10);
+    int32_t a2 = tensor({ 1, 12, 12, 4 }, TensorType_INT8, { 0.02f }, -10);
+    int32_t w3 = tensor({ 2, 1, 1, 4 }, TensorType_INT8, { 0.02f, 0.01f }, 0, weights(8, false));
+    int32_t b3 = tensor({ 2 }, TensorType_INT32, { 0.0004f, 0.0002f }, 0, weights(2, true));
+    int32_t t3 = tensor({ 1, 12, 12, 2 }, TensorType_INT8, { 0.07f }, 0);
+    int32_t out = tensor({ 1, 12, 12, 2 }, TensorType_INT8, { 0.07f }, 0);
+
+    std::vector<flatbuffers::Offset<Operator>> ops;
+    auto op = [&](uint32_t code, std::vector<int32_t> inputs, int32_t output, BuiltinOptions type,
+                  flatbuffers::Offset<void> options) {
+        ops.push_back(CreateOperator(b, code, b.CreateVector(inputs), b.CreateVector(std::vector<int32_t>{ output }),
+                                     type, options));
+    };
+    op(0, { in, w1, b1 }, t1, BuiltinOptions_Conv2DOptions,
+       CreateConv2DOptions(b, Padding_SAME, 1, 1, convAct).Union());
+    op(1, { t1 }, a1, BuiltinOptions_NONE, 0);
+    op(2, { a1, w2, b2 }, t2, BuiltinOptions_DepthwiseConv2DOptions,
+       CreateDepthwiseConv2DOptions(b, Padding_SAME, 1, 1, 1, dwAct).Union());
+    op(3, { t2 }, a2, BuiltinOptions_NONE, 0);
+    op(0, { a2, w3, b3 }, t3, BuiltinOptions_Conv2DOptions,
+       CreateConv2DOptions(b, Padding_VALID, 1, 1, ActivationFunctionType_NONE).Union());
+    op(1, { t3 }, out, BuiltinOptions_NONE, 0);
+
+    std::vector<int32_t> inputs = { in };
+    std::vector<int32_t> outputs = { out };
+    if (keepIntermediates) outputs.insert(outputs.end(), { t1, t2, t3 });
+    std::vector<flatbuffers::Offset<SubGraph>> subgraphs = {
+        CreateSubGraph(b, b.CreateVector(tensors), b.CreateVector(inputs), b.CreateVector(outputs), b.CreateVector(ops))
+    };
+    std::vector<flatbuffers::Offset<OperatorCode>> codes = {
+        CreateOperatorCode(b, BuiltinOperator_CONV_2D, 0, 1, BuiltinOperator_CONV_2D),
+        CreateOperatorCode(b, BuiltinOperator_RELU, 0, 1, BuiltinOperator_RELU),
+        CreateOperatorCode(b, BuiltinOperator_DEPTHWISE_CONV_2D, 0, 1, BuiltinOperator_DEPTHWISE_CONV_2D),
+        CreateOperatorCode(b, BuiltinOperator_RELU6, 0, 1, BuiltinOperator_RELU6),
+    };
+    b.Finish(CreateModel(b, TFLITE_SCHEMA_VERSION, b.CreateVector(codes), b.CreateVector(subgraphs), 0,
+                         b.CreateVector(buffers)), ModelIdentifier());
+
+    graph.model.assign(b.GetBufferPointer(), b.GetBufferPointer() + b.GetSize());
+    int pairs[3][2] = { { convAct, t1 }, { dwAct, t2 }, { ActivationFunctionType_NONE, t3 } };
+    memcpy(graph.pairs, pairs, sizeof(pairs));
+}
+
+// Every combination of the first two convolutions' own activations, with the
+// graph FuseActivations() folds and the same graph with every pair kept
+// apart, on that many random inputs each. Fails on the first output that
+// isn't bit exact, or when a pair without an activation of its own isn't
+// folded, or a folded intermediate still has arena space.
+static bool addFusionJson(JsonObject obj, int inputs) {
+    tflite::MicroMutableOpResolver<4> resolver;
+    resolver.AddConv2D();
+    resolver.AddRelu();
+    resolver.AddDepthwiseConv2D();
+    resolver.AddRelu6();
+    alignas(16) static uint8_t arenas[2][FUSION_BENCH_ARENA];
+
+    std::vector<uint64_t> invokeNs[2];
+    size_t arenaBytes[2] = { 0, 0 };
+    int graphCount = 0, folded = 0;
+    for (tflite::ActivationFunctionType convAct : fusionBenchActivations) {
+        for (tflite::ActivationFunctionType dwAct : fusionBenchActivations) {
+            // [0] folded where it can be, [1] every pair kept apart
+            FusionGraph graphs[2];
+            std::unique_ptr<tflite::MicroInterpreter> interpreters[2];
+            for (int k = 0; k < 2; k++) {
+                makeFusionGraph(graphCount, convAct, dwAct, k == 1, graphs[k]);
+                interpreters[k].reset(new tflite::MicroInterpreter(tflite::GetModel(graphs[k].model.data()), resolver,
+                                                                   arenas[k], FUSION_BENCH_ARENA));
+                if (interpreters[k]->AllocateTensors(true) != kTfLiteOk) {
+                    fprintf(stderr, "ERROR: Activation fusion: AllocateTensors() failed\n");
+                    return false;
+                }
+                arenaBytes[k] = std::max(arenaBytes[k], interpreters[k]->arena_used_bytes());
+            }
+            const char* convName = tflite::EnumNameActivationFunctionType(convAct);
+            const char* dwName = tflite::EnumNameActivationFunctionType(dwAct);
+
+            // A folded pair's intermediate is neither written nor read, so
+            // the planner leaves it out
+            for (const int* pair : graphs[0].pairs) {
+                bool inArena = interpreters[0]->eval_tensor(pair[1])->data.data != nullptr;
+#if EI_CLASSIFIER_TFLITE_FUSE_ACTIVATIONS == 1
+                if (pair[0] == tflite::ActivationFunctionType_NONE && inArena) {
+                    fprintf(stderr, "ERROR: Activation fusion: tensor %d kept arena space (conv %s, depthwise %s)\n",
+                            pair[1], convName, dwName);
+                    return false;
+                }
+#endif
+                if (!inArena) folded++;
+            }
+
+            std::mt19937 rng(graphCount);
+            for (int i = 0; i < inputs; i++) {
+                TfLiteTensor* input = interpreters[0]->input(0);
+                for (size_t b = 0; b < input->bytes; b++) input->data.int8[b] = (int8_t)rng();
+                memcpy(interpreters[1]->input(0)->data.int8, input->data.int8, input->bytes);
+                for (int k = 0; k < 2; k++) {
+                    auto start = std::chrono::steady_clock::now();
+                    if (interpreters[k]->Invoke() != kTfLiteOk) {
+                        fprintf(stderr, "ERROR: Activation fusion: Invoke() failed\n");
+                        return false;
+                    }
+                    invokeNs[k].push_back(elapsedNs(start));
+                }
+                TfLiteTensor* fused = interpreters[0]->output(0);
+                TfLiteTensor* apart = interpreters[1]->output(0);
+                if (fused->bytes != apart->bytes || memcmp(fused->data.int8, apart->data.int8, fused->bytes) != 0) {
+                    fprintf(stderr, "ERROR: Activation fusion: outputs differ (conv %s, depthwise %s, input %d)\n",
+                            convName, dwName, i);
+                    return false;
+                }
+            }
+            graphCount++;
+        }
+    }
+
+    obj["graphs"] = graphCount;
+    obj["inputs"] = inputs;
+    obj["pairs"] = graphCount * 3;
+    obj["folded_pairs"] = folded;
+    const char* names[2] = { "fused", "unfused" };
+    for (int k = 0; k < 2; k++) {
+        std::sort(invokeNs[k].begin(), invokeNs[k].end());
+        JsonObject json = obj[names[k]].to<JsonObject>();
+        json["p50_ns"] = percentile(invokeNs[k], 50);
+        json["p99_ns"] = percentile(invokeNs[k], 99);
+        json["max_ns"] = invokeNs[k].back();
+        json["arena_bytes"] = arenaBytes[k];
+    }
+    uint64_t fusedP50 = obj["fused"]["p50_ns"];
+    obj["speedup_p50"] = fusedP50 > 0 ? (double)obj["unfused"]["p50_ns"].as<uint64_t>() / fusedP50 : 0.0;
+    return true;
+}
+
+// --- Runtime Model ---
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+#define MODEL_BENCH_CHUNK   4096    // the buffer of the download task
+
+struct ModelRun {
+    std::vector<float> values;      // boxes or scores, the boxes buffer is reused by the next run
+    const uint8_t* model;           // flatbuffer the interpreter was built from
+    uint64_t classificationUs;
+};
+
+// Classifies the last frame of the run, still in inputImage
+static bool runModel(ModelRun& run) {
+    signal_t signal;
+    signal.total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
+    signal.get_data = &getInputData;
+    ei_impulse_result_t result;
+    if (run_classifier(&signal, &result, false) != EI_IMPULSE_OK) return false;
+
+    run.values.clear();
+#if EI_CLASSIFIER_OBJECT_DETECTION == 1
+    for (uint32_t i = 0; i < result.bounding_boxes_count; i++) {
+        const ei_impulse_result_bounding_box_t& box = result.bounding_boxes[i];
+        run.values.insert(run.values.end(), { (float)box.x, (float)box.y, (float)box.width, (float)box.height, box.value });
+    }
+#else
+    for (int i = 0; i < EI_CLASSIFIER_LABEL_COUNT; i++) {
+        run.values.push_back(result.classification[i].value);
+    }
+#endif
+    run.model = ei_tflite_get_arena_report()->model;
+    run.classificationUs = result.timing.classification_us;
+    return true;
+}
+
+// Streams a model in the way the upload handler and the download task do
+static bool writeModel(const uint8_t* model, size_t size, const char* name) {
+    if (!modelLoader.claimWrite()) return false;
+    if (!modelLoader.beginWrite()) {
+        modelLoader.abortWrite();
+        return false;
+    }
+    for (size_t offset = 0; offset < size; offset += MODEL_BENCH_CHUNK) {
+        if (!modelLoader.write(model + offset, std::min((size_t)MODEL_BENCH_CHUNK, size - offset))) {
+            modelLoader.abortWrite();
+            return false;
+        }
+    }
+    return modelLoader.endWrite(name, 0);
+}
+
+static bool modelCheck(bool ok, const char* what) {
+    if (!ok) fprintf(stderr, "ERROR: Runtime model: %s (%s)\n", what, modelLoader.lastError());
+    return ok;
+}
+
+static bool runtimeModelChecks(JsonObject obj, const ei_config_tflite_graph_t* compiled, const std::string& path, int updates) {
+    std::string tmpPath = path + ".tmp";
+    ModelRun expected, run;
+    if (!modelCheck(runModel(expected) && expected.model == compiled->model, "the compiled model didn't run")) return false;
+
+    if (!modelCheck(!modelLoader.begin(path.c_str()), "an empty store loaded a model") ||
+        !modelCheck(!modelLoader.beginWrite(), "a write started without the claim")) return false;
+
+    // A complete upload: mapped, CRC recorded, and the next inference runs it
+    if (!modelCheck(writeModel(compiled->model, compiled->model_size, "bench"), "upload failed") ||
+        !modelCheck(modelLoader.isLoaded() && !modelLoader.isWriting(), "upload didn't load the model") ||
+        !modelCheck(modelLoader.size() == compiled->model_size &&
+                    modelLoader.crc() == modelCrc32(0, compiled->model, compiled->model_size), "wrong size or CRC") ||
+        !modelCheck(runModel(run) && run.model == modelLoader.data(), "inference didn't use the mapped model") ||
+        !modelCheck(run.values == expected.values, "mapped model gave different results")) return false;
+
+    // A second writer is turned away, and while an update is claimed the
+    // compiled model runs. The client going away aborts the write and the
+    // current model stays.
+    if (!modelCheck(modelLoader.claimWrite(), "claim failed") ||
+        !modelCheck(!modelLoader.claimWrite(), "a second writer got the claim") ||
+        !modelCheck(runModel(run) && run.model == compiled->model, "mapped model used during an update") ||
+        !modelCheck(modelLoader.beginWrite() && modelLoader.write(compiled->model, compiled->model_size / 2), "partial write failed")) return false;
+    modelLoader.abortWrite();
+    if (!modelCheck(!modelLoader.isWriting() && access(tmpPath.c_str(), F_OK) != 0, "abort left the write behind") ||
+        !modelCheck(runModel(run) && run.model == modelLoader.data(), "model lost after an aborted upload")) return false;
+
+    // Right CRC, broken flatbuffer: the verifier turns it down and the
+    // compiled model runs instead
+    std::vector<uint8_t> broken(compiled->model, compiled->model + compiled->model_size);
+    memset(broken.data(), 0xFF, 4);     // root table offset past the end
+    if (!modelCheck(writeModel(broken.data(), broken.size(), "broken"), "upload of the broken model failed") ||
+        !modelCheck(runModel(run) && run.model == compiled->model && run.values == expected.values,
+                    "broken model wasn't rejected")) return false;
+
+    // Flash (here the file) going bad under a stored model
+    if (!modelCheck(writeModel(compiled->model, compiled->model_size, "bench"), "upload failed")) return false;
+    FILE* file = fopen(path.c_str(), "r+b");
+    bool flipped = file && fseek(file, -1, SEEK_END) == 0 && fputc(0x5A ^ compiled->model[compiled->model_size - 1], file) != EOF;
+    if (file) fclose(file);
+    if (!modelCheck(flipped && !modelLoader.reload(), "corrupt model was mapped") ||
+        !modelCheck(runModel(run) && run.model == compiled->model, "compiled model didn't take over")) return false;
+
+    // Update cost: streaming and committing the model, the first inference
+    // after it (verification included) and the one after that
+    std::vector<uint64_t> updateUs, firstUs, nextUs;
+    for (int i = 0; i < updates; i++) {
+        uint64_t startUs = ei_read_timer_us();
+        if (!modelCheck(writeModel(compiled->model, compiled->model_size, "bench"), "upload failed")) return false;
+        updateUs.push_back(ei_read_timer_us() - startUs);
+        if (!modelCheck(runModel(run) && run.model == modelLoader.data() && run.values == expected.values,
+                        "updated model gave different results")) return false;
+        firstUs.push_back(run.classificationUs);
+        if (!modelCheck(runModel(run), "inference failed")) return false;
+        nextUs.push_back(run.classificationUs);
+    }
+
+    obj["model_bytes"] = compiled->model_size;
+    obj["updates"] = updates;
+    addStageJson(obj["update"].to<JsonObject>(), updateUs);
+    addStageJson(obj["first_inference"].to<JsonObject>(), firstUs);
+    addStageJson(obj["inference"].to<JsonObject>(), nextUs);
+    return true;
+}
+
+// The model loader's posix backend in a temporary directory, with the
+// interpreter built from what it maps. Fails on the first check that doesn't
+// hold.
+static bool addRuntimeModelJson(JsonObject obj, int updates) {
+    const ei_learning_block_config_tflite_graph_t* block =
+        (const ei_learning_block_config_tflite_graph_t*)ei_default_impulse.impulse->learning_blocks[0].config;
+    const ei_config_tflite_graph_t* compiled = (const ei_config_tflite_graph_t*)block->graph_config;
+
+    char dir[] = "/tmp/bench_model_XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "ERROR: Can't create a temporary directory\n");
+        return false;
+    }
+    std::string path = std::string(dir) + "/model.bin";
+    bool ok = runtimeModelChecks(obj, compiled, path, updates);
+
+    modelLoader.abortWrite();
+    modelLoader.unload();
+    unlink(path.c_str());
+    unlink((path + ".tmp").c_str());
+    rmdir(dir);
+    return ok;
+}
+#endif
+
+// --- Multi-Impulse Scheduler ---
+
+#if EI_CLASSIFIER_OBJECT_DETECTION == 1
+#define SCHEDULER_BENCH_CROP_SCALE  2.0f    // crop side relative to the box, for some context
+
+// Square crop around a box (impulse input coordinates) from the decoded frame,
+// resized to the impulse input
+static void cropBox(const std::vector<uint8_t>& rgb, int width, int height,
+                    const ei_impulse_result_bounding_box_t& box, std::vector<uint8_t>& out) {
+    float scaleX = (float)width / EI_CLASSIFIER_INPUT_WIDTH;
+    float scaleY = (float)height / EI_CLASSIFIER_INPUT_HEIGHT;
+    float side = std::max(box.width * scaleX, box.height * scaleY) * SCHEDULER_BENCH_CROP_SCALE;
+    int size = std::max(1, std::min((int)side, std::min(width, height)));
+    int cx = (int)((box.x + box.width / 2.0f) * scaleX);
+    int cy = (int)((box.y + box.height / 2.0f) * scaleY);
+    int x0 = std::max(0, std::min(cx - size / 2, width - size));
+    int y0 = std::max(0, std::min(cy - size / 2, height - size));
+
+    std::vector<uint8_t> region(size * size * 3);
+    for (int y = 0; y < size; y++) {
+        memcpy(&region[y * size * 3], &rgb[((y0 + y) * width + x0) * 3], size * 3);
+    }
+    out.resize(EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * 3);
+    ei::image::processing::crop_and_interpolate_rgb888(region.data(), size, size, out.data(),
+                                                       EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT);
+}
+
+static void addSchedulerStatsJson(JsonObject obj, const ei_impulse_scheduler_stats_t* stats) {
+    obj["runs"] = stats->runs;
+    obj["skipped"] = stats->skipped;
+    obj["deadline_misses"] = stats->deadline_misses;
+    obj["batches"] = stats->batches;
+    obj["mean_us"] = stats->runs > 0 ? stats->total_us / stats->runs : 0;
+    obj["min_us"] = stats->min_us;
+    obj["max_us"] = stats->max_us;
+}
+
+// One pass in capture order. Every detection of the frame's counter run
+// queues a crop, the crops run as far as the frame budget allows.
+static bool addSchedulerJson(JsonObject obj, const std::vector<BenchImage>& images, int budgetMs) {
+    static ei_impulse_handle_t cropHandle(ei_default_impulse.impulse);
+    uint32_t budgetUs = (uint32_t)budgetMs * 1000;
+
+    run_classifier_deinit();
+    run_classifier_init();
+    run_classifier_init(&cropHandle);
+
+    EiImpulseScheduler scheduler;
+    int counter = scheduler.add(&ei_default_impulse, EI_IMPULSE_SCHEDULER_PRIORITY_EVERY_FRAME, budgetUs);
+    int crops = scheduler.add(&cropHandle, 1, budgetUs);
+    EI_IMPULSE_ERROR res = scheduler.begin();
+    if (res != EI_IMPULSE_OK) {
+        fprintf(stderr, "ERROR: Scheduler setup failed (%d)\n", res);
+        return false;
+    }
+
+    std::vector<uint8_t> rgb;
+    std::vector<std::vector<uint8_t>> cropImages(EI_CLASSIFIER_SCHEDULER_MAX_JOBS);
+    std::vector<signal_t> cropSignals(EI_CLASSIFIER_SCHEDULER_MAX_JOBS);
+    std::vector<ei_impulse_result_t> cropResults(EI_CLASSIFIER_SCHEDULER_MAX_JOBS);
+    for (size_t i = 0; i < cropSignals.size(); i++) {
+        cropSignals[i].total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
+        cropSignals[i].get_data = [&cropImages, i](size_t offset, size_t length, float* out) {
+            const uint8_t* pixel = cropImages[i].data() + offset * 3;
+            for (size_t p = 0; p < length; p++) {
+                out[p] = (float)((pixel[0] << 16) | (pixel[1] << 8) | pixel[2]);
+                pixel += 3;
+            }
+            return 0;
+        };
+    }
+    signal_t signal;
+    signal.total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
+    signal.get_data = &getInputData;
+
+    uint64_t queued = 0;
+    for (const BenchImage& image : images) {
+        int width, height;
+        if (!benchDecodeJpeg(image.data.data(), image.data.size(), rgb, width, height)) {
+            fprintf(stderr, "ERROR: Can't decode %s (baseline colour JPEG only)\n", image.name.c_str());
+            return false;
+        }
+        ei::image::processing::crop_and_interpolate_rgb888(rgb.data(), width, height, inputImage,
+                                                           EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT);
+
+        // the frame starts once the camera frame is in, like on the hive
+        scheduler.begin_frame(budgetUs);
+        ei_impulse_result_t result;
+        res = scheduler.run(counter, &signal, &result);
+        if (res == EI_IMPULSE_OK) {
+            size_t jobs = 0;
+            for (uint32_t i = 0; i < result.bounding_boxes_count && jobs < cropImages.size(); i++) {
+                if (result.bounding_boxes[i].value <= 0) continue;
+                cropBox(rgb, width, height, result.bounding_boxes[i], cropImages[jobs]);
+                scheduler.queue(crops, &cropSignals[jobs], &cropResults[jobs]);
+                jobs++;
+            }
+            queued += jobs;
+            res = scheduler.run_queued();
+        }
+        if (res != EI_IMPULSE_OK) {
+            fprintf(stderr, "ERROR: Scheduled inference failed (%d) on %s\n", res, image.name.c_str());
+            return false;
+        }
+    }
+
+    const ei_impulse_scheduler_frame_stats_t* frames = scheduler.get_frame_stats();
+    obj["budget_us"] = budgetUs;
+    obj["frames"] = frames->frames;
+    obj["frame_overruns"] = frames->overruns;
+    obj["frame_max_us"] = frames->max_us;
+    obj["crops_queued"] = queued;
+    obj["shared_arena_bytes"] = scheduler.arena_size();
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+    obj["shared_arena_misses"] = ei_tflite_get_shared_arena()->misses;
+#endif
+    addSchedulerStatsJson(obj["counter"].to<JsonObject>(), scheduler.get_stats(counter));
+    addSchedulerStatsJson(obj["crops"].to<JsonObject>(), scheduler.get_stats(crops));
+
+    scheduler.end();
+    run_classifier_deinit(&cropHandle);
+    return true;
+}
+#endif
+
+static void printUsage(const char* program) {
+    fprintf(stderr, "Usage: %s [--warmup N] [--passes N] [--budget FILE] [--output FILE] [--flash-mbs N] "
+                    "[--frame-skip N] [--tracker N] [--fomo N] [--nms-scenes N] [--scheduler MS] "
+                    "[--model-updates N] [--fusion N] IMAGE_DIR\n", program);
+}
+
+int main(int argc, char** argv) {
+    int warmup = 3;
+    int passes = 1;
+    const char* budgetPath = nullptr;
+    const char* outputPath = nullptr;
+    const char* imageDir = nullptr;
+    float flashMBs = 0.0f;
+    int frameSkip = 0;
+    int trackerStreams = 0;
+    int fomoFrames = 0;
+    int nmsScenes = 0;
+    int schedulerMs = 0;
+    int modelUpdates = 0;
+    int fusionInputs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            warmup = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--passes") == 0 && hasValue) {
+            passes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--budget") == 0 && hasValue) {
+            budgetPath = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--flash-mbs") == 0 && hasValue) {
+            flashMBs = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--frame-skip") == 0 && hasValue) {
+            frameSkip = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tracker") == 0 && hasValue) {
+            trackerStreams = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fomo") == 0 && hasValue) {
+            fomoFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--nms-scenes") == 0 && hasValue) {
+            nmsScenes = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scheduler") == 0 && hasValue) {
+            schedulerMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--model-updates") == 0 && hasValue) {
+            modelUpdates = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fusion") == 0 && hasValue) {
+            fusionInputs = atoi(argv[++i]);
+        } else if (argv[i][0] != '-' && !imageDir) {
+            imageDir = argv[i];
+        } else {
+            printUsage(argv[0]);
+            return BENCH_EXIT_ERROR;
+        }
+    }
+    if (!imageDir || warmup < 0 || passes < 1 || flashMBs < 0.0f || frameSkip < 0 || trackerStreams < 0 ||
+            fomoFrames < 0 || nmsScenes < 0 || schedulerMs < 0 || modelUpdates < 0 || fusionInputs < 0) {
+        printUsage(argv[0]);
+        return BENCH_EXIT_ERROR;
+    }
+
+    JsonDocument budget;
+    if (budgetPath) {
+        std::vector<uint8_t> text;
+        if (!readFile(budgetPath, text)) {
+            fprintf(stderr, "ERROR: Can't read budget %s\n", budgetPath);
+            return BENCH_EXIT_ERROR;
+        }
+        DeserializationError err = deserializeJson(budget, (const char*)text.data(), text.size());
+        if (err || !budget.is<JsonObject>()) {
+            fprintf(stderr, "ERROR: Invalid budget %s: %s\n", budgetPath, err ? err.c_str() : "not an object");
+            return BENCH_EXIT_ERROR;
+        }
+    }
+
+#if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED != 1
+    if (frameSkip > 0) {
+        fprintf(stderr, "ERROR: --frame-skip needs an impulse with object tracking\n");
+        return BENCH_EXIT_ERROR;
+    }
+    if (trackerStreams > 0) {
+        fprintf(stderr, "ERROR: --tracker needs an impulse with object tracking\n");
+        return BENCH_EXIT_ERROR;
+    }
+#endif
+#ifndef EI_HAS_FOMO
+    if (fomoFrames > 0) {
+        fprintf(stderr, "ERROR: --fomo needs a FOMO impulse\n");
+        return BENCH_EXIT_ERROR;
+    }
+#endif
+#if EI_CLASSIFIER_OBJECT_DETECTION != 1
+    if (schedulerMs > 0) {
+        fprintf(stderr, "ERROR: --scheduler needs an object detection impulse\n");
+        return BENCH_EXIT_ERROR;
+    }
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_TFLITE) || (EI_CLASSIFIER_COMPILED == 1)
+    if (modelUpdates > 0) {
+        fprintf(stderr, "ERROR: --model-updates needs a TFLite Micro impulse (not EON compiled)\n");
+        return BENCH_EXIT_ERROR;
+    }
+#endif
+
+    std::vector<BenchImage> images;
+    if (!loadImages(imageDir, images)) {
+        return BENCH_EXIT_ERROR;
+    }
+    fprintf(stderr, "INFO: %u images, %d warmup frames, %d passes\n", (unsigned)images.size(), warmup, passes);
+
+    // --- Run ---
+    std::vector<uint64_t> stageUs[STAGE_COUNT];
+    std::vector<uint64_t> frameAllocs;
+    std::vector<uint64_t> frameBytes;
+    uint64_t detections = 0;
+    std::vector<uint8_t> rgb;
+    signal_t signal;
+    signal.total_length = EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT;
+    signal.get_data = &getInputData;
+
+    // Post-processing blocks (tracking, counting) keep their state in here
+    run_classifier_init();
+
+    // Peak heap covers the pipeline, not the images the harness holds
+    size_t heapBase = benchAllocStats().live;
+    benchAllocResetPeak();
+
+    int frames = warmup + passes * (int)images.size();
+    for (int frame = 0; frame < frames; frame++) {
+        const BenchImage& image = images[frame % images.size()];
+        BenchAllocStats before = benchAllocStats();
+        uint64_t startUs = ei_read_timer_us();
+
+        int width, height;
+        if (!benchDecodeJpeg(image.data.data(), image.data.size(), rgb, width, height)) {
+            fprintf(stderr, "ERROR: Can't decode %s (baseline colour JPEG only)\n", image.name.c_str());
+            return BENCH_EXIT_ERROR;
+        }
+        uint64_t decodedUs = ei_read_timer_us();
+
+        ei::image::processing::crop_and_interpolate_rgb888(rgb.data(), width, height, inputImage,
+                                                           EI_CLASSIFIER_INPUT_WIDTH, EI_CLASSIFIER_INPUT_HEIGHT);
+        uint64_t resizedUs = ei_read_timer_us();
+
+        ei_impulse_result_t result;
+        EI_IMPULSE_ERROR res = run_classifier(&signal, &result, false);
+        uint64_t endUs = ei_read_timer_us();
+        if (res != EI_IMPULSE_OK) {
+            fprintf(stderr, "ERROR: run_classifier failed (%d) on %s\n", res, image.name.c_str());
+            return BENCH_EXIT_ERROR;
+        }
+        BenchAllocStats after = benchAllocStats();
+
+        if (frame < warmup) continue;
+
+        stageUs[STAGE_DECODE].push_back(decodedUs - startUs);
+        stageUs[STAGE_RESIZE].push_back(resizedUs - decodedUs);
+        stageUs[STAGE_DSP].push_back(result.timing.dsp_us);
+        stageUs[STAGE_CLASSIFICATION].push_back(result.timing.classification_us);
+        stageUs[STAGE_POSTPROCESSING].push_back(result.timing.postprocessing_us);
+        stageUs[STAGE_TOTAL].push_back(endUs - startUs);
+        frameAllocs.push_back(after.allocs - before.allocs);
+        frameBytes.push_back(after.bytes - before.bytes);
+
+#if EI_CLASSIFIER_OBJECT_DETECTION == 1
+        for (uint32_t i = 0; i < result.bounding_boxes_count; i++) {
+            if (result.bounding_boxes[i].value > 0) detections++;
+        }
+#endif
+    }
+
+    // --- Report ---
+    JsonDocument report;
+    JsonObject model = report["model"].to<JsonObject>();
+    model["project"] = EI_CLASSIFIER_PROJECT_NAME;
+    model["project_id"] = EI_CLASSIFIER_PROJECT_ID;
+    model["deploy_version"] = EI_CLASSIFIER_PROJECT_DEPLOY_VERSION;
+    model["input_width"] = EI_CLASSIFIER_INPUT_WIDTH;
+    model["input_height"] = EI_CLASSIFIER_INPUT_HEIGHT;
+#if EI_CLASSIFIER_TFLITE_ENABLE_ESP_NN == 1
+    model["esp_nn"] = true;
+#else
+    model["esp_nn"] = false;
+#endif
+    report["images"] = images.size();
+    report["warmup"] = warmup;
+    report["frames"] = frameAllocs.size();
+    report["detections"] = detections;
+
+    JsonObject stages = report["stages"].to<JsonObject>();
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        addStageJson(stages[stageNames[stage]].to<JsonObject>(), stageUs[stage]);
+    }
+
+    JsonObject memory = report["memory"].to<JsonObject>();
+    std::sort(frameAllocs.begin(), frameAllocs.end());
+    std::sort(frameBytes.begin(), frameBytes.end());
+    uint64_t allocSum = 0, byteSum = 0;
+    for (size_t i = 0; i < frameAllocs.size(); i++) {
+        allocSum += frameAllocs[i];
+        byteSum += frameBytes[i];
+    }
+    memory["allocs_per_frame_mean"] = (double)allocSum / frameAllocs.size();
+    memory["allocs_per_frame_max"] = frameAllocs.back();
+    memory["alloc_bytes_per_frame_mean"] = byteSum / frameBytes.size();
+    memory["alloc_bytes_per_frame_max"] = frameBytes.back();
+    memory["peak_heap_bytes"] = benchAllocStats().peak - heapBase;
+
+#if defined(EI_CLASSIFIER_TFLITE_MEMORY_PLAN_CACHE) && (EI_CLASSIFIER_TFLITE_MEMORY_PLAN_CACHE == 1)
+    // AllocateTensors() with the greedy planner (first frame) vs the recorded plan
+    const ei_tflite_memory_plan_report_t* plan = ei_tflite_get_memory_plan_report();
+    JsonObject init = report["model_init"].to<JsonObject>();
+    init["planned_allocate_us"] = plan->planned_allocate_us;
+    init["cached_allocate_us"] = plan->cached_allocate_us;
+    init["saved_us"] = (int64_t)plan->planned_allocate_us - (int64_t)plan->cached_allocate_us;
+    init["plan_buffers"] = plan->buffer_count;
+    init["plan_hits"] = plan->hits;
+    init["plan_misses"] = plan->misses;
+#endif
+
+#if defined(EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH) && (EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1)
+    // Filters staged through internal RAM on the last frame. The host copies
+    // synchronously, --flash-mbs predicts what a copy task hides on the device.
+    const ei_tflite_prefetch_report_t* prefetch = ei_tflite_get_weight_prefetch_report();
+    JsonObject prefetchJson = report["weight_prefetch"].to<JsonObject>();
+    prefetchJson["staging_size"] = prefetch->staging_size;
+    prefetchJson["layers"] = prefetch->layers;
+    prefetchJson["prefetched_layers"] = prefetch->prefetched;
+    prefetchJson["copied_bytes"] = prefetch->copied_bytes;
+    prefetchJson["stall_us"] = prefetch->stall_us;
+    if (flashMBs > 0.0f) {
+        // 1 MB/s is one byte per microsecond
+        static uint32_t layerStallUs[EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH_MAX_LAYERS];
+        ei_tflite_prefetch_simulation_t sim = ei_tflite_weight_prefetch_simulate(prefetch, flashMBs, layerStallUs);
+        JsonObject simJson = prefetchJson["simulated"].to<JsonObject>();
+        simJson["flash_mbs"] = flashMBs;
+        simJson["serial_copy_us"] = sim.serial_copy_us;
+        simJson["stall_us"] = sim.stall_us;
+        simJson["hidden_us"] = sim.serial_copy_us - sim.stall_us;
+        JsonArray layers = simJson["layers"].to<JsonArray>();
+        for (uint32_t i = 0; i < prefetch->layers; i++) {
+            if (prefetch->layer[i].bytes == 0) continue;
+            JsonObject layer = layers.add<JsonObject>();
+            layer["index"] = i;
+            layer["op"] = prefetch->layer[i].op;
+            layer["bytes"] = prefetch->layer[i].bytes;
+            layer["op_us"] = prefetch->layer[i].op_us;
+            layer["stall_us"] = layerStallUs[i];
+        }
+    }
+#else
+    (void)flashMBs;
+#endif
+
+#if (EI_CLASSIFIER_OBJECT_COUNTING_ENABLED == 1) && (EI_CLASSIFIER_OBJECT_COUNTING_CONSENSUS == 1)
+    // Traces held back from the counter until they had enough detections
+    ei_object_counting_consensus_stats_t consensusStats;
+    if (get_object_counting_consensus_stats(&consensusStats) == EI_IMPULSE_OK) {
+        JsonObject consensus = report["consensus"].to<JsonObject>();
+        consensus["confirmed_traces"] = consensusStats.confirmed_traces;
+        consensus["rejected_traces"] = consensusStats.rejected_traces;
+        consensus["suppressed_crossings"] = consensusStats.suppressed_crossings;
+    }
+#endif
+
+#if EI_CLASSIFIER_OBJECT_TRACKING_ENABLED == 1
+    if (frameSkip > 0 && !addFrameSkipJson(report["frame_skip"].to<JsonObject>(), images, frameSkip)) {
+        return BENCH_EXIT_ERROR;
+    }
+    if (trackerStreams > 0 && !addTrackerJson(report["tracker"].to<JsonObject>(), trackerStreams)) {
+        return BENCH_EXIT_ERROR;
+    }
+#endif
+
+#ifdef EI_HAS_FOMO
+    if (fomoFrames > 0 && !addFomoJson(report["fomo"].to<JsonObject>(), fomoFrames)) {
+        return BENCH_EXIT_ERROR;
+    }
+#endif
+
+    if (nmsScenes > 0 && !addNmsJson(report["nms"].to<JsonObject>(), nmsScenes)) {
+        return BENCH_EXIT_ERROR;
+    }
+
+#if EI_CLASSIFIER_OBJECT_DETECTION == 1
+    if (schedulerMs > 0 && !addSchedulerJson(report["scheduler"].to<JsonObject>(), images, schedulerMs)) {
+        return BENCH_EXIT_ERROR;
+    }
+#endif
+
+    if (fusionInputs > 0 && !addFusionJson(report["fusion"].to<JsonObject>(), fusionInputs)) {
+        return BENCH_EXIT_ERROR;
+    }
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED != 1)
+    if (modelUpdates > 0 && !addRuntimeModelJson(report["runtime_model"].to<JsonObject>(), modelUpdates)) {
+        return BENCH_EXIT_ERROR;
+    }
+#endif
+
+    int exitCode = BENCH_EXIT_OK;
+    if (budgetPath) {
+        JsonObject budgetResult = report["budget"].to<JsonObject>();
+        budgetResult["file"] = budgetPath;
+        JsonArray violations = budgetResult["violations"].to<JsonArray>();
+        checkBudget(budget.as<JsonObjectConst>(), report.as<JsonObjectConst>(), "", violations);
+        budgetResult["passed"] = violations.size() == 0;
+        for (JsonObject violation : violations) {
+            fprintf(stderr, "ERROR: Budget exceeded: %s\n", violation["metric"].as<const char*>());
+        }
+        if (violations.size() > 0) exitCode = BENCH_EXIT_BUDGET;
+    }
+
+    std::string json;
+    serializeJsonPretty(report, json);
+    if (outputPath) {
+        FILE* file = fopen(outputPath, "w");
+        if (!file || fwrite(json.data(), 1, json.size(), file) != json.size()) {
+            fprintf(stderr, "ERROR: Can't write %s\n", outputPath);
+            if (file) fclose(file);
+            return BENCH_EXIT_ERROR;
+        }
+        fclose(file);
+    } else {
+        printf("%s\n", json.c_str());
+    }
+    return exitCode;
+}
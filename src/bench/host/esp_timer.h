@@ -0,0 +1,15 @@
+#ifndef BENCH_HOST_ESP_TIMER_H
+#define BENCH_HOST_ESP_TIMER_H
+
+// The ESP-NN branches of the TFLite Micro kernels include <esp_timer.h> to
+// time themselves. This stands in for it on the host benchmark build.
+#include <stdint.h>
+#include <time.h>
+
+static inline int64_t esp_timer_get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif // BENCH_HOST_ESP_TIMER_H
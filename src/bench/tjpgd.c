@@ -0,0 +1,5 @@
+// Builds the software JPEG decoder the camera driver ships with
+// (lib/esp32-camera/target), so frames are decoded on the host the way the
+// ROM decoder decodes them on the ESP32. The esp32-camera library itself only
+// builds for ESP-IDF.
+#include "../../lib/esp32-camera/target/tjpgd.c"
@@ -0,0 +1,254 @@
+#include "device_config.h"
+#include <Arduino.h>
+#include <string.h>
+#include <stddef.h>
+#include <Preferences.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+DeviceConfig deviceConfig;
+
+static Preferences nvs;
+static portMUX_TYPE configLock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t commitLock = nullptr;
+
+// --- Key Table ---
+enum ConfigType : uint8_t { TYPE_STRING, TYPE_BOOL, TYPE_INT, TYPE_ULONG };
+
+struct ConfigField {
+    const char* nvsKey;
+    ConfigType type;
+    size_t offset;
+    size_t size;
+    const char* defaultText;
+    int32_t defaultValue;
+    bool storeDefault;      // written at boot when missing, as setup() always did
+};
+
+#define FIELD(member) offsetof(DeviceSettings, member), sizeof(((DeviceSettings*)nullptr)->member)
+
+static const ConfigField fields[CONFIG_KEY_COUNT] = {
+    {"deviceName",    TYPE_STRING, FIELD(deviceName),    "BeeCounter",             0,  true},
+    {"ssid",          TYPE_STRING, FIELD(ssid),          "",                       0,  false},
+    {"password",      TYPE_STRING, FIELD(password),      "",                       0,  false},
+    {"adminPass",     TYPE_STRING, FIELD(adminPass),     "",                       0,  true},
+    {"isDefaultPass", TYPE_BOOL,   FIELD(isDefaultPass), nullptr,                  1,  true},
+    {"timezone",      TYPE_STRING, FIELD(timezone),      "EST5EDT,M3.2.0,M11.1.0", 0,  true},
+    {"eiApiKey",      TYPE_STRING, FIELD(eiApiKey),      "",                       0,  false},
+    {"cam_res",       TYPE_STRING, FIELD(camResolution), "SVGA",                   0,  false},
+    {"cam_qlty",      TYPE_INT,    FIELD(camQuality),    nullptr,                  12, false},
+    {"loginFails",    TYPE_INT,    FIELD(loginFails),    nullptr,                  0,  true},
+    {"lastFailTime",  TYPE_ULONG,  FIELD(lastFailTime),  nullptr,                  0,  true},
+    {"histSnapshot",  TYPE_BOOL,   FIELD(historySnapshot), nullptr,                0,  false},
+};
+
+static void* fieldPtr(DeviceSettings& values, ConfigKey key) {
+    return (uint8_t*)&values + fields[key].offset;
+}
+
+static const void* fieldPtr(const DeviceSettings& values, ConfigKey key) {
+    return (const uint8_t*)&values + fields[key].offset;
+}
+
+static void setDefault(DeviceSettings& values, ConfigKey key) {
+    const ConfigField& field = fields[key];
+    void* dst = fieldPtr(values, key);
+    switch (field.type) {
+        case TYPE_STRING: strlcpy((char*)dst, field.defaultText, field.size); break;
+        case TYPE_BOOL:   *(bool*)dst = field.defaultValue != 0; break;
+        case TYPE_INT:    *(int32_t*)dst = field.defaultValue; break;
+        case TYPE_ULONG:  *(uint32_t*)dst = (uint32_t)field.defaultValue; break;
+    }
+}
+
+// Needs an open nvs
+static void readField(DeviceSettings& values, ConfigKey key) {
+    const ConfigField& field = fields[key];
+    void* dst = fieldPtr(values, key);
+    switch (field.type) {
+        case TYPE_STRING:
+            if (nvs.getString(field.nvsKey, (char*)dst, field.size) == 0) {
+                // Missing, or longer than the field
+                strlcpy((char*)dst, field.defaultText, field.size);
+            }
+            break;
+        case TYPE_BOOL:  *(bool*)dst = nvs.getBool(field.nvsKey, field.defaultValue != 0); break;
+        case TYPE_INT:   *(int32_t*)dst = nvs.getInt(field.nvsKey, field.defaultValue); break;
+        case TYPE_ULONG: *(uint32_t*)dst = nvs.getULong(field.nvsKey, (uint32_t)field.defaultValue); break;
+    }
+}
+
+static void writeField(const DeviceSettings& values, ConfigKey key) {
+    const ConfigField& field = fields[key];
+    const void* src = fieldPtr(values, key);
+    switch (field.type) {
+        case TYPE_STRING: nvs.putString(field.nvsKey, (const char*)src); break;
+        case TYPE_BOOL:   nvs.putBool(field.nvsKey, *(const bool*)src); break;
+        case TYPE_INT:    nvs.putInt(field.nvsKey, *(const int32_t*)src); break;
+        case TYPE_ULONG:  nvs.putULong(field.nvsKey, *(const uint32_t*)src); break;
+    }
+}
+
+static bool fieldEqual(const DeviceSettings& a, const DeviceSettings& b, ConfigKey key) {
+    if (fields[key].type == TYPE_STRING) {
+        return strcmp((const char*)fieldPtr(a, key), (const char*)fieldPtr(b, key)) == 0;
+    }
+    return memcmp(fieldPtr(a, key), fieldPtr(b, key), fields[key].size) == 0;
+}
+
+// --- Batch ---
+DeviceConfig::Batch::Batch(DeviceConfig& owner)
+    : config(owner), values(owner.get()), dirty(0), invalid(false)
+{
+}
+
+bool DeviceConfig::Batch::setString(ConfigKey key, const char* value) {
+    if (key >= CONFIG_KEY_COUNT || fields[key].type != TYPE_STRING || strlen(value) >= fields[key].size) {
+        invalid = true;
+        return false;
+    }
+    strcpy((char*)fieldPtr(values, key), value);
+    dirty |= CONFIG_BIT(key);
+    return true;
+}
+
+bool DeviceConfig::Batch::setBool(ConfigKey key, bool value) {
+    if (key >= CONFIG_KEY_COUNT || fields[key].type != TYPE_BOOL) {
+        invalid = true;
+        return false;
+    }
+    *(bool*)fieldPtr(values, key) = value;
+    dirty |= CONFIG_BIT(key);
+    return true;
+}
+
+bool DeviceConfig::Batch::setInt(ConfigKey key, int32_t value) {
+    if (key >= CONFIG_KEY_COUNT || fields[key].type != TYPE_INT) {
+        invalid = true;
+        return false;
+    }
+    *(int32_t*)fieldPtr(values, key) = value;
+    dirty |= CONFIG_BIT(key);
+    return true;
+}
+
+bool DeviceConfig::Batch::setULong(ConfigKey key, uint32_t value) {
+    if (key >= CONFIG_KEY_COUNT || fields[key].type != TYPE_ULONG) {
+        invalid = true;
+        return false;
+    }
+    *(uint32_t*)fieldPtr(values, key) = value;
+    dirty |= CONFIG_BIT(key);
+    return true;
+}
+
+bool DeviceConfig::Batch::commit() {
+    if (invalid) return false;
+    if (dirty == 0) return true;
+
+    xSemaphoreTake(commitLock, portMAX_DELAY);
+    // Compare with what is stored now, another batch may have committed since
+    // this one was started
+    DeviceSettings stored = config.get();
+    uint32_t changed = 0;
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if ((dirty & CONFIG_BIT(key)) && !fieldEqual(values, stored, (ConfigKey)key)) {
+            changed |= CONFIG_BIT(key);
+        }
+    }
+    if (changed != 0) {
+        nvs.begin(DEVICE_CONFIG_NAMESPACE, false);
+        for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+            if (changed & CONFIG_BIT(key)) writeField(values, (ConfigKey)key);
+        }
+        nvs.end();
+        config.apply(values, changed);
+    }
+    xSemaphoreGive(commitLock);
+
+    if (changed != 0) config.notify(changed);
+    dirty = 0;
+    return true;
+}
+
+// --- DeviceConfig ---
+DeviceConfig::DeviceConfig() : listenerCount(0) {
+    memset(&current, 0, sizeof(current));
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+        setDefault(current, (ConfigKey)key);
+    }
+}
+
+void DeviceConfig::begin() {
+    if (commitLock == nullptr) commitLock = xSemaphoreCreateMutex();
+
+    DeviceSettings loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    nvs.begin(DEVICE_CONFIG_NAMESPACE, false);
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+        const ConfigField& field = fields[key];
+        if (nvs.isKey(field.nvsKey)) {
+            readField(loaded, (ConfigKey)key);
+        } else {
+            setDefault(loaded, (ConfigKey)key);
+            if (field.storeDefault) {
+                writeField(loaded, (ConfigKey)key);
+                Serial.printf("Set default %s\n", field.nvsKey);
+            }
+        }
+    }
+    nvs.end();
+
+    portENTER_CRITICAL(&configLock);
+    loaded.version = current.version + 1;
+    current = loaded;
+    portEXIT_CRITICAL(&configLock);
+}
+
+DeviceSettings DeviceConfig::get() const {
+    DeviceSettings copy;
+    portENTER_CRITICAL(&configLock);
+    copy = current;
+    portEXIT_CRITICAL(&configLock);
+    return copy;
+}
+
+uint32_t DeviceConfig::version() const {
+    return current.version;
+}
+
+void DeviceConfig::apply(const DeviceSettings& values, uint32_t changed) {
+    portENTER_CRITICAL(&configLock);
+    for (int key = 0; key < CONFIG_KEY_COUNT; key++) {
+        if (changed & CONFIG_BIT(key)) {
+            memcpy(fieldPtr(current, (ConfigKey)key), fieldPtr(values, (ConfigKey)key), fields[key].size);
+        }
+    }
+    current.version++;
+    portEXIT_CRITICAL(&configLock);
+}
+
+void DeviceConfig::reset() {
+    xSemaphoreTake(commitLock, portMAX_DELAY);
+    nvs.begin(DEVICE_CONFIG_NAMESPACE, false);
+    nvs.clear();
+    nvs.end();
+    xSemaphoreGive(commitLock);
+    // Writes the defaults back like a first boot
+    begin();
+    notify(CONFIG_BIT(CONFIG_KEY_COUNT) - 1);
+}
+
+bool DeviceConfig::onChange(uint32_t keys, ConfigListener listener) {
+    if (listenerCount == DEVICE_CONFIG_MAX_LISTENERS) return false;
+    listeners[listenerCount].keys = keys;
+    listeners[listenerCount].listener = listener;
+    listenerCount++;
+    return true;
+}
+
+void DeviceConfig::notify(uint32_t changed) {
+    for (size_t i = 0; i < listenerCount; i++) {
+        if (listeners[i].keys & changed) listeners[i].listener(changed & listeners[i].keys);
+    }
+}
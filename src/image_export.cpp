@@ -0,0 +1,248 @@
+#include "image_export.h"
+#include <string.h>
+#include <stdio.h>
+#include <memory>
+#include <LittleFS.h>
+#include "stored_images.h"
+
+#define TAR_END_SIZE    (2 * TAR_BLOCK_SIZE)
+
+// --- Tar ---
+bool tarHeader(uint8_t* block, const char* name, uint32_t size, uint32_t mtime, char type) {
+    if (strlen(name) >= 100) return false;
+    memset(block, 0, TAR_BLOCK_SIZE);
+    char* h = (char*)block;
+    strcpy(h, name);                            // name
+    memcpy(h + 100, "0000644", 7);              // mode
+    memcpy(h + 108, "0000000", 7);              // uid
+    memcpy(h + 116, "0000000", 7);              // gid
+    snprintf(h + 124, 12, "%011o", (unsigned)size);
+    snprintf(h + 136, 12, "%011o", (unsigned)mtime);
+    h[156] = type;
+    memcpy(h + 257, "ustar", 6);                // magic with its NUL
+    memcpy(h + 263, "00", 2);                   // version
+    strcpy(h + 265, "beecounter");              // uname
+    strcpy(h + 297, "beecounter");              // gname
+
+    // Sum of the header with the checksum field as spaces
+    memset(h + 148, ' ', 8);
+    unsigned sum = 0;
+    for (int i = 0; i < TAR_BLOCK_SIZE; i++) sum += block[i];
+    snprintf(h + 148, 8, "%06o", sum);          // six digits, NUL, and the space left
+    return true;
+}
+
+static bool exportMatches(const ImageExportFilter& filter, const ImageRecord& record) {
+    return record.timestamp >= filter.fromTime && record.timestamp <= filter.toTime &&
+           (filter.label[0] == '\0' || strncmp(record.label, filter.label, IMAGE_LABEL_LEN) == 0);
+}
+
+// Path of an image in the archive
+static void exportName(const ImageRecord& record, char* out, size_t outSize) {
+    if (record.label[0] != '\0') {
+        snprintf(out, outSize, "%.*s/%.*s", IMAGE_LABEL_LEN, record.label, IMAGE_NAME_LEN, record.name);
+    } else {
+        snprintf(out, outSize, "%.*s", IMAGE_NAME_LEN, record.name);
+    }
+}
+
+// Byte at of the data of a pax header standing in for a deleted image: a
+// single "<length> comment=deleted ...\n" record of length bytes
+static uint8_t deletedRecordByte(size_t length, size_t at) {
+    char prefix[32];
+    int prefixLen = snprintf(prefix, sizeof(prefix), "%u comment=deleted", (unsigned)length);
+    if (at + 1 == length) return '\n';
+    return at < (size_t)prefixLen ? prefix[at] : ' ';
+}
+
+// --- Archive Stream ---
+class ImageArchiveStream {
+public:
+    ImageArchiveStream(const ImageExportFilter& filter, uint32_t endPos, size_t length)
+        : filter(filter), endPos(endPos), length(length), pos(0), liveAt(UINT32_MAX), deletedSize(0),
+          haveEntry(false), entryStart(0), entryEnd(0), entriesDone(false), offset(0) {}
+
+    // Bytes of the archive from offset on. Always fills up to maxLen until the
+    // end of the archive, the response would stall otherwise.
+    size_t read(size_t at, uint8_t* buffer, size_t maxLen) {
+        if (at != offset) seekTo(at);
+        size_t written = 0;
+        while (written < maxLen && offset < length) {
+            size_t n = 0;
+            if (!entriesDone && (!haveEntry || offset >= entryEnd)) {
+                nextEntry();
+                continue;
+            }
+            size_t room = length - offset < maxLen - written ? length - offset : maxLen - written;
+            if (entriesDone) {
+                // End of archive blocks, and zeros for images deleted since the
+                // length was taken
+                n = room;
+                memset(buffer + written, 0, n);
+            } else {
+                n = readEntry(buffer + written, room);
+            }
+            written += n;
+            offset += n;
+        }
+        return written;
+    }
+
+private:
+    // Starts the next matching entry at the current offset
+    void nextEntry() {
+        if (file) file.close();
+        haveEntry = false;
+        uint32_t next;
+        while (pos < endPos && imageIndex.read(pos, &entry, 1, &next, true) == 1) {
+            pos = next;
+            if (next > endPos) break;
+            if (!exportMatches(filter, entry)) continue;
+            char name[IMAGE_LABEL_LEN + IMAGE_NAME_LEN + 12];
+            if (entry.flags & IMAGE_RECORD_DELETED) {
+                // A pax header needs an entry after it, the rest is zeros
+                if (!liveEntryAfter(pos)) break;
+                // Same length as the image had, the data padding becomes part of the record
+                strcpy(name, "PaxHeaders/");
+                exportName(entry, name + 11, sizeof(name) - 11);
+                deletedSize = tarEntrySize(entry.size) - TAR_BLOCK_SIZE;
+                if (!tarHeader(header, name, deletedSize, entry.timestamp, TAR_TYPE_PAX)) continue;
+            } else {
+                exportName(entry, name, sizeof(name));
+                if (!tarHeader(header, name, entry.size, entry.timestamp)) continue;
+            }
+            haveEntry = true;
+            entryStart = offset;
+            entryEnd = offset + tarEntrySize(entry.size);
+            return;
+        }
+        pos = endPos;
+        entriesDone = true;
+    }
+
+    // True if an image of the selection that isn't deleted is at position
+    // from or later
+    bool liveEntryAfter(uint32_t from) {
+        if (liveAt != UINT32_MAX && liveAt >= from) return true;
+        ImageRecord record;
+        uint32_t next;
+        for (uint32_t at = from; at < endPos && imageIndex.read(at, &record, 1, &next, true) == 1; at = next) {
+            if (next > endPos) break;
+            if (!(record.flags & IMAGE_RECORD_DELETED) && exportMatches(filter, record)) {
+                liveAt = at;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t readEntry(uint8_t* buffer, size_t maxLen) {
+        size_t inEntry = offset - entryStart;
+        size_t n;
+        if (inEntry < TAR_BLOCK_SIZE) {
+            n = TAR_BLOCK_SIZE - inEntry < maxLen ? TAR_BLOCK_SIZE - inEntry : maxLen;
+            memcpy(buffer, header + inEntry, n);
+            return n;
+        }
+        size_t inData = inEntry - TAR_BLOCK_SIZE;
+        if (entry.flags & IMAGE_RECORD_DELETED) {
+            n = entryEnd - offset < maxLen ? entryEnd - offset : maxLen;
+            for (size_t i = 0; i < n; i++) buffer[i] = deletedRecordByte(deletedSize, inData + i);
+            return n;
+        }
+        if (inData < entry.size) {
+            n = entry.size - inData < maxLen ? entry.size - inData : maxLen;
+            if (!file) file = LittleFS.open(String(IMAGE_DIR "/") + entry.name, "r");
+            size_t got = 0;
+            if (file && (file.position() == inData || file.seek(inData))) got = file.read(buffer, n);
+            // A file deleted mid export reads as zeros, the length is promised
+            if (got < n) memset(buffer + got, 0, n - got);
+            return n;
+        }
+        n = entryEnd - offset < maxLen ? entryEnd - offset : maxLen;
+        memset(buffer, 0, n);
+        return n;
+    }
+
+    // Walks the index from the start, only the records are read
+    void seekTo(size_t at) {
+        if (file) file.close();
+        pos = 0;
+        haveEntry = false;
+        entriesDone = false;
+        offset = 0;
+        while (true) {
+            nextEntry();
+            if (entriesDone || entryEnd > at) break;
+            offset = entryEnd;
+        }
+        offset = at;
+    }
+
+    ImageExportFilter filter;
+    uint32_t endPos;        // index positions added after the request are left out
+    size_t length;
+    uint32_t pos;
+    uint32_t liveAt;        // position of an image that isn't deleted, UINT32_MAX if none known
+    ImageRecord entry;
+    size_t deletedSize;     // pax record length when entry is deleted
+    uint8_t header[TAR_BLOCK_SIZE];
+    File file;
+    bool haveEntry;
+    size_t entryStart;
+    size_t entryEnd;
+    bool entriesDone;
+    size_t offset;
+};
+
+void sendImageExport(AsyncWebServerRequest* request, const ImageExportFilter& filter) {
+    // Archive length and an ETag of the selection (FNV-1a of names, sizes and
+    // deletes). Deleted images keep their place, see image_export.h.
+    uint32_t endPos = imageIndex.positions();
+    size_t length = TAR_END_SIZE;
+    uint32_t images = 0;
+    uint32_t hash = 2166136261u;
+    ImageRecord record;
+    uint32_t pos = 0, next;
+    while (pos < endPos && imageIndex.read(pos, &record, 1, &next, true) == 1 && next <= endPos) {
+        pos = next;
+        if (!exportMatches(filter, record)) continue;
+        length += tarEntrySize(record.size);
+        if (!(record.flags & IMAGE_RECORD_DELETED)) images++;
+        const uint8_t* bytes = (const uint8_t*)record.name;
+        for (size_t i = 0; i < IMAGE_NAME_LEN && bytes[i] != 0; i++) hash = (hash ^ bytes[i]) * 16777619u;
+        hash = (hash ^ record.size) * 16777619u;
+        hash = (hash ^ record.flags) * 16777619u;
+        hash = (hash ^ pos) * 16777619u;
+    }
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08x-%x\"", (unsigned)hash, (unsigned)images);
+
+    size_t first = 0, last = length - 1;
+    ByteRangeResult range = BYTE_RANGE_NONE;
+    if (request->hasHeader("Range") && (!request->hasHeader("If-Range") || request->header("If-Range") == etag)) {
+        range = parseByteRange(request->header("Range").c_str(), length, &first, &last);
+    }
+    if (range == BYTE_RANGE_UNSATISFIABLE) {
+        AsyncWebServerResponse* response = request->beginResponse(416, "text/plain", "Range Not Satisfiable");
+        response->addHeader("Content-Range", "bytes */" + String(length));
+        request->send(response);
+        return;
+    }
+
+    std::shared_ptr<ImageArchiveStream> stream(new ImageArchiveStream(filter, endPos, length));
+    AsyncWebServerResponse* response = request->beginResponse("application/x-tar", last - first + 1,
+        [stream, first](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            return stream->read(first + index, buffer, maxLen);
+        });
+    if (range == BYTE_RANGE_OK) {
+        response->setCode(206);
+        response->addHeader("Content-Range", "bytes " + String(first) + "-" + String(last) + "/" + String(length));
+    }
+    response->addHeader("Content-Disposition", "attachment; filename=\"beecounter-images.tar\"");
+    response->addHeader("Accept-Ranges", "bytes");
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-store");
+    response->addHeader("X-Image-Count", String(images));
+    request->send(response);
+}
@@ -0,0 +1,371 @@
+#include "image_index.h"
+#include <string.h>
+#include <stdio.h>
+#include <memory>
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_task_wdt.h"
+
+ImageIndex imageIndex;
+
+static SemaphoreHandle_t indexLock = nullptr;
+
+#define IMAGE_INDEX_TMP_PATH  IMAGE_INDEX_PATH ".tmp"
+#define IMAGE_INDEX_BATCH     8
+
+struct ImageIndexHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+};
+
+static size_t recordOffset(uint32_t pos) {
+    return sizeof(ImageIndexHeader) + (size_t)pos * sizeof(ImageRecord);
+}
+
+static bool writeHeader(File& file) {
+    ImageIndexHeader header = { IMAGE_INDEX_MAGIC, IMAGE_INDEX_VERSION, sizeof(ImageRecord) };
+    return file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+}
+
+static void copyText(char* dst, size_t dstSize, const char* src) {
+    strncpy(dst, src != nullptr ? src : "", dstSize - 1);
+    dst[dstSize - 1] = '\0';
+}
+
+// Keeps what a label needs and drops what would have to be escaped
+static void copyLabel(char* dst, const char* src) {
+    size_t len = 0;
+    for (; src != nullptr && *src != '\0' && len < IMAGE_LABEL_LEN - 1; src++) {
+        char c = *src;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '-' || c == '_' || c == '.' || c == ' ') {
+            dst[len++] = c;
+        }
+    }
+    dst[len] = '\0';
+}
+
+bool readJpegSize(File& file, uint16_t* width, uint16_t* height) {
+    *width = 0;
+    *height = 0;
+    uint8_t b[9];
+    if (file.read(b, 2) != 2 || b[0] != 0xFF || b[1] != 0xD8) return false;
+    while (file.position() < 16384 && file.read(b, 4) == 4) {
+        if (b[0] != 0xFF) return false;
+        uint8_t marker = b[1];
+        size_t len = (b[2] << 8) | b[3];
+        if (len < 2) return false;
+        bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (sof) {
+            if (file.read(b, 5) != 5) return false;
+            *height = (b[1] << 8) | b[2];
+            *width = (b[3] << 8) | b[4];
+            return true;
+        }
+        if (!file.seek(file.position() + len - 2)) return false;
+    }
+    return false;
+}
+
+ImageIndex::ImageIndex() : recordCount(0), liveCount(0) {
+}
+
+void ImageIndex::begin() {
+    if (indexLock == nullptr) indexLock = xSemaphoreCreateMutex();
+    xSemaphoreTake(indexLock, portMAX_DELAY);
+
+    bool valid = false;
+    size_t deleted = 0;
+    File file = LittleFS.open(IMAGE_INDEX_PATH, "r");
+    if (file) {
+        ImageIndexHeader header;
+        size_t size = file.size();
+        valid = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+                header.magic == IMAGE_INDEX_MAGIC && header.version == IMAGE_INDEX_VERSION &&
+                header.recordSize == sizeof(ImageRecord) &&
+                (size - sizeof(header)) % sizeof(ImageRecord) == 0;
+        if (valid) {
+            recordCount = (size - sizeof(header)) / sizeof(ImageRecord);
+            liveCount = 0;
+            ImageRecord record;
+            while (file.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+                if (record.flags & IMAGE_RECORD_DELETED) {
+                    deleted++;
+                } else {
+                    liveCount++;
+                }
+            }
+        }
+        file.close();
+    }
+
+    if (!valid) {
+        Serial.println("Image index missing or outdated, rebuilding from " IMAGE_DIR);
+        rebuild();
+    } else if (deleted > liveCount && deleted >= 64) {
+        compact();
+    }
+    Serial.printf("Image index: %u images, %u records\n", (unsigned)liveCount, (unsigned)recordCount);
+    xSemaphoreGive(indexLock);
+}
+
+// Needs the lock. Writes the new index next to the old one, so a reset in
+// between leaves one of them.
+bool ImageIndex::rebuild() {
+    File out = LittleFS.open(IMAGE_INDEX_TMP_PATH, "w");
+    if (!out || !writeHeader(out)) {
+        Serial.println("ERROR: Can't write " IMAGE_INDEX_TMP_PATH);
+        return false;
+    }
+    uint32_t records = 0;
+    File dir = LittleFS.open(IMAGE_DIR);
+    File file = dir ? dir.openNextFile() : File();
+    while (file) {
+        const char* name = file.name();
+        if (!file.isDirectory() && strlen(name) < IMAGE_NAME_LEN) {
+            ImageRecord record;
+            memset(&record, 0, sizeof(record));
+            copyText(record.name, sizeof(record.name), name);
+            record.size = file.size();
+            unsigned long seconds;
+            record.timestamp = sscanf(name, "img-%lu.jpg", &seconds) == 1 ? seconds : (uint32_t)file.getLastWrite();
+            readJpegSize(file, &record.width, &record.height);
+            out.write((const uint8_t*)&record, sizeof(record));
+            records++;
+        }
+        esp_task_wdt_reset(); // opening every image takes a while with thousands of them
+        file = dir.openNextFile();
+    }
+    out.close();
+
+    LittleFS.remove(IMAGE_INDEX_PATH);
+    if (!LittleFS.rename(IMAGE_INDEX_TMP_PATH, IMAGE_INDEX_PATH)) {
+        Serial.println("ERROR: Can't replace " IMAGE_INDEX_PATH);
+        return false;
+    }
+    recordCount = records;
+    liveCount = records;
+    return true;
+}
+
+// Needs the lock. Drops the deleted records, which moves the others, so
+// cursors handed out before are only valid until the next compaction.
+bool ImageIndex::compact() {
+    File in = LittleFS.open(IMAGE_INDEX_PATH, "r");
+    File out = LittleFS.open(IMAGE_INDEX_TMP_PATH, "w");
+    if (!in || !out || !writeHeader(out) || !in.seek(recordOffset(0))) {
+        Serial.println("ERROR: Can't compact " IMAGE_INDEX_PATH);
+        return false;
+    }
+    uint32_t records = 0;
+    ImageRecord record;
+    while (in.read((uint8_t*)&record, sizeof(record)) == sizeof(record)) {
+        if (record.flags & IMAGE_RECORD_DELETED) continue;
+        out.write((const uint8_t*)&record, sizeof(record));
+        records++;
+    }
+    in.close();
+    out.close();
+
+    LittleFS.remove(IMAGE_INDEX_PATH);
+    if (!LittleFS.rename(IMAGE_INDEX_TMP_PATH, IMAGE_INDEX_PATH)) {
+        Serial.println("ERROR: Can't replace " IMAGE_INDEX_PATH);
+        return false;
+    }
+    recordCount = records;
+    liveCount = records;
+    return true;
+}
+
+bool ImageIndex::add(const char* name, uint32_t size, uint32_t timestamp, const char* label, uint16_t width, uint16_t height) {
+    if (strlen(name) >= IMAGE_NAME_LEN) return false;
+    ImageRecord record;
+    memset(&record, 0, sizeof(record));
+    copyText(record.name, sizeof(record.name), name);
+    copyLabel(record.label, label);
+    record.size = size;
+    record.timestamp = timestamp;
+    record.width = width;
+    record.height = height;
+
+    xSemaphoreTake(indexLock, portMAX_DELAY);
+    File file = LittleFS.open(IMAGE_INDEX_PATH, "a");
+    bool ok = file && file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+    file.close();
+    if (ok) {
+        recordCount++;
+        liveCount++;
+    }
+    xSemaphoreGive(indexLock);
+    return ok;
+}
+
+// Needs the lock
+int32_t ImageIndex::findLocked(const char* name, ImageRecord* out) {
+    File file = LittleFS.open(IMAGE_INDEX_PATH, "r");
+    if (!file || !file.seek(recordOffset(0))) return -1;
+    ImageRecord record;
+    for (uint32_t pos = 0; file.read((uint8_t*)&record, sizeof(record)) == sizeof(record); pos++) {
+        if (!(record.flags & IMAGE_RECORD_DELETED) && strncmp(record.name, name, IMAGE_NAME_LEN) == 0) {
+            if (out != nullptr) *out = record;
+            return pos;
+        }
+    }
+    return -1;
+}
+
+int32_t ImageIndex::find(const char* name, ImageRecord* out) {
+    xSemaphoreTake(indexLock, portMAX_DELAY);
+    int32_t pos = findLocked(name, out);
+    xSemaphoreGive(indexLock);
+    return pos;
+}
+
+bool ImageIndex::remove(const char* name) {
+    bool ok = false;
+    ImageRecord record;
+    xSemaphoreTake(indexLock, portMAX_DELAY);
+    int32_t pos = findLocked(name, &record);
+    if (pos >= 0) {
+        record.flags |= IMAGE_RECORD_DELETED;
+        File file = LittleFS.open(IMAGE_INDEX_PATH, "r+");
+        ok = file && file.seek(recordOffset(pos)) &&
+             file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+        file.close();
+        if (ok) liveCount--;
+    }
+    xSemaphoreGive(indexLock);
+    return ok;
+}
+
+size_t ImageIndex::read(uint32_t pos, ImageRecord* out, size_t maxCount, uint32_t* next, bool withDeleted) {
+    size_t count = 0;
+    xSemaphoreTake(indexLock, portMAX_DELAY);
+    if (pos < recordCount) {
+        File file = LittleFS.open(IMAGE_INDEX_PATH, "r");
+        if (file && file.seek(recordOffset(pos))) {
+            while (count < maxCount && pos < recordCount &&
+                   file.read((uint8_t*)&out[count], sizeof(ImageRecord)) == sizeof(ImageRecord)) {
+                pos++;
+                if (withDeleted || !(out[count].flags & IMAGE_RECORD_DELETED)) count++;
+            }
+        }
+        file.close();
+    }
+    xSemaphoreGive(indexLock);
+    *next = pos;
+    return count;
+}
+
+// --- Image List ---
+// Writes the JSON of a page one record at a time into the response buffer,
+// whatever the page size the memory is this object
+class ImageListStream {
+public:
+    ImageListStream(uint32_t cursor, size_t limit)
+        : pos(cursor), remaining(limit), stage(STAGE_HEAD), first(true),
+          batchCount(0), batchIndex(0), lineLen(0), lineOffset(0) {}
+
+    size_t read(uint8_t* buffer, size_t maxLen) {
+        size_t written = 0;
+        while (written < maxLen) {
+            if (lineOffset == lineLen && !nextLine()) break;
+            size_t n = lineLen - lineOffset;
+            if (n > maxLen - written) n = maxLen - written;
+            memcpy(buffer + written, line + lineOffset, n);
+            lineOffset += n;
+            written += n;
+        }
+        return written;
+    }
+
+private:
+    enum Stage { STAGE_HEAD, STAGE_RECORDS, STAGE_TAIL, STAGE_DONE };
+
+    void escape(const char* text, size_t maxLen) {
+        for (size_t i = 0; i < maxLen && text[i] != '\0'; i++) {
+            unsigned char c = text[i];
+            if (c == '"' || c == '\\') {
+                line[lineLen++] = '\\';
+                line[lineLen++] = c;
+            } else if (c < 0x20) {
+                lineLen += snprintf(line + lineLen, sizeof(line) - lineLen, "\\u%04x", c);
+            } else {
+                line[lineLen++] = c;
+            }
+        }
+    }
+
+    // Fills line with the next piece of JSON, false when there is none
+    bool nextLine() {
+        lineLen = 0;
+        lineOffset = 0;
+        switch (stage) {
+        case STAGE_HEAD:
+            lineLen = snprintf(line, sizeof(line), "{\"total\":%u,\"images\":[", (unsigned)imageIndex.count());
+            stage = STAGE_RECORDS;
+            return true;
+        case STAGE_RECORDS:
+            if (remaining > 0 && batchIndex == batchCount) {
+                size_t want = remaining < IMAGE_INDEX_BATCH ? remaining : IMAGE_INDEX_BATCH;
+                batchCount = imageIndex.read(pos, batch, want, &pos);
+                batchIndex = 0;
+                if (batchCount == 0) remaining = 0;
+            }
+            if (remaining == 0) {
+                stage = STAGE_TAIL;
+                return nextLine();
+            } else {
+                const ImageRecord& record = batch[batchIndex++];
+                remaining--;
+                lineLen = snprintf(line, sizeof(line), "%s{\"name\":\"", first ? "" : ",");
+                escape(record.name, IMAGE_NAME_LEN);
+                lineLen += snprintf(line + lineLen, sizeof(line) - lineLen, "\",\"label\":\"");
+                escape(record.label, IMAGE_LABEL_LEN);
+                lineLen += snprintf(line + lineLen, sizeof(line) - lineLen,
+                                    "\",\"size\":%u,\"timestamp\":%u,\"width\":%u,\"height\":%u}",
+                                    (unsigned)record.size, (unsigned)record.timestamp,
+                                    (unsigned)record.width, (unsigned)record.height);
+                first = false;
+                return true;
+            }
+        case STAGE_TAIL: {
+            // Only a cursor that still has images behind it
+            ImageRecord peek;
+            uint32_t after;
+            if (imageIndex.read(pos, &peek, 1, &after) > 0) {
+                lineLen = snprintf(line, sizeof(line), "],\"next\":%u}", (unsigned)pos);
+            } else {
+                lineLen = snprintf(line, sizeof(line), "],\"next\":null}");
+            }
+            stage = STAGE_DONE;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    uint32_t pos;
+    size_t remaining;
+    Stage stage;
+    bool first;
+    ImageRecord batch[IMAGE_INDEX_BATCH];
+    size_t batchCount;
+    size_t batchIndex;
+    char line[384];     // a record with every name character escaped
+    size_t lineLen;
+    size_t lineOffset;
+};
+
+void sendImageList(AsyncWebServerRequest* request, uint32_t cursor, size_t limit) {
+    std::shared_ptr<ImageListStream> stream(new ImageListStream(cursor, limit));
+    AsyncWebServerResponse* response = request->beginChunkedResponse("application/json",
+        [stream](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            return stream->read(buffer, maxLen);
+        });
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
@@ -0,0 +1,112 @@
+#include "inference_profiler.h"
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+static portMUX_TYPE profilerLock = portMUX_INITIALIZER_UNLOCKED;
+#define PROFILER_LOCK()   portENTER_CRITICAL(&profilerLock)
+#define PROFILER_UNLOCK() portEXIT_CRITICAL(&profilerLock)
+#define PROFILER_MILLIS() ((uint32_t)(esp_timer_get_time() / 1000))
+#else
+#include <mutex>
+#include <chrono>
+
+static std::mutex profilerLock;
+#define PROFILER_LOCK()   profilerLock.lock()
+#define PROFILER_UNLOCK() profilerLock.unlock()
+#define PROFILER_MILLIS() ((uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>( \
+    std::chrono::steady_clock::now().time_since_epoch()).count())
+#endif
+
+InferenceProfiler inferenceProfiler;
+
+InferenceProfiler::InferenceProfiler()
+    : enabled(false), seq(0), highWater(0), head(0)
+{
+    memset(&pending, 0, sizeof(pending));
+    memset(history, 0, sizeof(history));
+}
+
+void InferenceProfiler::setEnabled(bool enable) {
+    PROFILER_LOCK();
+    // drop a half recorded inference from before the switch
+    pending.opCount = 0;
+    pending.opsDropped = 0;
+    enabled = enable;
+    PROFILER_UNLOCK();
+}
+
+void InferenceProfiler::clear() {
+    PROFILER_LOCK();
+    seq = 0;
+    highWater = 0;
+    head = 0;
+    pending.opCount = 0;
+    pending.opsDropped = 0;
+    PROFILER_UNLOCK();
+}
+
+void InferenceProfiler::recordOp(const char* name, uint32_t us) {
+    if (!enabled) return;
+    // only the inference task touches pending between recordInvoke() calls
+    if (pending.opCount < INFERENCE_PROFILER_MAX_OPS) {
+        pending.ops[pending.opCount].name = name;
+        pending.ops[pending.opCount].us = us;
+        pending.opCount++;
+    } else {
+        pending.opsDropped++;
+    }
+}
+
+void InferenceProfiler::recordInvoke(uint32_t invokeUs, size_t arenaUsed, size_t arenaSize) {
+    if (!enabled) return;
+    pending.timestamp = PROFILER_MILLIS();
+    pending.invokeUs = invokeUs;
+    pending.arenaUsed = arenaUsed;
+    pending.arenaSize = arenaSize;
+
+    PROFILER_LOCK();
+    pending.sequence = ++seq;
+    if (arenaUsed > highWater) highWater = arenaUsed;
+    // only copy the filled part of the op list
+    size_t used = offsetof(InferenceProfile, ops) + pending.opCount * sizeof(InferenceProfileOp);
+    memcpy(&history[head], &pending, used);
+    head = (head + 1) % INFERENCE_PROFILER_HISTORY;
+    PROFILER_UNLOCK();
+
+    pending.opCount = 0;
+    pending.opsDropped = 0;
+}
+
+size_t InferenceProfiler::count() const {
+    return seq < INFERENCE_PROFILER_HISTORY ? seq : INFERENCE_PROFILER_HISTORY;
+}
+
+bool InferenceProfiler::get(size_t age, InferenceProfile& out) const {
+    bool found = false;
+    PROFILER_LOCK();
+    if (age < count()) {
+        size_t index = (head + INFERENCE_PROFILER_HISTORY - 1 - age) % INFERENCE_PROFILER_HISTORY;
+        size_t used = offsetof(InferenceProfile, ops) + history[index].opCount * sizeof(InferenceProfileOp);
+        memcpy(&out, &history[index], used);
+        found = true;
+    }
+    PROFILER_UNLOCK();
+    return found;
+}
+
+// --- Edge Impulse SDK hooks (see tflite_profiler.h) ---
+bool ei_tflite_profiler_enabled(void) {
+    return inferenceProfiler.isEnabled();
+}
+
+void ei_tflite_profiler_op(const char* op, uint32_t us) {
+    inferenceProfiler.recordOp(op, us);
+}
+
+void ei_tflite_profiler_invoke_end(uint32_t invoke_us, size_t arena_used, size_t arena_size) {
+    inferenceProfiler.recordInvoke(invoke_us, arena_used, arena_size);
+}
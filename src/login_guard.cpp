@@ -0,0 +1,179 @@
+#include "login_guard.h"
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+
+static portMUX_TYPE guardLock = portMUX_INITIALIZER_UNLOCKED;
+#define GUARD_LOCK()   portENTER_CRITICAL(&guardLock)
+#define GUARD_UNLOCK() portEXIT_CRITICAL(&guardLock)
+#else
+#include <mutex>
+
+static std::mutex guardLock;
+#define GUARD_LOCK()   guardLock.lock()
+#define GUARD_UNLOCK() guardLock.unlock()
+#endif
+
+LoginGuard loginGuard;
+
+// Lockout after the nth failure of a client
+static uint32_t lockDuration(uint32_t fails) {
+    if (fails <= LOGIN_GUARD_FREE_FAILS) return 0;
+    uint32_t doublings = fails - LOGIN_GUARD_FREE_FAILS - 1;
+    if (doublings > 16) doublings = 16;
+    uint32_t ms = LOGIN_GUARD_BASE_LOCK_MS << doublings;
+    return ms < LOGIN_GUARD_MAX_LOCK_MS ? ms : LOGIN_GUARD_MAX_LOCK_MS;
+}
+
+LoginGuard::LoginGuard()
+    : globalLocked(false), globalLockStartMs(0), storedFailures(0)
+{
+    memset(clients, 0, sizeof(clients));
+    memset(&st, 0, sizeof(st));
+}
+
+void LoginGuard::begin(uint32_t stored, uint32_t nowMs) {
+    GUARD_LOCK();
+    storedFailures = stored;
+    if (stored >= LOGIN_GUARD_GLOBAL_FAILS) {
+        // the reboot doesn't end a lockout
+        globalLocked = true;
+        globalLockStartMs = nowMs;
+    } else {
+        st.failures = stored;
+    }
+    GUARD_UNLOCK();
+}
+
+void LoginGuard::onLockout(LockoutListener l) {
+    listener = l;
+}
+
+// Needs the lock
+LoginGuard::Client* LoginGuard::find(uint32_t ip) {
+    for (int i = 0; i < LOGIN_GUARD_CLIENTS; i++) {
+        if (clients[i].used && clients[i].ip == ip) return &clients[i];
+    }
+    return nullptr;
+}
+
+// Needs the lock. A free entry, or else the one with the oldest failure, even
+// if it is locked out: the global count still limits that client.
+LoginGuard::Client* LoginGuard::claim(uint32_t ip, uint32_t nowMs) {
+    Client* slot = &clients[0];
+    for (int i = 0; i < LOGIN_GUARD_CLIENTS; i++) {
+        if (!clients[i].used) {
+            slot = &clients[i];
+            break;
+        }
+        if (nowMs - clients[i].lastFailMs > nowMs - slot->lastFailMs) slot = &clients[i];
+    }
+    if (!slot->used) st.clients++;
+    memset(slot, 0, sizeof(*slot));
+    slot->ip = ip;
+    slot->used = true;
+    return slot;
+}
+
+// Needs the lock. True if the global lockout ended and the stored count has
+// to be cleared, the caller notifies once it has released the lock.
+bool LoginGuard::forget(uint32_t nowMs) {
+    for (int i = 0; i < LOGIN_GUARD_CLIENTS; i++) {
+        Client& c = clients[i];
+        uint32_t idle = nowMs - c.lastFailMs;
+        if (c.used && idle > c.lockMs && idle - c.lockMs > LOGIN_GUARD_FORGET_MS) {
+            c.used = false;
+            st.clients--;
+        }
+    }
+    if (globalLocked && nowMs - globalLockStartMs >= LOGIN_GUARD_MAX_LOCK_MS) {
+        // another LOGIN_GUARD_GLOBAL_FAILS attempts until the next one
+        globalLocked = false;
+        st.failures = 0;
+        if (storedFailures != 0) {
+            // or the next boot would lock everyone out again
+            storedFailures = 0;
+            st.persisted++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void LoginGuard::notify(uint32_t failures) {
+    if (listener) listener(failures);
+}
+
+uint32_t LoginGuard::retryAfter(uint32_t ip, uint32_t nowMs) {
+    uint32_t waitMs = 0;
+    GUARD_LOCK();
+    bool clearStored = forget(nowMs);
+    if (globalLocked) {
+        waitMs = LOGIN_GUARD_MAX_LOCK_MS - (nowMs - globalLockStartMs);
+    }
+    Client* c = find(ip);
+    if (c != nullptr && nowMs - c->lastFailMs < c->lockMs) {
+        uint32_t clientWaitMs = c->lockMs - (nowMs - c->lastFailMs);
+        if (clientWaitMs > waitMs) waitMs = clientWaitMs;
+    }
+    if (waitMs > 0) st.rejected++;
+    GUARD_UNLOCK();
+    if (clearStored) notify(0);
+    return waitMs;
+}
+
+void LoginGuard::recordFailure(uint32_t ip, uint32_t nowMs) {
+    bool lockout = false;
+    uint32_t failures = 0;
+    GUARD_LOCK();
+    bool clearStored = forget(nowMs);
+    Client* c = find(ip);
+    if (c == nullptr) c = claim(ip, nowMs);
+    c->fails++;
+    c->lastFailMs = nowMs;
+    c->lockMs = lockDuration(c->fails);
+    st.failures++;
+    bool globalStarted = !globalLocked && st.failures >= LOGIN_GUARD_GLOBAL_FAILS;
+    if (globalStarted) {
+        globalLocked = true;
+        globalLockStartMs = nowMs;
+    }
+    // Attempts are refused while locked out, so every lock that starts here
+    // is a transition from unlocked. Only the global one is stored.
+    if (c->lockMs > 0 || globalStarted) st.lockouts++;
+    if (globalStarted && st.failures != storedFailures) {
+        storedFailures = st.failures;
+        failures = st.failures;
+        lockout = true;
+        st.persisted++;
+    }
+    GUARD_UNLOCK();
+    if (clearStored) notify(0);
+    if (lockout) notify(failures);
+}
+
+void LoginGuard::recordSuccess(uint32_t ip) {
+    bool clearStored = false;
+    GUARD_LOCK();
+    Client* c = find(ip);
+    if (c != nullptr) {
+        c->used = false;
+        st.clients--;
+    }
+    st.failures = 0;
+    if (storedFailures != 0) {
+        storedFailures = 0;
+        clearStored = true;
+        st.persisted++;
+    }
+    GUARD_UNLOCK();
+    if (clearStored) notify(0);
+}
+
+LoginGuardStats LoginGuard::stats() const {
+    GUARD_LOCK();
+    LoginGuardStats copy = st;
+    GUARD_UNLOCK();
+    return copy;
+}
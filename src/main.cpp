@@ -1,7 +1,6 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <Adafruit_NeoPixel.h>
-#include <Preferences.h>
 #include <vector>
 #include <map>
 #include <algorithm>
@@ -13,6 +12,20 @@
 #include <Adafruit_SSD1306.h>
 #include <LittleFS.h>
 #include "version.h"
+#include "model_loader.h"
+#include "inference_profiler.h"
+#include "memory_plan_store.h"
+#include "weight_prefetch.h"
+#include "web_assets.h"
+#include "page_renderer.h"
+#include "device_config.h"
+#include "session_table.h"
+#include "login_guard.h"
+#include "image_index.h"
+#include "stored_images.h"
+#include "image_export.h"
+#include "telemetry.h"
+#include "telemetry_history.h"
 
 // Optional config file for development (excluded from git)
 #ifdef __has_include
@@ -196,15 +209,10 @@ SystemState currentState = WIFI_CONNECTING;
 const char* ap_ssid = "BeeCounter-Setup";
 AsyncWebServer server(80);
 AsyncEventSource events("/events");
-Preferences preferences;
 
 // --- Camera State ---
 bool cameraInitialized = false;
 
-// --- Authentication ---
-#define SESSION_COOKIE_NAME "BEE_SESSION"
-String currentSessionId = "";
-
 // --- Structs ---
 struct WifiNetwork { String ssid; int32_t rssi; };
 
@@ -256,9 +264,9 @@ bool autoSetTimezone() {
             deserializeJson(doc, payload);
             const char* tz = doc["timezone"];
             if (tz) {
-                preferences.begin("beecounter", false); // Open preferences in read-write mode
-                preferences.putString("timezone", tz);
-                preferences.end();
+                DeviceConfig::Batch batch = deviceConfig.edit();
+                batch.setString(CONFIG_TIMEZONE, tz);
+                batch.commit();
                 updateOLED("Timezone Saved:", tz);
                 success = true;
             } else {
@@ -311,11 +319,13 @@ String getReadableTimezone(const String& posixTz) {
 }
 
 // --- Performance Monitoring ---
-unsigned long performanceUpdateInterval = 2000; // Default to 2 seconds
+unsigned long performanceUpdateInterval = 2000; // Default to 2 seconds, how often telemetry frames go out
 
 // --- Data Collection State ---
 bool isCollecting = false;
 int imagesCollected = 0;
+String collectionLabel = ""; // label of the images of the running collection
+unsigned long restartAt = 0; // millis() of a restart requested by the web UI, 0 = none
 const int totalImages = 50;
 const unsigned long collectionInterval = (24 * 60 * 60 * 1000) / totalImages; // ~30 mins
 unsigned long lastCollectionTime = 0;
@@ -327,13 +337,27 @@ void handleCaptureStart(AsyncWebServerRequest *request);
 void handleCaptureStop(AsyncWebServerRequest *request);
 void handleCapturePhoto(AsyncWebServerRequest *request);
 void handleEdgeImpulseSettings(AsyncWebServerRequest *request);
+void handleEdgeImpulseSettingsInfo(AsyncWebServerRequest *request);
+void handleUiInfo(AsyncWebServerRequest *request);
 void handleEdgeImpulseUpload(AsyncWebServerRequest *request);
 void handleEdgeImpulseDownloadModel(AsyncWebServerRequest *request);
+void handleModelInfo(AsyncWebServerRequest *request);
+void handleModelUpload(AsyncWebServerRequest *request);
+void handleModelUploadData(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
+void handleProfilerInfo(AsyncWebServerRequest *request);
+void handleProfilerSettings(AsyncWebServerRequest *request);
+void handleTelemetryInfo(AsyncWebServerRequest *request);
+void handleTelemetryHistory(AsyncWebServerRequest *request);
+void handleTelemetryHistorySettings(AsyncWebServerRequest *request);
+void sampleTelemetry(TelemetrySample& sample);
+void sampleHistory(HistoryRecord& sample, unsigned long elapsedMs);
+void addInferenceProfileJson(JsonObject obj, const InferenceProfile& profile);
 void startConfigurationMode();
 void handleWelcomePage(AsyncWebServerRequest *request);
 void handleSetupPage(AsyncWebServerRequest *request);
 void handleSaveWifiPage(AsyncWebServerRequest *request);
-String getPageTemplate(const String& title, const String& body, bool includeTabs = false);
+PageRenderer* newPage(const char* title, const char* body, bool includeTabs = false);
+void setNotice(PageRenderer* page, const char* cssClass, const char* text);
 void handleLoginPage(AsyncWebServerRequest *request);
 void handleDoLogin(AsyncWebServerRequest *request);
 void handleChangePassPage(AsyncWebServerRequest *request);
@@ -350,7 +374,7 @@ void handleReboot(AsyncWebServerRequest *request);
 void handleFactoryReset(AsyncWebServerRequest *request);
 void handleLogout(AsyncWebServerRequest *request);
 bool isAuthenticated(AsyncWebServerRequest *request);
-String getFooter();
+void redirectWithNewSession(AsyncWebServerRequest *request, const char* location);
 void logError(const String& message);
 
 String getLoginPageTemplate(const String& title, const String& body) {
@@ -369,6 +393,20 @@ String getLoginPageTemplate(const String& title, const String& body) {
     return html;
 }
 
+// --- Page Templates ---
+// Rendered by newPage() into a chunked response, see page_renderer.h
+static const char PAGE_LAYOUT[] = "<!DOCTYPE html><html lang='en'><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width, initial-scale=1.0'><title>BeeCounter - {{title}}</title>"
+    "<link rel='stylesheet' href='" WEB_ASSETS_STATIC_URI "app.css?v={{css_version}}'><script src='" WEB_ASSETS_STATIC_URI "app.js?v={{js_version}}' defer></script></head><body>"
+    "{{tabs}}<main class='container'>{{body}}</main>"
+    "<footer><p>{{device_name}} | v{{version}} | <span id='footer-time'>{{time}}</span></p></footer></body></html>";
+
+static const char PAGE_TABS[] = "<header><h1>BeeCounter</h1><img src='https://upload.wikimedia.org/wikipedia/commons/9/91/Abeille-bee.svg' alt='Bee Icon' style='height: 40px; margin: auto;' /><div><a href='/about'>About</a><span style='margin:0 10px;'>|</span><a href='/logout'>Logout</a></div></header>"
+    "<div class='tabs'><nav><a href='/' class='{{tab_monitor}}'>Monitor</a><a href='/train' class='{{tab_train}}'>Train</a>"
+    "<a href='/observability' class='{{tab_observability}}'>Observability</a><a href='/admin' class='{{tab_admin}}'>Administer</a></nav></div>";
+
+// Set as "notice" with setNotice()
+static const char PAGE_NOTICE[] = "<p class='{{notice_class}}'>{{notice_text}}</p>";
+
 // --- Main Setup & Loop ---
 void setup() {
     // Disable brownout detector to prevent watchdog timeouts during camera init
@@ -424,34 +462,35 @@ void setup() {
             return; // Halt on error
         }
     }
+    webAssets.begin();
+    imageIndex.begin();
+    if (!beginThumbnails()) {
+        Serial.println("WARN: Thumbnail task not started, the gallery gets full images");
+    }
     esp_task_wdt_reset(); // Reset watchdog after LittleFS
     Serial.println("DEBUG: Step J - LittleFS initialized");
 
     // --- Initialize Preferences with Defaults ---
     Serial.println("DEBUG: Step K - Initializing preferences...");
-    preferences.begin("beecounter", false); // Open in read-write mode
-    if (!preferences.isKey("deviceName")) {
-        preferences.putString("deviceName", "BeeCounter");
-        Serial.println("Set default deviceName: BeeCounter");
-    }
-    if (!preferences.isKey("isDefaultPass")) {
-        preferences.putBool("isDefaultPass", true);
-        preferences.putString("adminPass", ""); // Empty default password
-        Serial.println("Set default password settings");
-    }
-    if (!preferences.isKey("loginFails")) {
-        preferences.putInt("loginFails", 0);
-        preferences.putULong("lastFailTime", 0);
-        Serial.println("Set default login failure tracking");
-    }
-    if (!preferences.isKey("timezone")) {
-        preferences.putString("timezone", "EST5EDT,M3.2.0,M11.1.0");
-        Serial.println("Set default timezone");
-    }
-    preferences.end();
+    deviceConfig.begin();
+    // Failed logins are counted in RAM, flash only sees lockout transitions
+    loginGuard.begin(deviceConfig.get().loginFails, millis());
+    loginGuard.onLockout([](uint32_t failures) {
+        DeviceConfig::Batch batch = deviceConfig.edit();
+        batch.setInt(CONFIG_LOGIN_FAILS, failures);
+        batch.setULong(CONFIG_LAST_FAIL_TIME, failures > 0 ? millis() : 0);
+        batch.commit();
+    });
     esp_task_wdt_reset(); // Reset watchdog after preferences
     Serial.println("DEBUG: Step L - Preferences initialization complete.");
 
+    // --- Telemetry History ---
+    if (telemetryHistory.begin()) {
+        loadTelemetryHistory(); // the last hourly snapshot, if there is one
+    } else {
+        Serial.println("ERROR: No memory for the telemetry history");
+    }
+
     // --- Initialize Camera (With Extensive Debugging) ---
     Serial.println("DEBUG: Step M - About to start camera initialization...");
     esp_task_wdt_reset(); // Reset watchdog before camera init
@@ -466,6 +505,20 @@ void setup() {
     }
     Serial.println("DEBUG: Step N - Camera initialization section complete.");
 
+    // --- Map the model from its flash partition ---
+    if (modelLoader.begin()) {
+        Serial.printf("SUCCESS: Model '%s' mapped from flash (%u bytes)\n", modelLoader.name(), (unsigned)modelLoader.size());
+    } else {
+        Serial.printf("WARN: No model loaded: %s\n", modelLoader.lastError());
+    }
+    memoryPlanStore.begin();
+    // The copy task only has work when the SDK stages filters
+#if defined(EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH) && (EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH == 1)
+    if (!weightPrefetch.begin()) {
+        Serial.println("WARN: Weight prefetch task not started, filters are copied synchronously");
+    }
+#endif
+
     // --- Wi-Fi Event Handlers ---
     WiFi.onEvent([](WiFiEvent_t event, WiFiEventInfo_t info){
         Serial.printf("[WiFi-event] event: %d\n", event);
@@ -489,8 +542,9 @@ void setup() {
     });
 
     // --- Station Mode ---
-    String ssid = preferences.getString("ssid", "");
-    String password = preferences.getString("password", "");
+    DeviceSettings config = deviceConfig.get();
+    String ssid = config.ssid;
+    String password = config.password;
     
     #if defined(HAS_CONFIG_H) && defined(DEBUG_WIFI_ENABLED)
         // Use config.h credentials for development
@@ -574,44 +628,55 @@ void setup() {
                 server.on("/api/capture/start", HTTP_POST, handleCaptureStart);
                 server.on("/api/capture/stop", HTTP_POST, handleCaptureStop);
                 server.on("/api/capture/photo", HTTP_POST, handleCapturePhoto);
+                server.on("/api/edgeimpulse/settings", HTTP_GET, handleEdgeImpulseSettingsInfo);
                 server.on("/api/edgeimpulse/settings", HTTP_POST, handleEdgeImpulseSettings);
-                server.on("/api/images", HTTP_GET, [](AsyncWebServerRequest *request){
+                server.on("/api/ui", HTTP_GET, handleUiInfo);
+                webAssets.registerStatic(server);
+                // Before /api/images, which also matches the URLs below it
+                server.on("/api/images/export", HTTP_GET, [](AsyncWebServerRequest *request){
                     if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
-                    JsonDocument doc;
-                    JsonArray array = doc.to<JsonArray>();
-                    File root = LittleFS.open("/images");
-                    File file = root.openNextFile();
-                    while(file){
-                        array.add(String(file.name()));
-                        file = root.openNextFile();
+                    ImageExportFilter filter = {0, UINT32_MAX, ""};
+                    if (request->hasParam("from")) filter.fromTime = strtoul(request->getParam("from")->value().c_str(), nullptr, 10);
+                    if (request->hasParam("to")) filter.toTime = strtoul(request->getParam("to")->value().c_str(), nullptr, 10);
+                    if (request->hasParam("label")) {
+                        strlcpy(filter.label, request->getParam("label")->value().c_str(), sizeof(filter.label));
                     }
-                    String json;
-                    serializeJson(doc, json);
-                    request->send(200, "application/json", json);
+                    sendImageExport(request, filter);
+                });
+                server.on("/api/images", HTTP_GET, [](AsyncWebServerRequest *request){
+                    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+                    uint32_t cursor = request->hasParam("cursor") ? request->getParam("cursor")->value().toInt() : 0;
+                    long limit = request->hasParam("limit") ? request->getParam("limit")->value().toInt() : IMAGE_LIST_DEFAULT_LIMIT;
+                    if (limit < 1 || limit > IMAGE_LIST_MAX_LIMIT) limit = IMAGE_LIST_DEFAULT_LIMIT;
+                    sendImageList(request, cursor, limit);
                 });
                 server.on("/images", HTTP_GET, [](AsyncWebServerRequest *request){
                     if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
                     if (request->hasParam("delete")) {
-                        String filename = "/images/" + request->getParam("delete")->value();
-                        if (LittleFS.exists(filename)) {
-                            LittleFS.remove(filename);
-                            request->send(200, "text/plain", "Deleted: " + filename);
+                        String name = request->getParam("delete")->value();
+                        if (removeStoredImage(name.c_str())) {
+                            request->send(200, "text/plain", "Deleted: /images/" + name);
                         } else {
                             request->send(404, "text/plain", "File not found");
                         }
                     } else if (request->hasParam("serve")) {
-                         String filename = "/images/" + request->getParam("serve")->value();
-                         if (LittleFS.exists(filename)) {
-                            request->send(LittleFS, filename, "image/jpeg");
-                         } else {
-                            request->send(404, "text/plain", "File not found");
-                         }
+                        sendStoredImage(request, request->getParam("serve")->value().c_str());
+                    } else if (request->hasParam("thumb")) {
+                        sendThumbnail(request, request->getParam("thumb")->value().c_str());
                     } else {
                         request->send(400, "text/plain", "Bad Request");
                     }
                 });
                 server.on("/api/edgeimpulse/upload", HTTP_POST, handleEdgeImpulseUpload);
                 server.on("/api/edgeimpulse/download-model", HTTP_POST, handleEdgeImpulseDownloadModel);
+                server.on("/api/model", HTTP_GET, handleModelInfo);
+                server.on("/api/model/upload", HTTP_POST, handleModelUpload, handleModelUploadData);
+                server.on("/api/profiler", HTTP_GET, handleProfilerInfo);
+                server.on("/api/profiler", HTTP_POST, handleProfilerSettings);
+                // Before /api/telemetry, which also matches the URL below it
+                server.on("/api/telemetry/history", HTTP_GET, handleTelemetryHistory);
+                server.on("/api/telemetry/history", HTTP_POST, handleTelemetryHistorySettings);
+                server.on("/api/telemetry", HTTP_GET, handleTelemetryInfo);
                 server.on("/about", HTTP_GET, handleAboutPage);
                 server.on("/changelog", HTTP_GET, handleChangelogPage);
                 
@@ -652,6 +717,7 @@ void setup() {
                         request->send(500, "text/plain", "Camera capture failed");
                         return;
                     }
+                    telemetryHistory.countFrame();
                     
                     Serial.printf("SUCCESS: Captured frame for /capture - %dx%d, %u bytes\n", 
                                  fb->width, fb->height, fb->len);
@@ -711,6 +777,7 @@ void setup() {
                         request->send(500, "text/plain", "Camera capture failed");
                         return;
                     }
+                    telemetryHistory.countFrame();
                     
                     Serial.printf("SUCCESS: Captured frame - %dx%d, %u bytes, format: %d\n", 
                                  fb->width, fb->height, fb->len, fb->format);
@@ -738,6 +805,7 @@ void setup() {
                     client->send("hello!", NULL, millis(), 10000);
                 });
                 server.addHandler(&events);
+                telemetrySocket.begin(server, isAuthenticated, sampleTelemetry);
 
                 Serial.println("DEBUG: Step R - Starting web server...");
                 esp_task_wdt_reset(); // Reset watchdog before server.begin()
@@ -747,9 +815,7 @@ void setup() {
                 // --- Start mDNS ---
                 Serial.println("DEBUG: Step T - Starting mDNS...");
                 esp_task_wdt_reset(); // Reset watchdog before mDNS
-                preferences.begin("beecounter", true); // Open in read-only mode for device name
-                String deviceName = preferences.getString("deviceName", "beecounter");
-                preferences.end();
+                String deviceName = deviceConfig.get().deviceName;
                 Serial.printf("DEBUG: Retrieved device name: %s\n", deviceName.c_str());
                 if (MDNS.begin(deviceName.c_str())) {
                     MDNS.addService("http", "tcp", 80);
@@ -761,11 +827,13 @@ void setup() {
                 // --- Start OTA Service ---
                 Serial.println("DEBUG: Step U - Setting up OTA...");
                 esp_task_wdt_reset(); // Reset watchdog before OTA setup
-                preferences.begin("beecounter", true); // Open in read-only mode for admin password
-                String ota_password_seed = preferences.getString("adminPass", "") + WiFi.macAddress();
-                preferences.end();
+                String ota_password_seed = String(deviceConfig.get().adminPass) + WiFi.macAddress();
                 Serial.println("DEBUG: OTA password seed generated");
                 ArduinoOTA.setPassword(sha256(ota_password_seed).c_str());
+                // A new admin password is the OTA password from now on
+                deviceConfig.onChange(CONFIG_BIT(CONFIG_ADMIN_PASS), [](uint32_t changed) {
+                    ArduinoOTA.setPassword(sha256(String(deviceConfig.get().adminPass) + WiFi.macAddress()).c_str());
+                });
 
                 ArduinoOTA.onStart([]() {
                     strip.setPixelColor(0, COLOR_SAVING); // White
@@ -797,9 +865,7 @@ void setup() {
                 // --- Start NTP and set Timezone ---
                 Serial.println("DEBUG: Step W - Setting up NTP and timezone...");
                 esp_task_wdt_reset(); // Reset watchdog before NTP setup
-                preferences.begin("beecounter", true); // Open in read-only mode for timezone
-                String timezone = preferences.getString("timezone", "");
-                preferences.end();
+                String timezone = deviceConfig.get().timezone;
                 if (timezone.length() > 0) {
                     Serial.printf("DEBUG: Setting timezone using saved value: %s\n", timezone.c_str());
                     configTzTime(timezone.c_str(), "pool.ntp.org");
@@ -810,6 +876,9 @@ void setup() {
                     configTzTime(tz_posix, "pool.ntp.org");
                 }
                 Serial.println("DEBUG: configTzTime called.");
+                deviceConfig.onChange(CONFIG_BIT(CONFIG_TIMEZONE), [](uint32_t changed) {
+                    configTzTime(deviceConfig.get().timezone, "pool.ntp.org");
+                });
 
                 // Wait for NTP sync
                 Serial.println("DEBUG: Step X - Waiting for NTP synchronization...");
@@ -849,6 +918,11 @@ void setup() {
 
 void loop() {
     esp_task_wdt_reset(); // Reset watchdog at start of loop
+
+    // Restart once the page announcing it had time to go out
+    if (restartAt != 0 && (long)(millis() - restartAt) >= 0) {
+        ESP.restart();
+    }
     
     ArduinoOTA.handle();
     esp_task_wdt_reset(); // Reset after OTA handle
@@ -939,34 +1013,49 @@ void loop() {
 
     if (currentState == SERVER_STARTED && (currentMillis - oledPreviousMillis >= oledInterval)) {
         oledPreviousMillis = currentMillis;
-        preferences.begin("beecounter", true);
-        String deviceName = preferences.getString("deviceName", "BeeCounter");
-        preferences.end();
+        DeviceSettings config = deviceConfig.get();
         
         updateOLED(
-            deviceName,
+            config.deviceName,
             "IP: " + WiFi.localIP().toString(),
             "Heap: " + String(ESP.getFreeHeap()) + " B"
         );
     }
 
-    // --- Send Performance Update Event ---
+    // --- Telemetry History ---
+    static unsigned long lastHistorySample = 0;
+    if (millis() - lastHistorySample >= TELEMETRY_HISTORY_SAMPLE_MS) {
+        unsigned long elapsed = millis() - lastHistorySample;
+        lastHistorySample = millis();
+        HistoryRecord sample;
+        sampleHistory(sample, elapsed);
+        if (telemetryHistory.add(sample) && deviceConfig.get().historySnapshot) {
+            saveTelemetryHistory();
+        }
+    }
+
+    // --- Performance Telemetry ---
+    // Samples only while the Observability page has the socket open
+    if (currentState == SERVER_STARTED) {
+        telemetrySocket.update(millis(), performanceUpdateInterval);
+    }
+
     static unsigned long lastEventTime = 0;
     if (currentState == SERVER_STARTED && (millis() - lastEventTime > performanceUpdateInterval)) {
-        calculate_cpu_usage(); // Update CPU usage values
-        JsonDocument doc;
-        doc["cpu_core_0"] = cpu_0_usage;
-        doc["cpu_core_1"] = cpu_1_usage;
-        doc["heap_used"] = ESP.getFreeHeap();
-        doc["heap_total"] = ESP.getHeapSize();
-        doc["flash_used"] = LittleFS.usedBytes();
-        doc["flash_total"] = LittleFS.totalBytes();
-        doc["wifi_rssi"] = WiFi.RSSI();
-        doc["cpu_temp"] = temperatureRead();
-        String json;
-        serializeJson(doc, json);
-        events.send(json.c_str(), "performance_update", millis());
         lastEventTime = millis();
+
+        // --- Latest profiled inference, if there is a new one ---
+        static uint32_t lastProfileSequence = 0;
+        static InferenceProfile profile;
+        if (inferenceProfiler.sequence() != lastProfileSequence && inferenceProfiler.get(0, profile)) {
+            lastProfileSequence = profile.sequence;
+            JsonDocument profileDoc;
+            profileDoc["arena_high_water"] = inferenceProfiler.arenaHighWater();
+            addInferenceProfileJson(profileDoc["invocation"].to<JsonObject>(), profile);
+            String profileJson;
+            serializeJson(profileDoc, profileJson);
+            events.send(profileJson.c_str(), "profiler_update", millis());
+        }
     }
 
     // --- Automated Data Collection ---
@@ -975,6 +1064,7 @@ void loop() {
             // It's time to take another picture
             camera_fb_t * fb = esp_camera_fb_get();
             if (fb) {
+                telemetryHistory.countFrame();
                 struct timeval tv;
                 gettimeofday(&tv, NULL);
                 String path = "/images/img-" + String(tv.tv_sec) + ".jpg";
@@ -982,6 +1072,8 @@ void loop() {
                 if (file) {
                     file.write(fb->buf, fb->len);
                     file.close();
+                    imageIndex.add(path.substring(8).c_str(), fb->len, tv.tv_sec, collectionLabel.c_str(), fb->width, fb->height);
+                    queueThumbnail(path.substring(8).c_str());
                     imagesCollected++;
                     Serial.printf("DATA COLLECTION: Saved %s (%d/%d)\n", path.c_str(), imagesCollected, totalImages);
                     
@@ -1016,12 +1108,10 @@ void loop() {
     // --- Periodic Serial Output ---
     static unsigned long lastSerialPrintMillis = 0;
     if (currentState == SERVER_STARTED && (millis() - lastSerialPrintMillis > 30000)) {
-        preferences.begin("beecounter", true);
-        String deviceName = preferences.getString("deviceName", "BeeCounter");
-        preferences.end();
+        DeviceSettings config = deviceConfig.get();
         
         Serial.println("\n--- STATUS UPDATE ---");
-        Serial.println("Device Name: " + deviceName);
+        Serial.println("Device Name: " + String(config.deviceName));
         Serial.println("WiFi SSID:   " + WiFi.SSID());
         Serial.println("IP Address:  " + WiFi.localIP().toString());
         Serial.println("---------------------\n");
@@ -1104,13 +1194,16 @@ void handleSaveWifiPage(AsyncWebServerRequest *request) {
         strip.setPixelColor(0, COLOR_SAVING);
         strip.show();
 
-        preferences.begin("beecounter", false);
-        preferences.putString("deviceName", request->getParam("deviceName", true)->value());
-        preferences.putString("ssid", request->getParam("wifi_ssid", true)->value());
-        preferences.putString("password", request->getParam("wifiPassword", true)->value());
-        preferences.putString("adminPass", ""); // Initialize empty password
-        preferences.putBool("isDefaultPass", true); // Set flag
-        preferences.end();
+        DeviceConfig::Batch batch = deviceConfig.edit();
+        batch.setString(CONFIG_DEVICE_NAME, request->getParam("deviceName", true)->value().c_str());
+        batch.setString(CONFIG_SSID, request->getParam("wifi_ssid", true)->value().c_str());
+        batch.setString(CONFIG_PASSWORD, request->getParam("wifiPassword", true)->value().c_str());
+        batch.setString(CONFIG_ADMIN_PASS, ""); // Initialize empty password
+        batch.setBool(CONFIG_DEFAULT_PASS, true); // Set flag
+        if (!batch.commit()) {
+            request->send(400, "text/plain", "Device name, SSID or password too long");
+            return;
+        }
 
         AsyncResponseStream *response = request->beginResponseStream("text/html");
         response->print(F("<!DOCTYPE html><html><head><title>Rebooting...</title><style>body{font-family:sans-serif;background-color:#1a1a1a;color:#FFC300;display:flex;justify-content:center;align-items:center;height:100vh;text-align:center;}</style></head><body><div><h1>Configuration Saved!</h1><p>Device is rebooting...</p></div></body></html>"));
@@ -1124,13 +1217,23 @@ void handleSaveWifiPage(AsyncWebServerRequest *request) {
 
 // --- Authentication & Page Handlers ---
 bool isAuthenticated(AsyncWebServerRequest *request) {
-    if (currentSessionId.length() == 0) return false;
     if (request->hasHeader("Cookie")) {
-        return request->header("Cookie").indexOf(SESSION_COOKIE_NAME "=" + currentSessionId) != -1;
+        return sessionTable.validate(request->header("Cookie").c_str());
     }
     return false;
 }
 
+// Starts a session and sends its cookie along with the redirect
+void redirectWithNewSession(AsyncWebServerRequest *request, const char* location) {
+    char token[SESSION_TOKEN_HEX_LEN + 1];
+    sessionTable.create(token);
+    AsyncWebServerResponse *response = request->beginResponse(302, "text/plain", "Redirecting");
+    response->addHeader("Location", location);
+    response->addHeader("Set-Cookie", String(SESSION_COOKIE_NAME) + "=" + token +
+        "; Path=/; HttpOnly; SameSite=Strict; Max-Age=" + String(SESSION_MAX_AGE_MS / 1000));
+    request->send(response);
+}
+
 void handleLoginPage(AsyncWebServerRequest *request) {
     String body = "<img src='https://upload.wikimedia.org/wikipedia/commons/9/91/Abeille-bee.svg' alt='Bee Icon' style='height: 120px; margin-bottom: 1rem;' />" 
                   "<form action='/login' method='POST'>" 
@@ -1143,26 +1246,26 @@ void handleLoginPage(AsyncWebServerRequest *request) {
 }
 
 void handleDoLogin(AsyncWebServerRequest *request) {
-    const int maxLoginAttempts = 5;
-    const unsigned long lockoutDuration = 5 * 60 * 1000; // 5 minutes
-
-    preferences.begin("beecounter", false);
-    int failCount = preferences.getInt("loginFails", 0);
-    unsigned long lastFail = preferences.getULong("lastFailTime", 0);
-
-    if (failCount >= maxLoginAttempts && (millis() - lastFail < lockoutDuration)) {
-        preferences.end();
-        String body = "<p class='error'>Too many failed login attempts. Please try again in 5 minutes.</p><a href='/login'>Back to Login</a>";
-        request->send(429, "text/html", getLoginPageTemplate("Account Locked", body));
+    uint32_t clientIp = request->client()->remoteIP();
+    uint32_t retryAfterMs = loginGuard.retryAfter(clientIp, millis());
+    if (retryAfterMs > 0) {
+        uint32_t retryAfterS = (retryAfterMs + 999) / 1000;
+        String body = "<p class='error'>Too many failed login attempts. Please try again in " + String(retryAfterS) +
+                      " seconds.</p><a href='/login'>Back to Login</a>";
+        AsyncWebServerResponse *response = request->beginResponse(429, "text/html", getLoginPageTemplate("Account Locked", body));
+        response->addHeader("Retry-After", String(retryAfterS));
+        request->send(response);
         return;
     }
 
+    DeviceSettings config = deviceConfig.get();
+
     if (request->hasParam("username", true) && request->hasParam("password", true)) {
         String username = request->getParam("username", true)->value();
         String password = request->getParam("password", true)->value();
 
-        String storedHash = preferences.getString("adminPass", "");
-        bool isDefault = preferences.getBool("isDefaultPass", true);
+        String storedHash = config.adminPass;
+        bool isDefault = config.isDefaultPass;
 
         if (username == "admin") {
             bool loginSuccess = false;
@@ -1173,25 +1276,16 @@ void handleDoLogin(AsyncWebServerRequest *request) {
             }
 
             if (loginSuccess) {
-                preferences.putInt("loginFails", 0);
-                preferences.putULong("lastFailTime", 0);
-                preferences.end();
-
-                currentSessionId = String(random(0, 1000000));
-                AsyncWebServerResponse *response = request->beginResponse(302, "text/plain", "Redirecting");
-                response->addHeader("Location", isDefault ? "/changepass" : "/");
-                response->addHeader("Set-Cookie", String(SESSION_COOKIE_NAME) + "=" + currentSessionId + "; Path=/");
-                request->send(response);
+                loginGuard.recordSuccess(clientIp);
+
+                redirectWithNewSession(request, isDefault ? "/changepass" : "/");
                 return;
             }
         }
     }
 
     // If we reach here, the login failed.
-    failCount++;
-    preferences.putInt("loginFails", failCount);
-    preferences.putULong("lastFailTime", millis());
-    preferences.end();
+    loginGuard.recordFailure(clientIp, millis());
 
     String body = "<img src='https://upload.wikimedia.org/wikipedia/commons/9/91/Abeille-bee.svg' alt='Bee Icon' style='height: 120px; margin-bottom: 1rem;' />" 
                   "<p class='error'>Invalid credentials.</p>" 
@@ -1204,32 +1298,26 @@ void handleDoLogin(AsyncWebServerRequest *request) {
     request->send(401, "text/html", getLoginPageTemplate("Login Failed", body));
 }
 
-String getChangePassForm(String errorMessage = "") {
-    String form = "";
-    if (errorMessage != "") {
-        form += "<p class='error'>" + errorMessage + "</p>";
-    }
-    form += "<form action='/changepass' method='POST'>" 
-            "<h2>Change Admin Password</h2>" 
-            "<p>Requirements: 8+ characters, one uppercase, one number, one symbol.</p>" 
-            "<div class='form-group'><label>New Password</label><input type='password' id='new_pass' name='new_password' pattern='(?=.*\\d)(?=.*[a-z])(?=.*[A-Z])(?=.*[^A-Za-z0-9]).{8,}' title='Must contain at least one number, one uppercase, one lowercase, one special character, and at least 8 or more characters' required></div>" 
-            "<div class='form-group-inline'><input type='checkbox' onclick='togglePassword(\"new_pass\")'> Show Password</div>" 
-            "<div class='form-group'><label>Confirm Password</label><input type='password' id='confirm_pass' name='confirm_password' required></div>" 
-            "<div class='form-group-inline'><input type='checkbox' onclick='togglePassword(\"confirm_pass\")'> Show Password</div>" 
-            "<button type='submit'>Save Password</button>" 
-            "</form>" 
-            "<script>" 
-            "function togglePassword(id) {" 
-            "  var x = document.getElementById(id);" 
-            "  if (x.type === 'password') { x.type = 'text'; } else { x.type = 'password'; }" 
-            "}" 
-            "</script>";
-    return form;
-}
+static const char CHANGE_PASS_BODY[] = "{{notice}}"
+    "<form action='/changepass' method='POST'>"
+    "<h2>Change Admin Password</h2>"
+    "<p>Requirements: 8+ characters, one uppercase, one number, one symbol.</p>"
+    "<div class='form-group'><label>New Password</label><input type='password' id='new_pass' name='new_password' pattern='(?=.*\\d)(?=.*[a-z])(?=.*[A-Z])(?=.*[^A-Za-z0-9]).{8,}' title='Must contain at least one number, one uppercase, one lowercase, one special character, and at least 8 or more characters' required></div>"
+    "<div class='form-group-inline'><input type='checkbox' onclick='togglePassword(\"new_pass\")'> Show Password</div>"
+    "<div class='form-group'><label>Confirm Password</label><input type='password' id='confirm_pass' name='confirm_password' required></div>"
+    "<div class='form-group-inline'><input type='checkbox' onclick='togglePassword(\"confirm_pass\")'> Show Password</div>"
+    "<button type='submit'>Save Password</button>"
+    "</form>"
+    "<script>"
+    "function togglePassword(id) {"
+    "  var x = document.getElementById(id);"
+    "  if (x.type === 'password') { x.type = 'text'; } else { x.type = 'password'; }"
+    "}"
+    "</script>";
 
 void handleChangePassPage(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->redirect("/login"); return; }
-    request->send(200, "text/html", getPageTemplate("Change Password", getChangePassForm()));
+    sendPage(request, newPage("Change Password", CHANGE_PASS_BODY));
 }
 
 void handleDoChangePass(AsyncWebServerRequest *request) {
@@ -1245,331 +1333,59 @@ void handleDoChangePass(AsyncWebServerRequest *request) {
                 if (!isalnum(c)) hasSymbol = true;
             }
             if (newPass.length() >= 8 && hasUpper && hasLower && hasDigit && hasSymbol) {
-                preferences.begin("beecounter", false);
-                preferences.putString("adminPass", sha256(newPass));
-                preferences.putBool("isDefaultPass", false); // <-- The fix
-                preferences.end();
-                request->redirect("/");
+                DeviceConfig::Batch batch = deviceConfig.edit();
+                batch.setString(CONFIG_ADMIN_PASS, sha256(newPass).c_str());
+                batch.setBool(CONFIG_DEFAULT_PASS, false); // <-- The fix
+                batch.commit();
+                // Sessions of the old password end, this browser stays logged in
+                sessionTable.clear();
+                redirectWithNewSession(request, "/");
                 return;
             }
         }
     }
-    request->send(400, "text/html", getPageTemplate("Password Change Failed", getChangePassForm("Passwords do not match or meet complexity rules.")));
+    PageRenderer* page = newPage("Password Change Failed", CHANGE_PASS_BODY);
+    setNotice(page, "error", "Passwords do not match or meet complexity rules.");
+    sendPage(request, page, 400);
+}
+
+// Sends one of the page shells from web/, the page loads its data from the JSON endpoints
+void sendPageShell(AsyncWebServerRequest *request, const char* name) {
+    if (!webAssets.send(request, name, WEB_ASSETS_PAGE_CACHE)) {
+        request->send(503, "text/plain", "Web UI assets missing, upload the LittleFS image (pio run -t uploadfs)");
+    }
 }
 
 void handleMainPage(AsyncWebServerRequest *request) {
-    preferences.begin("beecounter", true);
-    bool isDefault = preferences.getBool("isDefaultPass", true);
-    preferences.end();
-    if (isDefault) { request->redirect("/login"); return; }
+    if (deviceConfig.get().isDefaultPass) { request->redirect("/login"); return; }
     if (!isAuthenticated(request)) { request->redirect("/login"); return; }
-    
-    String message = "";
-    if (request->hasParam("success")) {
-        message = "<p class='success'>Camera settings saved!</p>";
-    }
-
-    String body = R"rawliteral(
-        <div class='card' style='padding: 0; text-align: center;'>
-            <div id='camera-feed' style='width: 100%; height: 480px; background-color: #000; color: #fff; display: flex; align-items: center; justify-content: center; border-radius: 8px 8px 0 0; position: relative;'>
-                <img id='camera-stream' src='/stream' style='max-width: 100%; max-height: 100%; object-fit: contain; display: none;' onerror='showCameraError()' onload='showCameraStream()' />
-                <p id='camera-error' style='margin: 0;'>Loading camera feed...</p>
-            </div>
-        </div>
-        <div class='card' style='margin-top: 2rem;'>
-            <h2>Camera Controls - OV3660 Sensor</h2>
-            )rawliteral" + message + R"rawliteral(
-            <div style='margin-bottom: 1rem; padding: 0.75rem; background-color: #444; border-radius: 6px; font-size: 0.9em;'>
-                <strong>Current Settings:</strong> <span id='current-resolution'>Loading...</span> | Quality: <span id='current-quality'>Loading...</span>
-            </div>
-            <div style='display: flex; justify-content: space-between; gap: 2rem; margin-bottom: 1rem;'>
-                <div class='form-group' style='flex: 1;'>
-                    <label for='resolution'>Resolution <small>(OV3660 Supported)</small></label>
-                    <select id='resolution' name='resolution'>
-                        <option value='QXGA'>QXGA (2048x1536) - 3.1MP [MAX]</option>
-                        <option value='UXGA'>UXGA (1600x1200) - 1.9MP</option>
-                        <option value='FHD'>Full HD (1920x1080) - 2.1MP</option>
-                        <option value='SXGA'>SXGA (1280x1024) - 1.3MP</option>
-                        <option value='HD'>HD (1280x720) - 0.9MP</option>
-                        <option value='XGA'>XGA (1024x768) - 0.8MP</option>
-                        <option value='SVGA' selected>SVGA (800x600) - 0.5MP</option>
-                        <option value='VGA'>VGA (640x480) - 0.3MP</option>
-                        <option value='HVGA'>HVGA (480x320) - 0.2MP</option>
-                        <option value='CIF'>CIF (400x296) - 0.1MP</option>
-                        <option value='QVGA'>QVGA (320x240) - 0.08MP</option>
-                    </select>
-                </div>
-                <div class='form-group' style='flex: 1;'>
-                    <label for='quality'>JPEG Quality (<span id='quality-val'>12</span>) <small>Lower = Higher Quality</small></label>
-                    <input type='range' id='quality' name='quality' min='0' max='63' value='12' oninput="updateQualityDisplay(this.value)">
-                    <div style='display: flex; justify-content: space-between; font-size: 0.8em; color: #bbb; margin-top: 0.25rem;'>
-                        <span>0 (Best)</span>
-                        <span>31 (Good)</span>
-                        <span>63 (Lowest)</span>
-                    </div>
-                </div>
-            </div>
-            <div style='display: flex; gap: 1rem;'>
-                <button onclick='saveCameraSettings()' style='flex: 1;'>Save Settings</button>
-                <button onclick='loadCurrentSettings()' style='flex: 1; background-color: #666;'>Refresh Current</button>
-            </div>
-        </div>
-        <script>
-            let refreshInterval;
-            
-            function showCameraStream() {
-                document.getElementById('camera-stream').style.display = 'block';
-                document.getElementById('camera-error').style.display = 'none';
-                startAutoRefresh();
-            }
-            
-            function showCameraError() {
-                document.getElementById('camera-stream').style.display = 'none';
-                document.getElementById('camera-error').style.display = 'block';
-                document.getElementById('camera-error').textContent = 'Camera feed not available.';
-                stopAutoRefresh();
-            }
-            
-            function refreshCamera() {
-                const img = document.getElementById('camera-stream');
-                const timestamp = new Date().getTime();
-                img.src = '/stream?t=' + timestamp;
-            }
-            
-            function startAutoRefresh() {
-                stopAutoRefresh();
-                refreshInterval = setInterval(refreshCamera, 500); // Refresh every 500ms
-            }
-            
-            function stopAutoRefresh() {
-                if (refreshInterval) {
-                    clearInterval(refreshInterval);
-                    refreshInterval = null;
-                }
-            }
-            
-            function updateQualityDisplay(value) {
-                document.getElementById('quality-val').innerText = value;
-                const qualityDesc = value <= 10 ? 'Excellent' : 
-                                   value <= 20 ? 'Very Good' : 
-                                   value <= 35 ? 'Good' : 
-                                   value <= 50 ? 'Fair' : 'Low';
-                document.getElementById('quality-val').innerText = value + ' (' + qualityDesc + ')';
-            }
-            
-            function loadCurrentSettings() {
-                fetch('/status')
-                    .then(response => response.json())
-                    .then(data => {
-                        // Update current settings display
-                        const resolutionNames = {
-                            0: 'QVGA (320x240)', 1: 'CIF (400x296)', 2: 'HVGA (480x320)', 
-                            3: 'VGA (640x480)', 4: 'SVGA (800x600)', 5: 'XGA (1024x768)', 
-                            6: 'HD (1280x720)', 7: 'SXGA (1280x1024)', 8: 'UXGA (1600x1200)', 
-                            9: 'FHD (1920x1080)', 13: 'QXGA (2048x1536)'
-                        };
-                        const currentRes = resolutionNames[data.framesize] || 'Unknown';
-                        document.getElementById('current-resolution').innerText = currentRes;
-                        document.getElementById('current-quality').innerText = data.quality + ' (' + 
-                            (data.quality <= 10 ? 'Excellent' : 
-                             data.quality <= 20 ? 'Very Good' : 
-                             data.quality <= 35 ? 'Good' : 
-                             data.quality <= 50 ? 'Fair' : 'Low') + ')';
-                    })
-                    .catch(error => {
-                        console.error('Failed to load current settings:', error);
-                        document.getElementById('current-resolution').innerText = 'Error';
-                        document.getElementById('current-quality').innerText = 'Error';
-                    });
-            }
-
-            function saveCameraSettings() {
-                const resolution = document.getElementById('resolution').value;
-                const quality = document.getElementById('quality').value;
-                
-                console.log('Saving camera settings:', resolution, quality);
-                
-                fetch('/api/camera-settings', {
-                    method: 'POST',
-                    headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
-                    body: `resolution=${resolution}&quality=${quality}`
-                }).then(response => {
-                    console.log('Response status:', response.status);
-                    if (response.ok) {
-                        loadCurrentSettings(); // Refresh current settings
-                        alert('Camera settings saved successfully!');
-                    } else {
-                        response.text().then(errorText => {
-                            console.error('Error response:', errorText);
-                            alert('Failed to save camera settings: ' + errorText);
-                        });
-                    }
-                }).catch(error => {
-                    console.error('Network error:', error);
-                    alert('Network error: ' + error.message);
-                });
-            }
-            
-            // Load current settings when page loads
-            document.addEventListener('DOMContentLoaded', function() {
-                loadCurrentSettings();
-                updateQualityDisplay(document.getElementById('quality').value);
-            });
-            
-            // Clean up interval when page is unloaded
-            window.addEventListener('beforeunload', stopAutoRefresh);
-        </script>
-    )rawliteral";
-    request->send(200, "text/html", getPageTemplate("Monitor", body, true));
+    sendPageShell(request, "monitor.html");
 }
 
 void handleTrainPage(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->redirect("/login"); return; }
+    sendPageShell(request, "train.html");
+}
 
-    preferences.begin("beecounter", true);
-    String eiApiKey = preferences.getString("eiApiKey", "");
-    preferences.end();
-
-    String message = "";
-    if (request->hasParam("success")) {
-        message = "<p class='success'>Edge Impulse credentials saved!</p>";
-    }
-    
-    String body = R"rawliteral(
-        <style>
-            #image-gallery { display: grid; grid-template-columns: repeat(auto-fill, minmax(150px, 1fr)); gap: 1rem; }
-            .img-container { position: relative; }
-            .img-container img { width: 100%; height: auto; border-radius: 8px; }
-            .img-container .delete-btn { position: absolute; top: 5px; right: 5px; background: rgba(0,0,0,0.7); color: white; border: none; border-radius: 50%; cursor: pointer; width: 25px; height: 25px; font-size: 16px; line-height: 25px; text-align: center;}
-            #progress-bar-container { width: 100%; background-color: #555; border-radius: 8px; margin-bottom: 1rem; }
-            #progress-bar { width: 0%; height: 30px; background-color: #4CAF50; border-radius: 8px; text-align: center; line-height: 30px; color: white; }
-            .grid-container { display: grid; grid-template-columns: 1fr 1fr; gap: 2rem; }
-        </style>
-        <h2>Training Workflow</h2>
-        )rawliteral" + message + R"rawliteral(
-        <div class="grid-container">
-            <div class='card'>
-                <h3>Step 1: Data Collection</h3>
-                <p>Automatically capture 50 images over 24 hours, or take manual snapshots.</p>
-                <div style='display: flex; justify-content: space-around; margin-bottom: 1rem;'>
-                    <button onclick='startCollection()'>Start Auto</button>
-                    <button onclick='stopCollection()'>Stop Auto</button>
-                    <button onclick='takePhoto()'>Manual Photo</button>
-                </div>
-                <div id="progress-bar-container">
-                    <div id="progress-bar">0%</div>
-                </div>
-                <p id='collection-status'>Status: Idle</p>
-            </div>
-
-            <div class='card'>
-                <h3>Step 2: Upload to Edge Impulse</h3>
-                <form id="ei-form">
-                    <div class='form-group'>
-                        <label for='ei-api-key'>API Key</label>
-                        <input type='password' id='ei-api-key' name='ei-api-key' value=')rawliteral" + eiApiKey + R"rawliteral(' required>
-                    </div>
-                    <div class='form-group'>
-                        <label for='ei-label'>Image Label</label>
-                        <input type='text' id='ei-label' name='ei-label' value='bee' required>
-                    </div>
-                    <button type='button' onclick='saveEdgeImpulseSettings()'>Save Settings</button>
-                    <button type='button' onclick='uploadToEdgeImpulse()' style='margin-top: 1rem;'>Upload All Images</button>
-                </form>
-                <p id='upload-status' style='margin-top: 1rem;'>Status: Idle</p>
-            </div>
-        </div>
-
-        <div class='card' style='margin-top: 2rem;'>
-            <h3>Collected Images (<span id="img-count">0</span>)</h3>
-            <div id='image-gallery'></div>
-        </div>
-
-        <script>
-            function startCollection() { fetch('/api/capture/start', { method: 'POST' }).then(() => alert('Collection Started!')); }
-            function stopCollection() { fetch('/api/capture/stop', { method: 'POST' }).then(() => alert('Collection Stopped!')); }
-            function takePhoto() { fetch('/api/capture/photo', { method: 'POST' }).then(() => setTimeout(loadImageGallery, 500)); }
-            function saveEdgeImpulseSettings() {
-                const apiKey = document.getElementById('ei-api-key').value;
-                fetch('/api/edgeimpulse/settings', {
-                    method: 'POST',
-                    headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
-                    body: `ei-api-key=${apiKey}`
-                }).then(response => {
-                    if (response.ok) { window.location.href = '/train?success=1'; } 
-                    else { alert('Failed to save settings.'); }
-                });
-            }
-            function uploadToEdgeImpulse() {
-                const label = document.getElementById('ei-label').value;
-                if (!label) { alert('Please provide a label for the images.'); return; }
-                document.getElementById('upload-status').innerText = 'Status: Starting upload...';
-                fetch('/api/edgeimpulse/upload', { 
-                    method: 'POST',
-                    headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
-                    body: `ei-label=${label}`
-                });
-            }
-
-            function loadImageGallery() {
-                fetch('/api/images')
-                    .then(response => response.json())
-                    .then(images => {
-                        const gallery = document.getElementById('image-gallery');
-                        gallery.innerHTML = '';
-                        document.getElementById('img-count').innerText = images.length;
-                        images.forEach(image => {
-                            const container = document.createElement('div');
-                            container.className = 'img-container';
-                            const img = document.createElement('img');
-                            img.src = '/images?serve=' + image.substring(8);
-                            const btn = document.createElement('button');
-                            btn.className = 'delete-btn';
-                            btn.innerHTML = '&times;';
-                            btn.onclick = () => deleteImage(image.substring(8));
-                            container.appendChild(img);
-                            container.appendChild(btn);
-                            gallery.appendChild(container);
-                        });
-                    });
-            }
-
-            function deleteImage(filename) {
-                if (confirm('Are you sure you want to delete ' + filename + '?')) {
-                    fetch('/images?delete=' + filename).then(() => loadImageGallery());
-                }
-            }
-
-            document.addEventListener('DOMContentLoaded', function() {
-                loadImageGallery();
-                const source = new EventSource('/events');
-                source.addEventListener('collection_update', function(e) {
-                    const data = JSON.parse(e.data);
-                    const progressBar = document.getElementById('progress-bar');
-                    progressBar.style.width = data.progress + '%';
-                    progressBar.innerText = data.progress + '%';
-                    document.getElementById('collection-status').innerText = `Status: Collecting (${data.collected}/${data.total})`;
-                    if (data.progress === 100) {
-                         document.getElementById('collection-status').innerText = 'Status: Collection Complete!';
-                         setTimeout(loadImageGallery, 500);
-                    }
-                });
-                source.addEventListener('ei_upload_status', function(e) {
-                    document.getElementById('upload-status').innerText = `Status: ${e.data}`;
-                });
-            });
-        </script>
-    )rawliteral";
-    request->send(200, "text/html", getPageTemplate("Train", body, true));
+void handleEdgeImpulseSettingsInfo(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    JsonDocument doc;
+    doc["api_key"] = deviceConfig.get().eiApiKey;
+    String json;
+    serializeJson(doc, json);
+    request->send(200, "application/json", json);
 }
 
 void handleEdgeImpulseSettings(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
     if (request->hasParam("ei-api-key", true)) {
-        preferences.begin("beecounter", false);
-        preferences.putString("eiApiKey", request->getParam("ei-api-key", true)->value());
-        preferences.end();
-        request->send(200, "text/plain", "OK");
+        DeviceConfig::Batch batch = deviceConfig.edit();
+        batch.setString(CONFIG_EI_API_KEY, request->getParam("ei-api-key", true)->value().c_str());
+        if (batch.commit()) {
+            request->send(200, "text/plain", "OK");
+        } else {
+            request->send(400, "text/plain", "API key too long");
+        }
     } else {
         request->send(400, "text/plain", "Bad Request");
     }
@@ -1584,9 +1400,7 @@ void handleEdgeImpulseUpload(AsyncWebServerRequest *request) {
 
     String label = request->getParam("ei-label", true)->value();
     
-    preferences.begin("beecounter", true);
-    String apiKey = preferences.getString("eiApiKey", "");
-    preferences.end();
+    String apiKey = deviceConfig.get().eiApiKey;
 
     if (apiKey.length() == 0) {
         request->send(400, "text/plain", "API Key not set");
@@ -1600,9 +1414,7 @@ void handleEdgeImpulseUpload(AsyncWebServerRequest *request) {
         String label = *(String*)pvParameters;
         delete (String*)pvParameters;
 
-        preferences.begin("beecounter", true);
-        String apiKey = preferences.getString("eiApiKey", "");
-        preferences.end();
+        String apiKey = deviceConfig.get().eiApiKey;
 
         File root = LittleFS.open("/images");
         if (!root) {
@@ -1672,10 +1484,10 @@ void handleSetCameraSettings(AsyncWebServerRequest *request) {
         int quality = request->getParam("quality", true)->value().toInt();
 
         // Save to preferences
-        preferences.begin("beecounter", false);
-        preferences.putString("cam_res", resolution);
-        preferences.putInt("cam_qlty", quality);
-        preferences.end();
+        DeviceConfig::Batch batch = deviceConfig.edit();
+        batch.setString(CONFIG_CAM_RESOLUTION, resolution.c_str());
+        batch.setInt(CONFIG_CAM_QUALITY, quality);
+        batch.commit();
 
         // Apply settings in real-time with watchdog management
         sensor_t *s = esp_camera_sensor_get();
@@ -1733,288 +1545,248 @@ void handleSetRefreshRate(AsyncWebServerRequest *request) {
     }
 }
 
-void handleObservabilityPage(AsyncWebServerRequest *request) {
-    if (!isAuthenticated(request)) { request->redirect("/login"); return; }
+void addInferenceProfileJson(JsonObject obj, const InferenceProfile& profile) {
+    obj["sequence"] = profile.sequence;
+    obj["timestamp"] = profile.timestamp;
+    obj["invoke_us"] = profile.invokeUs;
+    obj["arena_used"] = profile.arenaUsed;
+    obj["arena_size"] = profile.arenaSize;
+    obj["ops_dropped"] = profile.opsDropped;
+    JsonArray ops = obj["ops"].to<JsonArray>();
+    for (uint16_t i = 0; i < profile.opCount; i++) {
+        JsonObject op = ops.add<JsonObject>();
+        op["op"] = profile.ops[i].name ? profile.ops[i].name : "?";
+        op["us"] = profile.ops[i].us;
+    }
+}
 
-    String body = R"rawliteral(
-        <h2>Observability</h2>
-        <div class='form-group' style='max-width: 200px;'>
-            <label for='refresh-rate'>Refresh Rate</label>
-            <select id='refresh-rate'>
-                <option value='5000' selected>5 Seconds</option>
-                <option value='10000'>10 Seconds</option>
-                <option value='60000'>60 Seconds</option>
-            </select>
-        </div>
-        <div class='card'><canvas id='cpu-chart'></canvas></div>
-        <div class='card'><canvas id='temp-chart'></canvas></div>
-        <div class='card'><canvas id='wifi-chart'></canvas></div>
-        <div style='display: flex; justify-content: space-between; gap: 2rem;'>
-            <div class='card' style='width: 50%;'><canvas id='memory-chart'></canvas></div>
-            <div class='card' style='width: 50%;'><canvas id='storage-chart'></canvas></div>
-        </div>
-        <script src='https://cdn.jsdelivr.net/npm/chart.js'></script>
-        <script src='https://cdn.jsdelivr.net/npm/chartjs-plugin-annotation@3.0.1/dist/chartjs-plugin-annotation.min.js'></script>
-        <script>
-            document.addEventListener('DOMContentLoaded', function() {
-                console.log("Observability page JavaScript loaded and DOMContentLoaded fired.");
-                // --- Chart.js Configuration ---
-                const chartOptions = (title, threshold) => ({
-                    responsive: true,
-                    maintainAspectRatio: false,
-                    scales: {
-                        x: { ticks: { color: '#FFC300' }, grid: { color: '#444' } },
-                        y: { ticks: { color: '#FFC300' }, grid: { color: '#444' } }
-                    },
-                    plugins: {
-                        legend: { labels: { color: '#FFC300' } },
-                        annotation: {
-                            annotations: {
-                                line1: {
-                                    type: 'line',
-                                    yMin: threshold,
-                                    yMax: threshold,
-                                    borderColor: 'rgb(211, 47, 47, 0.8)',
-                                    borderWidth: 2,
-                                    borderDash: [6, 6],
-                                    label: {
-                                        content: title,
-                                        position: 'end',
-                                        backgroundColor: 'rgba(211, 47, 47, 0.8)',
-                                        color: '#fff',
-                                        font: { style: 'normal' }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                });
+void handleProfilerInfo(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    JsonDocument doc;
+    doc["enabled"] = inferenceProfiler.isEnabled();
+    doc["history"] = INFERENCE_PROFILER_HISTORY;
+    doc["sequence"] = inferenceProfiler.sequence();
+    doc["arena_high_water"] = inferenceProfiler.arenaHighWater();
+    JsonArray invocations = doc["invocations"].to<JsonArray>();
+    InferenceProfile profile;
+    for (size_t age = 0; inferenceProfiler.get(age, profile); age++) {
+        addInferenceProfileJson(invocations.add<JsonObject>(), profile);
+    }
+    // Filled only by a firmware built with EI_CLASSIFIER_TFLITE_WEIGHT_PREFETCH=1
+    JsonObject prefetch = doc["prefetch"].to<JsonObject>();
+    prefetch["enabled"] = weightPrefetch.isEnabled();
+    prefetch["sequence"] = weightPrefetch.sequence();
+    static WeightPrefetchReport prefetchReport;
+    if (weightPrefetch.last(prefetchReport)) {
+        prefetch["invoke_us"] = prefetchReport.invokeUs;
+        prefetch["stall_us"] = prefetchReport.stallUs;
+        prefetch["copied_bytes"] = prefetchReport.copiedBytes;
+        prefetch["prefetched_layers"] = prefetchReport.prefetchedLayers;
+        JsonArray layers = prefetch["layers"].to<JsonArray>();
+        for (uint16_t i = 0; i < prefetchReport.layerCount; i++) {
+            const WeightPrefetchLayer& layer = prefetchReport.layers[i];
+            JsonObject obj = layers.add<JsonObject>();
+            obj["op"] = layer.op;
+            obj["bytes"] = layer.bytes;
+            obj["stall_us"] = layer.stallUs;
+            obj["op_us"] = layer.opUs;
+        }
+    }
+    String json;
+    serializeJson(doc, json);
+    request->send(200, "application/json", json);
+}
 
-                 const doughnutChartOptions = {
-                    responsive: true,
-                    maintainAspectRatio: false,
-                    plugins: { legend: { position: 'top', labels: { color: '#FFC300' } } }
-                };
-
-                // --- CPU Chart ---
-                const cpuCtx = document.getElementById('cpu-chart').getContext('2d');
-                const cpuChart = new Chart(cpuCtx, {
-                    type: 'line',
-                    data: {
-                        labels: [],
-                        datasets: [{ label: 'CPU Core 0 (%)', data: [], borderColor: '#FFC300', backgroundColor: 'rgba(255, 195, 0, 0.2)', fill: true }, {
-                            label: 'CPU Core 1 (%)', data: [], borderColor: '#00A8E8', backgroundColor: 'rgba(0, 168, 232, 0.2)', fill: true
-                        }]
-                    },
-                    options: chartOptions('High Load', 70)
-                });
+// LittleFS.usedBytes() walks the file system, so it is read less often
+#define TELEMETRY_FLASH_MS 10000
 
-                // --- Temperature Chart ---
-                const tempCtx = document.getElementById('temp-chart').getContext('2d');
-                const tempChart = new Chart(tempCtx, {
-                    type: 'line',
-                    data: {
-                        labels: [],
-                        datasets: [{ label: 'CPU Temp (°C)', data: [], borderColor: '#FF5722', backgroundColor: 'rgba(255, 87, 34, 0.2)', fill: true }]
-                    },
-                    options: chartOptions('High Temp', 60)
-                });
+void sampleTelemetry(TelemetrySample& sample) {
+    static unsigned long lastFlashRead = 0;
+    static int32_t flashUsed = 0, flashTotal = 0;
+    if (lastFlashRead == 0 || millis() - lastFlashRead >= TELEMETRY_FLASH_MS) {
+        flashUsed = LittleFS.usedBytes();
+        flashTotal = LittleFS.totalBytes();
+        lastFlashRead = millis();
+    }
+    calculate_cpu_usage();
+    sample.values[TELEMETRY_CPU0] = (int32_t)(cpu_0_usage * 10.0f + 0.5f);
+    sample.values[TELEMETRY_CPU1] = (int32_t)(cpu_1_usage * 10.0f + 0.5f);
+    sample.values[TELEMETRY_HEAP_FREE] = ESP.getFreeHeap();
+    sample.values[TELEMETRY_HEAP_TOTAL] = ESP.getHeapSize();
+    sample.values[TELEMETRY_FLASH_USED] = flashUsed;
+    sample.values[TELEMETRY_FLASH_TOTAL] = flashTotal;
+    sample.values[TELEMETRY_RSSI] = WiFi.RSSI();
+    sample.values[TELEMETRY_TEMP] = (int32_t)lroundf(temperatureRead() * 10.0f);
+}
 
-                // --- Wi-Fi Chart ---
-                const wifiCtx = document.getElementById('wifi-chart').getContext('2d');
-                const wifiChart = new Chart(wifiCtx, {
-                    type: 'line',
-                    data: {
-                        labels: [],
-                        datasets: [{ label: 'WiFi RSSI (dBm)', data: [], borderColor: '#4CAF50', backgroundColor: 'rgba(76, 175, 80, 0.2)', fill: true }]
-                    },
-                    options: chartOptions('Poor Signal', -70)
-                });
+void sampleHistory(HistoryRecord& sample, unsigned long elapsedMs) {
+    uint32_t frames, beesIn, beesOut;
+    telemetryHistory.takeCounts(&frames, &beesIn, &beesOut);
+    calculate_cpu_usage();
+    sample.values[HISTORY_TIME] = (int32_t)time(nullptr);
+    sample.values[HISTORY_CPU0] = (int32_t)(cpu_0_usage * 10.0f + 0.5f);
+    sample.values[HISTORY_CPU1] = (int32_t)(cpu_1_usage * 10.0f + 0.5f);
+    sample.values[HISTORY_HEAP_FREE] = ESP.getFreeHeap();
+    sample.values[HISTORY_PSRAM_FREE] = ESP.getFreePsram();
+    sample.values[HISTORY_RSSI] = WiFi.RSSI(); // 0 while disconnected
+    sample.values[HISTORY_TEMP] = (int32_t)lroundf(temperatureRead() * 10.0f);
+    sample.values[HISTORY_FPS] = elapsedMs > 0 ? (int32_t)((uint64_t)frames * 10000 / elapsedMs) : 0;
+    sample.values[HISTORY_BEES_IN] = beesIn;
+    sample.values[HISTORY_BEES_OUT] = beesOut;
+}
 
-                // --- Memory Chart ---
-                const memoryCtx = document.getElementById('memory-chart').getContext('2d');
-                const memoryChart = new Chart(memoryCtx, {
-                    type: 'doughnut',
-                    data: {
-                        labels: ['Used Heap (bytes)', 'Free Heap (bytes)'],
-                        datasets: [{ data: [0, 0], backgroundColor: ['#FFC300', '#444'] }]
-                    },
-                    options: doughnutChartOptions
-                });
+void handleTelemetryHistory(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    sendTelemetryHistory(request);
+}
 
-                // --- Storage Chart ---
-                const storageCtx = document.getElementById('storage-chart').getContext('2d');
-                const storageChart = new Chart(storageCtx, {
-                    type: 'doughnut',
-                    data: {
-                        labels: ['Used Flash (bytes)', 'Free Flash (bytes)'],
-                        datasets: [{ data: [0, 0], backgroundColor: ['#00A8E8', '#444'] }]
-                    },
-                    options: doughnutChartOptions
-                });
+void handleTelemetryHistorySettings(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    if (!request->hasParam("snapshot", true)) { request->send(400, "text/plain", "Bad Request"); return; }
+    bool snapshot = request->getParam("snapshot", true)->value() == "1";
+    DeviceConfig::Batch batch = deviceConfig.edit();
+    batch.setBool(CONFIG_HISTORY_SNAPSHOT, snapshot);
+    if (!batch.commit()) { request->send(500, "text/plain", "Save failed"); return; }
+    // A snapshot left behind would come back at the next boot
+    if (!snapshot) LittleFS.remove(TELEMETRY_HISTORY_PATH);
+    request->send(200, "text/plain", "OK");
+}
 
-                // --- Server-Sent Events ---
-                if (!!window.EventSource) {
-                    var source = new EventSource('/events');
-
-                    source.onopen = function(e) { console.log("Events Connected"); };
-                    source.onerror = function(e) { 
-                        console.error("EventSource error:", e);
-                        if (e.target.readyState != EventSource.OPEN) { console.log("Events Disconnected"); } 
-                    };
-
-                    source.addEventListener('performance_update', function(e) {
-                        console.log("Performance update event received:", e.data);
-                        const data = JSON.parse(e.data);
-                        
-                        const now = new Date();
-                        const timestamp = `${now.getHours()}:${now.getMinutes()}:${now.getSeconds()}`;
-
-                        // Update CPU Chart
-                        cpuChart.data.labels.push(timestamp);
-                        cpuChart.data.datasets[0].data.push(data.cpu_core_0);
-                        cpuChart.data.datasets[1].data.push(data.cpu_core_1);
-                        if (cpuChart.data.labels.length > 20) {
-                            cpuChart.data.labels.shift();
-                            cpuChart.data.datasets[0].data.shift();
-                            cpuChart.data.datasets[1].data.shift();
-                        }
-                        cpuChart.update();
-
-                        // Update Temperature Chart
-                        tempChart.data.labels.push(timestamp);
-                        tempChart.data.datasets[0].data.push(data.cpu_temp);
-                        if (tempChart.data.labels.length > 20) {
-                            tempChart.data.labels.shift();
-                            tempChart.data.datasets[0].data.shift();
-                        }
-                        tempChart.update();
-
-                        // Update WiFi Chart
-                        wifiChart.data.labels.push(timestamp);
-                        wifiChart.data.datasets[0].data.push(data.wifi_rssi);
-                        if (wifiChart.data.labels.length > 20) {
-                            wifiChart.data.labels.shift();
-                            wifiChart.data.datasets[0].data.shift();
-                        }
-                        wifiChart.update();
-
-                        // Update Memory Chart
-                        const heapUsedPercent = (data.heap_used / data.heap_total) * 100;
-                        memoryChart.data.datasets[0].backgroundColor[0] = heapUsedPercent > 70 ? '#D32F2F' : '#FFC300';
-                        memoryChart.data.datasets[0].data[0] = data.heap_used;
-                        memoryChart.data.datasets[0].data[1] = data.heap_total - data.heap_used;
-                        memoryChart.update();
-
-                        // Update Storage Chart
-                        const flashUsedPercent = (data.flash_used / data.flash_total) * 100;
-                        storageChart.data.datasets[0].backgroundColor[0] = flashUsedPercent > 70 ? '#D32F2F' : '#00A8E8';
-                        storageChart.data.datasets[0].data[0] = data.flash_used;
-                        storageChart.data.datasets[0].data[1] = data.flash_total - data.flash_used;
-                        storageChart.update();
-                    }, false);
-                }
+void handleTelemetryInfo(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    TelemetryStats stats = telemetrySocket.stats();
+    JsonDocument doc;
+    doc["clients"] = stats.clients;
+    doc["sample_ms"] = TELEMETRY_SAMPLE_MS;
+    doc["frame_ms"] = performanceUpdateInterval;
+    doc["samples"] = stats.samples;
+    doc["frames"] = stats.frames;
+    doc["dropped"] = stats.dropped;
+    doc["bytes"] = stats.bytes;
+    doc["encode_us"] = stats.encodeUs;
+    JsonObject history = doc["history"].to<JsonObject>();
+    history["memory_bytes"] = telemetryHistory.memoryBytes();
+    history["snapshot"] = deviceConfig.get().historySnapshot;
+    JsonArray tiers = history["tiers"].to<JsonArray>();
+    for (int tier = 0; tier < TELEMETRY_HISTORY_TIERS; tier++) {
+        uint32_t first, end;
+        telemetryHistory.window(tier, &first, &end);
+        JsonObject obj = tiers.add<JsonObject>();
+        obj["seconds"] = telemetryHistory.tierSeconds(tier);
+        obj["records"] = end - first;
+    }
+    String json;
+    serializeJson(doc, json);
+    request->send(200, "application/json", json);
+}
 
-                // --- Refresh Rate Control ---
-                const refreshRateSelect = document.getElementById('refresh-rate');
-                refreshRateSelect.addEventListener('change', function() {
-                    fetch('/api/set-refresh-rate', {
-                        method: 'POST',
-                        headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
-                        body: 'rate=' + this.value
-                    });
-                });
-            });
-        </script>
-    )rawliteral";
+void handleProfilerSettings(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    if (request->hasParam("clear", true)) {
+        inferenceProfiler.clear();
+    }
+    if (request->hasParam("enabled", true)) {
+        bool enable = request->getParam("enabled", true)->value() == "1";
+        inferenceProfiler.setEnabled(enable);
+        Serial.printf("INFO: Inference profiler %s\n", enable ? "enabled" : "disabled");
+    }
+    if (request->hasParam("prefetch", true)) {
+        bool enable = request->getParam("prefetch", true)->value() == "1";
+        weightPrefetch.setEnabled(enable);
+        Serial.printf("INFO: Weight prefetch %s\n", enable ? "enabled" : "disabled");
+    }
+    request->send(200, "text/plain", "OK");
+}
 
-    request->send(200, "text/html", getPageTemplate("Observability", body, true));
+void handleObservabilityPage(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->redirect("/login"); return; }
+    sendPageShell(request, "observability.html");
 }
 
+static const char ADMIN_BODY[] = "<h2>Administer</h2>{{notice}}"
+    "<div style='display: flex; gap: 2rem;'>"
+    "<div class='card' style='flex: 1;'>"
+    "<h3>Change Password</h3>"
+    "<form action='/admin/changepass' method='POST'>"
+    "<div class='form-group'><label>Current Password</label><input type='password' name='current_password' required></div>"
+    "<div class='form-group'><label>New Password</label><input type='password' name='new_password' pattern='(?=.*\\d)(?=.*[a-z])(?=.*[A-Z])(?=.*[^A-Za-z0-9]).{8,}' title='Must contain at least one number, one uppercase, one lowercase, one special character, and at least 8 or more characters' required></div>"
+    "<div class='form-group'><label>Confirm New Password</label><input type='password' name='confirm_password' required></div>"
+    "<button type='submit'>Update Password</button>"
+    "</form>"
+    "</div>"
+    "<div class='card' style='flex: 1;'>"
+    "<h3>System</h3>"
+    "<p>The currently set timezone is: <strong>{{timezone}}</strong></p>"
+    "<form action='/admin/find-timezone' method='POST' style='margin-bottom:1rem;'>"
+    "<button type='submit'>Auto-Detect Timezone</button>"
+    "</form>"
+    "<form action='/admin/reboot' method='POST' onsubmit='return confirm(\"Are you sure you want to reboot?\" );' style='margin-bottom:1rem;'>"
+    "<button type='submit'>Reboot Device</button>"
+    "</form>"
+    "<form action='/factory-reset' method='POST' onsubmit='return confirm(\"Are you sure? This erases all settings.\" );'>"
+    "<button type='submit' class='danger'>Factory Reset</button>"
+    "</form>"
+    "</div>"
+    "</div>"
+    "<div class='card' style='margin-top: 2rem;'>"
+    "<h3>Firmware Update (OTA)</h3>"
+    "<p>Upload a new firmware binary. The device will update and reboot automatically. Ensure the file is a valid `.bin` file for this hardware.</p>"
+    "<form method='POST' action='/update' enctype='multipart/form-data'>"
+    "<div class='form-group'><input type='file' name='update' accept='.bin'></div>"
+    "<button type='submit'>Upload and Update</button>"
+    "</form>"
+    "<p><small>Note: For this to work, you must upload the firmware via the PlatformIO OTA command: `pio run --target upload --upload-port [DEVICE_IP]`</small></p>"
+    "</div>";
+
 void handleAdminPage(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->redirect("/login"); return; }
 
-    String message = "";
+    PageRenderer* page = newPage("Administer", ADMIN_BODY, true);
     if (request->hasParam("success")) {
-        message = "<p class='success'>Password updated successfully!</p>";
+        setNotice(page, "success", "Password updated successfully!");
     }
     if (request->hasParam("error")) {
-        message = "<p class='error'>" + request->getParam("error")->value() + "</p>";
+        setNotice(page, "error", request->getParam("error")->value().c_str());
     }
     if (request->hasParam("tz_success")) {
-        message = "<p class='success'>Timezone found and saved! Please reboot for the change to take effect.</p>";
+        setNotice(page, "success", "Timezone found and saved!");
     }
     if (request->hasParam("tz_error")) {
-        message = "<p class='error'>Failed to find timezone.</p>";
-    }
-
-    preferences.begin("beecounter", true);
-    String currentTz = preferences.getString("timezone", "UTC");
-    preferences.end();
-
-    String body = "<h2>Administer</h2>" + message +
-                  "<div style='display: flex; gap: 2rem;'>" +
-                  "<div class='card' style='flex: 1;'>" +
-                  "<h3>Change Password</h3>" +
-                  "<form action='/admin/changepass' method='POST'>" +
-                  "<div class='form-group'><label>Current Password</label><input type='password' name='current_password' required></div>" +
-                  "<div class='form-group'><label>New Password</label><input type='password' name='new_password' pattern='(?=.*\\d)(?=.*[a-z])(?=.*[A-Z])(?=.*[^A-Za-z0-9]).{8,}' title='Must contain at least one number, one uppercase, one lowercase, one special character, and at least 8 or more characters' required></div>" +
-                  "<div class='form-group'><label>Confirm New Password</label><input type='password' name='confirm_password' required></div>" +
-                  "<button type='submit'>Update Password</button>" +
-                  "</form>" +
-                  "</div>" +
-                  "<div class='card' style='flex: 1;'>" +
-                  "<h3>System</h3>" +
-                  "<p>The currently set timezone is: <strong>" + getReadableTimezone(currentTz) + "</strong></p>" +
-                  "<form action='/admin/find-timezone' method='POST' style='margin-bottom:1rem;'>" +
-                  "<button type='submit'>Auto-Detect Timezone</button>" +
-                  "</form>" +
-                  "<form action='/admin/reboot' method='POST' onsubmit='return confirm(\"Are you sure you want to reboot?\" );' style='margin-bottom:1rem;'>" +
-                  "<button type='submit'>Reboot Device</button>" +
-                  "</form>" +
-                  "<form action='/factory-reset' method='POST' onsubmit='return confirm(\"Are you sure? This erases all settings.\" );'>" +
-                  "<button type='submit' class='danger'>Factory Reset</button>" +
-                  "</form>" +
-                  "</div>" +
-                  "</div>" +
-                  "<div class='card' style='margin-top: 2rem;'>" +
-                  "<h3>Firmware Update (OTA)</h3>" +
-                  "<p>Upload a new firmware binary. The device will update and reboot automatically. Ensure the file is a valid `.bin` file for this hardware.</p>" +
-                  "<form method='POST' action='/update' enctype='multipart/form-data'>" +
-                  "<div class='form-group'><input type='file' name='update' accept='.bin'></div>" +
-                  "<button type='submit'>Upload and Update</button>" +
-                  "</form>" +
-                  "<p><small>Note: For this to work, you must upload the firmware via the PlatformIO OTA command: `pio run --target upload --upload-port [DEVICE_IP]`</small></p>" +
-                  "</div>";
-
-    request->send(200, "text/html", getPageTemplate("Administer", body, true));
+        setNotice(page, "error", "Failed to find timezone.");
+    }
+
+    page->set("timezone", getReadableTimezone(deviceConfig.get().timezone).c_str());
+
+    sendPage(request, page);
 }
 
+static const char ABOUT_BODY[] = "<div class='card'><h2>About BeeCounter</h2>"
+    "<p>This device is designed to monitor bee activity at a hive entrance.</p>"
+    "<ul>"
+    "<li><strong>Firmware Version:</strong> {{version}}</li>"
+    "<li><strong>Build Date:</strong> " BUILD_DATE "</li>"
+    "<li><strong>Build Host:</strong> " BUILD_HOST "</li>"
+    "<li><strong>Build Platform:</strong> " BUILD_PLATFORM "</li>"
+    "<li><strong>Build Operating System:</strong> {{build_os}}</li>"
+    "<li><strong>Local IP Address:</strong> {{local_ip}}</li>"
+    "<li><strong>Public IP Address:</strong> {{public_ip}}</li>"
+    "</ul>"
+    "<p><a href='/changelog'>View Full Changelog</a></p></div>";
+
 void handleAboutPage(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->redirect("/login"); return; }
     
-    String os_string = String(BUILD_OS);
-    int debian_index = os_string.indexOf("Debian");
-    if (debian_index != -1) {
-        os_string = os_string.substring(debian_index);
-    }
-
-    String body = "<div class='card'><h2>About BeeCounter</h2>" 
-                  "<p>This device is designed to monitor bee activity at a hive entrance.</p>" 
-                  "<ul>" 
-                  "<li><strong>Firmware Version:</strong> " + String(APP_VERSION) + "</li>" 
-                  "<li><strong>Build Date:</strong> " + String(BUILD_DATE) + "</li>" 
-                  "<li><strong>Build Host:</strong> " + String(BUILD_HOST) + "</li>" 
-                  "<li><strong>Build Platform:</strong> " + String(BUILD_PLATFORM) + "</li>" 
-                  "<li><strong>Build Operating System:</strong> " + os_string + "</li>" 
-                  "<li><strong>Local IP Address:</strong> " + WiFi.localIP().toString() + "</li>" 
-                  "<li><strong>Public IP Address:</strong> " + getPublicIP() + "</li>" 
-                  "</ul>" 
-                  "<p><a href='/changelog'>View Full Changelog</a></p></div>";
-
-    request->send(200, "text/html", getPageTemplate("About", body, true));
+    const char* os = strstr(BUILD_OS, "Debian");
+
+    PageRenderer* page = newPage("About", ABOUT_BODY, true);
+    page->set("build_os", os != nullptr ? os : BUILD_OS);
+    page->set("local_ip", WiFi.localIP().toString().c_str());
+    page->set("public_ip", getPublicIP().c_str());
+    sendPage(request, page);
 }
 
+static const char CHANGELOG_BODY[] = "<div class='card'><h2>Changelog</h2><pre style='background-color:#333;padding:1rem;border-radius:8px;white-space:pre-wrap;word-wrap:break-word;color:#fff;'>{{changelog}}</pre></div>";
+
 void handleChangelogPage(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->redirect("/login"); return; }
     
@@ -2023,12 +1795,13 @@ void handleChangelogPage(AsyncWebServerRequest *request) {
         request->send(404, "text/plain", "Changelog not found.");
         return;
     }
-    String changelogContent = file.readString();
-    file.close();
 
-    String body = "<div class='card'><h2>Changelog</h2><pre style='background-color:#333;padding:1rem;border-radius:8px;white-space:pre-wrap;word-wrap:break-word;color:#fff;'>" + changelogContent + "</pre></div>";
-    
-    request->send(200, "text/html", getPageTemplate("Changelog", body, true));
+    // Read while the response goes out, the file closes with the renderer
+    PageRenderer* page = newPage("Changelog", CHANGELOG_BODY, true);
+    page->setReader("changelog", [file](char* buf, size_t len) mutable -> size_t {
+        return file.read((uint8_t*)buf, len);
+    });
+    sendPage(request, page);
 }
 
 void handleFindTimezone(AsyncWebServerRequest *request) {
@@ -2042,10 +1815,8 @@ void handleFindTimezone(AsyncWebServerRequest *request) {
 
 void handleReboot(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->redirect("/login"); return; }
-    String body = "<h1>Rebooting...</h1><meta http-equiv='refresh' content='5;url=/' />";
-    request->send(200, "text/html", getPageTemplate("Rebooting...", body));
-    delay(2000);
-    ESP.restart();
+    sendPage(request, newPage("Rebooting...", "<h1>Rebooting...</h1><meta http-equiv='refresh' content='5;url=/' />"));
+    restartAt = millis() + 2000;
 }
 
 void handleDoAdminChangePass(AsyncWebServerRequest *request) {
@@ -2056,9 +1827,7 @@ void handleDoAdminChangePass(AsyncWebServerRequest *request) {
         String newPass = request->getParam("new_password", true)->value();
         String confirmPass = request->getParam("confirm_password", true)->value();
 
-        preferences.begin("beecounter", true);
-        String storedHash = preferences.getString("adminPass", "");
-        preferences.end();
+        String storedHash = deviceConfig.get().adminPass;
 
         if (sha256(currentPass) != storedHash) {
             request->redirect("/admin?error=Incorrect+current+password");
@@ -2079,10 +1848,12 @@ void handleDoAdminChangePass(AsyncWebServerRequest *request) {
         }
 
         if (newPass.length() >= 8 && hasUpper && hasLower && hasDigit && hasSymbol) {
-            preferences.begin("beecounter", false);
-            preferences.putString("adminPass", sha256(newPass));
-            preferences.end();
-            request->redirect("/admin?success=1");
+            DeviceConfig::Batch batch = deviceConfig.edit();
+            batch.setString(CONFIG_ADMIN_PASS, sha256(newPass).c_str());
+            batch.commit();
+            // Sessions of the old password end, this browser stays logged in
+            sessionTable.clear();
+            redirectWithNewSession(request, "/admin?success=1");
             return;
         } else {
             request->redirect("/admin?error=Password+does+not+meet+complexity+rules");
@@ -2094,18 +1865,18 @@ void handleDoAdminChangePass(AsyncWebServerRequest *request) {
 
 void handleFactoryReset(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->redirect("/login"); return; }
-    preferences.begin("beecounter", false);
-    preferences.clear();
-    preferences.end();
+    deviceConfig.reset();
+    LittleFS.remove(TELEMETRY_HISTORY_PATH); // the snapshot setting is off again
+    sessionTable.clear(); // the password is back to the default until the restart
     
-    String body = "<h1>Factory Reset Successful</h1><p>Device is rebooting into setup mode...</p>";
-    request->send(200, "text/html", getPageTemplate("Resetting...", body));
-    delay(2000);
-    ESP.restart();
+    sendPage(request, newPage("Resetting...", "<h1>Factory Reset Successful</h1><p>Device is rebooting into setup mode...</p>"));
+    restartAt = millis() + 2000;
 }
 
 void handleLogout(AsyncWebServerRequest *request) {
-    currentSessionId = "";
+    if (request->hasHeader("Cookie")) {
+        sessionTable.remove(request->header("Cookie").c_str());
+    }
     AsyncWebServerResponse *response = request->beginResponse(302, "text/plain", "Redirecting");
     response->addHeader("Location", "/login");
     response->addHeader("Set-Cookie", String(SESSION_COOKIE_NAME) + "=; Path=/; Expires=Thu, 01 Jan 1970 00:00:00 GMT");
@@ -2113,7 +1884,12 @@ void handleLogout(AsyncWebServerRequest *request) {
 }
 
 // --- HTML Template ---
-String getFooter() {
+// Tabs of PAGE_TABS, the one whose page title matches is marked active
+static const struct { const char* title; const char* name; } PAGE_TAB_NAMES[] = {
+    {"Monitor", "tab_monitor"}, {"Train", "tab_train"}, {"Observability", "tab_observability"}, {"Administer", "tab_admin"}
+};
+
+PageRenderer* newPage(const char* title, const char* body, bool includeTabs) {
     char timeStr[20];
     struct tm timeinfo;
     if (getLocalTime(&timeinfo, 5000)) { // 5s timeout
@@ -2122,14 +1898,40 @@ String getFooter() {
         strcpy(timeStr, "Time not synced");
     }
 
-    preferences.begin("beecounter", true);
-    String deviceName = preferences.getString("deviceName", "BeeCounter");
-    preferences.end();
+    DeviceSettings config = deviceConfig.get();
+
+    PageRenderer* page = new PageRenderer(PAGE_LAYOUT);
+    page->set("title", title);
+    page->set("css_version", webAssets.version("app.css"));
+    page->set("js_version", webAssets.version("app.js"));
+    page->setTemplate("body", body);
+    if (includeTabs) {
+        page->setTemplate("tabs", PAGE_TABS);
+        for (const auto& tab : PAGE_TAB_NAMES) {
+            if (strcmp(tab.title, title) == 0) page->set(tab.name, "active");
+        }
+    }
+    page->set("device_name", config.deviceName);
+    page->set("version", APP_VERSION);
+    page->set("time", timeStr);
+    return page;
+}
+
+void setNotice(PageRenderer* page, const char* cssClass, const char* text) {
+    page->setTemplate("notice", PAGE_NOTICE);
+    page->set("notice_class", cssClass);
+    page->set("notice_text", text);
+}
 
-    String footer = "<footer><p>";
-    footer += deviceName + " | v" + String(APP_VERSION) + " | <span id='footer-time'>" + String(timeStr) + "</span>";
-    footer += "</p></footer>";
-    return footer;
+// Per device values of the static page shells, the footer time is set by the browser
+void handleUiInfo(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    JsonDocument doc;
+    doc["device_name"] = deviceConfig.get().deviceName;
+    doc["version"] = APP_VERSION;
+    String json;
+    serializeJson(doc, json);
+    request->send(200, "application/json", json);
 }
 
 // --- Error Logging ---
@@ -2162,71 +1964,12 @@ void logError(const String& message) {
 }
 
 
-String getPageTemplate(const String& title, const String& body, bool includeTabs) {
-    String html = "<!DOCTYPE html><html lang='en'><head><meta charset='UTF-8'><meta name='viewport' content='width=device-width, initial-scale=1.0'><title>BeeCounter - " + title + "</title>";
-    html += "<style>" 
-            "html, body {height: 100%; margin: 0;}"
-            "body{font-family:-apple-system,BlinkMacSystemFont,'Segoe UI',Roboto,Helvetica,Arial,sans-serif;background-color:#444;color:#FFC300;display:flex;flex-direction:column;}"
-            "main{flex:1 0 auto;}"
-            "header{background-color:#555;color:#FFC300;padding:1rem 2rem;display:flex;justify-content:space-between;align-items:center;border-bottom:2px solid #FFC300;}"
-            "header h1{margin:0;font-size:1.5rem;} header a{color:#FFC300;text-decoration:none;}"
-            ".tabs{background-color:#555;padding:0 2rem;border-bottom:1px solid #444;}"
-            ".tabs nav{display:flex;}"
-            ".tabs a{padding:1rem 1.5rem;color:#fff;text-decoration:none;border-bottom:3px solid transparent;}"
-            ".tabs a.active, .tabs a:hover{color:#FFC300;border-bottom:3px solid #FFC300;}"
-            ".container{padding:2rem;}"
-            ".container a{color:#FFC300;}"
-            "form{background-color:#222;padding:2rem;border-radius:8px;max-width:400px;margin:2rem auto;border:1px solid #FFC300;}"
-            "form h2, form h3{margin-top:0;text-align:center;}"
-            ".form-group{margin-bottom:1rem;}"
-            ".form-group-inline{margin-bottom:1rem; display:flex; align-items:center;}"
-            ".form-group-inline input{width:auto; margin-right:0.5rem;}"
-            "label{display:block;margin-bottom:.5rem;}"
-            "input, select{width:100%;padding:.75rem;box-sizing:border-box;border-radius:4px;border:1px solid #FFC300;background:#333;color:#fff;}"
-            "button{width:100%;padding:.75rem;border:none;border-radius:4px;background-color:#FFC300;color:#000;font-size:1.1rem;cursor:pointer;}"
-            "button.danger{background-color:#D32F2F;color:#fff;}"
-            ".error{color:#F44336;text-align:center;margin-bottom:1rem;}"
-            ".success{color:#4CAF50;text-align:center;margin-bottom:1rem;}"
-            "footer{background-color:#555; flex-shrink: 0; text-align:center;padding:1rem;color:#ddd;font-size:0.9rem;border-top:1px solid #444;}"
-            "</style></head><body>";
-    
-    if (includeTabs) {
-        html += "<header><h1>BeeCounter</h1><img src='https://upload.wikimedia.org/wikipedia/commons/9/91/Abeille-bee.svg' alt='Bee Icon' style='height: 40px; margin: auto;' /><div><a href='/about'>About</a><span style='margin:0 10px;'>|</span><a href='/logout'>Logout</a></div></header>";
-        html += "<div class='tabs'><nav>";
-        html += String("<a href='/' class='") + (title == "Monitor" ? "active" : "") + "'>Monitor</a>";
-        html += String("<a href='/train' class='") + (title == "Train" ? "active" : "") + "'>Train</a>";
-        html += String("<a href='/observability' class='") + (title == "Observability" ? "active" : "") + "'>Observability</a>";
-        html += String("<a href='/admin' class='") + (title == "Administer" ? "active" : "") + "'>Administer</a>";
-        html += "</nav></div>";
-    }
-
-    html += "<main class='container'>" + body + "</main>";
-    html += getFooter();
-    html += "<script>" 
-            "function updateTime() {" 
-            "  const timeElement = document.getElementById('footer-time');" 
-            "  if (timeElement) {" 
-            "    const now = new Date();" 
-            "    const year = now.getFullYear();" 
-            "    const month = String(now.getMonth() + 1).padStart(2, '0');" 
-            "    const day = String(now.getDate()).padStart(2, '0');" 
-            "    const hours = String(now.getHours()).padStart(2, '0');" 
-            "    const minutes = String(now.getMinutes()).padStart(2, '0');" 
-            "    timeElement.textContent = `${year}-${month}-${day} ${hours}:${minutes}`;" 
-            "  }" 
-            "}" 
-            "updateTime();" // Initial call to set time immediately
-            "setInterval(updateTime, 60000);" // Update every 60 seconds
-            "</script>";
-    html += "</body></html>";
-    return html;
-}
-
 void handleCaptureStart(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
     if (!isCollecting) {
         isCollecting = true;
         imagesCollected = 0;
+        collectionLabel = request->hasParam("label", true) ? request->getParam("label", true)->value() : "";
         lastCollectionTime = millis(); // Start the timer now
         Serial.println("INFO: Starting automated data collection.");
     }
@@ -2251,6 +1994,7 @@ void handleCapturePhoto(AsyncWebServerRequest *request) {
         request->send(500, "text/plain", "Camera capture failed");
         return;
     }
+    telemetryHistory.countFrame();
 
     // Create a unique filename using the current timestamp
     struct timeval tv;
@@ -2267,6 +2011,9 @@ void handleCapturePhoto(AsyncWebServerRequest *request) {
 
     file.write(fb->buf, fb->len);
     file.close();
+    String label = request->hasParam("label", true) ? request->getParam("label", true)->value() : "";
+    imageIndex.add(path.substring(8).c_str(), fb->len, tv.tv_sec, label.c_str(), fb->width, fb->height);
+    queueThumbnail(path.substring(8).c_str());
     Serial.printf("SUCCESS: Image saved to %s (%d bytes)\n", path.c_str(), fb->len);
     
     esp_camera_fb_return(fb);
@@ -2276,8 +2023,221 @@ void handleCapturePhoto(AsyncWebServerRequest *request) {
 
 
 
+// --- Model Deployment ---
+// Models are written to the "model" partition and mapped from there, so a new
+// model doesn't need a firmware flash or a reboot.
+
+void handleModelInfo(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    JsonDocument doc;
+    doc["loaded"] = modelLoader.isLoaded();
+    doc["writing"] = modelLoader.isWriting();
+    doc["name"] = modelLoader.name();
+    doc["size"] = modelLoader.size();
+    doc["arena_size"] = modelLoader.arenaSize();
+    doc["crc32"] = String(modelLoader.crc(), HEX);
+    doc["capacity"] = modelLoader.capacity();
+    doc["generation"] = modelLoader.generation();
+    doc["error"] = modelLoader.lastError();
+    MemoryPlanStats plan = memoryPlanStore.stats();
+    JsonObject memoryPlan = doc["memory_plan"].to<JsonObject>();
+    memoryPlan["model_hash"] = String(plan.modelHash, HEX);
+    memoryPlan["size"] = plan.planSize;
+    memoryPlan["plans"] = plan.plans;
+    memoryPlan["writes"] = plan.writes;
+    memoryPlan["hits"] = plan.hits;
+    memoryPlan["misses"] = plan.misses;
+    memoryPlan["planned_allocate_us"] = plan.plannedUs;
+    memoryPlan["cached_allocate_us"] = plan.cachedUs;
+    String json;
+    serializeJson(doc, json);
+    request->send(200, "application/json", json);
+}
+
+// The upload holding the model writer. Its write is aborted if the client
+// goes away before the last chunk.
+AsyncWebServerRequest* modelUploadRequest = nullptr;
+
+// The error goes to handleModelUpload() in the request's _tempObject, which
+// the request frees
+void failModelUpload(AsyncWebServerRequest *request, const char* stage) {
+    const char* error = modelLoader.lastError();
+    Serial.printf("ERROR: Model %s failed: %s\n", stage, error);
+    if (!request->_tempObject) request->_tempObject = strdup(error);
+    if (modelUploadRequest == request) {
+        modelLoader.abortWrite();
+        modelUploadRequest = nullptr;
+    }
+}
+
+void handleModelUploadData(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
+    if (!isAuthenticated(request)) return;
+
+    if (index == 0) {
+        Serial.printf("INFO: Model upload started: %s\n", filename.c_str());
+        if (!modelLoader.claimWrite()) {
+            failModelUpload(request, "upload");
+            return;
+        }
+        modelUploadRequest = request;
+        request->onDisconnect([request]() {
+            if (modelUploadRequest == request) {
+                Serial.println("WARN: Model upload aborted by the client");
+                modelLoader.abortWrite();
+                modelUploadRequest = nullptr;
+            }
+        });
+        if (!modelLoader.beginWrite()) {
+            failModelUpload(request, "upload");
+            return;
+        }
+    }
+    if (modelUploadRequest != request) return;
+
+    esp_task_wdt_reset(); // Flash erase and write can take a while per chunk
+    if (len && !modelLoader.write(data, len)) {
+        failModelUpload(request, "write");
+        return;
+    }
+
+    if (final) {
+        String name = request->hasParam("name", true) ? request->getParam("name", true)->value() : filename;
+        uint32_t arena = request->hasParam("arena", true) ? request->getParam("arena", true)->value().toInt() : 0;
+        // endWrite() gives up the writer either way
+        modelUploadRequest = nullptr;
+        if (modelLoader.endWrite(name.c_str(), arena)) {
+            Serial.printf("SUCCESS: Model '%s' loaded (%u bytes)\n", modelLoader.name(), (unsigned)modelLoader.size());
+        } else {
+            failModelUpload(request, "commit");
+        }
+    }
+}
+
+void handleModelUpload(AsyncWebServerRequest *request) {
+    if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
+    if (request->_tempObject || !modelLoader.isLoaded()) {
+        String error = request->_tempObject ? String((const char*)request->_tempObject) : String(modelLoader.lastError());
+        request->send(500, "text/plain", "Model upload failed: " + error);
+        return;
+    }
+    request->send(200, "text/plain", String("Model loaded: ") + modelLoader.name());
+}
+
+// The API key only goes to Edge Impulse over TLS: https on edgeimpulse.com
+// or one of its subdomains. Any other model URL is fetched without it.
+static bool isEdgeImpulseUrl(const String& url) {
+    if (!url.startsWith("https://")) return false;
+    int start = 8;
+    int end = start;
+    while (end < (int)url.length() && strchr("/?#", url[end]) == nullptr) end++;
+    String host = url.substring(start, end);
+    // user info ("https://edgeimpulse.com@elsewhere/") isn't the host
+    int at = host.lastIndexOf('@');
+    if (at >= 0) host = host.substring(at + 1);
+    int port = host.indexOf(':');
+    if (port >= 0) host = host.substring(0, port);
+    host.toLowerCase();
+    return host == "edgeimpulse.com" || host.endsWith(".edgeimpulse.com");
+}
+
 void handleEdgeImpulseDownloadModel(AsyncWebServerRequest *request) {
     if (!isAuthenticated(request)) { request->send(401, "text/plain", "Unauthorized"); return; }
-    // In a real implementation, you would parse the API key, then download the model from Edge Impulse
-    request->send(200, "text/plain", "Model downloaded (placeholder)");
+    if (!request->hasParam("model-url", true)) {
+        request->send(400, "text/plain", "Missing model URL");
+        return;
+    }
+    // taken here so two requests can't both start a download, the task
+    // ends the claim
+    if (!modelLoader.claimWrite()) {
+        request->send(409, "text/plain", "A model update is already in progress");
+        return;
+    }
+
+    String url = request->getParam("model-url", true)->value();
+
+    // --- Download in the background, straight into the model partition ---
+    String* urlCopy = new String(url);
+    if (xTaskCreate([](void* pvParameters){
+        String url = *(String*)pvParameters;
+        delete (String*)pvParameters;
+
+        String apiKey = deviceConfig.get().eiApiKey;
+
+        HTTPClient http;
+        http.begin(url);
+        if (apiKey.length() > 0) {
+            if (isEdgeImpulseUrl(url)) {
+                http.addHeader("x-api-key", apiKey);
+            } else {
+                Serial.println("WARN: Model URL isn't https on edgeimpulse.com, downloading it without the API key");
+            }
+        }
+        int httpCode = http.GET();
+        if (httpCode != HTTP_CODE_OK) {
+            Serial.printf("ERROR: Model download failed, HTTP code: %d\n", httpCode);
+            events.send(("Download failed (HTTP " + String(httpCode) + ")").c_str(), "ei_model_status", millis());
+            http.end();
+            modelLoader.abortWrite();
+            vTaskDelete(NULL);
+            return;
+        }
+
+        int total = http.getSize();
+        uint8_t *buf = (uint8_t*)malloc(4096);
+        if (!buf || !modelLoader.beginWrite()) {
+            events.send(buf ? modelLoader.lastError() : "Out of memory", "ei_model_status", millis());
+            free(buf);
+            http.end();
+            modelLoader.abortWrite();
+            vTaskDelete(NULL);
+            return;
+        }
+
+        WiFiClient *stream = http.getStreamPtr();
+        size_t received = 0;
+        int lastPercent = -1;
+        unsigned long lastData = millis();
+        bool ok = true;
+        while (http.connected() && (total < 0 || received < (size_t)total)) {
+            size_t available = stream->available();
+            if (!available) {
+                if (millis() - lastData > 10000) { ok = false; break; }
+                vTaskDelay(pdMS_TO_TICKS(10));
+                continue;
+            }
+            int len = stream->readBytes(buf, available > 4096 ? 4096 : available);
+            if (!modelLoader.write(buf, len)) { ok = false; break; }
+            received += len;
+            lastData = millis();
+            if (total > 0 && (int)(received * 100 / total) / 10 != lastPercent) {
+                lastPercent = (int)(received * 100 / total) / 10;
+                events.send(("Downloading " + String(lastPercent * 10) + "%").c_str(), "ei_model_status", millis());
+            }
+        }
+        free(buf);
+        http.end();
+
+        if (ok && (total < 0 || received == (size_t)total)) {
+            String name = url.substring(url.lastIndexOf('/') + 1);
+            ok = modelLoader.endWrite(name.c_str(), 0);
+        } else {
+            modelLoader.abortWrite();
+            ok = false;
+        }
+
+        if (ok) {
+            Serial.printf("SUCCESS: Model '%s' downloaded and loaded (%u bytes)\n", modelLoader.name(), (unsigned)modelLoader.size());
+            events.send(("Model loaded: " + String(modelLoader.name())).c_str(), "ei_model_status", millis());
+        } else {
+            Serial.printf("ERROR: Model download failed: %s\n", modelLoader.lastError());
+            events.send(("Download failed: " + String(modelLoader.lastError())).c_str(), "ei_model_status", millis());
+        }
+        vTaskDelete(NULL);
+    }, "eiModelTask", 8192, urlCopy, 1, NULL) != pdPASS) {
+        delete urlCopy;
+        modelLoader.abortWrite();
+        request->send(500, "text/plain", "Could not start the model download");
+        return;
+    }
+    request->send(200, "text/plain", "Model download started.");
 }
\ No newline at end of file
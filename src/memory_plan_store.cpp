@@ -0,0 +1,264 @@
+#include "memory_plan_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "nvs.h"
+#endif
+
+MemoryPlanStore memoryPlanStore;
+
+MemoryPlanStore::MemoryPlanStore() : useCounter(0) {
+    memset(slots, 0, sizeof(slots));
+    memset(&st, 0, sizeof(st));
+#if defined(ESP_PLATFORM)
+    strcpy(path, MEMORY_PLAN_PATH);
+#else
+    strcpy(path, "memory_plan.bin");
+#endif
+}
+
+int MemoryPlanStore::find(uint32_t modelHash) const {
+    for (int i = 0; i < MEMORY_PLAN_SLOTS; i++) {
+        if (slots[i].modelHash != 0 && slots[i].modelHash == modelHash) return i;
+    }
+    return -1;
+}
+
+int MemoryPlanStore::pick(uint32_t modelHash) const {
+    int slot = find(modelHash);
+    if (slot >= 0) return slot;
+    slot = 0;
+    for (int i = 0; i < MEMORY_PLAN_SLOTS; i++) {
+        if (slots[i].modelHash == 0) return i;
+        if (slots[i].lastUsed < slots[slot].lastUsed) slot = i;
+    }
+    return slot;
+}
+
+void MemoryPlanStore::use(int slot) {
+    slots[slot].lastUsed = ++useCounter;
+    st.modelHash = slots[slot].modelHash;
+    st.planSize = slots[slot].planSize;
+}
+
+void MemoryPlanStore::countPlans() {
+    st.plans = 0;
+    for (int i = 0; i < MEMORY_PLAN_SLOTS; i++) {
+        if (slots[i].modelHash != 0) st.plans++;
+    }
+}
+
+size_t MemoryPlanStore::load(uint32_t modelHash, void* buf, size_t bufSize) {
+    int slot = find(modelHash);
+    if (slot < 0) return 0;
+    if (buf == nullptr) return slots[slot].planSize;
+    if (bufSize < slots[slot].planSize) return 0;
+    size_t size = readSlot(slot, buf, bufSize);
+    if (size != slots[slot].planSize) return 0;
+    use(slot);
+    return size;
+}
+
+void MemoryPlanStore::store(uint32_t modelHash, const void* plan, size_t planSize) {
+    if (modelHash == 0 || planSize > MEMORY_PLAN_MAX_SIZE) return;
+    int slot = pick(modelHash);
+
+    // Flash wear: the same plan again (e.g. after the RAM copy was replaced)
+    // isn't written
+    if (slots[slot].modelHash == modelHash && slots[slot].planSize == planSize) {
+        uint8_t* stored = (uint8_t*)malloc(planSize);
+        bool same = stored != nullptr && readSlot(slot, stored, planSize) == planSize &&
+                    memcmp(stored, plan, planSize) == 0;
+        free(stored);
+        if (same) {
+            use(slot);
+            return;
+        }
+    }
+
+    if (writeSlot(slot, modelHash, plan, planSize)) {
+        slots[slot].modelHash = modelHash;
+        slots[slot].planSize = planSize;
+        use(slot);
+        st.writes++;
+    } else {
+        slots[slot].modelHash = 0;
+        slots[slot].planSize = 0;
+        st.modelHash = 0;
+        st.planSize = 0;
+    }
+    countPlans();
+}
+
+// A file per slot: model hash followed by the plan
+static void slotPath(char* out, size_t outSize, const char* path, int slot) {
+    snprintf(out, outSize, "%s.%d", path, slot);
+}
+
+#if defined(ESP_PLATFORM)
+
+// The plans of earlier firmware, kept in NVS
+static void eraseLegacyPlans() {
+    nvs_handle_t handle;
+    // opening it for writing would create the namespace
+    if (nvs_open(MEMORY_PLAN_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return;
+    nvs_close(handle);
+    if (nvs_open(MEMORY_PLAN_NVS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) return;
+    nvs_erase_all(handle);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+void MemoryPlanStore::begin(const char* planPath) {
+    if (planPath != nullptr) {
+        strncpy(path, planPath, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+    }
+    eraseLegacyPlans();
+    memset(slots, 0, sizeof(slots));
+    for (int i = 0; i < MEMORY_PLAN_SLOTS; i++) {
+        char file[sizeof(path) + 8];
+        slotPath(file, sizeof(file), path, i);
+        if (!LittleFS.exists(file)) continue;
+        File f = LittleFS.open(file, "r");
+        if (!f) continue;
+        uint32_t hash;
+        long size = (long)f.size() - (long)sizeof(hash);
+        if (f.read((uint8_t*)&hash, sizeof(hash)) == sizeof(hash) && size > 0 && size <= MEMORY_PLAN_MAX_SIZE) {
+            slots[i].modelHash = hash;
+            slots[i].planSize = (uint32_t)size;
+        }
+        f.close();
+    }
+    countPlans();
+}
+
+size_t MemoryPlanStore::readSlot(int slot, void* buf, size_t bufSize) {
+    char file[sizeof(path) + 8];
+    slotPath(file, sizeof(file), path, slot);
+    File f = LittleFS.open(file, "r");
+    if (!f) return 0;
+    size_t size = 0;
+    if (f.seek(sizeof(uint32_t))) {
+        size = f.read((uint8_t*)buf, bufSize);
+    }
+    f.close();
+    return size;
+}
+
+bool MemoryPlanStore::writeSlot(int slot, uint32_t modelHash, const void* plan, size_t planSize) {
+    char file[sizeof(path) + 8], tmpFile[sizeof(path) + 12];
+    slotPath(file, sizeof(file), path, slot);
+    snprintf(tmpFile, sizeof(tmpFile), "%s.tmp", file);
+    // Written aside and renamed, a plan written halfway must not look valid
+    File f = LittleFS.open(tmpFile, "w");
+    bool ok = f && f.write((const uint8_t*)&modelHash, sizeof(modelHash)) == sizeof(modelHash) &&
+              f.write((const uint8_t*)plan, planSize) == planSize;
+    f.close();
+    ok = ok && LittleFS.rename(tmpFile, file);
+    if (!ok) {
+        LittleFS.remove(tmpFile);
+        Serial.printf("ERROR: Can't store the memory plan in %s\n", file);
+    }
+    return ok;
+}
+
+void MemoryPlanStore::clear() {
+    for (int i = 0; i < MEMORY_PLAN_SLOTS; i++) {
+        char file[sizeof(path) + 8];
+        slotPath(file, sizeof(file), path, i);
+        LittleFS.remove(file);
+    }
+    memset(slots, 0, sizeof(slots));
+    memset(&st, 0, sizeof(st));
+}
+
+#else
+
+void MemoryPlanStore::begin(const char* planPath) {
+    if (planPath != nullptr) {
+        strncpy(path, planPath, sizeof(path) - 1);
+        path[sizeof(path) - 1] = '\0';
+    }
+    memset(slots, 0, sizeof(slots));
+    for (int i = 0; i < MEMORY_PLAN_SLOTS; i++) {
+        char file[sizeof(path) + 8];
+        slotPath(file, sizeof(file), path, i);
+        FILE* f = fopen(file, "rb");
+        if (f == nullptr) continue;
+        uint32_t hash;
+        if (fread(&hash, sizeof(hash), 1, f) == 1 && fseek(f, 0, SEEK_END) == 0) {
+            long size = ftell(f) - (long)sizeof(hash);
+            if (size > 0 && size <= MEMORY_PLAN_MAX_SIZE) {
+                slots[i].modelHash = hash;
+                slots[i].planSize = (uint32_t)size;
+            }
+        }
+        fclose(f);
+    }
+    countPlans();
+}
+
+size_t MemoryPlanStore::readSlot(int slot, void* buf, size_t bufSize) {
+    char file[sizeof(path) + 8];
+    slotPath(file, sizeof(file), path, slot);
+    FILE* f = fopen(file, "rb");
+    if (f == nullptr) return 0;
+    size_t size = 0;
+    if (fseek(f, sizeof(uint32_t), SEEK_SET) == 0) {
+        size = fread(buf, 1, bufSize, f);
+    }
+    fclose(f);
+    return size;
+}
+
+bool MemoryPlanStore::writeSlot(int slot, uint32_t modelHash, const void* plan, size_t planSize) {
+    char file[sizeof(path) + 8];
+    slotPath(file, sizeof(file), path, slot);
+    FILE* f = fopen(file, "wb");
+    if (f == nullptr) return false;
+    bool ok = fwrite(&modelHash, sizeof(modelHash), 1, f) == 1 &&
+              fwrite(plan, 1, planSize, f) == planSize;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) remove(file);
+    return ok;
+}
+
+void MemoryPlanStore::clear() {
+    for (int i = 0; i < MEMORY_PLAN_SLOTS; i++) {
+        char file[sizeof(path) + 8];
+        slotPath(file, sizeof(file), path, i);
+        remove(file);
+    }
+    memset(slots, 0, sizeof(slots));
+    memset(&st, 0, sizeof(st));
+}
+
+#endif
+
+void MemoryPlanStore::recordAllocate(bool cached, uint32_t allocateUs) {
+    if (cached) {
+        st.hits++;
+        st.cachedUs = allocateUs;
+    } else {
+        st.misses++;
+        st.plannedUs = allocateUs;
+    }
+}
+
+// --- Edge Impulse SDK hooks (see tflite_memory_plan.h) ---
+size_t ei_tflite_memory_plan_load(uint32_t model_hash, void* buf, size_t buf_size) {
+    return memoryPlanStore.load(model_hash, buf, buf_size);
+}
+
+void ei_tflite_memory_plan_store(uint32_t model_hash, const void* plan, size_t plan_size) {
+    memoryPlanStore.store(model_hash, plan, plan_size);
+}
+
+void ei_tflite_memory_plan_allocated(bool cached, uint32_t allocate_us) {
+    memoryPlanStore.recordAllocate(cached, allocate_us);
+}
@@ -0,0 +1,458 @@
+#include "model_loader.h"
+#include <string.h>
+#include <stdio.h>
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_partition.h"
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "esp_spi_flash.h"
+#endif
+
+static portMUX_TYPE loaderLock = portMUX_INITIALIZER_UNLOCKED;
+#define LOADER_LOCK()     portENTER_CRITICAL(&loaderLock)
+#define LOADER_UNLOCK()   portEXIT_CRITICAL(&loaderLock)
+#define LOADER_SLEEP(ms)  vTaskDelay(pdMS_TO_TICKS(ms))
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mutex>
+#include <chrono>
+#include <thread>
+
+static std::mutex loaderLock;
+#define LOADER_LOCK()     loaderLock.lock()
+#define LOADER_UNLOCK()   loaderLock.unlock()
+#define LOADER_SLEEP(ms)  std::this_thread::sleep_for(std::chrono::milliseconds(ms))
+#endif
+
+#define FLASH_SECTOR_SIZE 4096
+
+ModelLoader modelLoader;
+
+// --- CRC-32 (zlib polynomial), nibble table to keep it small ---
+uint32_t modelCrc32(uint32_t crc, const uint8_t* data, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+ModelLoader::ModelLoader()
+    : modelData(nullptr), gen(0), claimed(false), writing(false), writeSize(0), writeCrc(0), readers(0)
+#if defined(ESP_PLATFORM)
+    , partition(nullptr), mapHandle(0), erasedSize(0)
+#else
+    , mapAddr(nullptr), mapSize(0), writeFd(-1)
+#endif
+{
+    memset(&header, 0, sizeof(header));
+    error[0] = '\0';
+#if !defined(ESP_PLATFORM)
+    path[0] = '\0';
+#endif
+}
+
+ModelLoader::~ModelLoader() {
+    abortWrite();
+    unload();
+}
+
+bool ModelLoader::fail(const char* message) {
+    snprintf(error, sizeof(error), "%s", message);
+    return false;
+}
+
+bool ModelLoader::reload() {
+    unload();
+    return map();
+}
+
+// --- Writer claim and readers ---
+bool ModelLoader::claimWrite() {
+    LOADER_LOCK();
+    bool free = !claimed;
+    claimed = true;
+    LOADER_UNLOCK();
+    return free ? true : fail("Write already in progress");
+}
+
+void ModelLoader::endClaim() {
+    LOADER_LOCK();
+    claimed = false;
+    LOADER_UNLOCK();
+}
+
+// With the claim taken nobody acquires the model any more, so this only
+// waits for the inferences that were already running
+bool ModelLoader::waitForReaders() {
+    for (uint32_t waited = 0; ; waited += 10) {
+        LOADER_LOCK();
+        uint32_t count = readers;
+        LOADER_UNLOCK();
+        if (count == 0) return true;
+        if (waited >= MODEL_READER_WAIT_MS) return fail("Model still in use");
+        LOADER_SLEEP(10);
+    }
+}
+
+const uint8_t* ModelLoader::acquire() {
+    LOADER_LOCK();
+    const uint8_t* model = claimed ? nullptr : modelData;
+    if (model) readers++;
+    LOADER_UNLOCK();
+    return model;
+}
+
+void ModelLoader::release() {
+    LOADER_LOCK();
+    if (readers > 0) readers--;
+    LOADER_UNLOCK();
+}
+
+#if defined(ESP_PLATFORM)
+// --- ESP32 backend: the "model" data partition ---
+
+bool ModelLoader::begin(const char* path) {
+    (void)path;
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                         (esp_partition_subtype_t)MODEL_PARTITION_SUBTYPE,
+                                         MODEL_PARTITION_LABEL);
+    if (!partition) {
+        return fail("No model partition");
+    }
+    return map();
+}
+
+size_t ModelLoader::capacity() const {
+    if (!partition) return 0;
+    return ((const esp_partition_t*)partition)->size - MODEL_IMAGE_HEADER_SIZE;
+}
+
+bool ModelLoader::map() {
+    const esp_partition_t* part = (const esp_partition_t*)partition;
+    if (!part) {
+        return fail("No model partition");
+    }
+
+    if (esp_partition_read(part, 0, &header, sizeof(header)) != ESP_OK) {
+        return fail("Header read failed");
+    }
+    if (header.magic != MODEL_IMAGE_MAGIC) {
+        return fail("No model stored");
+    }
+    if (header.version != MODEL_IMAGE_VERSION || header.headerSize != MODEL_IMAGE_HEADER_SIZE ||
+        header.modelSize < 8 || header.modelSize > capacity()) {
+        return fail("Invalid model header");
+    }
+
+    const void* ptr = nullptr;
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+    spi_flash_mmap_handle_t handle;
+#else
+    esp_partition_mmap_handle_t handle;
+#endif
+    esp_err_t err = esp_partition_mmap(part, 0, MODEL_IMAGE_HEADER_SIZE + header.modelSize,
+                                       ESP_PARTITION_MMAP_DATA, &ptr, &handle);
+    if (err != ESP_OK) {
+        return fail("esp_partition_mmap failed");
+    }
+
+    const uint8_t* flatbuffer = (const uint8_t*)ptr + MODEL_IMAGE_HEADER_SIZE;
+    if (modelCrc32(0, flatbuffer, header.modelSize) != header.crc32 ||
+        memcmp(flatbuffer + 4, "TFL3", 4) != 0) {
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+        spi_flash_munmap(handle);
+#else
+        esp_partition_munmap(handle);
+#endif
+        return fail("Model data corrupt");
+    }
+
+    header.name[sizeof(header.name) - 1] = '\0';
+    mapHandle = handle;
+    modelData = flatbuffer;
+    gen++;
+    error[0] = '\0';
+    return true;
+}
+
+void ModelLoader::unload() {
+    if (!modelData) return;
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)
+    spi_flash_munmap(mapHandle);
+#else
+    esp_partition_munmap(mapHandle);
+#endif
+    modelData = nullptr;
+}
+
+bool ModelLoader::beginWrite() {
+    const esp_partition_t* part = (const esp_partition_t*)partition;
+    if (!claimed) return fail("Write not claimed");
+    if (writing) return fail("Write already in progress");
+    if (!part) return fail("No model partition");
+
+    // the flash under the current mapping is about to be erased
+    if (!waitForReaders()) return false;
+    unload();
+
+    // sector 0 holds the header, erasing it first invalidates the old model
+    if (esp_partition_erase_range(part, 0, FLASH_SECTOR_SIZE) != ESP_OK) {
+        return fail("Erase failed");
+    }
+    erasedSize = FLASH_SECTOR_SIZE;
+    writeSize = 0;
+    writeCrc = 0;
+    writing = true;
+    return true;
+}
+
+bool ModelLoader::write(const uint8_t* data, size_t len) {
+    const esp_partition_t* part = (const esp_partition_t*)partition;
+    if (!writing) return fail("No write in progress");
+    if (writeSize + len > capacity()) {
+        discardWrite();
+        return fail("Model too large for partition");
+    }
+
+    size_t end = MODEL_IMAGE_HEADER_SIZE + writeSize + len;
+    if (end > erasedSize) {
+        // erase sector by sector as the data comes in instead of stalling up front
+        size_t eraseEnd = (end + FLASH_SECTOR_SIZE - 1) & ~(size_t)(FLASH_SECTOR_SIZE - 1);
+        if (esp_partition_erase_range(part, erasedSize, eraseEnd - erasedSize) != ESP_OK) {
+            discardWrite();
+            return fail("Erase failed");
+        }
+        erasedSize = eraseEnd;
+    }
+
+    if (esp_partition_write(part, MODEL_IMAGE_HEADER_SIZE + writeSize, data, len) != ESP_OK) {
+        discardWrite();
+        return fail("Flash write failed");
+    }
+    writeCrc = modelCrc32(writeCrc, data, len);
+    writeSize += len;
+    return true;
+}
+
+bool ModelLoader::endWrite(const char* name, uint32_t arenaSize) {
+    const esp_partition_t* part = (const esp_partition_t*)partition;
+    if (!writing) {
+        endClaim();
+        return fail("No write in progress");
+    }
+    writing = false;
+    if (writeSize == 0) {
+        endClaim();
+        return fail("Empty model");
+    }
+
+    ModelImageHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = MODEL_IMAGE_MAGIC;
+    h.version = MODEL_IMAGE_VERSION;
+    h.headerSize = MODEL_IMAGE_HEADER_SIZE;
+    h.modelSize = writeSize;
+    h.arenaSize = arenaSize;
+    h.crc32 = writeCrc;
+    snprintf(h.name, sizeof(h.name), "%s", name ? name : "");
+
+    bool ok = esp_partition_write(part, 0, &h, sizeof(h)) == ESP_OK ? map() : fail("Header write failed");
+    endClaim();
+    return ok;
+}
+
+void ModelLoader::discardWrite() {
+    writing = false;
+}
+
+void ModelLoader::abortWrite() {
+    discardWrite();
+    endClaim();
+}
+
+#else
+// --- Posix backend: a model image file ---
+
+bool ModelLoader::begin(const char* filePath) {
+    snprintf(path, sizeof(path), "%s", filePath ? filePath : "model.bin");
+    return map();
+}
+
+size_t ModelLoader::capacity() const {
+    return MODEL_POSIX_MAX_SIZE;
+}
+
+bool ModelLoader::map() {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return fail("No model stored");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < MODEL_IMAGE_HEADER_SIZE) {
+        close(fd);
+        return fail("Invalid model header");
+    }
+
+    void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return fail("mmap failed");
+    }
+
+    memcpy(&header, addr, sizeof(header));
+    const uint8_t* flatbuffer = (const uint8_t*)addr + MODEL_IMAGE_HEADER_SIZE;
+    bool valid = header.magic == MODEL_IMAGE_MAGIC &&
+                 header.version == MODEL_IMAGE_VERSION &&
+                 header.headerSize == MODEL_IMAGE_HEADER_SIZE &&
+                 header.modelSize >= 8 && header.modelSize <= capacity() &&
+                 MODEL_IMAGE_HEADER_SIZE + (size_t)header.modelSize <= (size_t)st.st_size;
+    if (valid) {
+        valid = modelCrc32(0, flatbuffer, header.modelSize) == header.crc32 &&
+                memcmp(flatbuffer + 4, "TFL3", 4) == 0;
+    }
+    if (!valid) {
+        munmap(addr, st.st_size);
+        return fail("Model data corrupt");
+    }
+
+    header.name[sizeof(header.name) - 1] = '\0';
+    mapAddr = addr;
+    mapSize = st.st_size;
+    modelData = flatbuffer;
+    gen++;
+    error[0] = '\0';
+    return true;
+}
+
+void ModelLoader::unload() {
+    if (!modelData) return;
+    munmap((void*)mapAddr, mapSize);
+    mapAddr = nullptr;
+    mapSize = 0;
+    modelData = nullptr;
+}
+
+bool ModelLoader::beginWrite() {
+    if (!claimed) return fail("Write not claimed");
+    if (writing) return fail("Write already in progress");
+
+    // endWrite() replaces the mapping
+    if (!waitForReaders()) return false;
+
+    // written next to the current model and renamed over it in endWrite(),
+    // so the current mapping stays valid until then
+    char tmpPath[sizeof(path) + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    writeFd = open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writeFd < 0) {
+        return fail("Cannot create model file");
+    }
+    uint8_t blank[MODEL_IMAGE_HEADER_SIZE] = { 0 };
+    if (::write(writeFd, blank, sizeof(blank)) != (ssize_t)sizeof(blank)) {
+        discardWrite();
+        return fail("Model file write failed");
+    }
+    writeSize = 0;
+    writeCrc = 0;
+    writing = true;
+    return true;
+}
+
+bool ModelLoader::write(const uint8_t* data, size_t len) {
+    if (!writing) return fail("No write in progress");
+    if (writeSize + len > capacity()) {
+        discardWrite();
+        return fail("Model too large");
+    }
+    if (::write(writeFd, data, len) != (ssize_t)len) {
+        discardWrite();
+        return fail("Model file write failed");
+    }
+    writeCrc = modelCrc32(writeCrc, data, len);
+    writeSize += len;
+    return true;
+}
+
+bool ModelLoader::endWrite(const char* name, uint32_t arenaSize) {
+    if (!writing) {
+        endClaim();
+        return fail("No write in progress");
+    }
+    if (writeSize == 0) {
+        abortWrite();
+        return fail("Empty model");
+    }
+
+    ModelImageHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = MODEL_IMAGE_MAGIC;
+    h.version = MODEL_IMAGE_VERSION;
+    h.headerSize = MODEL_IMAGE_HEADER_SIZE;
+    h.modelSize = writeSize;
+    h.arenaSize = arenaSize;
+    h.crc32 = writeCrc;
+    snprintf(h.name, sizeof(h.name), "%s", name ? name : "");
+
+    bool ok = pwrite(writeFd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && fsync(writeFd) == 0;
+    close(writeFd);
+    writeFd = -1;
+    writing = false;
+
+    char tmpPath[sizeof(path) + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    if (!ok || rename(tmpPath, path) != 0) {
+        unlink(tmpPath);
+        endClaim();
+        return fail("Model file write failed");
+    }
+    ok = reload();
+    endClaim();
+    return ok;
+}
+
+void ModelLoader::discardWrite() {
+    if (writeFd >= 0) {
+        close(writeFd);
+        writeFd = -1;
+        char tmpPath[sizeof(path) + 4];
+        snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+        unlink(tmpPath);
+    }
+    writing = false;
+}
+
+void ModelLoader::abortWrite() {
+    discardWrite();
+    endClaim();
+}
+
+#endif
+
+// --- Edge Impulse SDK hooks (see tflite_model_source.h) ---
+bool ei_tflite_model_acquire(const unsigned char** model, size_t* modelSize, size_t* arenaSize, uint32_t* generation) {
+    const uint8_t* data = modelLoader.acquire();
+    if (data == nullptr) return false;
+    *model = data;
+    *modelSize = modelLoader.size();
+    if (modelLoader.arenaSize() != 0) *arenaSize = modelLoader.arenaSize();
+    *generation = modelLoader.generation();
+    return true;
+}
+
+void ei_tflite_model_release() {
+    modelLoader.release();
+}
@@ -0,0 +1,215 @@
+#include "page_renderer.h"
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include <memory>
+#include <ESPAsyncWebServer.h>
+#endif
+
+static const char* htmlEntity(char c) {
+    switch (c) {
+        case '&': return "&amp;";
+        case '<': return "&lt;";
+        case '>': return "&gt;";
+        case '"': return "&quot;";
+        case '\'': return "&#39;";
+        default: return nullptr;
+    }
+}
+
+PageRenderer::PageRenderer(const char* tpl)
+    : valueCount(0), spaceUsed(0), overflow(false), depth(0), current(nullptr), currentPos(0),
+      chunkLen(0), pendingLen(0), pendingPos(0), total(0)
+{
+    if (tpl != nullptr) {
+        stack[0].tpl = tpl;
+        stack[0].pos = 0;
+        depth = 1;
+    }
+}
+
+PageRenderer::Value* PageRenderer::addValue(const char* name, ValueKind kind) {
+    size_t nameLen = strlen(name);
+    Value* value = const_cast<Value*>(find(name, nameLen));
+    if (value == nullptr) {
+        if (valueCount == PAGE_RENDERER_MAX_VALUES) {
+            overflow = true;
+            return nullptr;
+        }
+        value = &values[valueCount++];
+        value->name = name;
+        value->nameLen = nameLen;
+    }
+    value->kind = kind;
+    value->data = nullptr;
+    value->len = 0;
+    value->reader = nullptr;
+    return value;
+}
+
+bool PageRenderer::copyValue(const char* name, const char* text, ValueKind kind) {
+    size_t len = text != nullptr ? strlen(text) : 0;
+    if (len > PAGE_RENDERER_VALUE_SPACE - spaceUsed) {
+        overflow = true;
+        return false;
+    }
+    Value* value = addValue(name, kind);
+    if (value == nullptr) return false;
+    // Replaced values keep their old bytes, pages set each value once
+    memcpy(space + spaceUsed, text, len);
+    value->data = space + spaceUsed;
+    value->len = len;
+    spaceUsed += len;
+    return true;
+}
+
+bool PageRenderer::set(const char* name, const char* text) {
+    return copyValue(name, text, VALUE_TEXT);
+}
+
+bool PageRenderer::setRaw(const char* name, const char* html) {
+    return copyValue(name, html, VALUE_RAW);
+}
+
+bool PageRenderer::setTemplate(const char* name, const char* tpl) {
+    Value* value = addValue(name, VALUE_TEMPLATE);
+    if (value == nullptr) return false;
+    value->data = tpl;
+    return true;
+}
+
+bool PageRenderer::setReader(const char* name, PageReader reader) {
+    Value* value = addValue(name, VALUE_READER);
+    if (value == nullptr) return false;
+    value->reader = reader;
+    return true;
+}
+
+const PageRenderer::Value* PageRenderer::find(const char* name, size_t nameLen) const {
+    for (size_t i = 0; i < valueCount; i++) {
+        if (values[i].nameLen == nameLen && memcmp(values[i].name, name, nameLen) == 0) {
+            return &values[i];
+        }
+    }
+    return nullptr;
+}
+
+size_t PageRenderer::escape(uint8_t* buf, size_t space, const char* src, size_t len, size_t& pos) {
+    size_t out = 0;
+    while (out < space && pos < len) {
+        const char c = src[pos++];
+        const char* entity = htmlEntity(c);
+        if (entity == nullptr) {
+            buf[out++] = (uint8_t)c;
+            continue;
+        }
+        size_t n = strlen(entity);
+        if (n <= space - out) {
+            memcpy(buf + out, entity, n);
+            out += n;
+        } else {
+            memcpy(pending, entity, n);
+            pendingLen = (uint8_t)n;
+            pendingPos = 0;
+            break;
+        }
+    }
+    return out;
+}
+
+bool PageRenderer::done() const {
+    return depth == 0 && current == nullptr && pendingPos == pendingLen;
+}
+
+size_t PageRenderer::read(uint8_t* buf, size_t maxLen) {
+    size_t out = 0;
+    while (out < maxLen) {
+        if (pendingPos < pendingLen) {
+            buf[out++] = (uint8_t)pending[pendingPos++];
+            continue;
+        }
+
+        if (current != nullptr) {
+            if (current->kind == VALUE_READER) {
+                if (currentPos == chunkLen) {
+                    chunkLen = current->reader(chunk, sizeof(chunk));
+                    currentPos = 0;
+                    if (chunkLen == 0) {
+                        current = nullptr;
+                        continue;
+                    }
+                }
+                out += escape(buf + out, maxLen - out, chunk, chunkLen, currentPos);
+            } else if (currentPos == current->len) {
+                current = nullptr;
+            } else if (current->kind == VALUE_RAW) {
+                size_t n = current->len - currentPos;
+                if (n > maxLen - out) n = maxLen - out;
+                memcpy(buf + out, current->data + currentPos, n);
+                currentPos += n;
+                out += n;
+            } else {
+                out += escape(buf + out, maxLen - out, current->data, current->len, currentPos);
+            }
+            continue;
+        }
+
+        if (depth == 0) break;
+        Frame& frame = stack[depth - 1];
+        const char* p = frame.tpl + frame.pos;
+        if (*p == '\0') {
+            depth--;
+            continue;
+        }
+
+        // Literal text up to the next placeholder
+        const char* open = strstr(p, "{{");
+        const char* close = open != nullptr ? strstr(open + 2, "}}") : nullptr;
+        size_t literal = close != nullptr ? (size_t)(open - p) : strlen(p);
+        if (literal > 0) {
+            size_t n = literal < maxLen - out ? literal : maxLen - out;
+            memcpy(buf + out, p, n);
+            frame.pos += n;
+            out += n;
+            continue;
+        }
+
+        const char* name = p + 2;
+        frame.pos += (close + 2) - p;
+        const Value* value = find(name, close - name);
+        if (value == nullptr) continue;
+        if (value->kind == VALUE_TEMPLATE) {
+            if (depth < PAGE_RENDERER_MAX_DEPTH && value->data != nullptr) {
+                stack[depth].tpl = value->data;
+                stack[depth].pos = 0;
+                depth++;
+            }
+        } else {
+            current = value;
+            currentPos = 0;
+            chunkLen = 0;
+        }
+    }
+    total += out;
+    return out;
+}
+
+#if defined(ESP_PLATFORM)
+void sendPage(AsyncWebServerRequest* request, PageRenderer* page, int code) {
+    // The filler outlives the handler, the response owns the renderer
+    std::shared_ptr<PageRenderer> renderer(page);
+    if (renderer->overflowed()) {
+        // A value was dropped, the page would render without it
+        Serial.printf("ERROR: Page values exceed the renderer (%d values, %d bytes)\n",
+                      PAGE_RENDERER_MAX_VALUES, PAGE_RENDERER_VALUE_SPACE);
+        request->send(500, "text/plain", "Page too large");
+        return;
+    }
+    AsyncWebServerResponse* response = request->beginChunkedResponse("text/html",
+        [renderer](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            return renderer->read(buffer, maxLen);
+        });
+    response->setCode(code);
+    request->send(response);
+}
+#endif
@@ -0,0 +1,181 @@
+#include "session_table.h"
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+static portMUX_TYPE sessionLock = portMUX_INITIALIZER_UNLOCKED;
+#define SESSION_LOCK()   portENTER_CRITICAL(&sessionLock)
+#define SESSION_UNLOCK() portEXIT_CRITICAL(&sessionLock)
+#define SESSION_MILLIS() ((uint32_t)(esp_timer_get_time() / 1000))
+#define SESSION_RANDOM(buf, len) esp_fill_random(buf, len)
+#else
+#include <mutex>
+#include <chrono>
+#include <random>
+
+static std::mutex sessionLock;
+#define SESSION_LOCK()   sessionLock.lock()
+#define SESSION_UNLOCK() sessionLock.unlock()
+static uint32_t steadyMillis() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+uint32_t (*sessionHostMillis)() = steadyMillis;
+#define SESSION_MILLIS() sessionHostMillis()
+static void sessionRandom(void* buf, size_t len) {
+    static std::random_device rd;
+    uint8_t* out = (uint8_t*)buf;
+    for (size_t i = 0; i < len; i++) out[i] = (uint8_t)rd();
+}
+#define SESSION_RANDOM(buf, len) sessionRandom(buf, len)
+#endif
+
+SessionTable sessionTable;
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool sessionCookieToken(const char* cookieHeader, uint8_t* token) {
+    static const size_t nameLen = sizeof(SESSION_COOKIE_NAME) - 1;
+    const char* p = cookieHeader;
+    while (p != nullptr && *p != '\0') {
+        while (*p == ' ' || *p == ';') p++;
+        const char* end = strchr(p, ';');
+        size_t len = end != nullptr ? (size_t)(end - p) : strlen(p);
+        while (len > 0 && p[len - 1] == ' ') len--;
+        if (len == nameLen + 1 + SESSION_TOKEN_HEX_LEN &&
+            strncmp(p, SESSION_COOKIE_NAME, nameLen) == 0 && p[nameLen] == '=') {
+            const char* hex = p + nameLen + 1;
+            for (int i = 0; i < SESSION_TOKEN_BYTES; i++) {
+                int hi = hexValue(hex[i * 2]);
+                int lo = hexValue(hex[i * 2 + 1]);
+                if (hi < 0 || lo < 0) return false;
+                token[i] = (uint8_t)((hi << 4) | lo);
+            }
+            return true;
+        }
+        p = end;
+    }
+    return false;
+}
+
+SessionTable::SessionTable() : useClock(0) {
+    memset(sessions, 0, sizeof(sessions));
+    memset(&st, 0, sizeof(st));
+}
+
+// Needs the lock
+void SessionTable::expire(uint32_t now) {
+    for (int i = 0; i < SESSION_TABLE_SIZE; i++) {
+        Session& s = sessions[i];
+        if (s.active && (now - s.lastUsedMs > SESSION_IDLE_TIMEOUT_MS || now - s.createdMs > SESSION_MAX_AGE_MS)) {
+            s.active = false;
+            st.active--;
+            st.expired++;
+        }
+    }
+}
+
+// Needs the lock. Every active slot is compared with every byte, the match is
+// picked without a branch on the token.
+int SessionTable::find(const uint8_t* token) {
+    int found = -1;
+    for (int i = 0; i < SESSION_TABLE_SIZE; i++) {
+        uint8_t diff = sessions[i].active ? 0 : 1;
+        for (int j = 0; j < SESSION_TOKEN_BYTES; j++) {
+            diff |= sessions[i].token[j] ^ token[j];
+        }
+        int match = -(int)(diff == 0);   // all ones on a match
+        found = (found & ~match) | (i & match);
+    }
+    return found;
+}
+
+void SessionTable::create(char* tokenHex) {
+    static const char digits[] = "0123456789abcdef";
+    uint8_t token[SESSION_TOKEN_BYTES];
+    SESSION_RANDOM(token, sizeof(token));
+    for (int i = 0; i < SESSION_TOKEN_BYTES; i++) {
+        tokenHex[i * 2] = digits[token[i] >> 4];
+        tokenHex[i * 2 + 1] = digits[token[i] & 0x0F];
+    }
+    tokenHex[SESSION_TOKEN_HEX_LEN] = '\0';
+
+    SESSION_LOCK();
+    uint32_t now = SESSION_MILLIS();
+    expire(now);
+    // A free slot, or else the least recently used one
+    int slot = 0;
+    for (int i = 0; i < SESSION_TABLE_SIZE; i++) {
+        if (!sessions[i].active) {
+            slot = i;
+            break;
+        }
+        if (useClock - sessions[i].lastUse > useClock - sessions[slot].lastUse) slot = i;
+    }
+    if (sessions[slot].active) {
+        st.evicted++;
+    } else {
+        st.active++;
+    }
+    memcpy(sessions[slot].token, token, sizeof(token));
+    sessions[slot].createdMs = now;
+    sessions[slot].lastUsedMs = now;
+    sessions[slot].lastUse = ++useClock;
+    sessions[slot].active = true;
+    st.created++;
+    SESSION_UNLOCK();
+}
+
+bool SessionTable::validate(const char* cookieHeader) {
+    uint8_t token[SESSION_TOKEN_BYTES];
+    bool parsed = cookieHeader != nullptr && sessionCookieToken(cookieHeader, token);
+
+    SESSION_LOCK();
+    uint32_t now = SESSION_MILLIS();
+    expire(now);
+    int slot = parsed ? find(token) : -1;
+    if (slot >= 0) {
+        sessions[slot].lastUsedMs = now;
+        sessions[slot].lastUse = ++useClock;
+    } else if (parsed) {
+        st.rejected++;
+    }
+    SESSION_UNLOCK();
+    return slot >= 0;
+}
+
+void SessionTable::remove(const char* cookieHeader) {
+    uint8_t token[SESSION_TOKEN_BYTES];
+    if (cookieHeader == nullptr || !sessionCookieToken(cookieHeader, token)) return;
+    SESSION_LOCK();
+    int slot = find(token);
+    if (slot >= 0) {
+        sessions[slot].active = false;
+        st.active--;
+    }
+    SESSION_UNLOCK();
+}
+
+void SessionTable::clear() {
+    SESSION_LOCK();
+    for (int i = 0; i < SESSION_TABLE_SIZE; i++) {
+        sessions[i].active = false;
+    }
+    st.active = 0;
+    SESSION_UNLOCK();
+}
+
+SessionStats SessionTable::stats() const {
+    SESSION_LOCK();
+    SessionStats copy = st;
+    SESSION_UNLOCK();
+    return copy;
+}
@@ -0,0 +1,307 @@
+#include "stored_images.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <memory>
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_jpg_decode.h"
+#include "img_converters.h"
+#include "image_index.h"
+
+// --- Byte Ranges ---
+static bool parseNumber(const char*& p, size_t* out) {
+    if (*p < '0' || *p > '9') return false;
+    size_t value = 0;
+    while (*p >= '0' && *p <= '9') {
+        size_t next = value * 10 + (*p - '0');
+        if (next < value) return false;
+        value = next;
+        p++;
+    }
+    *out = value;
+    return true;
+}
+
+ByteRangeResult parseByteRange(const char* header, size_t size, size_t* first, size_t* last) {
+    const char* p = header;
+    while (*p == ' ') p++;
+    if (strncmp(p, "bytes=", 6) != 0) return BYTE_RANGE_NONE;
+    p += 6;
+    if (strchr(p, ',') != nullptr) return BYTE_RANGE_NONE;
+    while (*p == ' ') p++;
+
+    size_t start, end;
+    if (*p == '-') {
+        // The last n bytes
+        p++;
+        if (!parseNumber(p, &end)) return BYTE_RANGE_NONE;
+        if (end == 0 || size == 0) return BYTE_RANGE_UNSATISFIABLE;
+        start = end >= size ? 0 : size - end;
+        end = size - 1;
+    } else {
+        if (!parseNumber(p, &start) || *p++ != '-') return BYTE_RANGE_NONE;
+        if (*p >= '0' && *p <= '9') {
+            if (!parseNumber(p, &end) || end < start) return BYTE_RANGE_NONE;
+        } else {
+            end = SIZE_MAX;
+        }
+        if (start >= size) return BYTE_RANGE_UNSATISFIABLE;
+        if (end >= size) end = size - 1;
+    }
+    while (*p == ' ') p++;
+    if (*p != '\0') return BYTE_RANGE_NONE;
+    *first = start;
+    *last = end;
+    return BYTE_RANGE_OK;
+}
+
+bool isImageName(const char* name) {
+    size_t len = strlen(name);
+    return len > 0 && len < IMAGE_NAME_LEN && strchr(name, '/') == nullptr && strcmp(name, "..") != 0 && name[0] != '.';
+}
+
+// --- Validators ---
+struct ImageValidators {
+    char etag[40];
+    char lastModified[32];
+};
+
+// Names are "img-<unix time>.jpg" and the files are never rewritten, so the
+// name and size are as good as a hash
+static void imageValidators(File& file, const char* name, const char* variant, ImageValidators& out) {
+    unsigned long seconds;
+    time_t modified = sscanf(name, "img-%lu.jpg", &seconds) == 1 ? (time_t)seconds : file.getLastWrite();
+    snprintf(out.etag, sizeof(out.etag), "\"%lx-%x%s\"", (unsigned long)modified, (unsigned)file.size(), variant);
+    struct tm tm;
+    gmtime_r(&modified, &tm);
+    strftime(out.lastModified, sizeof(out.lastModified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+// If-None-Match wins over If-Modified-Since. Browsers send back the
+// Last-Modified they got, so comparing the text is enough.
+static bool notModified(AsyncWebServerRequest* request, const ImageValidators& v) {
+    if (request->hasHeader("If-None-Match")) {
+        String tags = request->header("If-None-Match");
+        return tags == "*" || tags.indexOf(v.etag) != -1;
+    }
+    return request->hasHeader("If-Modified-Since") && request->header("If-Modified-Since") == v.lastModified;
+}
+
+static void addCacheHeaders(AsyncWebServerResponse* response, const ImageValidators& v) {
+    response->addHeader("ETag", v.etag);
+    response->addHeader("Last-Modified", v.lastModified);
+    response->addHeader("Cache-Control", IMAGE_CACHE_CONTROL);
+}
+
+static void sendImageFile(AsyncWebServerRequest* request, const String& path, const char* name,
+                          const char* variant, bool ranges) {
+    File file = LittleFS.open(path, "r");
+    if (!file || file.isDirectory()) {
+        request->send(404, "text/plain", "File not found");
+        return;
+    }
+    ImageValidators validators;
+    imageValidators(file, name, variant, validators);
+    size_t size = file.size();
+
+    AsyncWebServerResponse* response;
+    if (notModified(request, validators)) {
+        file.close();
+        response = request->beginResponse(304);
+        addCacheHeaders(response, validators);
+        request->send(response);
+        return;
+    }
+
+    size_t first = 0, last = 0;
+    ByteRangeResult range = BYTE_RANGE_NONE;
+    if (ranges && request->hasHeader("Range")) {
+        // A Range under If-Range only holds for the version the client has
+        bool current = true;
+        if (request->hasHeader("If-Range")) {
+            String ifRange = request->header("If-Range");
+            current = ifRange == validators.etag || ifRange == validators.lastModified;
+        }
+        if (current) range = parseByteRange(request->header("Range").c_str(), size, &first, &last);
+    }
+
+    if (range == BYTE_RANGE_UNSATISFIABLE) {
+        file.close();
+        response = request->beginResponse(416, "text/plain", "Range Not Satisfiable");
+        response->addHeader("Content-Range", "bytes */" + String(size));
+    } else if (range == BYTE_RANGE_OK) {
+        // The response reads the range from the file as the socket takes it
+        std::shared_ptr<File> shared(new File(file));
+        size_t length = last - first + 1;
+        response = request->beginResponse("image/jpeg", length,
+            [shared, first, length](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                if (index >= length) return 0;
+                size_t n = length - index < maxLen ? length - index : maxLen;
+                if (shared->position() != first + index && !shared->seek(first + index)) return 0;
+                return shared->read(buffer, n);
+            });
+        response->setCode(206);
+        response->addHeader("Content-Range", "bytes " + String(first) + "-" + String(last) + "/" + String(size));
+        addCacheHeaders(response, validators);
+    } else {
+        file.close();
+        response = request->beginResponse(LittleFS, path, "image/jpeg");
+        addCacheHeaders(response, validators);
+    }
+    if (ranges) response->addHeader("Accept-Ranges", "bytes");
+    request->send(response);
+}
+
+void sendStoredImage(AsyncWebServerRequest* request, const char* name) {
+    if (!isImageName(name)) {
+        request->send(400, "text/plain", "Bad Request");
+        return;
+    }
+    sendImageFile(request, String(IMAGE_DIR "/") + name, name, "", true);
+}
+
+// --- Thumbnails ---
+struct ThumbnailDecode {
+    File* source;
+    uint8_t* rgb;       // BGR888, what the decoder writes and fmt2jpg takes
+    uint16_t width;
+    uint16_t height;
+};
+
+static size_t readJpeg(void* arg, size_t index, uint8_t* buf, size_t len) {
+    ThumbnailDecode* decode = (ThumbnailDecode*)arg;
+    if (decode->source->position() != index && !decode->source->seek(index)) return 0;
+    if (buf == nullptr) {
+        // skip
+        return decode->source->seek(index + len) ? len : 0;
+    }
+    return decode->source->read(buf, len);
+}
+
+static bool writeThumbnailPixels(void* arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t* data) {
+    ThumbnailDecode* decode = (ThumbnailDecode*)arg;
+    if (data == nullptr) {
+        if (x == 0 && y == 0 && decode->rgb == nullptr) {
+            decode->width = w;
+            decode->height = h;
+            decode->rgb = (uint8_t*)ps_malloc((size_t)w * h * 3);
+            return decode->rgb != nullptr;
+        }
+        return true;
+    }
+    for (uint16_t row = 0; row < h; row++) {
+        memcpy(decode->rgb + ((size_t)(y + row) * decode->width + x) * 3, data, (size_t)w * 3);
+        data += (size_t)w * 3;
+    }
+    return true;
+}
+
+// Decodes straight from the file, only the scaled down pixels are in RAM.
+// Runs on the thumbnail task only, esp_jpg_decode() has a static work buffer.
+static bool makeThumbnail(const char* name, const String& thumbPath) {
+    File source = LittleFS.open(String(IMAGE_DIR "/") + name, "r");
+    uint16_t width, height;
+    if (!source || !readJpegSize(source, &width, &height)) return false;
+    jpg_scale_t scale = JPG_SCALE_NONE;
+    while (scale < JPG_SCALE_MAX && (width >> (scale + 1)) >= IMAGE_THUMB_MIN_WIDTH) {
+        scale = (jpg_scale_t)(scale + 1);
+    }
+
+    ThumbnailDecode decode = { &source, nullptr, 0, 0 };
+    source.seek(0);
+    bool ok = esp_jpg_decode(source.size(), scale, readJpeg, writeThumbnailPixels, &decode) == ESP_OK;
+    source.close();
+
+    uint8_t* jpg = nullptr;
+    size_t jpgLen = 0;
+    if (ok) {
+        ok = fmt2jpg(decode.rgb, (size_t)decode.width * decode.height * 3, decode.width, decode.height,
+                     PIXFORMAT_RGB888, IMAGE_THUMB_QUALITY, &jpg, &jpgLen);
+    }
+    free(decode.rgb);
+    if (ok) {
+        // Written aside and renamed, the web server never sees half a thumbnail
+        String tmpPath = thumbPath + ".tmp";
+        if (!LittleFS.exists(IMAGE_THUMB_DIR)) LittleFS.mkdir(IMAGE_THUMB_DIR);
+        File out = LittleFS.open(tmpPath, "w");
+        ok = out && out.write(jpg, jpgLen) == jpgLen;
+        out.close();
+        ok = ok && LittleFS.rename(tmpPath, thumbPath);
+        if (!ok) LittleFS.remove(tmpPath);
+    }
+    free(jpg);
+    if (!ok) Serial.printf("ERROR: Can't make a thumbnail of %s\n", name);
+    return ok;
+}
+
+static QueueHandle_t thumbQueue = nullptr;
+
+static void thumbnailTask(void* arg) {
+    char name[IMAGE_NAME_LEN];
+    for (;;) {
+        if (xQueueReceive(thumbQueue, name, portMAX_DELAY) != pdTRUE) continue;
+        String thumbPath = String(IMAGE_THUMB_DIR "/") + name;
+        // A gallery asks again while the first request is queued
+        if (LittleFS.exists(thumbPath) || !LittleFS.exists(String(IMAGE_DIR "/") + name)) continue;
+        makeThumbnail(name, thumbPath);
+        // Deleted while it was being made
+        if (!LittleFS.exists(String(IMAGE_DIR "/") + name)) LittleFS.remove(thumbPath);
+    }
+}
+
+bool beginThumbnails() {
+    if (thumbQueue != nullptr) return true;
+    thumbQueue = xQueueCreate(IMAGE_THUMB_QUEUE, IMAGE_NAME_LEN);
+    if (thumbQueue == nullptr) return false;
+    if (xTaskCreatePinnedToCore(thumbnailTask, "thumbnails", 6144, nullptr,
+                                IMAGE_THUMB_PRIORITY, nullptr, IMAGE_THUMB_CORE) != pdPASS) {
+        vQueueDelete(thumbQueue);
+        thumbQueue = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void queueThumbnail(const char* name) {
+    if (thumbQueue == nullptr || !isImageName(name)) return;
+    char item[IMAGE_NAME_LEN];
+    strncpy(item, name, sizeof(item) - 1);
+    item[sizeof(item) - 1] = '\0';
+    xQueueSend(thumbQueue, item, 0);
+}
+
+void sendThumbnail(AsyncWebServerRequest* request, const char* name) {
+    if (!isImageName(name)) {
+        request->send(400, "text/plain", "Bad Request");
+        return;
+    }
+    String thumbPath = String(IMAGE_THUMB_DIR "/") + name;
+    if (LittleFS.exists(thumbPath)) {
+        sendImageFile(request, thumbPath, name, "-t", false);
+        return;
+    }
+    String path = String(IMAGE_DIR "/") + name;
+    if (!LittleFS.exists(path)) {
+        request->send(404, "text/plain", "File not found");
+        return;
+    }
+    // The browser scales the image this time and asks again next time
+    queueThumbnail(name);
+    AsyncWebServerResponse* response = request->beginResponse(LittleFS, path, "image/jpeg");
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+bool removeStoredImage(const char* name) {
+    if (!isImageName(name)) return false;
+    String path = String(IMAGE_DIR "/") + name;
+    if (!LittleFS.exists(path)) return false;
+    imageIndex.remove(name);
+    LittleFS.remove(String(IMAGE_THUMB_DIR "/") + name);
+    return LittleFS.remove(path);
+}
@@ -0,0 +1,124 @@
+#include "telemetry.h"
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "esp_timer.h"
+#endif
+
+// --- Encoder ---
+static size_t putVarint(uint8_t* out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+size_t telemetryPutDelta(uint8_t* out, int32_t value, int32_t previous) {
+    int32_t delta = (int32_t)((uint32_t)value - (uint32_t)previous);
+    return putVarint(out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+}
+
+TelemetryEncoder::TelemetryEncoder() : sampleCount(0) {
+}
+
+bool TelemetryEncoder::add(const TelemetrySample& sample) {
+    if (sampleCount >= TELEMETRY_MAX_BATCH) return false;
+    samples[sampleCount++] = sample;
+    return true;
+}
+
+size_t TelemetryEncoder::finish(uint8_t* out) {
+    size_t len = 0;
+    out[len++] = TELEMETRY_FRAME_VERSION;
+    out[len++] = (uint8_t)sampleCount;
+    int32_t previous[TELEMETRY_FIELD_COUNT] = {};
+    for (size_t i = 0; i < sampleCount; i++) {
+        for (int field = 0; field < TELEMETRY_FIELD_COUNT; field++) {
+            len += telemetryPutDelta(out + len, samples[i].values[field], previous[field]);
+            previous[field] = samples[i].values[field];
+        }
+    }
+    sampleCount = 0;
+    return len;
+}
+
+// --- WebSocket ---
+#if defined(ESP_PLATFORM)
+TelemetrySocket telemetrySocket;
+
+TelemetrySocket::TelemetrySocket()
+    : ws(TELEMETRY_WS_URI), sampler(nullptr), lastSampleMs(0), lastFlushMs(0), flushSoon(false)
+{
+    memset(&st, 0, sizeof(st));
+}
+
+void TelemetrySocket::begin(AsyncWebServer& server, ArRequestFilterFunction filter, TelemetrySampler s) {
+    sampler = s;
+    ws.setFilter(filter);
+    ws.onEvent([this](AsyncWebSocket* socket, AsyncWebSocketClient* client, AwsEventType type,
+                      void* arg, uint8_t* data, size_t len) {
+        if (type == WS_EVT_CONNECT) flushSoon = true;
+    });
+    server.addHandler(&ws);
+}
+
+void TelemetrySocket::update(uint32_t nowMs, uint32_t flushMs) {
+    st.clients = ws.count();
+    if (st.clients == 0) {
+        // Leftovers of the last client would be stale for the next one
+        if (encoder.count() > 0) {
+            uint8_t discard[TELEMETRY_MAX_FRAME];
+            encoder.finish(discard);
+        }
+        lastSampleMs = nowMs - TELEMETRY_SAMPLE_MS;
+        return;
+    }
+
+    if (nowMs - lastSampleMs >= TELEMETRY_SAMPLE_MS) {
+        int64_t startUs = esp_timer_get_time();
+        TelemetrySample sample;
+        sampler(sample);
+        sample.values[TELEMETRY_MILLIS] = (int32_t)nowMs;
+        if (!encoder.add(sample)) {
+            // The refresh interval is longer than a full batch
+            flushSoon = true;
+        } else {
+            st.samples++;
+        }
+        lastSampleMs = nowMs;
+        st.encodeUs += esp_timer_get_time() - startUs;
+    }
+
+    if (encoder.count() > 0 && (flushSoon || nowMs - lastFlushMs >= flushMs || encoder.count() >= TELEMETRY_MAX_BATCH)) {
+        int64_t startUs = esp_timer_get_time();
+        uint8_t frame[TELEMETRY_MAX_FRAME];
+        size_t len = encoder.finish(frame);
+        st.encodeUs += esp_timer_get_time() - startUs;
+        // A client with a full queue skips this frame, the others still get it
+        bool sent = false;
+        for (auto& client : ws.getClients()) {
+            if (client.status() != WS_CONNECTED) continue;
+            if (client.canSend()) {
+                ws.binary(client.id(), frame, len);
+                sent = true;
+            } else {
+                st.dropped++;
+            }
+        }
+        if (sent) {
+            st.frames++;
+            st.bytes += len;
+        }
+        lastFlushMs = nowMs;
+        flushSoon = false;
+        ws.cleanupClients();
+    }
+}
+
+TelemetryStats TelemetrySocket::stats() const {
+    return st;
+}
+#endif
@@ -0,0 +1,346 @@
+#include "telemetry_history.h"
+#include <string.h>
+#include <stdlib.h>
+#include "telemetry.h"
+
+#if defined(ESP_PLATFORM)
+#include <memory>
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+
+static portMUX_TYPE historyLock = portMUX_INITIALIZER_UNLOCKED;
+#define HISTORY_LOCK()   portENTER_CRITICAL(&historyLock)
+#define HISTORY_UNLOCK() portEXIT_CRITICAL(&historyLock)
+#else
+#include <mutex>
+
+static std::mutex historyLock;
+#define HISTORY_LOCK()   historyLock.lock()
+#define HISTORY_UNLOCK() historyLock.unlock()
+#endif
+
+#define HISTORY_HEADER_SIZE       7
+#define HISTORY_TIER_HEADER_SIZE  4
+#define HISTORY_MAX_STREAM        (HISTORY_HEADER_SIZE + TELEMETRY_HISTORY_TIERS * HISTORY_TIER_HEADER_SIZE + \
+    (TELEMETRY_HISTORY_SECONDS + TELEMETRY_HISTORY_MINUTES + TELEMETRY_HISTORY_HOURS) * HISTORY_FIELD_COUNT * 5)
+
+TelemetryHistory telemetryHistory;
+
+// --- Folding ---
+enum FoldKind : uint8_t { FOLD_FIRST, FOLD_MEAN, FOLD_MIN, FOLD_SUM };
+
+static const FoldKind foldKinds[HISTORY_FIELD_COUNT] = {
+    FOLD_FIRST,     // time
+    FOLD_MEAN,      // cpu0
+    FOLD_MEAN,      // cpu1
+    FOLD_MIN,       // heap free
+    FOLD_MIN,       // psram free
+    FOLD_MEAN,      // rssi
+    FOLD_MEAN,      // temp
+    FOLD_MEAN,      // fps
+    FOLD_SUM,       // bees in
+    FOLD_SUM,       // bees out
+};
+
+static const uint16_t tierCapacity[TELEMETRY_HISTORY_TIERS] = {
+    TELEMETRY_HISTORY_SECONDS, TELEMETRY_HISTORY_MINUTES, TELEMETRY_HISTORY_HOURS
+};
+
+// Rounded to the nearest, halves away from zero
+static int32_t roundedMean(int64_t sum, uint16_t count) {
+    return (int32_t)(sum >= 0 ? (sum + count / 2) / count : -((-sum + count / 2) / count));
+}
+
+TelemetryHistory::TelemetryHistory() : frames(0), beesIn(0), beesOut(0) {
+    uint16_t seconds = 1;
+    for (int t = 0; t < TELEMETRY_HISTORY_TIERS; t++) {
+        tiers[t].records = nullptr;
+        tiers[t].capacity = tierCapacity[t];
+        tiers[t].seconds = seconds;
+        tiers[t].total = 0;
+        seconds *= TELEMETRY_HISTORY_FOLD;
+    }
+    memset(folds, 0, sizeof(folds));
+}
+
+bool TelemetryHistory::begin() {
+    for (int t = 0; t < TELEMETRY_HISTORY_TIERS; t++) {
+        if (tiers[t].records != nullptr) continue;
+        size_t bytes = (size_t)tiers[t].capacity * sizeof(HistoryRecord);
+#if defined(ESP_PLATFORM)
+        HistoryRecord* records = (HistoryRecord*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM);
+        if (records == nullptr) records = (HistoryRecord*)malloc(bytes);
+#else
+        HistoryRecord* records = (HistoryRecord*)malloc(bytes);
+#endif
+        if (records == nullptr) return false;
+        HISTORY_LOCK();
+        tiers[t].records = records;
+        HISTORY_UNLOCK();
+    }
+    return true;
+}
+
+void TelemetryHistory::push(int tier, const HistoryRecord& record) {
+    Tier& t = tiers[tier];
+    t.records[t.total % t.capacity] = record;
+    t.total++;
+}
+
+// Folds a record of the tier into the record of the next one, and that into
+// the one after when it is complete. True when the last tier got a record.
+bool TelemetryHistory::fold(int tier, const HistoryRecord& record) {
+    Fold& f = folds[tier];
+    for (int field = 0; field < HISTORY_FIELD_COUNT; field++) {
+        int32_t value = record.values[field];
+        switch (foldKinds[field]) {
+            case FOLD_FIRST:
+                if (f.count == 0) f.record.values[field] = value;
+                break;
+            case FOLD_MIN:
+                if (f.count == 0 || value < f.record.values[field]) f.record.values[field] = value;
+                break;
+            case FOLD_MEAN:
+            case FOLD_SUM:
+                f.sums[field] = (f.count == 0 ? 0 : f.sums[field]) + value;
+                break;
+        }
+    }
+    if (++f.count < TELEMETRY_HISTORY_FOLD) return false;
+
+    for (int field = 0; field < HISTORY_FIELD_COUNT; field++) {
+        if (foldKinds[field] == FOLD_MEAN) f.record.values[field] = roundedMean(f.sums[field], f.count);
+        if (foldKinds[field] == FOLD_SUM) f.record.values[field] = (int32_t)f.sums[field];
+    }
+    f.count = 0;
+    push(tier + 1, f.record);
+    if (tier + 1 == TELEMETRY_HISTORY_TIERS - 1) return true;
+    return fold(tier + 1, f.record);
+}
+
+bool TelemetryHistory::add(const HistoryRecord& sample) {
+    HISTORY_LOCK();
+    bool hour = false;
+    if (tiers[TELEMETRY_HISTORY_TIERS - 1].records != nullptr) {
+        push(0, sample);
+        hour = fold(0, sample);
+    }
+    HISTORY_UNLOCK();
+    return hour;
+}
+
+void TelemetryHistory::countFrame() {
+    HISTORY_LOCK();
+    frames++;
+    HISTORY_UNLOCK();
+}
+
+void TelemetryHistory::countBees(uint32_t in, uint32_t out) {
+    HISTORY_LOCK();
+    beesIn += in;
+    beesOut += out;
+    HISTORY_UNLOCK();
+}
+
+void TelemetryHistory::takeCounts(uint32_t* f, uint32_t* in, uint32_t* out) {
+    HISTORY_LOCK();
+    *f = frames;
+    *in = beesIn;
+    *out = beesOut;
+    frames = beesIn = beesOut = 0;
+    HISTORY_UNLOCK();
+}
+
+void TelemetryHistory::window(int tier, uint32_t* first, uint32_t* end) const {
+    HISTORY_LOCK();
+    const Tier& t = tiers[tier];
+    *end = t.records != nullptr ? t.total : 0;
+    *first = *end > t.capacity ? *end - t.capacity : 0;
+    HISTORY_UNLOCK();
+}
+
+bool TelemetryHistory::get(int tier, uint32_t number, HistoryRecord& out) const {
+    HISTORY_LOCK();
+    const Tier& t = tiers[tier];
+    bool ok = t.records != nullptr && number < t.total;
+    if (ok) {
+        if (t.total - number > t.capacity) number = t.total - t.capacity;
+        out = t.records[number % t.capacity];
+    }
+    HISTORY_UNLOCK();
+    return ok;
+}
+
+size_t TelemetryHistory::memoryBytes() const {
+    size_t bytes = 0;
+    for (int t = 0; t < TELEMETRY_HISTORY_TIERS; t++) {
+        if (tiers[t].records != nullptr) bytes += (size_t)tiers[t].capacity * sizeof(HistoryRecord);
+    }
+    return bytes;
+}
+
+// --- Restore ---
+static bool getVarint(const uint8_t* data, size_t len, size_t& at, uint32_t* out) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (at >= len) return false;
+        uint8_t b = data[at++];
+        value |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *out = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+bool TelemetryHistory::restore(const uint8_t* data, size_t len) {
+    if (len < HISTORY_HEADER_SIZE || data[0] != TELEMETRY_HISTORY_VERSION || data[2] != HISTORY_FIELD_COUNT) {
+        return false;
+    }
+    // Checked whole before anything is put back
+    for (int apply = 0; apply < 2; apply++) {
+        size_t at = HISTORY_HEADER_SIZE;
+        for (int i = 0; i < data[1]; i++) {
+            if (len - at < HISTORY_TIER_HEADER_SIZE) return false;
+            uint16_t seconds = getU16(data + at);
+            uint16_t count = getU16(data + at + 2);
+            at += HISTORY_TIER_HEADER_SIZE;
+            int tier = -1;
+            for (int t = 0; t < TELEMETRY_HISTORY_TIERS; t++) {
+                if (tiers[t].seconds == seconds) tier = t;
+            }
+            HistoryRecord record = {};
+            for (uint16_t r = 0; r < count; r++) {
+                for (int field = 0; field < HISTORY_FIELD_COUNT; field++) {
+                    uint32_t zigzag;
+                    if (!getVarint(data, len, at, &zigzag)) return false;
+                    int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+                    record.values[field] = (int32_t)((uint32_t)record.values[field] + (uint32_t)delta);
+                }
+                // A tier this firmware doesn't have is skipped
+                if (apply && tier >= 0) {
+                    HISTORY_LOCK();
+                    if (tiers[tier].records != nullptr) push(tier, record);
+                    HISTORY_UNLOCK();
+                }
+            }
+        }
+        if (at != len) return false;
+    }
+    return true;
+}
+
+// --- Stream ---
+TelemetryHistoryStream::TelemetryHistoryStream(const TelemetryHistory& history, uint32_t now)
+    : history(history), now(now), tier(-1), next(0), end(0), pendingLen(0), pendingPos(0)
+{
+    memset(previous, 0, sizeof(previous));
+}
+
+// Puts the next header or record in pending, nothing at the end
+void TelemetryHistoryStream::fill() {
+    pendingLen = pendingPos = 0;
+    if (tier < 0) {
+        pending[0] = TELEMETRY_HISTORY_VERSION;
+        pending[1] = TELEMETRY_HISTORY_TIERS;
+        pending[2] = HISTORY_FIELD_COUNT;
+        for (int i = 0; i < 4; i++) pending[3 + i] = (uint8_t)(now >> (8 * i));
+        pendingLen = HISTORY_HEADER_SIZE;
+        tier = 0;
+        next = end = 0;
+        return;
+    }
+    while (next == end) {
+        if (tier >= TELEMETRY_HISTORY_TIERS) return;
+        // A new tier, from the first record as it is now
+        uint32_t first;
+        history.window(tier, &first, &end);
+        next = first;
+        uint16_t seconds = history.tierSeconds(tier);
+        uint16_t count = (uint16_t)(end - first);
+        pending[0] = (uint8_t)seconds;
+        pending[1] = (uint8_t)(seconds >> 8);
+        pending[2] = (uint8_t)count;
+        pending[3] = (uint8_t)(count >> 8);
+        pendingLen = HISTORY_TIER_HEADER_SIZE;
+        memset(previous, 0, sizeof(previous));
+        tier++;
+        return;
+    }
+    HistoryRecord record;
+    history.get(tier - 1, next++, record);
+    for (int field = 0; field < HISTORY_FIELD_COUNT; field++) {
+        pendingLen += telemetryPutDelta(pending + pendingLen, record.values[field], previous[field]);
+        previous[field] = record.values[field];
+    }
+}
+
+size_t TelemetryHistoryStream::read(uint8_t* buffer, size_t maxLen) {
+    size_t written = 0;
+    while (written < maxLen) {
+        if (pendingPos == pendingLen) {
+            fill();
+            if (pendingLen == 0) break;
+        }
+        size_t n = pendingLen - pendingPos < maxLen - written ? pendingLen - pendingPos : maxLen - written;
+        memcpy(buffer + written, pending + pendingPos, n);
+        pendingPos += n;
+        written += n;
+    }
+    return written;
+}
+
+// --- Web and Flash ---
+#if defined(ESP_PLATFORM)
+void sendTelemetryHistory(AsyncWebServerRequest* request) {
+    std::shared_ptr<TelemetryHistoryStream> stream(new TelemetryHistoryStream(telemetryHistory, (uint32_t)time(nullptr)));
+    AsyncWebServerResponse* response = request->beginChunkedResponse("application/octet-stream",
+        [stream](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            return stream->read(buffer, maxLen);
+        });
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+bool saveTelemetryHistory() {
+    static const char* tempPath = TELEMETRY_HISTORY_PATH ".tmp";
+    File file = LittleFS.open(tempPath, "w");
+    if (!file) return false;
+    TelemetryHistoryStream stream(telemetryHistory, (uint32_t)time(nullptr));
+    uint8_t buffer[512];
+    size_t n;
+    bool ok = true;
+    while (ok && (n = stream.read(buffer, sizeof(buffer))) > 0) ok = file.write(buffer, n) == n;
+    file.close();
+    if (ok) ok = LittleFS.rename(tempPath, TELEMETRY_HISTORY_PATH);
+    if (!ok) {
+        LittleFS.remove(tempPath);
+        Serial.println("ERROR: Can't write the telemetry history snapshot");
+    }
+    return ok;
+}
+
+bool loadTelemetryHistory() {
+    if (!LittleFS.exists(TELEMETRY_HISTORY_PATH)) return false;
+    File file = LittleFS.open(TELEMETRY_HISTORY_PATH, "r");
+    if (!file) return false;
+    size_t len = file.size();
+    uint8_t* data = nullptr;
+    if (len <= HISTORY_MAX_STREAM) {
+        data = (uint8_t*)ps_malloc(len > 0 ? len : 1);
+        if (data == nullptr) data = (uint8_t*)malloc(len > 0 ? len : 1);
+    }
+    bool ok = data != nullptr && file.read(data, len) == len && telemetryHistory.restore(data, len);
+    file.close();
+    free(data);
+    if (!ok) Serial.println("WARN: Telemetry history snapshot not restored");
+    return ok;
+}
+#endif
@@ -0,0 +1,159 @@
+#include "web_assets.h"
+#include <string.h>
+#include <LittleFS.h>
+#include "mbedtls/md.h"
+
+WebAssets webAssets;
+
+static const char* contentType(const char* name) {
+    const char* ext = strrchr(name, '.');
+    if (ext == nullptr) return "application/octet-stream";
+    if (strcmp(ext, ".html") == 0) return "text/html";
+    if (strcmp(ext, ".css") == 0) return "text/css";
+    if (strcmp(ext, ".js") == 0) return "application/javascript";
+    if (strcmp(ext, ".svg") == 0) return "image/svg+xml";
+    return "application/octet-stream";
+}
+
+static bool endsWith(const char* str, const char* suffix) {
+    size_t len = strlen(str);
+    size_t suffixLen = strlen(suffix);
+    return len >= suffixLen && strcmp(str + len - suffixLen, suffix) == 0;
+}
+
+// Hashes the file in small pieces, the assets are never loaded whole
+static void fileVersion(File& file, char* version) {
+    uint8_t buf[256];
+    uint8_t hash[32];
+    mbedtls_md_context_t ctx;
+    mbedtls_md_init(&ctx);
+    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 0);
+    mbedtls_md_starts(&ctx);
+    size_t n;
+    while ((n = file.read(buf, sizeof(buf))) > 0) {
+        mbedtls_md_update(&ctx, buf, n);
+    }
+    mbedtls_md_finish(&ctx, hash);
+    mbedtls_md_free(&ctx);
+
+    for (int i = 0; i < 8; i++) {
+        sprintf(version + i * 2, "%02x", hash[i]);
+    }
+}
+
+// gzip is acceptable unless Accept-Encoding leaves it out or gives it q=0.
+// Without the header any coding is.
+static bool acceptsGzip(AsyncWebServerRequest* request) {
+    if (!request->hasHeader("Accept-Encoding")) return true;
+    String header = request->header("Accept-Encoding");
+    header.toLowerCase();
+    float gzipQ = -1.0f, anyQ = -1.0f;
+    int start = 0;
+    while (start < (int)header.length()) {
+        int end = header.indexOf(',', start);
+        if (end < 0) end = header.length();
+        String coding = header.substring(start, end);
+        start = end + 1;
+        float q = 1.0f;
+        int semicolon = coding.indexOf(';');
+        if (semicolon >= 0) {
+            String params = coding.substring(semicolon + 1);
+            params.replace(" ", "");
+            int qAt = params.indexOf("q=");
+            if (qAt >= 0) q = params.substring(qAt + 2).toFloat();
+            coding = coding.substring(0, semicolon);
+        }
+        coding.trim();
+        if (coding == "gzip") gzipQ = q;
+        else if (coding == "*") anyQ = q;
+    }
+    return gzipQ >= 0.0f ? gzipQ > 0.0f : anyQ > 0.0f;
+}
+
+WebAssets::WebAssets() : assetCount(0) {
+    memset(assets, 0, sizeof(assets));
+}
+
+size_t WebAssets::begin() {
+    assetCount = 0;
+    File dir = LittleFS.open(WEB_ASSETS_DIR);
+    if (!dir || !dir.isDirectory()) {
+        Serial.println("WARNING: No " WEB_ASSETS_DIR " in LittleFS, upload the filesystem image for the web UI");
+        return 0;
+    }
+    File file = dir.openNextFile();
+    while (file && assetCount < WEB_ASSETS_MAX) {
+        const char* name = file.name();
+        size_t nameLen = strlen(name);
+        if (!file.isDirectory() && endsWith(name, ".gz") && nameLen - 3 < WEB_ASSETS_NAME_LEN) {
+            WebAsset& asset = assets[assetCount++];
+            memcpy(asset.name, name, nameLen - 3);
+            asset.name[nameLen - 3] = '\0';
+            asset.size = file.size();
+            fileVersion(file, asset.version);
+            asset.etag[0] = '"';
+            memcpy(asset.etag + 1, asset.version, 16);
+            asset.etag[17] = '"';
+            asset.etag[18] = '\0';
+            asset.identity = LittleFS.exists(String(WEB_ASSETS_DIR "/") + asset.name);
+            Serial.printf("Web asset %s: %u bytes, ETag %s\n", asset.name, (unsigned)asset.size, asset.etag);
+        }
+        file = dir.openNextFile();
+    }
+    return assetCount;
+}
+
+void WebAssets::registerStatic(AsyncWebServer& server) {
+    for (size_t i = 0; i < assetCount; i++) {
+        if (endsWith(assets[i].name, ".html")) continue;
+        const char* name = assets[i].name;
+        const char* version = assets[i].version;
+        server.on((String(WEB_ASSETS_STATIC_URI) + name).c_str(), HTTP_GET, [this, name, version](AsyncWebServerRequest* request) {
+            bool current = request->hasParam("v") && request->getParam("v")->value() == version;
+            send(request, name, current ? WEB_ASSETS_VERSIONED_CACHE : WEB_ASSETS_STATIC_CACHE);
+        });
+    }
+}
+
+const WebAsset* WebAssets::find(const char* name) const {
+    for (size_t i = 0; i < assetCount; i++) {
+        if (strcmp(assets[i].name, name) == 0) return &assets[i];
+    }
+    return nullptr;
+}
+
+const char* WebAssets::version(const char* name) const {
+    const WebAsset* asset = find(name);
+    return asset != nullptr ? asset->version : "";
+}
+
+bool WebAssets::send(AsyncWebServerRequest* request, const char* name, const char* cacheControl) {
+    const WebAsset* asset = find(name);
+    if (asset == nullptr) return false;
+
+    // The uncompressed copy is another representation, with its own ETag. A
+    // LittleFS image without the copies still sends gzip.
+    bool gzip = acceptsGzip(request) || !asset->identity;
+    char etag[sizeof(asset->etag) + 4];
+    if (gzip) {
+        strcpy(etag, asset->etag);
+    } else {
+        snprintf(etag, sizeof(etag), "\"%s-id\"", asset->version);
+    }
+
+    AsyncWebServerResponse* response;
+    // If-None-Match may list several tags, ours are unique enough to search for
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match").indexOf(etag) != -1) {
+        response = request->beginResponse(304);
+    } else if (gzip) {
+        response = request->beginResponse(LittleFS, String(WEB_ASSETS_DIR "/") + asset->name + ".gz", contentType(asset->name));
+        response->addHeader("Content-Encoding", "gzip");
+    } else {
+        response = request->beginResponse(LittleFS, String(WEB_ASSETS_DIR "/") + asset->name, contentType(asset->name));
+    }
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", cacheControl);
+    response->addHeader("Vary", "Accept-Encoding");
+    request->send(response);
+    return true;
+}
@@ -0,0 +1,151 @@
+#include "weight_prefetch.h"
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static portMUX_TYPE prefetchLock = portMUX_INITIALIZER_UNLOCKED;
+#define PREFETCH_LOCK()   portENTER_CRITICAL(&prefetchLock)
+#define PREFETCH_UNLOCK() portEXIT_CRITICAL(&prefetchLock)
+
+// One request at a time: the inference task fills it and notifies the copy
+// task, which gives copyDone when the data is in the staging area
+static TaskHandle_t copyTask = nullptr;
+static SemaphoreHandle_t copyDone = nullptr;
+static void* volatile copyDst;
+static const void* volatile copySrc;
+static volatile size_t copySize;
+
+static void copyTaskMain(void* arg) {
+    (void)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        memcpy(copyDst, copySrc, copySize);
+        xSemaphoreGive(copyDone);
+    }
+}
+#else
+#include <mutex>
+
+static std::mutex prefetchLock;
+#define PREFETCH_LOCK()   prefetchLock.lock()
+#define PREFETCH_UNLOCK() prefetchLock.unlock()
+#endif
+
+WeightPrefetch weightPrefetch;
+
+WeightPrefetch::WeightPrefetch()
+    : enabled(true), pending(false), seq(0)
+{
+    memset(&current, 0, sizeof(current));
+    memset(&report, 0, sizeof(report));
+}
+
+#if defined(ESP_PLATFORM)
+
+bool WeightPrefetch::begin() {
+    if (copyTask != nullptr) return true;
+    copyDone = xSemaphoreCreateBinary();
+    if (copyDone == nullptr) return false;
+    if (xTaskCreatePinnedToCore(copyTaskMain, "weight_prefetch", 2048, nullptr,
+                                WEIGHT_PREFETCH_PRIORITY, &copyTask, WEIGHT_PREFETCH_COPY_CORE) != pdPASS) {
+        vSemaphoreDelete(copyDone);
+        copyDone = nullptr;
+        copyTask = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void WeightPrefetch::copy(void* dst, const void* src, size_t size) {
+    if (copyTask == nullptr) {
+        memcpy(dst, src, size);
+        return;
+    }
+    copyDst = dst;
+    copySrc = src;
+    copySize = size;
+    pending = true;
+    xTaskNotifyGive(copyTask);
+}
+
+void WeightPrefetch::wait() {
+    if (!pending) return;
+    xSemaphoreTake(copyDone, portMAX_DELAY);
+    pending = false;
+}
+
+#else
+
+// No second core to borrow on the host, copies run in the caller
+bool WeightPrefetch::begin() {
+    return true;
+}
+
+void WeightPrefetch::copy(void* dst, const void* src, size_t size) {
+    memcpy(dst, src, size);
+}
+
+void WeightPrefetch::wait() {
+}
+
+#endif
+
+void WeightPrefetch::recordLayer(const char* op, uint32_t bytes, uint32_t stallUs, uint32_t opUs) {
+    // only the inference task touches current between recordInvoke() calls
+    if (current.layerCount >= WEIGHT_PREFETCH_MAX_LAYERS) return;
+    WeightPrefetchLayer& layer = current.layers[current.layerCount++];
+    layer.op = op;
+    layer.bytes = bytes;
+    layer.stallUs = stallUs;
+    layer.opUs = opUs;
+}
+
+void WeightPrefetch::recordInvoke(uint32_t invokeUs, uint32_t stallUs, uint32_t copiedBytes, uint32_t prefetchedLayers) {
+    current.invokeUs = invokeUs;
+    current.stallUs = stallUs;
+    current.copiedBytes = copiedBytes;
+    current.prefetchedLayers = (uint16_t)prefetchedLayers;
+
+    PREFETCH_LOCK();
+    current.sequence = ++seq;
+    size_t used = offsetof(WeightPrefetchReport, layers) + current.layerCount * sizeof(WeightPrefetchLayer);
+    memcpy(&report, &current, used);
+    PREFETCH_UNLOCK();
+
+    current.layerCount = 0;
+}
+
+bool WeightPrefetch::last(WeightPrefetchReport& out) const {
+    PREFETCH_LOCK();
+    bool found = seq > 0;
+    if (found) {
+        size_t used = offsetof(WeightPrefetchReport, layers) + report.layerCount * sizeof(WeightPrefetchLayer);
+        memcpy(&out, &report, used);
+    }
+    PREFETCH_UNLOCK();
+    return found;
+}
+
+// --- Edge Impulse SDK hooks (see tflite_weight_prefetch.h) ---
+bool ei_tflite_weight_prefetch_enabled(void) {
+    return weightPrefetch.isEnabled();
+}
+
+void ei_tflite_weight_prefetch_copy(void* dst, const void* src, size_t size) {
+    weightPrefetch.copy(dst, src, size);
+}
+
+void ei_tflite_weight_prefetch_wait(void) {
+    weightPrefetch.wait();
+}
+
+void ei_tflite_weight_prefetch_op(const char* op, uint32_t bytes, uint32_t stall_us, uint32_t op_us) {
+    weightPrefetch.recordLayer(op, bytes, stall_us, op_us);
+}
+
+void ei_tflite_weight_prefetch_invoke_end(uint32_t invoke_us, uint32_t stall_us, uint32_t copied_bytes, uint32_t prefetched_layers) {
+    weightPrefetch.recordInvoke(invoke_us, stall_us, copied_bytes, prefetched_layers);
+}
@@ -0,0 +1,73 @@
+#ifndef _EI_CLASSIFIER_MODEL_METADATA_H_
+#define _EI_CLASSIFIER_MODEL_METADATA_H_
+
+// --- Test Impulse ---
+// The part of an Edge Impulse model export the postprocessing headers read,
+// for a FOMO impulse with object tracking and no model behind it. The unit
+// tests build the SDK's tracker and FOMO clustering against this instead of
+// the model-parameters folder of a real export.
+
+#include <stdint.h>
+#include <tuple>
+
+#define EI_CLASSIFIER_NONE                       255
+#define EI_CLASSIFIER_UTENSOR                    1
+#define EI_CLASSIFIER_TFLITE                     2
+#define EI_CLASSIFIER_CUBEAI                     3
+#define EI_CLASSIFIER_TFLITE_FULL                4
+#define EI_CLASSIFIER_TENSAIFLOW                 5
+#define EI_CLASSIFIER_TENSORRT                   6
+#define EI_CLASSIFIER_DRPAI                      7
+#define EI_CLASSIFIER_TFLITE_TIDL                8
+#define EI_CLASSIFIER_AKIDA                      9
+#define EI_CLASSIFIER_SYNTIANT                   10
+#define EI_CLASSIFIER_ONNX_TIDL                  11
+#define EI_CLASSIFIER_MEMRYX                     12
+#define EI_CLASSIFIER_ETHOS_LINUX                13
+#define EI_CLASSIFIER_ATON                       14
+#define EI_CLASSIFIER_CEVA_NPN                   15
+
+#define EI_CLASSIFIER_SENSOR_CAMERA              3
+#define EI_CLASSIFIER_LAST_LAYER_FOMO            2
+
+#define EI_CLASSIFIER_INFERENCING_ENGINE         EI_CLASSIFIER_NONE
+#define EI_CLASSIFIER_SENSOR                     EI_CLASSIFIER_SENSOR_CAMERA
+#define EI_CLASSIFIER_INPUT_WIDTH                96
+#define EI_CLASSIFIER_INPUT_HEIGHT               96
+#define EI_CLASSIFIER_INPUT_FRAMES               1
+#define EI_CLASSIFIER_NN_INPUT_FRAME_SIZE        (EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT)
+#define EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE       (EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT)
+#define EI_CLASSIFIER_RAW_SAMPLE_COUNT           (EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT)
+#define EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME      1
+#define EI_CLASSIFIER_FREQUENCY                  0
+#define EI_CLASSIFIER_LABEL_COUNT                2
+#define EI_CLASSIFIER_HAS_ANOMALY                0
+#define EI_CLASSIFIER_HAS_VISUAL_ANOMALY         0
+#define EI_CLASSIFIER_SINGLE_FEATURE_INPUT       1
+#define EI_CLASSIFIER_COMPILED                   0
+#define EI_CLASSIFIER_OBJECT_DETECTION           1
+#define EI_CLASSIFIER_OBJECT_DETECTION_LAST_LAYER EI_CLASSIFIER_LAST_LAYER_FOMO
+#define EI_CLASSIFIER_MAX_OBJECT_DETECTION_COUNT 10
+#define EI_CLASSIFIER_OBJECT_TRACKING_ENABLED    1
+
+typedef struct {
+    uint32_t id;
+    const char *label;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint32_t last_ground_truth_update_t;
+    std::tuple<int, int, int, int> last_centroid_segment;
+} ei_object_tracking_trace_t;
+
+typedef struct {
+    ei_object_tracking_trace_t *open_traces;
+    uint32_t open_traces_count;
+} ei_object_tracking_output_t;
+
+typedef struct {
+    ei_object_tracking_output_t object_tracking_output;
+} ei_post_processing_output_t;
+
+#endif // _EI_CLASSIFIER_MODEL_METADATA_H_
@@ -0,0 +1,280 @@
+// FOMO cell clustering: the fixed cube pool of process_fomo_f32() against
+// the heap cube clustering it replaced, and the int8 threshold of
+// process_fomo_i8() against the float test of every dequantized cell, on
+// synthetic output grids, no model needed (pio test -e native)
+
+#include <unity.h>
+#include <algorithm>
+#include <math.h>
+#include <new>
+#include <random>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "edge-impulse-sdk/classifier/postprocessing/ei_postprocessing_common.h"
+
+#define TEST_FRAMES         200
+#define TEST_CELL_PIXELS    8       // a FOMO output cell covers 8x8 input pixels
+#define TEST_THRESHOLD      0.5f
+
+static const int testBees[] = { 0, 10, 50 };
+static const uint32_t testInputSizes[] = { EI_CLASSIFIER_INPUT_WIDTH, 160 };
+static const char* testLabels[] = { "bee", "wasp" };
+
+// The SDK's porting layer, the clustering only needs the heap and logging
+void* ei_malloc(size_t size) {
+    return malloc(size);
+}
+
+void* ei_calloc(size_t nitems, size_t size) {
+    return calloc(nitems, size);
+}
+
+void ei_free(void* ptr) {
+    free(ptr);
+}
+
+void ei_printf(const char* format, ...) {
+}
+
+// Counts operator new, the cube pool must not allocate
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// A FOMO output with that many bees, each lighting up a few neighbouring
+// cells of one class above the threshold, and some noise below it
+static void makeFrame(std::mt19937& rng, int bees, size_t width, size_t height, size_t labelCount,
+                      std::vector<float>& out) {
+    std::uniform_real_distribution<float> noise(0.0f, TEST_THRESHOLD * 0.8f);
+    std::uniform_real_distribution<float> hit(TEST_THRESHOLD, 1.0f);
+    size_t stride = labelCount + 1;
+    out.assign(width * height * stride, 0.0f);
+    for (size_t i = 0; i < width * height; i++) {
+        out[i * stride + 1 + rng() % labelCount] = noise(rng);
+    }
+    for (int bee = 0; bee < bees; bee++) {
+        size_t x = rng() % width, y = rng() % height, label = 1 + rng() % labelCount;
+        for (size_t dy = 0; dy < 2 && y + dy < height; dy++) {
+            for (size_t dx = 0; dx < 2 && x + dx < width; dx++) {
+                if (rng() % 3 == 0) continue;
+                out[((y + dy) * height + x + dx) * stride + label] = hit(rng);
+            }
+        }
+    }
+}
+
+// The clustering as it was before the fixed cube pool: a heap cube per
+// activated cell, then process_cubes()
+static void referenceCubes(const ei_impulse_t* impulse, const float* buffer,
+                           const ei_fill_result_fomo_f32_config_t& config, ei_impulse_result_t* result) {
+    std::vector<ei_classifier_cube_t*> cubes;
+    for (size_t y = 0; y < config.out_width; y++) {
+        for (size_t x = 0; x < config.out_height; x++) {
+            size_t loc = ((y * config.out_height) + x) * (impulse->label_count + 1);
+            for (size_t ix = 1; ix <= impulse->label_count; ix++) {
+                ei_handle_cube(&cubes, x, y, buffer[loc + ix], impulse->categories[ix - 1], config.threshold);
+            }
+        }
+    }
+    process_cubes(result, &cubes, impulse->input_width / config.out_width, config.object_detection_count);
+}
+
+// The int8 thresholding as it was before: every cell dequantized and tested
+// as a float
+static void referenceCubesI8(const ei_impulse_t* impulse, const int8_t* buffer,
+                             const ei_fill_result_fomo_i8_config_t& config, ei_impulse_result_t* result) {
+    std::vector<ei_classifier_cube_t*> cubes;
+    for (size_t y = 0; y < config.out_width; y++) {
+        for (size_t x = 0; x < config.out_height; x++) {
+            size_t loc = ((y * config.out_height) + x) * (impulse->label_count + 1);
+            for (size_t ix = 1; ix <= impulse->label_count; ix++) {
+                float vf = static_cast<float>(buffer[loc + ix] - config.zero_point) * config.scale;
+                ei_handle_cube(&cubes, x, y, vf, impulse->categories[ix - 1], config.threshold);
+            }
+        }
+    }
+    process_cubes(result, &cubes, impulse->input_width / config.out_width, config.object_detection_count);
+}
+
+// A quantized FOMO output: the float frame through the output quantization,
+// or random bytes when the scale isn't a usable one
+static void quantizeFrame(std::mt19937& rng, const std::vector<float>& frame,
+                          const ei_fill_result_fomo_i8_config_t& config, int8_t* out) {
+    for (size_t i = 0; i < frame.size(); i++) {
+        float q = config.scale > 0.0f ? roundf(frame[i] / config.scale) + config.zero_point : (float)(int8_t)rng();
+        out[i] = (int8_t)std::max(-128.0f, std::min(127.0f, q));
+    }
+}
+
+static bool sameBoxes(const std::vector<ei_impulse_result_bounding_box_t>& expected, const ei_impulse_result_t& result) {
+    if (result.bounding_boxes_count != expected.size()) return false;
+    for (size_t i = 0; i < expected.size(); i++) {
+        const ei_impulse_result_bounding_box_t& a = expected[i];
+        const ei_impulse_result_bounding_box_t& b = result.bounding_boxes[i];
+        if (strcmp(a.label, b.label) != 0 || a.x != b.x || a.y != b.y || a.width != b.width ||
+                a.height != b.height || a.value != b.value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A square FOMO impulse with the test labels
+static ei_impulse_t testImpulse(uint32_t inputSize) {
+    ei_impulse_t impulse = {};
+    impulse.input_width = inputSize;
+    impulse.input_height = inputSize;
+    impulse.learning_blocks_size = 1;
+    impulse.label_count = sizeof(testLabels) / sizeof(testLabels[0]);
+    impulse.categories = testLabels;
+    return impulse;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_static_cubes_match_heap_cubes(void) {
+    std::mt19937 rng(3);
+    std::vector<float> frame;
+    std::vector<ei_impulse_result_bounding_box_t> expected;
+    for (uint32_t inputSize : testInputSizes) {
+        ei_impulse_t impulse = testImpulse(inputSize);
+        ei_impulse_handle_t handle(&impulse);
+        ei_fill_result_fomo_f32_config_t config = {};
+        config.threshold = TEST_THRESHOLD;
+        config.out_width = inputSize / TEST_CELL_PIXELS;
+        config.out_height = inputSize / TEST_CELL_PIXELS;
+        config.object_detection_count = EI_CLASSIFIER_MAX_OBJECT_DETECTION_COUNT;
+
+        ei::matrix_t output(1, config.out_width * config.out_height * (impulse.label_count + 1));
+        ei_feature_t feature = {};
+        feature.matrix = &output;
+        ei_impulse_result_t result = {};
+        result._raw_outputs = &feature;
+
+        for (int bees : testBees) {
+            size_t boxes = 0;
+            for (int i = 0; i < TEST_FRAMES; i++) {
+                makeFrame(rng, bees, config.out_width, config.out_height, impulse.label_count, frame);
+                memcpy(output.buffer, frame.data(), frame.size() * sizeof(float));
+
+                referenceCubes(&impulse, output.buffer, config, &result);
+                expected.assign(result.bounding_boxes, result.bounding_boxes + result.bounding_boxes_count);
+                size_t before = allocations;
+                TEST_ASSERT_EQUAL_INT(EI_IMPULSE_OK, process_fomo_f32(&handle, 0, 0, &result, &config, nullptr));
+                // Crowded frames may fall back to heap cubes past EI_CLASSIFIER_FOMO_MAX_CUBES
+                if (bees <= 10) TEST_ASSERT_EQUAL_size_t(before, allocations);
+                if (!sameBoxes(expected, result)) {
+                    char message[80];
+                    snprintf(message, sizeof(message), "boxes differ (%u px input, %d bees, frame %d)",
+                             (unsigned)inputSize, bees, i);
+                    TEST_FAIL_MESSAGE(message);
+                }
+                boxes += expected.size();
+            }
+            if (bees > 0) TEST_ASSERT_GREATER_THAN(0, boxes);
+        }
+    }
+}
+
+void test_cells_at_the_threshold_are_activated(void) {
+    ei_impulse_t impulse = testImpulse(EI_CLASSIFIER_INPUT_WIDTH);
+    ei_impulse_handle_t handle(&impulse);
+    ei_fill_result_fomo_f32_config_t config = {};
+    config.threshold = TEST_THRESHOLD;
+    config.out_width = EI_CLASSIFIER_INPUT_WIDTH / TEST_CELL_PIXELS;
+    config.out_height = EI_CLASSIFIER_INPUT_WIDTH / TEST_CELL_PIXELS;
+    config.object_detection_count = EI_CLASSIFIER_MAX_OBJECT_DETECTION_COUNT;
+
+    ei::matrix_t output(1, config.out_width * config.out_height * (impulse.label_count + 1));
+    memset(output.buffer, 0, config.out_width * config.out_height * (impulse.label_count + 1) * sizeof(float));
+    size_t stride = impulse.label_count + 1;
+    output.buffer[(2 * config.out_height + 3) * stride + 1] = TEST_THRESHOLD;                 // bee at x 3, y 2
+    output.buffer[(7 * config.out_height + 9) * stride + 2] = nextafterf(TEST_THRESHOLD, 0);  // just below
+    ei_feature_t feature = {};
+    feature.matrix = &output;
+    ei_impulse_result_t result = {};
+    result._raw_outputs = &feature;
+
+    TEST_ASSERT_EQUAL_INT(EI_IMPULSE_OK, process_fomo_f32(&handle, 0, 0, &result, &config, nullptr));
+    TEST_ASSERT_EQUAL_UINT32(1, result.bounding_boxes_count);
+    TEST_ASSERT_EQUAL_STRING("bee", result.bounding_boxes[0].label);
+    TEST_ASSERT_EQUAL_UINT32(3 * TEST_CELL_PIXELS, result.bounding_boxes[0].x);
+    TEST_ASSERT_EQUAL_UINT32(2 * TEST_CELL_PIXELS, result.bounding_boxes[0].y);
+    TEST_ASSERT_EQUAL_UINT32(TEST_CELL_PIXELS, result.bounding_boxes[0].width);
+}
+
+void test_int8_threshold_matches_float_test(void) {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> frame;
+    std::vector<ei_impulse_result_bounding_box_t> expected;
+    for (uint32_t inputSize : testInputSizes) {
+        ei_impulse_t impulse = testImpulse(inputSize);
+        ei_impulse_handle_t handle(&impulse);
+        ei_fill_result_fomo_i8_config_t config = {};
+        config.out_width = inputSize / TEST_CELL_PIXELS;
+        config.out_height = inputSize / TEST_CELL_PIXELS;
+        config.object_detection_count = EI_CLASSIFIER_MAX_OBJECT_DETECTION_COUNT;
+
+        ei::matrix_i8_t output(1, config.out_width * config.out_height * (impulse.label_count + 1));
+        ei_feature_t feature = {};
+        feature.matrix_i8 = &output;
+        ei_impulse_result_t result = {};
+        result._raw_outputs = &feature;
+
+        for (int i = 0; i < TEST_FRAMES; i++) {
+            // The usual softmax output quantization, then random zero points
+            // and thresholds with positive, zero and negative scales
+            int kind = i % 4;
+            if (kind == 0) {
+                config.zero_point = -128.0f;
+                config.scale = 1.0f / 256.0f;
+                config.threshold = TEST_THRESHOLD;
+            } else {
+                config.zero_point = (float)(int8_t)rng();
+                config.scale = kind == 1 ? unit(rng) / 64.0f : (kind == 2 ? 0.0f : -unit(rng) / 64.0f);
+                config.threshold = unit(rng);
+            }
+            makeFrame(rng, testBees[rng() % 3], config.out_width, config.out_height, impulse.label_count, frame);
+            quantizeFrame(rng, frame, config, output.buffer);
+
+            referenceCubesI8(&impulse, output.buffer, config, &result);
+            expected.assign(result.bounding_boxes, result.bounding_boxes + result.bounding_boxes_count);
+            TEST_ASSERT_EQUAL_INT(EI_IMPULSE_OK, process_fomo_i8(&handle, 0, 0, &result, &config, nullptr));
+            if (!sameBoxes(expected, result)) {
+                char message[120];
+                snprintf(message, sizeof(message), "boxes differ (%u px input, frame %d, zero point %g, scale %g, "
+                         "threshold %g)", (unsigned)inputSize, i, config.zero_point, config.scale, config.threshold);
+                TEST_FAIL_MESSAGE(message);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_static_cubes_match_heap_cubes);
+    RUN_TEST(test_cells_at_the_threshold_are_activated);
+    RUN_TEST(test_int8_threshold_matches_float_test);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+// Login guard of the web server: per client backoff, the global lockout and
+// what the NVS listener is told (pio test -e native)
+
+#include <unity.h>
+#include <vector>
+
+#include "login_guard.h"
+
+static LoginGuard* guard;
+static std::vector<uint32_t> stored;    // listener calls, in order
+
+void setUp(void) {
+    guard = new LoginGuard();
+    stored.clear();
+    guard->onLockout([](uint32_t failures) { stored.push_back(failures); });
+}
+
+void tearDown(void) {
+    delete guard;
+}
+
+// Failures from that many addresses in turn, none of them locked out yet
+static uint32_t failFromAddresses(int failures, uint32_t nowMs) {
+    for (int i = 0; i < failures; i++, nowMs += 10) {
+        uint32_t ip = 0x0A000100 + i % 30;
+        TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(ip, nowMs));
+        guard->recordFailure(ip, nowMs);
+    }
+    return nowMs;
+}
+
+void test_free_failures_then_doubling_backoff(void) {
+    guard->begin(0, 0);
+    uint32_t nowMs = 1000;
+    for (int i = 0; i < LOGIN_GUARD_FREE_FAILS; i++) {
+        TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(1, nowMs));
+        guard->recordFailure(1, nowMs);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(1, nowMs));
+
+    uint32_t expectedMs = LOGIN_GUARD_BASE_LOCK_MS;
+    for (int i = 0; i < 12; i++) {
+        guard->recordFailure(1, nowMs);
+        TEST_ASSERT_EQUAL_UINT32(expectedMs, guard->retryAfter(1, nowMs));
+        TEST_ASSERT_EQUAL_UINT32(expectedMs - 500, guard->retryAfter(1, nowMs + 500));
+        nowMs += expectedMs;
+        TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(1, nowMs));
+        expectedMs = expectedMs * 2 < LOGIN_GUARD_MAX_LOCK_MS ? expectedMs * 2 : LOGIN_GUARD_MAX_LOCK_MS;
+    }
+    TEST_ASSERT_EQUAL_UINT32(LOGIN_GUARD_MAX_LOCK_MS, expectedMs);
+
+    // Other clients aren't slowed down, and nothing was stored
+    TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(2, nowMs));
+    TEST_ASSERT_EQUAL_size_t(0, stored.size());
+}
+
+void test_success_clears_the_client(void) {
+    guard->begin(0, 0);
+    for (int i = 0; i <= LOGIN_GUARD_FREE_FAILS; i++) guard->recordFailure(1, 100);
+    TEST_ASSERT_GREATER_THAN(0, guard->retryAfter(1, 100));
+    guard->recordSuccess(1);
+    TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(1, 100));
+    TEST_ASSERT_EQUAL_UINT32(0, guard->stats().failures);
+    TEST_ASSERT_EQUAL_UINT32(0, guard->stats().clients);
+}
+
+void test_global_lockout_locks_every_address(void) {
+    guard->begin(0, 0);
+    uint32_t nowMs = failFromAddresses(LOGIN_GUARD_GLOBAL_FAILS - 1, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(0x0A000002, nowMs));
+    TEST_ASSERT_EQUAL_size_t(0, stored.size());
+
+    guard->recordFailure(0x0A000200, nowMs);
+    uint32_t startMs = nowMs;
+    TEST_ASSERT_EQUAL_UINT32(LOGIN_GUARD_MAX_LOCK_MS, guard->retryAfter(0x0A000002, nowMs));
+    TEST_ASSERT_EQUAL_UINT32(LOGIN_GUARD_MAX_LOCK_MS - 60000, guard->retryAfter(0x0A000003, startMs + 60000));
+    TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(0x0A000002, startMs + LOGIN_GUARD_MAX_LOCK_MS));
+}
+
+void test_listener_hears_the_global_lockout_start_and_end_once(void) {
+    guard->begin(0, 0);
+    uint32_t nowMs = failFromAddresses(LOGIN_GUARD_GLOBAL_FAILS, 0);
+    TEST_ASSERT_EQUAL_size_t(1, stored.size());
+    TEST_ASSERT_EQUAL_UINT32(LOGIN_GUARD_GLOBAL_FAILS, stored[0]);
+
+    // Refused attempts don't store anything
+    for (int i = 0; i < 20; i++) TEST_ASSERT_GREATER_THAN(0, guard->retryAfter(0x0A000300 + i, nowMs + i));
+    TEST_ASSERT_EQUAL_size_t(1, stored.size());
+
+    nowMs += LOGIN_GUARD_MAX_LOCK_MS;
+    TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(0x0A000002, nowMs));
+    TEST_ASSERT_EQUAL_size_t(2, stored.size());
+    TEST_ASSERT_EQUAL_UINT32(0, stored[1]);
+
+    guard->retryAfter(0x0A000002, nowMs + 1);
+    guard->recordFailure(0x0A000002, nowMs + 2);
+    TEST_ASSERT_EQUAL_size_t(2, stored.size());
+    TEST_ASSERT_EQUAL_UINT32(1, guard->stats().failures);
+}
+
+void test_lockout_restored_at_boot_ends_and_is_cleared(void) {
+    guard->begin(LOGIN_GUARD_GLOBAL_FAILS, 1000);
+    TEST_ASSERT_EQUAL_UINT32(LOGIN_GUARD_MAX_LOCK_MS - 1000, guard->retryAfter(1, 2000));
+    TEST_ASSERT_EQUAL_size_t(0, stored.size());
+
+    uint32_t endMs = 1000 + LOGIN_GUARD_MAX_LOCK_MS;
+    guard->recordFailure(1, endMs);
+    TEST_ASSERT_EQUAL_size_t(1, stored.size());
+    TEST_ASSERT_EQUAL_UINT32(0, stored[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(1, endMs));
+}
+
+void test_stored_count_below_the_limit_is_kept_until_a_success(void) {
+    guard->begin(10, 0);
+    TEST_ASSERT_EQUAL_UINT32(0, guard->retryAfter(1, 0));
+    TEST_ASSERT_EQUAL_UINT32(10, guard->stats().failures);
+
+    failFromAddresses(LOGIN_GUARD_GLOBAL_FAILS - 11, 0);
+    TEST_ASSERT_EQUAL_size_t(0, stored.size());
+    guard->recordSuccess(0x0A000002);
+    TEST_ASSERT_EQUAL_size_t(1, stored.size());
+    TEST_ASSERT_EQUAL_UINT32(0, stored[0]);
+    TEST_ASSERT_EQUAL_UINT32(0, guard->stats().failures);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_free_failures_then_doubling_backoff);
+    RUN_TEST(test_success_clears_the_client);
+    RUN_TEST(test_global_lockout_locks_every_address);
+    RUN_TEST(test_listener_hears_the_global_lockout_start_and_end_once);
+    RUN_TEST(test_lockout_restored_at_boot_ends_and_is_cleared);
+    RUN_TEST(test_stored_count_below_the_limit_is_kept_until_a_success);
+    return UNITY_END();
+}
@@ -0,0 +1,196 @@
+// Page renderer of the web server: random pages rendered at every small
+// buffer size against the same page built as one string (pio test -e native)
+
+#include <unity.h>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "page_renderer.h"
+
+#define TEST_PAGES          200
+#define TEST_MAX_BUFFER     64      // every buffer size from 1 up to this
+#define TEST_TCP_BUFFER     1436    // what AsyncWebServer usually asks for
+
+// Counts operator new, rendering must not allocate
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static const char layout[] = "<!DOCTYPE html><html><head><title>BeeCounter - {{title}}</title></head><body>"
+    "{{tabs}}<main class='container'>{{body}}</main>{{missing}}<footer><p>{{device_name}} | v{{version}}</p></footer></body></html>";
+static const char tabs[] = "<nav><a href='/' class='{{tab_monitor}}'>Monitor</a><a href='/admin' class='{{tab_admin}}'>Administer</a></nav>";
+static const char body[] = "<div class='card'>{{notice}}<h2>{{title}}</h2><p>Timezone: {{timezone}}</p>"
+    "<pre>{{log}}</pre>{{footer_note}}<p>{{ not a placeholder</p></div>";
+static const char notice[] = "<p class='{{notice_class}}'>{{notice_text}}</p>";
+
+struct TestPage {
+    std::vector<std::pair<const char*, std::string>> texts;
+    std::string raw;
+    std::string log;        // read through a PageReader in pieces
+    size_t logPiece;
+};
+
+static std::string randomText(std::mt19937& rng, size_t maxLen) {
+    static const char chars[] = "abcdefghij KLMNOP 0123456789 &<>\"' /=-.";
+    std::uniform_int_distribution<size_t> len(0, maxLen), pick(0, sizeof(chars) - 2);
+    std::string text(len(rng), ' ');
+    for (char& c : text) c = chars[pick(rng)];
+    return text;
+}
+
+static void makePage(std::mt19937& rng, TestPage& page) {
+    static const char* names[] = { "title", "tab_monitor", "tab_admin", "device_name", "version", "timezone",
+                                   "notice_class", "notice_text" };
+    page.texts.clear();
+    for (const char* name : names) page.texts.push_back({ name, randomText(rng, 40) });
+    page.raw = "<small>" + randomText(rng, 20) + "</small>";
+    page.log = randomText(rng, 600);
+    page.logPiece = std::uniform_int_distribution<size_t>(1, PAGE_RENDERER_READ_CHUNK)(rng);
+}
+
+static PageRenderer* newRenderer(const TestPage& page, size_t& logPos) {
+    PageRenderer* renderer = new PageRenderer(layout);
+    renderer->setTemplate("tabs", tabs);
+    renderer->setTemplate("body", body);
+    renderer->setTemplate("notice", notice);
+    for (const auto& text : page.texts) renderer->set(text.first, text.second.c_str());
+    renderer->setRaw("footer_note", page.raw.c_str());
+    renderer->setReader("log", [&page, &logPos](char* buf, size_t len) -> size_t {
+        size_t n = std::min(std::min(len, page.logPiece), page.log.size() - logPos);
+        memcpy(buf, page.log.data() + logPos, n);
+        logPos += n;
+        return n;
+    });
+    return renderer;
+}
+
+static void appendEscaped(std::string& html, const std::string& text) {
+    for (char c : text) {
+        switch (c) {
+            case '&': html += "&amp;"; break;
+            case '<': html += "&lt;"; break;
+            case '>': html += "&gt;"; break;
+            case '"': html += "&quot;"; break;
+            case '\'': html += "&#39;"; break;
+            default: html += c;
+        }
+    }
+}
+
+// The page as the handlers used to build it, one string
+static std::string buildPage(const TestPage& page) {
+    auto text = [&page](const char* name) {
+        std::string html;
+        for (const auto& value : page.texts) {
+            if (strcmp(value.first, name) == 0) appendEscaped(html, value.second);
+        }
+        return html;
+    };
+    std::string noticeHtml = std::string("<p class='") + text("notice_class") + "'>" + text("notice_text") + "</p>";
+    std::string log;
+    appendEscaped(log, page.log);
+    std::string bodyHtml = std::string("<div class='card'>") + noticeHtml + "<h2>" + text("title") + "</h2><p>Timezone: " +
+        text("timezone") + "</p><pre>" + log + "</pre>" + page.raw + "<p>{{ not a placeholder</p></div>";
+    std::string tabsHtml = std::string("<nav><a href='/' class='") + text("tab_monitor") + "'>Monitor</a><a href='/admin' class='" +
+        text("tab_admin") + "'>Administer</a></nav>";
+    return std::string("<!DOCTYPE html><html><head><title>BeeCounter - ") + text("title") + "</title></head><body>" +
+        tabsHtml + "<main class='container'>" + bodyHtml + "</main><footer><p>" + text("device_name") + " | v" +
+        text("version") + "</p></footer></body></html>";
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_renders_the_page_at_every_buffer_size(void) {
+    std::mt19937 rng(11);
+    std::vector<uint8_t> out(TEST_TCP_BUFFER);
+    TestPage page;
+    for (int i = 0; i < TEST_PAGES; i++) {
+        makePage(rng, page);
+        std::string expected = buildPage(page);
+        for (size_t bufSize = 1; bufSize <= TEST_MAX_BUFFER + 1; bufSize++) {
+            size_t size = bufSize <= TEST_MAX_BUFFER ? bufSize : TEST_TCP_BUFFER;
+            size_t logPos = 0;
+            std::unique_ptr<PageRenderer> renderer(newRenderer(page, logPos));
+            std::string html;
+            html.reserve(expected.size() + TEST_TCP_BUFFER);
+            size_t before = allocations;
+            for (size_t n; (n = renderer->read(out.data(), size)) > 0;) {
+                TEST_ASSERT_LESS_OR_EQUAL(size, n);
+                html.append((const char*)out.data(), n);
+            }
+            TEST_ASSERT_EQUAL_size_t(before, allocations);
+            TEST_ASSERT_TRUE(html == expected);
+            TEST_ASSERT_TRUE(renderer->done());
+            TEST_ASSERT_EQUAL_size_t(expected.size(), renderer->rendered());
+            TEST_ASSERT_FALSE(renderer->overflowed());
+        }
+    }
+}
+
+void test_value_larger_than_the_value_space_overflows(void) {
+    PageRenderer renderer(layout);
+    std::string big(PAGE_RENDERER_VALUE_SPACE + 1, 'x');
+    TEST_ASSERT_FALSE(renderer.set("title", big.c_str()));
+    TEST_ASSERT_TRUE(renderer.overflowed());
+
+    PageRenderer exact(layout);
+    big.resize(PAGE_RENDERER_VALUE_SPACE);
+    TEST_ASSERT_TRUE(exact.set("title", big.c_str()));
+    TEST_ASSERT_FALSE(exact.overflowed());
+}
+
+void test_too_many_values_overflow(void) {
+    static const char* names[] = { "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "v10", "v11",
+                                   "v12", "v13", "v14", "v15", "v16" };
+    PageRenderer renderer("{{v0}}{{v15}}{{v16}}");
+    for (int i = 0; i < PAGE_RENDERER_MAX_VALUES; i++) TEST_ASSERT_TRUE(renderer.set(names[i], "a"));
+    TEST_ASSERT_TRUE(renderer.set("v0", "b"));      // replacing one takes no new entry
+    TEST_ASSERT_FALSE(renderer.overflowed());
+    TEST_ASSERT_FALSE(renderer.setRaw(names[PAGE_RENDERER_MAX_VALUES], "c"));
+    TEST_ASSERT_TRUE(renderer.overflowed());
+}
+
+void test_templates_nest_up_to_the_maximum_depth(void) {
+    static const char* levels[] = { "1{{t2}}", "2{{t3}}", "3{{t4}}", "4{{t5}}", "5" };
+    static const char* names[] = { "t1", "t2", "t3", "t4", "t5" };
+    PageRenderer renderer("0{{t1}}!");
+    for (int i = 0; i < 5; i++) renderer.setTemplate(names[i], levels[i]);
+    char out[32];
+    size_t n = renderer.read((uint8_t*)out, sizeof(out));
+    // The layout is the first level, templates deeper than the limit render as nothing
+    TEST_ASSERT_EQUAL_size_t(PAGE_RENDERER_MAX_DEPTH + 1, n);
+    TEST_ASSERT_EQUAL_STRING_LEN("0123!", out, n);
+    TEST_ASSERT_TRUE(renderer.done());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_renders_the_page_at_every_buffer_size);
+    RUN_TEST(test_value_larger_than_the_value_space_overflows);
+    RUN_TEST(test_too_many_values_overflow);
+    RUN_TEST(test_templates_nest_up_to_the_maximum_depth);
+    return UNITY_END();
+}
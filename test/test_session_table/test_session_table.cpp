@@ -0,0 +1,199 @@
+// Session table of the web server: token lookup, idle and absolute expiry,
+// LRU eviction, cookie parsing and ending every session (pio test -e native)
+
+#include <unity.h>
+#include <string.h>
+#include <string>
+
+#include "session_table.h"
+
+static uint32_t nowMs;
+static SessionTable* table;
+
+static uint32_t testMillis() {
+    return nowMs;
+}
+
+static std::string cookieOf(const char* tokenHex) {
+    return std::string("theme=dark; " SESSION_COOKIE_NAME "=") + tokenHex + "; lang=en";
+}
+
+static std::string login(char* tokenHex) {
+    table->create(tokenHex);
+    return cookieOf(tokenHex);
+}
+
+void setUp(void) {
+    // Away from zero, so expiry math across the start is covered too
+    nowMs = 0xFFFFF000;
+    sessionHostMillis = testMillis;
+    table = new SessionTable();
+}
+
+void tearDown(void) {
+    delete table;
+}
+
+void test_only_the_exact_token_of_an_active_session_matches(void) {
+    char tokens[3][SESSION_TOKEN_HEX_LEN + 1];
+    std::string cookies[3];
+    for (int i = 0; i < 3; i++) cookies[i] = login(tokens[i]);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_size_t(SESSION_TOKEN_HEX_LEN, strlen(tokens[i]));
+        TEST_ASSERT_TRUE(table->validate(cookies[i].c_str()));
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, table->stats().active);
+
+    // Every byte counts, the first and the last alike
+    for (int pos : { 0, SESSION_TOKEN_HEX_LEN - 1 }) {
+        char forged[SESSION_TOKEN_HEX_LEN + 1];
+        memcpy(forged, tokens[1], sizeof(forged));
+        forged[pos] = forged[pos] == '0' ? '1' : '0';
+        TEST_ASSERT_FALSE(table->validate(cookieOf(forged).c_str()));
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, table->stats().rejected);
+
+    // A removed slot keeps its bytes but no longer matches
+    table->remove(cookies[1].c_str());
+    TEST_ASSERT_FALSE(table->validate(cookies[1].c_str()));
+    TEST_ASSERT_TRUE(table->validate(cookies[0].c_str()));
+    TEST_ASSERT_TRUE(table->validate(cookies[2].c_str()));
+    TEST_ASSERT_EQUAL_UINT32(2, table->stats().active);
+
+    // An all zero token doesn't match the empty slots
+    char zeros[SESSION_TOKEN_HEX_LEN + 1];
+    memset(zeros, '0', SESSION_TOKEN_HEX_LEN);
+    zeros[SESSION_TOKEN_HEX_LEN] = '\0';
+    TEST_ASSERT_FALSE(table->validate(cookieOf(zeros).c_str()));
+}
+
+void test_idle_sessions_expire(void) {
+    char token[SESSION_TOKEN_HEX_LEN + 1];
+    std::string kept = login(token);
+    std::string idle = login(token);
+
+    // Requests keep a session alive, the idle one ends
+    for (int i = 0; i < 3; i++) {
+        nowMs += SESSION_IDLE_TIMEOUT_MS / 2;
+        TEST_ASSERT_TRUE(table->validate(kept.c_str()));
+    }
+    TEST_ASSERT_FALSE(table->validate(idle.c_str()));
+    TEST_ASSERT_EQUAL_UINT32(1, table->stats().expired);
+
+    nowMs += SESSION_IDLE_TIMEOUT_MS;
+    TEST_ASSERT_TRUE(table->validate(kept.c_str()));
+    nowMs += SESSION_IDLE_TIMEOUT_MS + 1;
+    TEST_ASSERT_FALSE(table->validate(kept.c_str()));
+    TEST_ASSERT_EQUAL_UINT32(0, table->stats().active);
+    TEST_ASSERT_EQUAL_UINT32(2, table->stats().expired);
+}
+
+void test_sessions_end_at_the_maximum_age(void) {
+    char token[SESSION_TOKEN_HEX_LEN + 1];
+    std::string cookie = login(token);
+    uint32_t loginMs = nowMs;
+    while (nowMs - loginMs + 10UL * 60 * 1000 <= SESSION_MAX_AGE_MS) {
+        nowMs += 10UL * 60 * 1000;
+        TEST_ASSERT_TRUE(table->validate(cookie.c_str()));
+    }
+    nowMs = loginMs + SESSION_MAX_AGE_MS;
+    TEST_ASSERT_TRUE(table->validate(cookie.c_str()));
+    nowMs++;
+    TEST_ASSERT_FALSE(table->validate(cookie.c_str()));
+    TEST_ASSERT_EQUAL_UINT32(1, table->stats().expired);
+}
+
+void test_full_table_evicts_the_least_recently_used(void) {
+    char token[SESSION_TOKEN_HEX_LEN + 1];
+    std::string cookies[SESSION_TABLE_SIZE];
+    for (int i = 0; i < SESSION_TABLE_SIZE; i++) {
+        cookies[i] = login(token);
+        nowMs += 1000;
+    }
+    // The oldest login is the most recent request, the second oldest is left
+    for (int i = 0; i < SESSION_TABLE_SIZE; i++) {
+        if (i != 1) TEST_ASSERT_TRUE(table->validate(cookies[i].c_str()));
+    }
+    TEST_ASSERT_TRUE(table->validate(cookies[0].c_str()));
+
+    std::string newest = login(token);
+    TEST_ASSERT_EQUAL_UINT32(1, table->stats().evicted);
+    TEST_ASSERT_EQUAL_UINT32(SESSION_TABLE_SIZE, table->stats().active);
+    TEST_ASSERT_FALSE(table->validate(cookies[1].c_str()));
+    TEST_ASSERT_TRUE(table->validate(newest.c_str()));
+    for (int i = 0; i < SESSION_TABLE_SIZE; i++) {
+        if (i != 1) TEST_ASSERT_TRUE(table->validate(cookies[i].c_str()));
+    }
+}
+
+void test_expired_slots_are_reused_before_evicting(void) {
+    char token[SESSION_TOKEN_HEX_LEN + 1];
+    for (int i = 0; i < SESSION_TABLE_SIZE; i++) login(token);
+    nowMs += SESSION_IDLE_TIMEOUT_MS + 1;
+    std::string cookie = login(token);
+    TEST_ASSERT_EQUAL_UINT32(0, table->stats().evicted);
+    TEST_ASSERT_EQUAL_UINT32(SESSION_TABLE_SIZE, table->stats().expired);
+    TEST_ASSERT_EQUAL_UINT32(1, table->stats().active);
+    TEST_ASSERT_TRUE(table->validate(cookie.c_str()));
+}
+
+void test_cookie_header_parsing(void) {
+    static const char hex[] = "00112233445566778899aabbccddeeff";
+    uint8_t token[SESSION_TOKEN_BYTES];
+    TEST_ASSERT_TRUE(sessionCookieToken(SESSION_COOKIE_NAME "=00112233445566778899aabbccddeeff", token));
+    TEST_ASSERT_EQUAL_UINT8(0x00, token[0]);
+    TEST_ASSERT_EQUAL_UINT8(0x11, token[1]);
+    TEST_ASSERT_EQUAL_UINT8(0xFF, token[SESSION_TOKEN_BYTES - 1]);
+
+    std::string cookie = std::string("a=b;  " SESSION_COOKIE_NAME "=") + hex + " ; c=d";
+    TEST_ASSERT_TRUE(sessionCookieToken(cookie.c_str(), token));
+    TEST_ASSERT_EQUAL_UINT8(0xAA, token[10]);
+    TEST_ASSERT_TRUE(sessionCookieToken(SESSION_COOKIE_NAME "=00112233445566778899AABBCCDDEEFF", token));
+    TEST_ASSERT_EQUAL_UINT8(0xAA, token[10]);
+
+    static const char* refused[] = {
+        "",
+        "a=b; c=d",
+        SESSION_COOKIE_NAME "=",
+        SESSION_COOKIE_NAME "=00112233445566778899aabbccddeef",       // one digit short
+        SESSION_COOKIE_NAME "=00112233445566778899aabbccddeeff0",     // one digit long
+        SESSION_COOKIE_NAME "=00112233445566778899aabbccddeefg",
+        "X" SESSION_COOKIE_NAME "=00112233445566778899aabbccddeeff",
+        SESSION_COOKIE_NAME "X=00112233445566778899aabbccddeeff",
+        SESSION_COOKIE_NAME " =00112233445566778899aabbccddeeff",
+    };
+    for (const char* header : refused) TEST_ASSERT_FALSE(sessionCookieToken(header, token));
+
+    TEST_ASSERT_FALSE(table->validate(nullptr));
+    TEST_ASSERT_FALSE(table->validate("a=b"));
+    table->remove(nullptr);
+    // Headers without a token aren't counted as rejected sessions
+    TEST_ASSERT_EQUAL_UINT32(0, table->stats().rejected);
+}
+
+void test_password_change_ends_every_other_session(void) {
+    char token[SESSION_TOKEN_HEX_LEN + 1];
+    std::string others[3];
+    for (int i = 0; i < 3; i++) others[i] = login(token);
+
+    // What the password handlers do: end all, then log this browser in again
+    table->clear();
+    TEST_ASSERT_EQUAL_UINT32(0, table->stats().active);
+    std::string current = login(token);
+    for (int i = 0; i < 3; i++) TEST_ASSERT_FALSE(table->validate(others[i].c_str()));
+    TEST_ASSERT_TRUE(table->validate(current.c_str()));
+    TEST_ASSERT_EQUAL_UINT32(1, table->stats().active);
+    TEST_ASSERT_EQUAL_UINT32(0, table->stats().evicted);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_only_the_exact_token_of_an_active_session_matches);
+    RUN_TEST(test_idle_sessions_expire);
+    RUN_TEST(test_sessions_end_at_the_maximum_age);
+    RUN_TEST(test_full_table_evicts_the_least_recently_used);
+    RUN_TEST(test_expired_slots_are_reused_before_evicting);
+    RUN_TEST(test_cookie_header_parsing);
+    RUN_TEST(test_password_change_ends_every_other_session);
+    return UNITY_END();
+}
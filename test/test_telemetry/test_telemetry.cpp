@@ -0,0 +1,155 @@
+// Binary telemetry frames of the Observability page: the encoder against a
+// decoder written the way the page reads them (pio test -e native)
+
+#include <unity.h>
+#include <limits.h>
+#include <random>
+#include <string.h>
+#include <vector>
+
+#include "telemetry.h"
+
+// Decodes a frame into samples, false if it is malformed
+static bool decodeFrame(const uint8_t* frame, size_t len, std::vector<TelemetrySample>& samples) {
+    samples.clear();
+    if (len < 2 || frame[0] != TELEMETRY_FRAME_VERSION) return false;
+    size_t at = 2;
+    int32_t previous[TELEMETRY_FIELD_COUNT] = {};
+    for (size_t k = 0; k < frame[1]; k++) {
+        TelemetrySample sample;
+        for (int field = 0; field < TELEMETRY_FIELD_COUNT; field++) {
+            uint32_t zigzag = 0;
+            for (int shift = 0;; shift += 7) {
+                if (at == len || shift > 28) return false;
+                zigzag |= (uint32_t)(frame[at] & 0x7f) << shift;
+                if (!(frame[at++] & 0x80)) break;
+            }
+            int32_t delta = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+            previous[field] = (int32_t)((uint32_t)previous[field] + (uint32_t)delta);
+            sample.values[field] = previous[field];
+        }
+        samples.push_back(sample);
+    }
+    return at == len;
+}
+
+static bool sameSample(const TelemetrySample& a, const TelemetrySample& b) {
+    return memcmp(a.values, b.values, sizeof(a.values)) == 0;
+}
+
+// A device at work: both cores busy in bursts, heap moving by a few hundred
+// bytes, Wi-Fi and temperature drifting
+static void makeSample(std::mt19937& rng, uint32_t nowMs, TelemetrySample& sample) {
+    std::uniform_int_distribution<int> step(-1, 1);
+    std::uniform_int_distribution<int> cpu(0, 1000);
+    std::uniform_int_distribution<int> heap(-600, 600);
+    if (nowMs == 0) {
+        sample.values[TELEMETRY_HEAP_FREE] = 180000;
+        sample.values[TELEMETRY_HEAP_TOTAL] = 327680;
+        sample.values[TELEMETRY_FLASH_USED] = 1024 * 1024;
+        sample.values[TELEMETRY_FLASH_TOTAL] = 1408 * 1024;
+        sample.values[TELEMETRY_RSSI] = -61;
+        sample.values[TELEMETRY_TEMP] = 452;
+    }
+    sample.values[TELEMETRY_MILLIS] = (int32_t)nowMs;
+    sample.values[TELEMETRY_CPU0] = cpu(rng) / 4 + 150;
+    sample.values[TELEMETRY_CPU1] = cpu(rng) / 2;
+    sample.values[TELEMETRY_HEAP_FREE] += heap(rng);
+    sample.values[TELEMETRY_RSSI] += step(rng);
+    sample.values[TELEMETRY_TEMP] += step(rng);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_deltas_take_as_many_bytes_as_they_need(void) {
+    uint8_t out[8];
+    TEST_ASSERT_EQUAL_size_t(1, telemetryPutDelta(out, 1000, 1000));
+    TEST_ASSERT_EQUAL_UINT8(0, out[0]);
+    TEST_ASSERT_EQUAL_size_t(1, telemetryPutDelta(out, 63, 0));
+    TEST_ASSERT_EQUAL_size_t(1, telemetryPutDelta(out, -64, 0));
+    TEST_ASSERT_EQUAL_size_t(2, telemetryPutDelta(out, 64, 0));
+    TEST_ASSERT_EQUAL_size_t(5, telemetryPutDelta(out, INT32_MAX, 0));
+    TEST_ASSERT_EQUAL_size_t(5, telemetryPutDelta(out, INT32_MIN, 0));
+    TEST_ASSERT_EQUAL_size_t(1, telemetryPutDelta(out, INT32_MIN, INT32_MAX));
+    // millis() wrapping is a small change
+    TEST_ASSERT_EQUAL_size_t(2, telemetryPutDelta(out, 984, (int32_t)0xFFFFFC18));
+}
+
+void test_frames_decode_to_their_samples(void) {
+    static const uint32_t frameMs[] = { 2000, 5000, 10000 };
+    std::mt19937 rng(7);
+    std::vector<TelemetrySample> samples;
+    TelemetrySample sample = {};
+    for (uint32_t nowMs = 0; nowMs < 60UL * 60 * 1000; nowMs += TELEMETRY_SAMPLE_MS) {
+        makeSample(rng, nowMs, sample);
+        samples.push_back(sample);
+    }
+
+    for (uint32_t ms : frameMs) {
+        TelemetryEncoder encoder;
+        uint8_t frame[TELEMETRY_MAX_FRAME];
+        std::vector<TelemetrySample> decoded;
+        size_t first = 0;
+        for (size_t i = 0; i < samples.size(); i++) {
+            TEST_ASSERT_TRUE(encoder.add(samples[i]));
+            bool last = i + 1 == samples.size();
+            if (!last && samples[i + 1].values[TELEMETRY_MILLIS] % ms != 0) continue;
+            size_t count = encoder.count();
+            size_t len = encoder.finish(frame);
+            TEST_ASSERT_EQUAL_size_t(0, encoder.count());
+            // Slowly changing fields take a byte
+            TEST_ASSERT_LESS_OR_EQUAL(2 + count * TELEMETRY_FIELD_COUNT * 3, len);
+            TEST_ASSERT_TRUE(decodeFrame(frame, len, decoded));
+            TEST_ASSERT_EQUAL_size_t(count, decoded.size());
+            for (size_t k = 0; k < count; k++) TEST_ASSERT_TRUE(sameSample(samples[first + k], decoded[k]));
+            first += count;
+        }
+        TEST_ASSERT_EQUAL_size_t(samples.size(), first);
+    }
+}
+
+void test_full_batch_of_extremes_fits_the_frame(void) {
+    TelemetryEncoder encoder;
+    std::vector<TelemetrySample> samples;
+    for (int i = 0; i < TELEMETRY_MAX_BATCH; i++) {
+        TelemetrySample sample;
+        for (int field = 0; field < TELEMETRY_FIELD_COUNT; field++) {
+            sample.values[field] = i % 2 == 0 ? INT32_MIN : 0;
+        }
+        samples.push_back(sample);
+        TEST_ASSERT_TRUE(encoder.add(sample));
+    }
+    TEST_ASSERT_FALSE(encoder.add(samples[0]));
+    TEST_ASSERT_EQUAL_size_t(TELEMETRY_MAX_BATCH, encoder.count());
+
+    uint8_t frame[TELEMETRY_MAX_FRAME + 1];
+    frame[TELEMETRY_MAX_FRAME] = 0xA5;
+    size_t len = encoder.finish(frame);
+    TEST_ASSERT_EQUAL_size_t(TELEMETRY_MAX_FRAME, len);
+    TEST_ASSERT_EQUAL_UINT8(0xA5, frame[TELEMETRY_MAX_FRAME]);
+    std::vector<TelemetrySample> decoded;
+    TEST_ASSERT_TRUE(decodeFrame(frame, len, decoded));
+    TEST_ASSERT_EQUAL_size_t(samples.size(), decoded.size());
+    for (size_t k = 0; k < samples.size(); k++) TEST_ASSERT_TRUE(sameSample(samples[k], decoded[k]));
+}
+
+void test_empty_batch_is_a_header(void) {
+    TelemetryEncoder encoder;
+    uint8_t frame[TELEMETRY_MAX_FRAME];
+    TEST_ASSERT_EQUAL_size_t(2, encoder.finish(frame));
+    TEST_ASSERT_EQUAL_UINT8(TELEMETRY_FRAME_VERSION, frame[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, frame[1]);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_deltas_take_as_many_bytes_as_they_need);
+    RUN_TEST(test_frames_decode_to_their_samples);
+    RUN_TEST(test_full_batch_of_extremes_fits_the_frame);
+    RUN_TEST(test_empty_batch_is_a_header);
+    return UNITY_END();
+}
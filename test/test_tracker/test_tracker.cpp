@@ -0,0 +1,179 @@
+// Fixed-capacity object tracker against the SDK's vector based Tracker on
+// synthetic detection streams, no model needed (pio test -e native)
+
+#include <unity.h>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "edge-impulse-sdk/classifier/postprocessing/ei_object_tracking.h"
+
+#define TEST_STREAMS        40
+#define TEST_FRAMES         200
+#define TEST_MAX_OBJECTS    12
+#define TEST_IOU            0.3f
+#define TEST_DISTANCE       30.0f   // centroid distance threshold, pixels
+
+typedef StaticTracker<EI_CLASSIFIER_OBJECT_TRACKING_MAX_TRACES, EI_CLASSIFIER_OBJECT_TRACKING_MAX_DETECTIONS> TestStaticTracker;
+
+// The SDK's porting layer, the tracker only needs the heap and logging
+void* ei_malloc(size_t size) {
+    return malloc(size);
+}
+
+void* ei_calloc(size_t nitems, size_t size) {
+    return calloc(nitems, size);
+}
+
+void ei_free(void* ptr) {
+    free(ptr);
+}
+
+void ei_printf(const char* format, ...) {
+}
+
+static ei_impulse_t testImpulse = {};
+static ei_impulse_handle_t testHandle(&testImpulse);
+ei_impulse_handle_t& ei_default_impulse = testHandle;
+
+// Counts operator new, the fixed-capacity tracker must not allocate
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+struct TestObject {
+    float x, y, vx, vy;
+    uint32_t width, height;
+};
+
+static const char* labels[] = { "bee", "wasp" };
+
+// Bees flying through the frame: some arrive, some leave, every detection is
+// a few pixels off and some frames miss one, in no particular order
+static void makeFrame(std::mt19937& rng, std::vector<TestObject>& objects,
+                      std::vector<ei_impulse_result_bounding_box_t>& detections) {
+    size_t maxObjects = std::min<size_t>(TEST_MAX_OBJECTS, EI_CLASSIFIER_OBJECT_TRACKING_MAX_DETECTIONS);
+    if (objects.size() < maxObjects && rng() % 4 == 0) {
+        objects.push_back({ (float)(rng() % 300), (float)(rng() % 300), (float)((int)(rng() % 11) - 5),
+                            (float)((int)(rng() % 11) - 5), (uint32_t)(8 + rng() % 24), (uint32_t)(8 + rng() % 24) });
+    }
+    if (!objects.empty() && rng() % 10 == 0) {
+        objects.erase(objects.begin() + rng() % objects.size());
+    }
+    detections.clear();
+    for (TestObject& o : objects) {
+        o.x = std::max(0.0f, o.x + o.vx);
+        o.y = std::max(0.0f, o.y + o.vy);
+        if (rng() % 8 == 0) continue;
+        const char* label = labels[rng() % 2];
+        uint32_t x = (uint32_t)o.x + rng() % 3;
+        uint32_t y = (uint32_t)o.y + rng() % 3;
+        detections.push_back({ label, x, y, o.width, o.height, 0.5f + (rng() % 50) / 100.0f });
+    }
+    std::shuffle(detections.begin(), detections.end(), rng);
+}
+
+static bool sameTraces(const Tracker& tracker, const TestStaticTracker& staticTracker) {
+    if (tracker.object_tracking_output.size() != staticTracker.object_tracking_output_count) return false;
+    for (size_t i = 0; i < staticTracker.object_tracking_output_count; i++) {
+        const ei_object_tracking_trace_t& a = tracker.object_tracking_output[i];
+        const ei_object_tracking_trace_t& b = staticTracker.object_tracking_output[i];
+        if (a.id != b.id || a.x != b.x || a.y != b.y || a.width != b.width || a.height != b.height ||
+                a.last_ground_truth_update_t != b.last_ground_truth_update_t ||
+                a.last_centroid_segment != b.last_centroid_segment || strcmp(a.label, b.label) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Both trackers side by side on every stream, the open traces compared after
+// every frame
+static void runStreams(bool useIou) {
+    std::vector<TestObject> objects;
+    std::vector<ei_impulse_result_bounding_box_t> detections;
+    size_t tracesSeen = 0;
+    for (int stream = 0; stream < TEST_STREAMS; stream++) {
+        std::mt19937 rng(stream);
+        float threshold = useIou ? TEST_IOU : TEST_DISTANCE;
+        Tracker tracker(5, 5, threshold, useIou);
+        std::unique_ptr<TestStaticTracker> staticTracker(new TestStaticTracker(5, 5, threshold, useIou));
+        objects.clear();
+        for (int frame = 0; frame < TEST_FRAMES; frame++) {
+            makeFrame(rng, objects, detections);
+            tracker.process_new_detections(detections);
+            size_t before = allocations;
+            staticTracker->process_new_detections(detections.data(), detections.size());
+            TEST_ASSERT_EQUAL_size_t(before, allocations);
+            if (!sameTraces(tracker, *staticTracker)) {
+                char message[64];
+                snprintf(message, sizeof(message), "traces differ (stream %d, frame %d)", stream, frame);
+                TEST_FAIL_MESSAGE(message);
+            }
+            tracesSeen += staticTracker->object_tracking_output_count;
+        }
+    }
+    // Streams that never opened a trace would compare nothing
+    TEST_ASSERT_GREATER_THAN(TEST_STREAMS * TEST_FRAMES, tracesSeen);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_static_tracker_matches_tracker_with_iou(void) {
+    runStreams(true);
+}
+
+void test_static_tracker_matches_tracker_with_centroid_distance(void) {
+    runStreams(false);
+}
+
+void test_detections_and_traces_beyond_capacity_are_dropped(void) {
+    std::vector<ei_impulse_result_bounding_box_t> detections;
+    for (uint32_t i = 6; i-- > 0;) detections.push_back({ "bee", i * 40, 10, 20, 20, 0.9f });
+
+    // The first ones passed in are kept (x 200, 160 and 120), in the tracker's order
+    StaticTracker<8, 3> fewDetections(5, 5, TEST_IOU, true);
+    fewDetections.process_new_detections(detections.data(), detections.size());
+    TEST_ASSERT_EQUAL_size_t(3, fewDetections.object_tracking_output_count);
+    for (size_t i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT32(120 + i * 40, fewDetections.object_tracking_output[i].x);
+    }
+
+    StaticTracker<2, 8> fewTraces(5, 5, TEST_IOU, true);
+    for (int frame = 0; frame < 4; frame++) {
+        size_t before = allocations;
+        fewTraces.process_new_detections(detections.data(), detections.size());
+        TEST_ASSERT_EQUAL_size_t(before, allocations);
+        TEST_ASSERT_EQUAL_size_t(2, fewTraces.object_tracking_output_count);
+        for (auto& d : detections) d.y += 2;
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_static_tracker_matches_tracker_with_iou);
+    RUN_TEST(test_static_tracker_matches_tracker_with_centroid_distance);
+    RUN_TEST(test_detections_and_traces_beyond_capacity_are_dropped);
+    return UNITY_END();
+}
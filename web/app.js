@@ -0,0 +1,37 @@
+// Shared script of the web UI: footer and the ?success message of the pages
+
+function updateTime() {
+    const timeElement = document.getElementById('footer-time');
+    if (timeElement) {
+        const now = new Date();
+        const year = now.getFullYear();
+        const month = String(now.getMonth() + 1).padStart(2, '0');
+        const day = String(now.getDate()).padStart(2, '0');
+        const hours = String(now.getHours()).padStart(2, '0');
+        const minutes = String(now.getMinutes()).padStart(2, '0');
+        timeElement.textContent = `${year}-${month}-${day} ${hours}:${minutes}`;
+    }
+}
+
+// The page shells are the same for every device, the few per device values
+// come from /api/ui
+function loadDeviceInfo() {
+    const nameElement = document.getElementById('footer-device');
+    if (!nameElement) return;
+    fetch('/api/ui')
+        .then(response => response.json())
+        .then(info => {
+            nameElement.textContent = info.device_name;
+            document.getElementById('footer-version').textContent = 'v' + info.version;
+        });
+}
+
+document.addEventListener('DOMContentLoaded', function() {
+    const message = document.getElementById('success-message');
+    if (message && new URLSearchParams(window.location.search).has('success')) {
+        message.hidden = false;
+    }
+    loadDeviceInfo();
+    updateTime();
+    setInterval(updateTime, 60000);
+});
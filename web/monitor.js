@@ -0,0 +1,108 @@
+let refreshInterval;
+
+function showCameraStream() {
+    document.getElementById('camera-stream').style.display = 'block';
+    document.getElementById('camera-error').style.display = 'none';
+    startAutoRefresh();
+}
+
+function showCameraError() {
+    document.getElementById('camera-stream').style.display = 'none';
+    document.getElementById('camera-error').style.display = 'block';
+    document.getElementById('camera-error').textContent = 'Camera feed not available.';
+    stopAutoRefresh();
+}
+
+function refreshCamera() {
+    const img = document.getElementById('camera-stream');
+    const timestamp = new Date().getTime();
+    img.src = '/stream?t=' + timestamp;
+}
+
+function startAutoRefresh() {
+    stopAutoRefresh();
+    refreshInterval = setInterval(refreshCamera, 500); // Refresh every 500ms
+}
+
+function stopAutoRefresh() {
+    if (refreshInterval) {
+        clearInterval(refreshInterval);
+        refreshInterval = null;
+    }
+}
+
+function updateQualityDisplay(value) {
+    document.getElementById('quality-val').innerText = value;
+    const qualityDesc = value <= 10 ? 'Excellent' : 
+                       value <= 20 ? 'Very Good' : 
+                       value <= 35 ? 'Good' : 
+                       value <= 50 ? 'Fair' : 'Low';
+    document.getElementById('quality-val').innerText = value + ' (' + qualityDesc + ')';
+}
+
+function loadCurrentSettings() {
+    fetch('/status')
+        .then(response => response.json())
+        .then(data => {
+            // Update current settings display
+            const resolutionNames = {
+                0: 'QVGA (320x240)', 1: 'CIF (400x296)', 2: 'HVGA (480x320)', 
+                3: 'VGA (640x480)', 4: 'SVGA (800x600)', 5: 'XGA (1024x768)', 
+                6: 'HD (1280x720)', 7: 'SXGA (1280x1024)', 8: 'UXGA (1600x1200)', 
+                9: 'FHD (1920x1080)', 13: 'QXGA (2048x1536)'
+            };
+            const currentRes = resolutionNames[data.framesize] || 'Unknown';
+            document.getElementById('current-resolution').innerText = currentRes;
+            document.getElementById('current-quality').innerText = data.quality + ' (' + 
+                (data.quality <= 10 ? 'Excellent' : 
+                 data.quality <= 20 ? 'Very Good' : 
+                 data.quality <= 35 ? 'Good' : 
+                 data.quality <= 50 ? 'Fair' : 'Low') + ')';
+        })
+        .catch(error => {
+            console.error('Failed to load current settings:', error);
+            document.getElementById('current-resolution').innerText = 'Error';
+            document.getElementById('current-quality').innerText = 'Error';
+        });
+}
+
+function saveCameraSettings() {
+    const resolution = document.getElementById('resolution').value;
+    const quality = document.getElementById('quality').value;
+
+    console.log('Saving camera settings:', resolution, quality);
+
+    fetch('/api/camera-settings', {
+        method: 'POST',
+        headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+        body: `resolution=${resolution}&quality=${quality}`
+    }).then(response => {
+        console.log('Response status:', response.status);
+        if (response.ok) {
+            loadCurrentSettings(); // Refresh current settings
+            alert('Camera settings saved successfully!');
+        } else {
+            response.text().then(errorText => {
+                console.error('Error response:', errorText);
+                alert('Failed to save camera settings: ' + errorText);
+            });
+        }
+    }).catch(error => {
+        console.error('Network error:', error);
+        alert('Network error: ' + error.message);
+    });
+}
+
+// Load current settings when page loads
+document.addEventListener('DOMContentLoaded', function() {
+    loadCurrentSettings();
+    updateQualityDisplay(document.getElementById('quality').value);
+    // The first frame may have arrived before this deferred script defined its handlers
+    const img = document.getElementById('camera-stream');
+    if (img.complete) {
+        if (img.naturalWidth > 0) showCameraStream(); else showCameraError();
+    }
+});
+
+// Clean up interval when page is unloaded
+window.addEventListener('beforeunload', stopAutoRefresh);
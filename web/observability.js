@@ -0,0 +1,396 @@
+document.addEventListener('DOMContentLoaded', function() {
+    console.log("Observability page JavaScript loaded and DOMContentLoaded fired.");
+    // --- Chart.js Configuration ---
+    const chartOptions = (title, threshold) => ({
+        responsive: true,
+        maintainAspectRatio: false,
+        scales: {
+            x: { ticks: { color: '#FFC300' }, grid: { color: '#444' } },
+            y: { ticks: { color: '#FFC300' }, grid: { color: '#444' } }
+        },
+        plugins: {
+            legend: { labels: { color: '#FFC300' } },
+            annotation: {
+                annotations: {
+                    line1: {
+                        type: 'line',
+                        yMin: threshold,
+                        yMax: threshold,
+                        borderColor: 'rgb(211, 47, 47, 0.8)',
+                        borderWidth: 2,
+                        borderDash: [6, 6],
+                        label: {
+                            content: title,
+                            position: 'end',
+                            backgroundColor: 'rgba(211, 47, 47, 0.8)',
+                            color: '#fff',
+                            font: { style: 'normal' }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+     const doughnutChartOptions = {
+        responsive: true,
+        maintainAspectRatio: false,
+        plugins: { legend: { position: 'top', labels: { color: '#FFC300' } } }
+    };
+
+    // --- CPU Chart ---
+    const cpuCtx = document.getElementById('cpu-chart').getContext('2d');
+    const cpuChart = new Chart(cpuCtx, {
+        type: 'line',
+        data: {
+            labels: [],
+            datasets: [{ label: 'CPU Core 0 (%)', data: [], borderColor: '#FFC300', backgroundColor: 'rgba(255, 195, 0, 0.2)', fill: true }, {
+                label: 'CPU Core 1 (%)', data: [], borderColor: '#00A8E8', backgroundColor: 'rgba(0, 168, 232, 0.2)', fill: true
+            }]
+        },
+        options: chartOptions('High Load', 70)
+    });
+
+    // --- Temperature Chart ---
+    const tempCtx = document.getElementById('temp-chart').getContext('2d');
+    const tempChart = new Chart(tempCtx, {
+        type: 'line',
+        data: {
+            labels: [],
+            datasets: [{ label: 'CPU Temp (°C)', data: [], borderColor: '#FF5722', backgroundColor: 'rgba(255, 87, 34, 0.2)', fill: true }]
+        },
+        options: chartOptions('High Temp', 60)
+    });
+
+    // --- Wi-Fi Chart ---
+    const wifiCtx = document.getElementById('wifi-chart').getContext('2d');
+    const wifiChart = new Chart(wifiCtx, {
+        type: 'line',
+        data: {
+            labels: [],
+            datasets: [{ label: 'WiFi RSSI (dBm)', data: [], borderColor: '#4CAF50', backgroundColor: 'rgba(76, 175, 80, 0.2)', fill: true }]
+        },
+        options: chartOptions('Poor Signal', -70)
+    });
+
+    // --- Memory Chart ---
+    const memoryCtx = document.getElementById('memory-chart').getContext('2d');
+    const memoryChart = new Chart(memoryCtx, {
+        type: 'doughnut',
+        data: {
+            labels: ['Used Heap (bytes)', 'Free Heap (bytes)'],
+            datasets: [{ data: [0, 0], backgroundColor: ['#FFC300', '#444'] }]
+        },
+        options: doughnutChartOptions
+    });
+
+    // --- Storage Chart ---
+    const storageCtx = document.getElementById('storage-chart').getContext('2d');
+    const storageChart = new Chart(storageCtx, {
+        type: 'doughnut',
+        data: {
+            labels: ['Used Flash (bytes)', 'Free Flash (bytes)'],
+            datasets: [{ data: [0, 0], backgroundColor: ['#00A8E8', '#444'] }]
+        },
+        options: doughnutChartOptions
+    });
+
+    // --- Telemetry ---
+    // Binary frames from /ws/telemetry: version, sample count, then per sample
+    // one zigzag varint per field, each the change from the previous sample
+    // (from zero for the first). See include/telemetry.h.
+    const TELEMETRY_FRAME_VERSION = 1;
+    const TELEMETRY_FIELDS = ['ms', 'cpu0', 'cpu1', 'heapFree', 'heapTotal', 'flashUsed', 'flashTotal', 'rssi', 'temp'];
+    const CHART_POINTS = 60;
+
+    function decodeTelemetry(buffer) {
+        const bytes = new Uint8Array(buffer);
+        if (bytes.length < 2 || bytes[0] !== TELEMETRY_FRAME_VERSION) return [];
+        const samples = [];
+        const previous = new Array(TELEMETRY_FIELDS.length).fill(0);
+        let at = 2;
+        for (let i = 0; i < bytes[1]; i++) {
+            const sample = {};
+            TELEMETRY_FIELDS.forEach((field, f) => {
+                // Up to 32 bits, so no bit operators on the whole value
+                let zigzag = 0, scale = 1, b;
+                do {
+                    b = bytes[at++];
+                    zigzag += (b & 0x7f) * scale;
+                    scale *= 128;
+                } while (b & 0x80);
+                const delta = zigzag % 2 ? -(zigzag + 1) / 2 : zigzag / 2;
+                previous[f] = (previous[f] + delta) | 0;
+                sample[field] = previous[f];
+            });
+            sample.ms >>>= 0;
+            samples.push(sample);
+        }
+        return samples;
+    }
+
+    function pushPoint(chart, label, values) {
+        chart.data.labels.push(label);
+        values.forEach((value, i) => chart.data.datasets[i].data.push(value));
+        if (chart.data.labels.length > CHART_POINTS) {
+            chart.data.labels.shift();
+            chart.data.datasets.forEach(dataset => dataset.data.shift());
+        }
+    }
+
+    function showTelemetry(samples) {
+        if (samples.length === 0) return;
+        // Samples carry the device's millis(), placed relative to the newest
+        const now = Date.now();
+        const newest = samples[samples.length - 1].ms;
+        samples.forEach(sample => {
+            const timestamp = historyLabel(new Date(now - ((newest - sample.ms) >>> 0)), 1);
+            pushPoint(cpuChart, timestamp, [sample.cpu0 / 10, sample.cpu1 / 10]);
+            pushPoint(tempChart, timestamp, [sample.temp / 10]);
+            pushPoint(wifiChart, timestamp, [sample.rssi]);
+        });
+        cpuChart.update();
+        tempChart.update();
+        wifiChart.update();
+
+        const last = samples[samples.length - 1];
+        const heapUsed = last.heapTotal - last.heapFree;
+        const heapUsedPercent = (heapUsed / last.heapTotal) * 100;
+        memoryChart.data.datasets[0].backgroundColor[0] = heapUsedPercent > 70 ? '#D32F2F' : '#FFC300';
+        memoryChart.data.datasets[0].data[0] = heapUsed;
+        memoryChart.data.datasets[0].data[1] = last.heapFree;
+        memoryChart.update();
+
+        const flashUsedPercent = (last.flashUsed / last.flashTotal) * 100;
+        storageChart.data.datasets[0].backgroundColor[0] = flashUsedPercent > 70 ? '#D32F2F' : '#00A8E8';
+        storageChart.data.datasets[0].data[0] = last.flashUsed;
+        storageChart.data.datasets[0].data[1] = last.flashTotal - last.flashUsed;
+        storageChart.update();
+    }
+
+    function connectTelemetry() {
+        const scheme = location.protocol === 'https:' ? 'wss://' : 'ws://';
+        const socket = new WebSocket(scheme + location.host + '/ws/telemetry');
+        socket.binaryType = 'arraybuffer';
+        socket.onopen = function() { console.log("Telemetry connected"); };
+        socket.onmessage = function(e) {
+            if (e.data instanceof ArrayBuffer) showTelemetry(decodeTelemetry(e.data));
+        };
+        // The device stops sampling while nobody is connected, so reconnect
+        socket.onclose = function() {
+            console.log("Telemetry disconnected");
+            setTimeout(connectTelemetry, 5000);
+        };
+    }
+
+    // --- History ---
+    // /api/telemetry/history: version, tier count, field count, u32 device
+    // time, then per tier u16 seconds per record, u16 record count and the
+    // records as zigzag varint deltas like the live frames. See
+    // include/telemetry_history.h.
+    const HISTORY_VERSION = 1;
+    const HISTORY_FIELDS = ['time', 'cpu0', 'cpu1', 'heapFree', 'psramFree', 'rssi', 'temp', 'fps', 'beesIn', 'beesOut'];
+    const HISTORY_METRICS = {
+        cpu:   [['CPU Core 0 (%)', r => r.cpu0 / 10, '#FFC300'], ['CPU Core 1 (%)', r => r.cpu1 / 10, '#00A8E8']],
+        heap:  [['Lowest Free Heap (bytes)', r => r.heapFree, '#FFC300']],
+        psram: [['Lowest Free PSRAM (bytes)', r => r.psramFree, '#00A8E8']],
+        rssi:  [['WiFi RSSI (dBm)', r => r.rssi, '#4CAF50']],
+        temp:  [['CPU Temp (°C)', r => r.temp / 10, '#FF5722']],
+        fps:   [['Camera Frame Rate (fps)', r => r.fps / 10, '#FFC300']],
+        bees:  [['Bees In', r => r.beesIn, '#4CAF50'], ['Bees Out', r => r.beesOut, '#FF5722']]
+    };
+    let history = null;
+
+    function decodeHistory(buffer) {
+        const bytes = new Uint8Array(buffer);
+        const view = new DataView(buffer);
+        if (bytes.length < 7 || bytes[0] !== HISTORY_VERSION || bytes[2] !== HISTORY_FIELDS.length) return null;
+        const result = { now: view.getUint32(3, true), tiers: {} };
+        let at = 7;
+        for (let t = 0; t < bytes[1]; t++) {
+            const seconds = view.getUint16(at, true);
+            const count = view.getUint16(at + 2, true);
+            at += 4;
+            const records = [];
+            const previous = new Array(HISTORY_FIELDS.length).fill(0);
+            for (let i = 0; i < count; i++) {
+                const record = {};
+                HISTORY_FIELDS.forEach((field, f) => {
+                    let zigzag = 0, scale = 1, b;
+                    do {
+                        b = bytes[at++];
+                        zigzag += (b & 0x7f) * scale;
+                        scale *= 128;
+                    } while (b & 0x80);
+                    const delta = zigzag % 2 ? -(zigzag + 1) / 2 : zigzag / 2;
+                    previous[f] = (previous[f] + delta) | 0;
+                    record[field] = previous[f];
+                });
+                record.time >>>= 0;
+                records.push(record);
+            }
+            result.tiers[seconds] = records;
+        }
+        return result;
+    }
+
+    // Records are placed by the device clock relative to its time now, so
+    // they line up even before it had NTP
+    function historyDate(record) {
+        return new Date(Date.now() - (history.now - record.time) * 1000);
+    }
+
+    function historyLabel(date, seconds) {
+        const pad = n => String(n).padStart(2, '0');
+        const time = `${pad(date.getHours())}:${pad(date.getMinutes())}`;
+        if (seconds < 60) return `${time}:${pad(date.getSeconds())}`;
+        return seconds < 3600 ? time : `${date.getMonth() + 1}/${date.getDate()} ${time}`;
+    }
+
+    const historyChart = new Chart(document.getElementById('history-chart').getContext('2d'), {
+        type: 'line',
+        data: { labels: [], datasets: [] },
+        options: {
+            responsive: true,
+            maintainAspectRatio: false,
+            elements: { point: { radius: 0 } },
+            scales: {
+                x: { ticks: { color: '#FFC300', maxTicksLimit: 12 }, grid: { color: '#444' } },
+                y: { ticks: { color: '#FFC300' }, grid: { color: '#444' } }
+            },
+            plugins: { legend: { labels: { color: '#FFC300' } } }
+        }
+    });
+
+    function renderHistory() {
+        if (!history) return;
+        const seconds = parseInt(document.getElementById('history-tier').value);
+        const records = history.tiers[seconds] || [];
+        const metric = HISTORY_METRICS[document.getElementById('history-metric').value];
+        historyChart.data.labels = records.map(r => historyLabel(historyDate(r), seconds));
+        historyChart.data.datasets = metric.map(([label, value, color]) => ({
+            label: label, data: records.map(value), borderColor: color, borderWidth: 1.5, fill: false
+        }));
+        historyChart.update();
+    }
+
+    // The live charts start with the last minute from the seconds tier
+    function seedLiveCharts() {
+        const records = (history.tiers[1] || []).slice(-CHART_POINTS);
+        records.forEach(r => {
+            const timestamp = historyLabel(historyDate(r), 1);
+            pushPoint(cpuChart, timestamp, [r.cpu0 / 10, r.cpu1 / 10]);
+            pushPoint(tempChart, timestamp, [r.temp / 10]);
+            pushPoint(wifiChart, timestamp, [r.rssi]);
+        });
+        cpuChart.update();
+        tempChart.update();
+        wifiChart.update();
+    }
+
+    // The live frames only start once the charts have the history
+    fetch('/api/telemetry/history').then(r => r.arrayBuffer()).then(buffer => {
+        history = decodeHistory(buffer);
+        if (!history) return;
+        seedLiveCharts();
+        renderHistory();
+    }).catch(e => console.error("History not loaded:", e)).finally(connectTelemetry);
+    fetch('/api/telemetry').then(r => r.json()).then(data => {
+        document.getElementById('history-snapshot').checked = data.history.snapshot;
+    });
+    document.getElementById('history-tier').addEventListener('change', renderHistory);
+    document.getElementById('history-metric').addEventListener('change', renderHistory);
+    document.getElementById('history-snapshot').addEventListener('change', function() {
+        fetch('/api/telemetry/history', {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+            body: 'snapshot=' + (this.checked ? '1' : '0')
+        });
+    });
+
+    // --- Server-Sent Events ---
+    if (!!window.EventSource) {
+        var source = new EventSource('/events');
+
+        source.onopen = function(e) { console.log("Events Connected"); };
+        source.onerror = function(e) { 
+            console.error("EventSource error:", e);
+            if (e.target.readyState != EventSource.OPEN) { console.log("Events Disconnected"); } 
+        };
+    }
+
+    // --- Inference Profile ---
+    let profileHistory = [];
+    let profileHistorySize = 8;
+
+    function renderProfile(highWater) {
+        const tbody = document.getElementById('profiler-ops');
+        tbody.innerHTML = '';
+        if (profileHistory.length === 0) {
+            document.getElementById('profiler-summary').textContent = 'No profiled inference yet.';
+            return;
+        }
+        const last = profileHistory[profileHistory.length - 1];
+        let summary = `Last invoke: ${(last.invoke_us / 1000).toFixed(1)} ms, arena: ${last.arena_used} / ${last.arena_size} bytes (high-water ${highWater})`;
+        if (last.ops_dropped > 0) summary += `, ${last.ops_dropped} operators not shown`;
+        document.getElementById('profiler-summary').textContent = summary;
+
+        // Average each operator position over the invocations of the same graph
+        const total = last.ops.reduce((sum, op) => sum + op.us, 0);
+        last.ops.forEach((op, i) => {
+            let sum = 0, n = 0;
+            profileHistory.forEach(inv => {
+                if (inv.ops.length === last.ops.length && inv.ops[i].op === op.op) { sum += inv.ops[i].us; n++; }
+            });
+            const share = total > 0 ? (op.us * 100 / total).toFixed(1) : '0.0';
+            const row = document.createElement('tr');
+            row.style.borderBottom = '1px solid #444';
+            row.innerHTML = `<td>${i}</td><td>${op.op}</td><td style='text-align: right;'>${op.us}</td><td style='text-align: right;'>${Math.round(sum / n)}</td><td style='text-align: right;'>${share}%</td>`;
+            tbody.appendChild(row);
+        });
+    }
+
+    function loadProfile() {
+        fetch('/api/profiler').then(r => r.json()).then(data => {
+            document.getElementById('profiler-enabled').checked = data.enabled;
+            profileHistorySize = data.history;
+            // The endpoint lists the newest invocation first
+            profileHistory = data.invocations.reverse();
+            renderProfile(data.arena_high_water);
+        });
+    }
+
+    function postProfiler(body) {
+        return fetch('/api/profiler', {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+            body: body
+        });
+    }
+
+    document.getElementById('profiler-enabled').addEventListener('change', function() {
+        postProfiler('enabled=' + (this.checked ? '1' : '0'));
+    });
+    document.getElementById('profiler-clear').addEventListener('click', function() {
+        postProfiler('clear=1').then(loadProfile);
+    });
+    if (source) {
+        source.addEventListener('profiler_update', function(e) {
+            const data = JSON.parse(e.data);
+            profileHistory.push(data.invocation);
+            if (profileHistory.length > profileHistorySize) profileHistory.shift();
+            renderProfile(data.arena_high_water);
+        }, false);
+    }
+    loadProfile();
+
+    // --- Refresh Rate Control ---
+    const refreshRateSelect = document.getElementById('refresh-rate');
+    refreshRateSelect.addEventListener('change', function() {
+        fetch('/api/set-refresh-rate', {
+            method: 'POST',
+            headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+            body: 'rate=' + this.value
+        });
+    });
+});
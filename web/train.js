@@ -0,0 +1,138 @@
+function startCollection() { fetch('/api/capture/start', { method: 'POST' }).then(() => alert('Collection Started!')); }
+function stopCollection() { fetch('/api/capture/stop', { method: 'POST' }).then(() => alert('Collection Stopped!')); }
+function takePhoto() { fetch('/api/capture/photo', { method: 'POST' }).then(() => setTimeout(loadImageGallery, 500)); }
+function saveEdgeImpulseSettings() {
+    const apiKey = document.getElementById('ei-api-key').value;
+    fetch('/api/edgeimpulse/settings', {
+        method: 'POST',
+        headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+        body: `ei-api-key=${apiKey}`
+    }).then(response => {
+        if (response.ok) { window.location.href = '/train?success=1'; } 
+        else { alert('Failed to save settings.'); }
+    });
+}
+function uploadToEdgeImpulse() {
+    const label = document.getElementById('ei-label').value;
+    if (!label) { alert('Please provide a label for the images.'); return; }
+    document.getElementById('upload-status').innerText = 'Status: Starting upload...';
+    fetch('/api/edgeimpulse/upload', { 
+        method: 'POST',
+        headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+        body: `ei-label=${label}`
+    });
+}
+
+function loadModelInfo() {
+    fetch('/api/model')
+        .then(response => response.json())
+        .then(model => {
+            document.getElementById('model-info').innerText = model.loaded
+                ? `Current model: ${model.name} (${(model.size / 1024).toFixed(1)} KB of ${(model.capacity / 1024).toFixed(0)} KB, crc ${model.crc32})`
+                : `Current model: none (${model.error})`;
+        });
+}
+function downloadModel() {
+    const url = document.getElementById('model-url').value;
+    if (!url) { alert('Please provide a model URL.'); return; }
+    document.getElementById('model-status').innerText = 'Status: Starting download...';
+    fetch('/api/edgeimpulse/download-model', {
+        method: 'POST',
+        headers: { 'Content-Type': 'application/x-www-form-urlencoded' },
+        body: `model-url=${encodeURIComponent(url)}`
+    }).then(response => response.text()).then(text => {
+        document.getElementById('model-status').innerText = `Status: ${text}`;
+    });
+}
+function uploadModel() {
+    const file = document.getElementById('model-file').files[0];
+    if (!file) { alert('Please choose a .tflite file.'); return; }
+    const form = new FormData();
+    form.append('name', file.name);
+    form.append('model', file);
+    document.getElementById('model-status').innerText = 'Status: Uploading...';
+    fetch('/api/model/upload', { method: 'POST', body: form })
+        .then(response => response.text())
+        .then(text => {
+            document.getElementById('model-status').innerText = `Status: ${text}`;
+            loadModelInfo();
+        });
+}
+
+let galleryCursor = 0;
+
+// Pages through /api/images, the next page is fetched from the cursor the
+// last one returned
+function loadImagePage() {
+    fetch('/api/images?limit=48&cursor=' + galleryCursor)
+        .then(response => response.json())
+        .then(page => {
+            const gallery = document.getElementById('image-gallery');
+            document.getElementById('img-count').innerText = page.total;
+            page.images.forEach(image => {
+                const container = document.createElement('div');
+                container.className = 'img-container';
+                container.title = image.label ? `${image.name} (${image.label})` : image.name;
+                // The thumbnail in the gallery, the image itself on click
+                const link = document.createElement('a');
+                link.href = '/images?serve=' + encodeURIComponent(image.name);
+                link.target = '_blank';
+                const img = document.createElement('img');
+                img.loading = 'lazy';
+                img.src = '/images?thumb=' + encodeURIComponent(image.name);
+                link.appendChild(img);
+                const btn = document.createElement('button');
+                btn.className = 'delete-btn';
+                btn.innerHTML = '&times;';
+                btn.onclick = () => deleteImage(image.name);
+                container.appendChild(link);
+                container.appendChild(btn);
+                gallery.appendChild(container);
+            });
+            galleryCursor = page.next;
+            document.getElementById('gallery-more').style.display = page.next === null ? 'none' : '';
+        });
+}
+
+function loadImageGallery() {
+    galleryCursor = 0;
+    document.getElementById('image-gallery').innerHTML = '';
+    loadImagePage();
+}
+
+function deleteImage(filename) {
+    if (confirm('Are you sure you want to delete ' + filename + '?')) {
+        fetch('/images?delete=' + encodeURIComponent(filename)).then(() => loadImageGallery());
+    }
+}
+
+function loadEdgeImpulseSettings() {
+    fetch('/api/edgeimpulse/settings')
+        .then(response => response.json())
+        .then(settings => { document.getElementById('ei-api-key').value = settings.api_key; });
+}
+
+document.addEventListener('DOMContentLoaded', function() {
+    loadEdgeImpulseSettings();
+    loadImageGallery();
+    loadModelInfo();
+    const source = new EventSource('/events');
+    source.addEventListener('collection_update', function(e) {
+        const data = JSON.parse(e.data);
+        const progressBar = document.getElementById('progress-bar');
+        progressBar.style.width = data.progress + '%';
+        progressBar.innerText = data.progress + '%';
+        document.getElementById('collection-status').innerText = `Status: Collecting (${data.collected}/${data.total})`;
+        if (data.progress === 100) {
+             document.getElementById('collection-status').innerText = 'Status: Collection Complete!';
+             setTimeout(loadImageGallery, 500);
+        }
+    });
+    source.addEventListener('ei_upload_status', function(e) {
+        document.getElementById('upload-status').innerText = `Status: ${e.data}`;
+    });
+    source.addEventListener('ei_model_status', function(e) {
+        document.getElementById('model-status').innerText = `Status: ${e.data}`;
+        if (e.data.startsWith('Model loaded')) loadModelInfo();
+    });
+});